@@ -0,0 +1,51 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * sha512_ce_glue.c - SHA-384/SHA-512 secure hash using ARMv8.2 Crypto
+ * Extensions
+ */
+
+#include <common.h>
+#include <asm/global_data.h>
+#include <u-boot/sha512.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* ID_AA64ISAR0_EL1.SHA2 is 2 when SHA512H and friends are implemented */
+#define ID_AA64ISAR0_SHA2_SHIFT		12
+#define ID_AA64ISAR0_SHA2_SHA512	2
+
+extern void sha512_armv8_ce_process(uint64_t state[8], uint8_t const *src,
+				    uint32_t blocks);
+
+static bool sha512_ce_probe(void)
+{
+	u64 isar0;
+
+	asm volatile("mrs %0, id_aa64isar0_el1" : "=r" (isar0));
+
+	return ((isar0 >> ID_AA64ISAR0_SHA2_SHIFT) & 0xf) >=
+		ID_AA64ISAR0_SHA2_SHA512;
+}
+
+static bool sha512_ce_available(void)
+{
+	/* Read the ID register once, gd being writable before relocation */
+	if (!gd->arch.sha512_ce)
+		gd->arch.sha512_ce = sha512_ce_probe() ? 1 : -1;
+
+	return gd->arch.sha512_ce > 0;
+}
+
+void sha512_process(sha512_context *ctx, const unsigned char *data,
+		    unsigned int blocks)
+{
+	if (!blocks)
+		return;
+
+	if (!sha512_ce_available()) {
+		sha512_process_generic(ctx, data, blocks);
+		return;
+	}
+
+	sha512_armv8_ce_process(ctx->state, data, blocks);
+}
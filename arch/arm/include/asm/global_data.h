@@ -97,6 +97,9 @@ struct arch_global_data {
 	u32 uid[4];
 #endif
 
+#ifdef CONFIG_ARMV8_CE_SHA512
+	int sha512_ce;		/* >0 SHA-512 insns present, <0 absent, 0 not probed */
+#endif
 };
 
 #include <asm-generic/global_data.h>
@@ -315,4 +315,15 @@ int sandbox_sdl_set_bpp(struct udevice *dev, enum video_log2_bpp l2bpp);
  */
 void sandbox_set_fake_efi_mgr_dev(struct udevice *dev, bool fake_dev);
 
+/**
+ * sandbox_mmc_cqe_max_queued() - Get the deepest command queue seen
+ *
+ * This is only used for testing.
+ *
+ * @dev: MMC device
+ * Return: largest number of tasks queued at once since the device was
+ * probed
+ */
+uint sandbox_mmc_cqe_max_queued(struct udevice *dev);
+
 #endif
@@ -0,0 +1,91 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * SHA-1 block function using the Intel SHA extensions
+ *
+ * Based on the sample code in Intel's "Intel SHA Extensions" white paper.
+ */
+
+#include <common.h>
+#include <u-boot/sha1.h>
+#include "sha_ni.h"
+
+/*
+ * Four rounds on message words 4g..4g+3 held in @cur, with @e carrying E
+ * into them and @e_next saving A for the next group. The schedule for later
+ * words is advanced in @prev, @next and @next2 along the way.
+ */
+#define SHA1_ROUNDS4(g, cur, prev, next, next2, e, e_next)		\
+	do {								\
+		if ((g) == 0)						\
+			e += cur;					\
+		else							\
+			e = __builtin_ia32_sha1nexte(e, cur);		\
+		e_next = abcd;						\
+		if ((g) >= 3 && (g) <= 18)				\
+			next = __builtin_ia32_sha1msg2(next, cur);	\
+		abcd = __builtin_ia32_sha1rnds4(abcd, e, (g) / 5);	\
+		if ((g) >= 1 && (g) <= 16)				\
+			prev = __builtin_ia32_sha1msg1(prev, cur);	\
+		if ((g) >= 2 && (g) <= 17)				\
+			next2 ^= cur;					\
+	} while (0)
+
+static void __sha_ni sha1_ni_blocks(u32 state[5], const u8 *data,
+				    unsigned int blocks)
+{
+	const v4si mask = { 0x0c0d0e0f, 0x08090a0b, 0x04050607, 0x00010203 };
+	v4si abcd, e0, e1, abcd_save, e0_save;
+	v4si m0, m1, m2, m3;
+
+	abcd = sha_ni_shuffle(sha_ni_load(&state[0]), 0x1b);
+	e0 = (v4si){ 0, 0, 0, state[4] };
+
+	while (blocks--) {
+		abcd_save = abcd;
+		e0_save = e0;
+
+		m0 = sha_ni_bswap(sha_ni_load(data), mask);
+		SHA1_ROUNDS4(0, m0, m3, m1, m2, e0, e1);
+		m1 = sha_ni_bswap(sha_ni_load(data + 16), mask);
+		SHA1_ROUNDS4(1, m1, m0, m2, m3, e1, e0);
+		m2 = sha_ni_bswap(sha_ni_load(data + 32), mask);
+		SHA1_ROUNDS4(2, m2, m1, m3, m0, e0, e1);
+		m3 = sha_ni_bswap(sha_ni_load(data + 48), mask);
+		SHA1_ROUNDS4(3, m3, m2, m0, m1, e1, e0);
+		SHA1_ROUNDS4(4, m0, m3, m1, m2, e0, e1);
+		SHA1_ROUNDS4(5, m1, m0, m2, m3, e1, e0);
+		SHA1_ROUNDS4(6, m2, m1, m3, m0, e0, e1);
+		SHA1_ROUNDS4(7, m3, m2, m0, m1, e1, e0);
+		SHA1_ROUNDS4(8, m0, m3, m1, m2, e0, e1);
+		SHA1_ROUNDS4(9, m1, m0, m2, m3, e1, e0);
+		SHA1_ROUNDS4(10, m2, m1, m3, m0, e0, e1);
+		SHA1_ROUNDS4(11, m3, m2, m0, m1, e1, e0);
+		SHA1_ROUNDS4(12, m0, m3, m1, m2, e0, e1);
+		SHA1_ROUNDS4(13, m1, m0, m2, m3, e1, e0);
+		SHA1_ROUNDS4(14, m2, m1, m3, m0, e0, e1);
+		SHA1_ROUNDS4(15, m3, m2, m0, m1, e1, e0);
+		SHA1_ROUNDS4(16, m0, m3, m1, m2, e0, e1);
+		SHA1_ROUNDS4(17, m1, m0, m2, m3, e1, e0);
+		SHA1_ROUNDS4(18, m2, m1, m3, m0, e0, e1);
+		SHA1_ROUNDS4(19, m3, m2, m0, m1, e1, e0);
+
+		e0 = __builtin_ia32_sha1nexte(e0, e0_save);
+		abcd += abcd_save;
+		data += 64;
+	}
+
+	sha_ni_store(&state[0], sha_ni_shuffle(abcd, 0x1b));
+	state[4] = e0[3];
+}
+
+void sha1_process(sha1_context *ctx, const unsigned char *data,
+		  unsigned int blocks)
+{
+	if (!blocks)
+		return;
+
+	if (sha_ni_available())
+		sha1_ni_blocks(ctx->state, data, blocks);
+	else
+		sha1_process_generic(ctx, data, blocks);
+}
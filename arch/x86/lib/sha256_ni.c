@@ -0,0 +1,108 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * SHA-256 block function using the Intel SHA extensions
+ *
+ * Based on the sample code in Intel's "Intel SHA Extensions" white paper.
+ */
+
+#include <common.h>
+#include <u-boot/sha256.h>
+#include "sha_ni.h"
+
+static const u32 sha256_k[64] __aligned(16) = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+/*
+ * Four rounds on message words 4g..4g+3 held in @cur. Along the way, finish
+ * the schedule for the words in @next and start it for those in @prev.
+ */
+#define SHA256_ROUNDS4(g, cur, prev, next)				\
+	do {								\
+		msg = cur + *(const v4si *)&sha256_k[4 * (g)];		\
+		st1 = __builtin_ia32_sha256rnds2(st1, st0, msg);	\
+		if ((g) >= 3 && (g) <= 14) {				\
+			next += sha_ni_alignr(cur, prev, 4);		\
+			next = __builtin_ia32_sha256msg2(next, cur);	\
+		}							\
+		msg = sha_ni_shuffle(msg, 0x0e);			\
+		st0 = __builtin_ia32_sha256rnds2(st0, st1, msg);	\
+		if ((g) >= 1 && (g) <= 12)				\
+			prev = __builtin_ia32_sha256msg1(prev, cur);	\
+	} while (0)
+
+static void __sha_ni sha256_ni_blocks(u32 state[8], const u8 *data,
+				      unsigned int blocks)
+{
+	const v4si mask = { 0x00010203, 0x04050607, 0x08090a0b, 0x0c0d0e0f };
+	v4si st0, st1, abef, cdgh, msg, tmp;
+	v4si m0, m1, m2, m3;
+
+	/* The instructions want the state as ABEF and CDGH */
+	tmp = sha_ni_shuffle(sha_ni_load(&state[0]), 0xb1);
+	st1 = sha_ni_shuffle(sha_ni_load(&state[4]), 0x1b);
+	st0 = sha_ni_alignr(tmp, st1, 8);
+	st1 = sha_ni_blend(st1, tmp, 0xf0);
+
+	while (blocks--) {
+		abef = st0;
+		cdgh = st1;
+
+		m0 = sha_ni_bswap(sha_ni_load(data), mask);
+		SHA256_ROUNDS4(0, m0, m3, m1);
+		m1 = sha_ni_bswap(sha_ni_load(data + 16), mask);
+		SHA256_ROUNDS4(1, m1, m0, m2);
+		m2 = sha_ni_bswap(sha_ni_load(data + 32), mask);
+		SHA256_ROUNDS4(2, m2, m1, m3);
+		m3 = sha_ni_bswap(sha_ni_load(data + 48), mask);
+		SHA256_ROUNDS4(3, m3, m2, m0);
+		SHA256_ROUNDS4(4, m0, m3, m1);
+		SHA256_ROUNDS4(5, m1, m0, m2);
+		SHA256_ROUNDS4(6, m2, m1, m3);
+		SHA256_ROUNDS4(7, m3, m2, m0);
+		SHA256_ROUNDS4(8, m0, m3, m1);
+		SHA256_ROUNDS4(9, m1, m0, m2);
+		SHA256_ROUNDS4(10, m2, m1, m3);
+		SHA256_ROUNDS4(11, m3, m2, m0);
+		SHA256_ROUNDS4(12, m0, m3, m1);
+		SHA256_ROUNDS4(13, m1, m0, m2);
+		SHA256_ROUNDS4(14, m2, m1, m3);
+		SHA256_ROUNDS4(15, m3, m2, m0);
+
+		st0 += abef;
+		st1 += cdgh;
+		data += 64;
+	}
+
+	tmp = sha_ni_shuffle(st0, 0x1b);
+	st1 = sha_ni_shuffle(st1, 0xb1);
+	sha_ni_store(&state[0], sha_ni_blend(tmp, st1, 0xf0));
+	sha_ni_store(&state[4], sha_ni_alignr(st1, tmp, 8));
+}
+
+void sha256_process(sha256_context *ctx, const unsigned char *data,
+		    unsigned int blocks)
+{
+	if (!blocks)
+		return;
+
+	if (sha_ni_available())
+		sha256_ni_blocks(ctx->state, data, blocks);
+	else
+		sha256_process_generic(ctx, data, blocks);
+}
@@ -0,0 +1,46 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * CPU feature detection for the Intel SHA extensions
+ */
+
+#include <common.h>
+#include <asm/control_regs.h>
+#include <asm/cpu.h>
+#include <asm/global_data.h>
+#include <asm/processor-flags.h>
+#include "sha_ni.h"
+
+DECLARE_GLOBAL_DATA_PTR;
+
+#define CPUID1_ECX_SSSE3	BIT(9)
+#define CPUID1_ECX_SSE4_1	BIT(19)
+#define CPUID7_EBX_SHA		BIT(29)
+
+static bool sha_ni_probe(void)
+{
+	ulong cr4;
+
+	if (cpuid_eax(0) < 7)
+		return false;
+	if ((cpuid_ecx(1) & (CPUID1_ECX_SSSE3 | CPUID1_ECX_SSE4_1)) !=
+	    (CPUID1_ECX_SSSE3 | CPUID1_ECX_SSE4_1))
+		return false;
+	if (!(cpuid_ext(7, 0).ebx & CPUID7_EBX_SHA))
+		return false;
+
+	/* The FPU is already set up, but SSE must be enabled before use */
+	cr4 = read_cr4();
+	if (!(cr4 & X86_CR4_OSFXSR))
+		write_cr4(cr4 | X86_CR4_OSFXSR | X86_CR4_OSXMMEXCPT);
+
+	return true;
+}
+
+bool sha_ni_available(void)
+{
+	/* Kept in global data, which is writable before relocation too */
+	if (!gd->arch.sha_ni)
+		gd->arch.sha_ni = sha_ni_probe() ? 1 : -1;
+
+	return gd->arch.sha_ni > 0;
+}
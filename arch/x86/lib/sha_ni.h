@@ -0,0 +1,43 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Helpers for the SHA-1 and SHA-256 code using the Intel SHA extensions
+ *
+ * U-Boot is built without SSE, so the block functions enable the needed
+ * instruction sets themselves with a target attribute and use the compiler
+ * builtins directly, since <immintrin.h> needs a hosted environment.
+ */
+
+#ifndef __X86_SHA_NI_H
+#define __X86_SHA_NI_H
+
+#include <linux/types.h>
+
+#define __sha_ni	__attribute__((target("sse4.1,sha")))
+
+typedef int v4si __attribute__((vector_size(16)));
+typedef long long v2di __attribute__((vector_size(16)));
+typedef short v8hi __attribute__((vector_size(16)));
+typedef char v16qi __attribute__((vector_size(16)));
+
+#define sha_ni_load(p)		({ v4si __v; memcpy(&__v, (p), 16); __v; })
+#define sha_ni_store(p, v)	({ v4si __v = (v); memcpy((p), &__v, 16); })
+#define sha_ni_bswap(v, mask) \
+	((v4si)__builtin_ia32_pshufb128((v16qi)(v), (v16qi)(mask)))
+#define sha_ni_shuffle(v, imm)	__builtin_ia32_pshufd((v), (imm))
+#define sha_ni_alignr(a, b, n) \
+	((v4si)__builtin_ia32_palignr128((v2di)(a), (v2di)(b), (n) * 8))
+#define sha_ni_blend(a, b, imm) \
+	((v4si)__builtin_ia32_pblendw128((v8hi)(a), (v8hi)(b), (imm)))
+
+/**
+ * sha_ni_available() - check for the SHA extensions and enable SSE
+ *
+ * The CPU is only probed on the first call, later calls return the cached
+ * answer.
+ *
+ * Return: true if the CPU supports the SHA extensions and the SSE4.1
+ * instructions the block functions use, in which case SSE has been enabled
+ */
+bool sha_ni_available(void);
+
+#endif
@@ -306,7 +306,9 @@ int bootmeth_alloc_file(struct bootflow *bflow, uint size_limit, uint align)
 	if (size > size_limit)
 		return log_msg_ret("chk", -E2BIG);
 
-	buf = memalign(align, size + 1);
+	/* Match the device's alignment so that the read is not bounced */
+	align = max_t(uint, align, fs_dma_align());
+	buf = memalign(align, ALIGN(size + 1, align));
 	if (!buf)
 		return log_msg_ret("buf", -ENOMEM);
 	addr = map_to_sysmem(buf);
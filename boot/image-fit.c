@@ -42,6 +42,13 @@ DECLARE_GLOBAL_DATA_PTR;
 #include <u-boot/sha1.h>
 #include <u-boot/sha256.h>
 #include <u-boot/sha512.h>
+#include <watchdog.h>
+#include <linux/compiler_attributes.h>
+
+/* Hash nodes calculated together in one pass over the data */
+#define FIT_HASH_JOBS_MAX	4
+/* Hash nodes of all images collected by fit_all_image_verify() */
+#define FIT_HASH_JOBS_ALL_MAX	32
 
 /*****************************************************************************/
 /* New uImage format routines */
@@ -1262,9 +1269,11 @@ int calculate_hash(const void *data, int data_len, const char *name,
 }
 
 static int fit_image_check_hash(const void *fit, int noffset, const void *data,
-				size_t size, char **err_msgp)
+				size_t size, const struct fit_hash_job *job,
+				char **err_msgp)
 {
 	ALLOC_CACHE_ALIGN_BUFFER(uint8_t, value, FIT_MAX_HASH_LEN);
+	const uint8_t *hash = value;
 	int value_len;
 	const char *algo;
 	uint8_t *fit_value;
@@ -1293,7 +1302,15 @@ static int fit_image_check_hash(const void *fit, int noffset, const void *data,
 		return -1;
 	}
 
-	if (calculate_hash(data, size, algo, value, &value_len)) {
+	if (job) {
+		/* Already calculated by fit_hash_jobs_run() */
+		if (job->ret) {
+			*err_msgp = "Hash calculation failed";
+			return -1;
+		}
+		hash = job->value;
+		value_len = job->algo->digest_size;
+	} else if (calculate_hash(data, size, algo, value, &value_len)) {
 		*err_msgp = "Unsupported hash algorithm";
 		return -1;
 	}
@@ -1301,7 +1318,7 @@ static int fit_image_check_hash(const void *fit, int noffset, const void *data,
 	if (value_len != fit_value_len) {
 		*err_msgp = "Bad hash value len";
 		return -1;
-	} else if (memcmp(value, fit_value, value_len) != 0) {
+	} else if (memcmp(hash, fit_value, value_len) != 0) {
 		*err_msgp = "Bad hash value";
 		return -1;
 	}
@@ -1309,9 +1326,163 @@ static int fit_image_check_hash(const void *fit, int noffset, const void *data,
 	return 0;
 }
 
-int fit_image_verify_with_data(const void *fit, int image_noffset,
-			       const void *key_blob, const void *data,
-			       size_t size)
+static void fit_hash_job_run(struct fit_hash_job *job)
+{
+	struct hash_algo *algo = job->algo;
+
+	algo->hash_func_ws(job->data, job->size, job->value,
+			   algo->chunk_size);
+	job->ret = 0;
+}
+
+/*
+ * Walk a group of jobs together, one chunk at a time, so that an image with
+ * several hash nodes is read from memory only once: each chunk is still in
+ * the cache for the second and further algorithms.
+ */
+static void fit_hash_jobs_run_chunked(struct fit_hash_job *jobs, int count)
+{
+	void *ctx[FIT_HASH_JOBS_MAX];
+	struct fit_hash_job *job;
+	size_t offset, len;
+	bool more;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		job = &jobs[i];
+		ctx[i] = NULL;
+		if (count == 1 || !job->algo->hash_init ||
+		    job->algo->hash_init(job->algo, &ctx[i])) {
+			fit_hash_job_run(job);
+			ctx[i] = NULL;
+		}
+	}
+
+	for (offset = 0, more = true; more; offset += CHUNKSZ) {
+		more = false;
+		for (i = 0; i < count; i++) {
+			struct hash_algo *algo;
+			int is_last;
+
+			if (!ctx[i])
+				continue;
+
+			job = &jobs[i];
+			algo = job->algo;
+			len = job->size - offset;
+			is_last = len <= CHUNKSZ;
+			if (!is_last)
+				len = CHUNKSZ;
+			if (algo->hash_update(algo, ctx[i], job->data + offset,
+					      len, is_last)) {
+				/* the context is freed on error */
+				job->ret = -EIO;
+				ctx[i] = NULL;
+			} else if (is_last) {
+				job->ret = algo->hash_finish(algo, ctx[i],
+							     job->value,
+							     algo->digest_size) ?
+					   -EIO : 0;
+				ctx[i] = NULL;
+			} else {
+				more = true;
+			}
+		}
+		WATCHDOG_RESET();
+	}
+}
+
+/**
+ * fit_hash_jobs_run() - calculate the hashes of a list of jobs
+ * @jobs: jobs to calculate
+ * @count: number of jobs
+ *
+ * The jobs are calculated in groups of FIT_HASH_JOBS_MAX jobs.
+ */
+static void fit_hash_jobs_run(struct fit_hash_job *jobs, int count)
+{
+	int i, n;
+
+	for (i = 0; i < count; i += n) {
+		n = count - i;
+		if (n > FIT_HASH_JOBS_MAX)
+			n = FIT_HASH_JOBS_MAX;
+		fit_hash_jobs_run_chunked(jobs + i, n);
+	}
+}
+
+/**
+ * fit_image_add_hash_jobs() - add a job for each hash node of an image
+ * @fit: pointer to the FIT format image header
+ * @image_noffset: component image node offset
+ * @data: image data
+ * @size: image data size
+ * @jobs: job list to add to
+ * @count: number of jobs already in @jobs
+ * @max: maximum number of jobs in @jobs
+ *
+ * Hash nodes that cannot be turned into a job, e.g. because the list is
+ * full or the algorithm is unknown, are left to fit_image_check_hash() to
+ * deal with as usual.
+ *
+ * returns:
+ *     the new number of jobs in @jobs
+ */
+static int fit_image_add_hash_jobs(const void *fit, int image_noffset,
+				   const void *data, size_t size,
+				   struct fit_hash_job *jobs, int count, int max)
+{
+	int noffset;
+
+	/* Hash devices are not shared between jobs */
+	if (!tools_build() && IS_ENABLED(CONFIG_DM_HASH))
+		return count;
+
+	fdt_for_each_subnode(noffset, fit, image_noffset) {
+		const char *name = fit_get_name(fit, noffset, NULL);
+		struct fit_hash_job *job = &jobs[count];
+		const char *algo;
+		int ignore = 0;
+
+		if (count == max)
+			break;
+		if (strncmp(name, FIT_HASH_NODENAME, strlen(FIT_HASH_NODENAME)))
+			continue;
+		if (fit_image_hash_get_algo(fit, noffset, &algo))
+			continue;
+		if (!tools_build())
+			fit_image_hash_get_ignore(fit, noffset, &ignore);
+		if (ignore || hash_lookup_algo(algo, &job->algo))
+			continue;
+
+		job->data = data;
+		job->size = size;
+		job->noffset = noffset;
+		job->ret = -EINPROGRESS;
+		count++;
+	}
+
+	return count;
+}
+
+static const struct fit_hash_job *fit_hash_job_find(const struct fit_hash_job *jobs,
+						    int count, int noffset)
+{
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (jobs[i].noffset == noffset)
+			return &jobs[i];
+	}
+
+	return NULL;
+}
+
+static int fit_image_verify_with_jobs(const void *fit, int image_noffset,
+				      const void *key_blob, const void *data,
+				      size_t size,
+				      const struct fit_hash_job *jobs,
+				      int count)
 {
 	int		noffset = 0;
 	char		*err_msg = "";
@@ -1338,6 +1509,8 @@ int fit_image_verify_with_data(const void *fit, int image_noffset,
 		if (!strncmp(name, FIT_HASH_NODENAME,
 			     strlen(FIT_HASH_NODENAME))) {
 			if (fit_image_check_hash(fit, noffset, data, size,
+						 fit_hash_job_find(jobs, count,
+								   noffset),
 						 &err_msg))
 				goto error;
 			puts("+ ");
@@ -1374,6 +1547,66 @@ error:
 	return 0;
 }
 
+int fit_image_verify_with_data(const void *fit, int image_noffset,
+			       const void *key_blob, const void *data,
+			       size_t size)
+{
+	struct fit_hash_job jobs[FIT_HASH_JOBS_MAX];
+	int count;
+
+	count = fit_image_add_hash_jobs(fit, image_noffset, data, size, jobs,
+					0, ARRAY_SIZE(jobs));
+	fit_hash_jobs_run(jobs, count);
+
+	return fit_image_verify_with_jobs(fit, image_noffset, key_blob, data,
+					  size, jobs, count);
+}
+
+static int fit_image_get_verify_data(const void *fit, int image_noffset,
+				     const void **data, size_t *size,
+				     char **err_msgp)
+{
+	const char *name = fit_get_name(fit, image_noffset, NULL);
+
+	if (IS_ENABLED(CONFIG_FIT_SIGNATURE) && strchr(name, '@')) {
+		/*
+		 * We don't support this since libfdt considers names with the
+		 * name root but different @ suffix to be equal
+		 */
+		*err_msgp = "Node name contains @";
+		return -1;
+	}
+	/* Get image data and data length */
+	if (fit_image_get_data_and_size(fit, image_noffset, data, size)) {
+		*err_msgp = "Can't get image data/size";
+		return -1;
+	}
+
+	return 0;
+}
+
+static int fit_image_verify_jobs(const void *fit, int image_noffset,
+				 const struct fit_hash_job *jobs, int count)
+{
+	const void	*data;
+	size_t		size;
+	char		*err_msg = "";
+
+	if (fit_image_get_verify_data(fit, image_noffset, &data, &size,
+				      &err_msg)) {
+		printf("error!\n%s in '%s' image node\n", err_msg,
+		       fit_get_name(fit, image_noffset, NULL));
+		return 0;
+	}
+
+	if (!jobs)
+		return fit_image_verify_with_data(fit, image_noffset,
+						  gd_fdt_blob(), data, size);
+
+	return fit_image_verify_with_jobs(fit, image_noffset, gd_fdt_blob(),
+					  data, size, jobs, count);
+}
+
 /**
  * fit_image_verify - verify data integrity
  * @fit: pointer to the FIT format image header
@@ -1389,32 +1622,7 @@ error:
  */
 int fit_image_verify(const void *fit, int image_noffset)
 {
-	const char *name = fit_get_name(fit, image_noffset, NULL);
-	const void	*data;
-	size_t		size;
-	char		*err_msg = "";
-
-	if (IS_ENABLED(CONFIG_FIT_SIGNATURE) && strchr(name, '@')) {
-		/*
-		 * We don't support this since libfdt considers names with the
-		 * name root but different @ suffix to be equal
-		 */
-		err_msg = "Node name contains @";
-		goto err;
-	}
-	/* Get image data and data length */
-	if (fit_image_get_data_and_size(fit, image_noffset, &data, &size)) {
-		err_msg = "Can't get image data/size";
-		goto err;
-	}
-
-	return fit_image_verify_with_data(fit, image_noffset, gd_fdt_blob(),
-					  data, size);
-
-err:
-	printf("error!\n%s in '%s' image node\n", err_msg,
-	       fit_get_name(fit, image_noffset, NULL));
-	return 0;
+	return fit_image_verify_jobs(fit, image_noffset, NULL, 0);
 }
 
 /**
@@ -1422,7 +1630,8 @@ err:
  * @fit: pointer to the FIT format image header
  *
  * fit_all_image_verify() goes over all images in the FIT and
- * for every images checks if all it's hashes are valid.
+ * for every images checks if all it's hashes are valid. The hashes of all
+ * images are calculated up front, in one batch.
  *
  * returns:
  *     1, if all hashes of all images are valid
@@ -1430,10 +1639,16 @@ err:
  */
 int fit_all_image_verify(const void *fit)
 {
+	struct fit_hash_job *jobs;
+	const void *data;
+	size_t size;
+	char *err_msg;
 	int images_noffset;
 	int noffset;
 	int ndepth;
 	int count;
+	int njobs = 0;
+	int ret = 1;
 
 	/* Find images parent node offset */
 	images_noffset = fdt_path_offset(fit, FIT_IMAGES_PATH);
@@ -1443,6 +1658,24 @@ int fit_all_image_verify(const void *fit)
 		return 0;
 	}
 
+	/*
+	 * Collect the hash nodes of all images, so that they can be spread
+	 * over several CPUs. Without memory for the list, each image is
+	 * verified on its own.
+	 */
+	jobs = calloc(FIT_HASH_JOBS_ALL_MAX, sizeof(*jobs));
+	if (jobs) {
+		fdt_for_each_subnode(noffset, fit, images_noffset) {
+			if (fit_image_get_verify_data(fit, noffset, &data,
+						      &size, &err_msg))
+				continue;
+			njobs = fit_image_add_hash_jobs(fit, noffset, data,
+							size, jobs, njobs,
+							FIT_HASH_JOBS_ALL_MAX);
+		}
+		fit_hash_jobs_run(jobs, njobs);
+	}
+
 	/* Process all image subnodes, check hashes for each */
 	printf("## Checking hash(es) for FIT Image at %08lx ...\n",
 	       (ulong)fit);
@@ -1459,12 +1692,16 @@ int fit_all_image_verify(const void *fit)
 			       fit_get_name(fit, noffset, NULL));
 			count++;
 
-			if (!fit_image_verify(fit, noffset))
-				return 0;
+			if (!fit_image_verify_jobs(fit, noffset, jobs, njobs)) {
+				ret = 0;
+				break;
+			}
 			printf("\n");
 		}
 	}
-	return 1;
+	free(jobs);
+
+	return ret;
 }
 
 static int fit_image_uncipher(const void *fit, int image_noffset,
@@ -430,33 +430,27 @@ int image_decomp_type(const unsigned char *buf, ulong len)
 	return cmagic->comp_id;
 }
 
-int image_decomp(int comp, ulong load, ulong image_start, int type,
-		 void *load_buf, void *image_buf, ulong image_len,
-		 uint unc_len, ulong *load_end)
+/*
+ * Decompress @image_len bytes at @image_buf to @load_buf, which has room for
+ * @unc_len bytes. On success @image_len is set to the number of uncompressed
+ * bytes.
+ */
+static int image_decomp_buf(int comp, void *load_buf, void *image_buf,
+			    ulong *image_len, uint unc_len)
 {
 	int ret = -ENOSYS;
 
-	*load_end = load;
-	print_decomp_msg(comp, type, load == image_start);
-
-	/*
-	 * Load the image to the right place, decompressing if needed. After
-	 * this, image_len will be set to the number of uncompressed bytes
-	 * loaded, ret will be non-zero on error.
-	 */
 	switch (comp) {
 	case IH_COMP_NONE:
 		ret = 0;
-		if (load == image_start)
-			break;
-		if (image_len <= unc_len)
-			memmove_wd(load_buf, image_buf, image_len, CHUNKSZ);
+		if (*image_len <= unc_len)
+			memmove_wd(load_buf, image_buf, *image_len, CHUNKSZ);
 		else
 			ret = -ENOSPC;
 		break;
 	case IH_COMP_GZIP:
 		if (!tools_build() && CONFIG_IS_ENABLED(GZIP))
-			ret = gunzip(load_buf, unc_len, image_buf, &image_len);
+			ret = gunzip(load_buf, unc_len, image_buf, image_len);
 		break;
 	case IH_COMP_BZIP2:
 		if (!tools_build() && CONFIG_IS_ENABLED(BZIP2)) {
@@ -468,8 +462,8 @@ int image_decomp(int comp, ulong load, ulong image_start, int type,
 			 * at most 2300 KB of memory.
 			 */
 			ret = BZ2_bzBuffToBuffDecompress(load_buf, &size,
-				image_buf, image_len, CONSERVE_MEMORY, 0);
-			image_len = size;
+				image_buf, *image_len, CONSERVE_MEMORY, 0);
+			*image_len = size;
 		}
 		break;
 	case IH_COMP_LZMA:
@@ -477,40 +471,62 @@ int image_decomp(int comp, ulong load, ulong image_start, int type,
 			SizeT lzma_len = unc_len;
 
 			ret = lzmaBuffToBuffDecompress(load_buf, &lzma_len,
-						       image_buf, image_len);
-			image_len = lzma_len;
+						       image_buf, *image_len);
+			*image_len = lzma_len;
 		}
 		break;
 	case IH_COMP_LZO:
 		if (!tools_build() && CONFIG_IS_ENABLED(LZO)) {
 			size_t size = unc_len;
 
-			ret = lzop_decompress(image_buf, image_len, load_buf, &size);
-			image_len = size;
+			ret = lzop_decompress(image_buf, *image_len, load_buf,
+					      &size);
+			*image_len = size;
 		}
 		break;
 	case IH_COMP_LZ4:
 		if (!tools_build() && CONFIG_IS_ENABLED(LZ4)) {
 			size_t size = unc_len;
 
-			ret = ulz4fn(image_buf, image_len, load_buf, &size);
-			image_len = size;
+			ret = ulz4fn(image_buf, *image_len, load_buf, &size);
+			*image_len = size;
 		}
 		break;
 	case IH_COMP_ZSTD:
 		if (!tools_build() && CONFIG_IS_ENABLED(ZSTD)) {
 			struct abuf in, out;
 
-			abuf_init_set(&in, image_buf, image_len);
+			abuf_init_set(&in, image_buf, *image_len);
 			abuf_init_set(&out, load_buf, unc_len);
 			ret = zstd_decompress(&in, &out);
 			if (ret >= 0) {
-				image_len = ret;
+				*image_len = ret;
 				ret = 0;
 			}
 		}
 		break;
 	}
+
+	return ret;
+}
+
+int image_decomp(int comp, ulong load, ulong image_start, int type,
+		 void *load_buf, void *image_buf, ulong image_len,
+		 uint unc_len, ulong *load_end)
+{
+	int ret = 0;
+
+	*load_end = load;
+	print_decomp_msg(comp, type, load == image_start);
+
+	/*
+	 * Load the image to the right place, decompressing if needed. After
+	 * this, image_len will be set to the number of uncompressed bytes
+	 * loaded, ret will be non-zero on error.
+	 */
+	if (comp != IH_COMP_NONE || load != image_start)
+		ret = image_decomp_buf(comp, load_buf, image_buf, &image_len,
+				       unc_len);
 	if (ret == -ENOSYS) {
 		printf("Unimplemented compression type %d\n", comp);
 		return ret;
@@ -523,6 +539,131 @@ int image_decomp(int comp, ulong load, ulong image_start, int type,
 	return 0;
 }
 
+bool image_decomp_can_stream(int comp)
+{
+	return comp == IH_COMP_NONE || comp == IH_COMP_GZIP ||
+		comp == IH_COMP_LZ4;
+}
+
+int image_decomp_stream_start(struct image_decomp_stream *s, int comp,
+			      void *load_buf, ulong unc_len, void *stage,
+			      ulong stage_size)
+{
+	memset(s, '\0', sizeof(*s));
+	s->comp = comp;
+	s->load_buf = load_buf;
+	/* The decompressors count their output in a uint */
+	if (unc_len > UINT_MAX)
+		unc_len = UINT_MAX;
+	s->unc_len = unc_len;
+	s->stage = stage;
+	s->stage_size = stage_size;
+
+	switch (comp) {
+	case IH_COMP_NONE:
+		return 0;
+	case IH_COMP_GZIP:
+		if (!tools_build() && CONFIG_IS_ENABLED(GZIP))
+			return gunzip_stream_init(&s->gz, load_buf, unc_len);
+		break;
+	case IH_COMP_LZ4:
+		if (!tools_build() && CONFIG_IS_ENABLED(LZ4)) {
+			s->lz4 = malloc(sizeof(*s->lz4));
+			if (!s->lz4)
+				return -ENOMEM;
+			ulz4_stream_init(s->lz4, load_buf, unc_len);
+			return 0;
+		}
+		break;
+	/*
+	 * Other algorithms have no streaming decoder here: their input is
+	 * collected in @stage and decompressed in one go at the end
+	 */
+	case IH_COMP_BZIP2:
+		if (!tools_build() && CONFIG_IS_ENABLED(BZIP2))
+			return stage ? 0 : -EINVAL;
+		break;
+	case IH_COMP_LZMA:
+		if (!tools_build() && CONFIG_IS_ENABLED(LZMA))
+			return stage ? 0 : -EINVAL;
+		break;
+	case IH_COMP_LZO:
+		if (!tools_build() && CONFIG_IS_ENABLED(LZO))
+			return stage ? 0 : -EINVAL;
+		break;
+	case IH_COMP_ZSTD:
+		if (!tools_build() && CONFIG_IS_ENABLED(ZSTD))
+			return stage ? 0 : -EINVAL;
+		break;
+	}
+	printf("Unimplemented compression type %d\n", comp);
+
+	return -ENOSYS;
+}
+
+int image_decomp_stream_feed(struct image_decomp_stream *s, const void *buf,
+			     ulong len)
+{
+	switch (s->comp) {
+	case IH_COMP_NONE:
+		if (len > s->unc_len - s->unc_size)
+			return -ENOSPC;
+		memcpy(s->load_buf + s->unc_size, buf, len);
+		s->unc_size += len;
+		return 0;
+	case IH_COMP_GZIP:
+		if (!tools_build() && CONFIG_IS_ENABLED(GZIP))
+			return gunzip_stream_feed(s->gz, buf, len);
+		return -ENOSYS;
+	case IH_COMP_LZ4:
+		if (!tools_build() && CONFIG_IS_ENABLED(LZ4))
+			return ulz4_stream_feed(s->lz4, buf, len);
+		return -ENOSYS;
+	}
+
+	if (len > s->stage_size - s->stage_len)
+		return -ENOSPC;
+	/* The caller may have read the input into place already */
+	if (buf != s->stage + s->stage_len)
+		memcpy(s->stage + s->stage_len, buf, len);
+	s->stage_len += len;
+
+	return 0;
+}
+
+int image_decomp_stream_end(struct image_decomp_stream *s, ulong *unc_size)
+{
+	int ret = -ENOSYS;
+
+	*unc_size = 0;
+	switch (s->comp) {
+	case IH_COMP_NONE:
+		*unc_size = s->unc_size;
+		ret = 0;
+		break;
+	case IH_COMP_GZIP:
+		if (!tools_build() && CONFIG_IS_ENABLED(GZIP))
+			ret = gunzip_stream_end(s->gz, unc_size);
+		break;
+	case IH_COMP_LZ4:
+		if (!tools_build() && CONFIG_IS_ENABLED(LZ4)) {
+			ret = ulz4_stream_end(s->lz4);
+			*unc_size = s->lz4->out - s->lz4->dst;
+			free(s->lz4);
+		}
+		break;
+	default:
+		*unc_size = s->stage_len;
+		ret = image_decomp_buf(s->comp, s->load_buf, s->stage, unc_size,
+				       s->unc_len);
+		if (ret == -ENOSYS)
+			printf("Unimplemented compression type %d\n", s->comp);
+		break;
+	}
+
+	return ret;
+}
+
 const table_entry_t *get_table_entry(const table_entry_t *table, int id)
 {
 	for (; table->id >= 0; ++table) {
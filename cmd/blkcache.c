@@ -7,6 +7,7 @@
 #include <command.h>
 #include <config.h>
 #include <common.h>
+#include <dm.h>
 #include <malloc.h>
 #include <part.h>
 
@@ -14,36 +15,69 @@ static int blkc_show(struct cmd_tbl *cmdtp, int flag,
 		     int argc, char *const argv[])
 {
 	struct block_cache_stats stats;
+	struct udevice *dev;
+	struct uclass *uc;
+
 	blkcache_stats(&stats);
 
 	printf("hits: %u\n"
 	       "misses: %u\n"
+	       "evictions: %u\n"
 	       "entries: %u\n"
+	       "size: %lu KiB\n"
 	       "max blocks/entry: %u\n"
-	       "max cache entries: %u\n",
-	       stats.hits, stats.misses, stats.entries,
-	       stats.max_blocks_per_entry, stats.max_entries);
+	       "max cache entries: %u\n"
+	       "max size: %lu KiB\n",
+	       stats.hits, stats.misses, stats.evictions, stats.entries,
+	       stats.bytes / 1024, stats.max_blocks_per_entry,
+	       stats.max_entries, stats.max_bytes / 1024);
+
+	if (uclass_get(UCLASS_BLK, &uc))
+		return 0;
+
+	uclass_foreach_dev(dev, uc) {
+		struct blk_desc *desc = dev_get_uclass_plat(dev);
+
+		if (blkcache_dev_stats(desc->if_type, desc->devnum, &stats))
+			continue;
+		printf("%s %d: hits %u, misses %u, evictions %u, entries %u\n",
+		       blk_get_if_type_name(desc->if_type), desc->devnum,
+		       stats.hits, stats.misses, stats.evictions,
+		       stats.entries);
+	}
+
 	return 0;
 }
 
 static int blkc_configure(struct cmd_tbl *cmdtp, int flag,
 			  int argc, char *const argv[])
 {
+	struct block_cache_stats stats;
 	unsigned blocks_per_entry, max_entries;
-	if (argc != 3)
+	ulong max_bytes;
+
+	if (argc != 3 && argc != 4)
 		return CMD_RET_USAGE;
 
+	blkcache_stats(&stats);
+	max_bytes = stats.max_bytes;
+
 	blocks_per_entry = simple_strtoul(argv[1], 0, 0);
 	max_entries = simple_strtoul(argv[2], 0, 0);
-	blkcache_configure(blocks_per_entry, max_entries);
-	printf("changed to max of %u entries of %u blocks each\n",
-	       max_entries, blocks_per_entry);
+	if (argc == 4)
+		max_bytes = simple_strtoul(argv[3], 0, 0) * 1024;
+	blkcache_configure(blocks_per_entry, max_entries, max_bytes);
+
+	blkcache_stats(&stats);
+	printf("changed to max of %u entries of %u blocks each, %lu KiB\n",
+	       stats.max_entries, stats.max_blocks_per_entry,
+	       stats.max_bytes / 1024);
 	return 0;
 }
 
 static struct cmd_tbl cmd_blkc_sub[] = {
 	U_BOOT_CMD_MKENT(show, 0, 0, blkc_show, "", ""),
-	U_BOOT_CMD_MKENT(configure, 3, 0, blkc_configure, "", ""),
+	U_BOOT_CMD_MKENT(configure, 4, 0, blkc_configure, "", ""),
 };
 
 static __maybe_unused void blkc_reloc(void)
@@ -80,9 +114,9 @@ static int do_blkcache(struct cmd_tbl *cmdtp, int flag,
 }
 
 U_BOOT_CMD(
-	blkcache, 4, 0, do_blkcache,
+	blkcache, 5, 0, do_blkcache,
 	"block cache diagnostics and control",
 	"show - show and reset statistics\n"
-	"blkcache configure <blocks> <entries> "
-	"- set max blocks per entry and max cache entries\n"
+	"blkcache configure <blocks> <entries> [<size>] "
+	"- set max blocks per entry, max cache entries and max size in KiB\n"
 );
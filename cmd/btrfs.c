@@ -17,6 +17,8 @@ int do_btrsubvol(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[])
 		return 1;
 
 	btrfs_list_subvols();
+	fs_close();
+
 	return 0;
 }
 
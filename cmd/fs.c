@@ -30,8 +30,14 @@ static int do_load_wrapper(struct cmd_tbl *cmdtp, int flag, int argc,
 }
 
 U_BOOT_CMD(
-	load,	7,	0,	do_load_wrapper,
+	load,	9,	0,	do_load_wrapper,
 	"load binary file from a filesystem",
+#if CONFIG_IS_ENABLED(FS_LOAD_DECOMP)
+	"[-z] "
+#endif
+#if CONFIG_IS_ENABLED(FS_LOAD_HASH)
+	"[-h <algo>] "
+#endif
 	"<interface> [<dev[:part]> [<addr> [<filename> [bytes [pos]]]]]\n"
 	"    - Load binary file 'filename' from partition 'part' on device\n"
 	"       type 'interface' instance 'dev' to address 'addr' in memory.\n"
@@ -39,6 +45,16 @@ U_BOOT_CMD(
 	"      If 'bytes' is 0 or omitted, the file is read until the end.\n"
 	"      'pos' gives the file byte position to start reading from.\n"
 	"      If 'pos' is 0 or omitted, the file is read from the start."
+#if CONFIG_IS_ENABLED(FS_LOAD_HASH)
+	"\n"
+	"      With -h, hash the file with 'algo' while loading it and\n"
+	"      store the digest in 'filehash'."
+#endif
+#if CONFIG_IS_ENABLED(FS_LOAD_DECOMP)
+	"\n"
+	"      With -z, decompress the file to 'addr' while loading it and\n"
+	"      set 'filesize' to the uncompressed size."
+#endif
 )
 
 static int do_save_wrapper(struct cmd_tbl *cmdtp, int flag, int argc,
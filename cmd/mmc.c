@@ -152,6 +152,10 @@ static struct mmc *__init_mmc_device(int dev, bool force_init,
 	if (mmc_init(mmc))
 		return NULL;
 
+	/* The card may have been swapped, so drop anything read from it */
+	if (force_init)
+		blk_note_change();
+
 #ifdef CONFIG_BLOCK_CACHE
 	struct blk_desc *bd = mmc_get_blk_desc(mmc);
 	blkcache_invalidate(bd->if_type, bd->devnum);
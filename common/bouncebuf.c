@@ -13,6 +13,9 @@
 #include <bouncebuf.h>
 #include <asm/cache.h>
 
+/* This may be used before relocation, so keep it out of BSS */
+static struct bounce_buffer_stats bb_stats __section(".data");
+
 static int addr_aligned(struct bounce_buffer *state)
 {
 	const ulong align_mask = ARCH_DMA_MINALIGN - 1;
@@ -43,12 +46,15 @@ int bounce_buffer_start_extalign(struct bounce_buffer *state, void *data,
 	state->len = len;
 	state->len_aligned = roundup(len, alignment);
 	state->flags = flags;
+	bb_stats.sessions++;
 
 	if (!addr_is_aligned(state)) {
 		state->bounce_buffer = memalign(alignment,
 						state->len_aligned);
 		if (!state->bounce_buffer)
 			return -ENOMEM;
+		bb_stats.bounced++;
+		bb_stats.bytes += state->len;
 
 		if (state->flags & GEN_BB_READ)
 			memcpy(state->bounce_buffer, state->user_buffer,
@@ -93,3 +99,13 @@ int bounce_buffer_stop(struct bounce_buffer *state)
 
 	return 0;
 }
+
+void bounce_buffer_get_stats(struct bounce_buffer_stats *stats)
+{
+	*stats = bb_stats;
+}
+
+void bounce_buffer_reset_stats(void)
+{
+	memset(&bb_stats, '\0', sizeof(bb_stats));
+}
@@ -8,10 +8,13 @@
 
 #include <common.h>
 #include <blk.h>
+#include <blk_req.h>
 #include <dm.h>
 #include <log.h>
 #include <malloc.h>
+#include <memalign.h>
 #include <part.h>
+#include <watchdog.h>
 #include <dm/device-internal.h>
 #include <dm/lists.h>
 #include <dm/uclass-internal.h>
@@ -361,6 +364,19 @@ int blk_dselect_hwpart(struct blk_desc *desc, int hwpart)
 	return blk_select_hwpart(desc->bdev, hwpart);
 }
 
+/* In .data so that changes made before relocation are counted too */
+static ulong blk_change_count __section(".data");
+
+void blk_note_change(void)
+{
+	blk_change_count++;
+}
+
+ulong blk_get_change_count(void)
+{
+	return blk_change_count;
+}
+
 int blk_first_device(int if_type, struct udevice **devp)
 {
 	struct blk_desc *desc;
@@ -436,6 +452,120 @@ int blk_get_device(int if_type, int devnum, struct udevice **devp)
 	return device_probe(*devp);
 }
 
+/**
+ * struct blk_uclass_priv - uclass-private data for each block device
+ *
+ * @ra_buf: Readahead buffer, allocated on the first sequential access
+ * @ra_start: First block held in @ra_buf
+ * @ra_count: Number of blocks held in @ra_buf, 0 if it is empty
+ * @ra_used: Number of prefetched blocks in @ra_buf returned to callers
+ * @ra_hwpart: Hardware partition of the last read, which @ra_buf and
+ *	@ra_next refer to
+ * @ra_next: Block which follows the last read, used to detect sequential
+ *	access, %BLK_RA_NONE before the first read
+ * @ra_size: Size of the readahead window in bytes, 0 to disable readahead
+ * @ra_stats: Readahead statistics
+ */
+struct blk_uclass_priv {
+	void *ra_buf;
+	lbaint_t ra_start;
+	lbaint_t ra_count;
+	lbaint_t ra_used;
+	int ra_hwpart;
+	lbaint_t ra_next;
+	ulong ra_size;
+	struct blk_readahead_stats ra_stats;
+};
+
+/* No block follows on from this, so the first read is never sequential */
+#define BLK_RA_NONE	((lbaint_t)-1)
+
+static void blk_ra_drop(struct blk_uclass_priv *priv)
+{
+	if (priv->ra_count > priv->ra_used)
+		priv->ra_stats.wasted += priv->ra_count - priv->ra_used;
+	priv->ra_count = 0;
+	priv->ra_used = 0;
+}
+
+/*
+ * blk_ra_read() - read blocks, prefetching ahead of sequential accesses
+ *
+ * Small reads which follow on directly from the previous one fill the whole
+ * readahead window with a single device read, so that the next few reads
+ * can be satisfied from memory.
+ */
+static ulong blk_ra_read(struct blk_desc *desc, lbaint_t start,
+			 lbaint_t blkcnt, void *buffer)
+{
+	struct udevice *dev = desc->bdev;
+	const struct blk_ops *ops = blk_get_ops(dev);
+	struct blk_uclass_priv *priv = dev_get_uclass_priv(dev);
+	lbaint_t done = 0, count, n;
+	bool sequential;
+	ulong ret;
+
+	if (!priv->ra_size || !desc->blksz)
+		return ops->read(dev, start, blkcnt, buffer);
+
+	/* nothing read from another hardware partition follows on */
+	if (priv->ra_hwpart != desc->hwpart) {
+		blk_ra_drop(priv);
+		priv->ra_next = BLK_RA_NONE;
+		priv->ra_hwpart = desc->hwpart;
+	}
+
+	/* use whatever is in the buffer already */
+	if (priv->ra_count && start >= priv->ra_start &&
+	    start < priv->ra_start + priv->ra_count) {
+		n = min(blkcnt, priv->ra_start + priv->ra_count - start);
+		memcpy(buffer, priv->ra_buf + (start - priv->ra_start) *
+		       desc->blksz, n * desc->blksz);
+		priv->ra_used = min(priv->ra_used + n, priv->ra_count);
+		priv->ra_stats.hits += n;
+		done = n;
+		start += n;
+		blkcnt -= n;
+		buffer += n * desc->blksz;
+		priv->ra_next = start;
+		if (!blkcnt)
+			return done;
+	}
+
+	sequential = start == priv->ra_next;
+	priv->ra_next = start + blkcnt;
+	count = min((lbaint_t)(priv->ra_size / desc->blksz),
+		    desc->lba > start ? desc->lba - start : 0);
+	if (!sequential || blkcnt >= count)
+		goto direct;
+
+	if (!priv->ra_buf) {
+		priv->ra_buf = memalign(ARCH_DMA_MINALIGN, priv->ra_size);
+		if (!priv->ra_buf)
+			goto direct;
+	}
+
+	blk_ra_drop(priv);
+	ret = ops->read(dev, start, count, priv->ra_buf);
+	if (ret != count)
+		goto direct;
+
+	priv->ra_start = start;
+	priv->ra_count = count;
+	priv->ra_used = blkcnt;
+	priv->ra_stats.issued += count - blkcnt;
+	memcpy(buffer, priv->ra_buf, blkcnt * desc->blksz);
+
+	return done + blkcnt;
+
+direct:
+	ret = ops->read(dev, start, blkcnt, buffer);
+	if (IS_ERR_VALUE(ret))
+		return done ? done : ret;
+
+	return done + ret;
+}
+
 unsigned long blk_dread(struct blk_desc *block_dev, lbaint_t start,
 			lbaint_t blkcnt, void *buffer)
 {
@@ -449,7 +579,10 @@ unsigned long blk_dread(struct blk_desc *block_dev, lbaint_t start,
 	if (blkcache_read(block_dev->if_type, block_dev->devnum,
 			  start, blkcnt, block_dev->blksz, buffer))
 		return blkcnt;
-	blks_read = ops->read(dev, start, blkcnt, buffer);
+	if (CONFIG_IS_ENABLED(BLK_READAHEAD))
+		blks_read = blk_ra_read(block_dev, start, blkcnt, buffer);
+	else
+		blks_read = ops->read(dev, start, blkcnt, buffer);
 	if (blks_read == blkcnt)
 		blkcache_fill(block_dev->if_type, block_dev->devnum,
 			      start, blkcnt, block_dev->blksz, buffer);
@@ -457,6 +590,44 @@ unsigned long blk_dread(struct blk_desc *block_dev, lbaint_t start,
 	return blks_read;
 }
 
+static void blk_ra_invalidate(struct udevice *dev)
+{
+	if (CONFIG_IS_ENABLED(BLK_READAHEAD))
+		blk_ra_drop(dev_get_uclass_priv(dev));
+}
+
+int blk_set_readahead(struct udevice *dev, ulong size)
+{
+	struct blk_uclass_priv *priv = dev_get_uclass_priv(dev);
+
+	if (!CONFIG_IS_ENABLED(BLK_READAHEAD))
+		return -ENOSYS;
+
+	blk_ra_drop(priv);
+	free(priv->ra_buf);
+	priv->ra_buf = NULL;
+	priv->ra_size = size;
+	priv->ra_next = BLK_RA_NONE;
+	memset(&priv->ra_stats, '\0', sizeof(priv->ra_stats));
+
+	return 0;
+}
+
+int blk_get_readahead_stats(struct udevice *dev,
+			    struct blk_readahead_stats *stats)
+{
+	struct blk_uclass_priv *priv = dev_get_uclass_priv(dev);
+
+	if (!CONFIG_IS_ENABLED(BLK_READAHEAD))
+		return -ENOSYS;
+
+	*stats = priv->ra_stats;
+	/* blocks still in the buffer may yet be used */
+	stats->wasted += priv->ra_count - priv->ra_used;
+
+	return 0;
+}
+
 unsigned long blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 			 lbaint_t blkcnt, const void *buffer)
 {
@@ -467,6 +638,8 @@ unsigned long blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 		return -ENOSYS;
 
 	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+	blk_ra_invalidate(dev);
+	blk_note_change();
 	return ops->write(dev, start, blkcnt, buffer);
 }
 
@@ -480,9 +653,84 @@ unsigned long blk_derase(struct blk_desc *block_dev, lbaint_t start,
 		return -ENOSYS;
 
 	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+	blk_ra_invalidate(dev);
+	blk_note_change();
 	return ops->erase(dev, start, blkcnt);
 }
 
+void blk_complete_request(struct blk_request *req, long result)
+{
+	req->result = result;
+	req->done = true;
+	if (req->complete)
+		req->complete(req);
+}
+
+int blk_submit(struct udevice *dev, struct blk_request *req)
+{
+	struct blk_desc *desc = dev_get_uclass_plat(dev);
+	const struct blk_ops *ops = blk_get_ops(dev);
+	ulong ret;
+	int err;
+
+	req->dev = dev;
+	req->result = 0;
+	req->done = false;
+
+	if (req->op == BLK_REQ_WRITE) {
+		blkcache_invalidate(desc->if_type, desc->devnum);
+		blk_ra_invalidate(dev);
+		blk_note_change();
+	}
+
+	if (ops->submit) {
+		/* wait for room on the device if needed */
+		while ((err = ops->submit(dev, req)) == -EBUSY) {
+			err = ops->poll(dev);
+			if (err < 0)
+				return err;
+		}
+
+		return err;
+	}
+
+	/* fall back to a synchronous transfer */
+	if (req->op == BLK_REQ_READ)
+		ret = blk_dread(desc, req->start, req->blkcnt, req->buffer);
+	else
+		ret = blk_dwrite(desc, req->start, req->blkcnt, req->buffer);
+	blk_complete_request(req, ret);
+
+	return 0;
+}
+
+int blk_poll(struct udevice *dev)
+{
+	const struct blk_ops *ops = blk_get_ops(dev);
+
+	if (!ops->poll)
+		return 0;
+
+	return ops->poll(dev);
+}
+
+int blk_wait(struct udevice *dev, struct blk_request *req)
+{
+	int ret;
+
+	while (!req->done) {
+		ret = blk_poll(dev);
+		if (ret < 0)
+			return ret;
+		WATCHDOG_RESET();
+	}
+
+	if (IS_ERR_VALUE(req->result))
+		return req->result;
+
+	return req->result == req->blkcnt ? 0 : -EIO;
+}
+
 int blk_get_from_parent(struct udevice *parent, struct udevice **devp)
 {
 	struct udevice *dev;
@@ -757,9 +1005,35 @@ static int blk_post_probe(struct udevice *dev)
 	return 0;
 }
 
+static int blk_pre_probe(struct udevice *dev)
+{
+	if (CONFIG_IS_ENABLED(BLK_READAHEAD)) {
+		struct blk_uclass_priv *priv = dev_get_uclass_priv(dev);
+
+		priv->ra_size = CONFIG_IF_ENABLED_INT(BLK_READAHEAD,
+						      BLK_READAHEAD_SIZE) * 1024;
+		priv->ra_next = BLK_RA_NONE;
+	}
+
+	return 0;
+}
+
+static int blk_pre_remove(struct udevice *dev)
+{
+	struct blk_uclass_priv *priv = dev_get_uclass_priv(dev);
+
+	free(priv->ra_buf);
+	blk_note_change();
+
+	return 0;
+}
+
 UCLASS_DRIVER(blk) = {
 	.id		= UCLASS_BLK,
 	.name		= "blk",
+	.pre_probe	= blk_pre_probe,
 	.post_probe	= blk_post_probe,
+	.pre_remove	= blk_pre_remove,
+	.per_device_auto	= sizeof(struct blk_uclass_priv),
 	.per_device_plat_auto	= sizeof(struct blk_desc),
 };
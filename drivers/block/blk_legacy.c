@@ -6,6 +6,7 @@
 
 #include <common.h>
 #include <blk.h>
+#include <memalign.h>
 #include <part.h>
 #include <linux/err.h>
 
@@ -202,6 +203,19 @@ int blk_dselect_hwpart(struct blk_desc *desc, int hwpart)
 	return 0;
 }
 
+/* In .data so that changes made before relocation are counted too */
+static ulong blk_change_count __section(".data");
+
+void blk_note_change(void)
+{
+	blk_change_count++;
+}
+
+ulong blk_get_change_count(void)
+{
+	return blk_change_count;
+}
+
 struct blk_desc *blk_get_devnum_by_typename(const char *if_typename, int devnum)
 {
 	struct blk_driver *drv = blk_driver_lookup_typename(if_typename);
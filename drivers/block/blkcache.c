@@ -10,30 +10,82 @@
 #include <malloc.h>
 #include <part.h>
 #include <asm/global_data.h>
+#include <linux/bitops.h>
 #include <linux/ctype.h>
 #include <linux/list.h>
+#include <linux/log2.h>
 
 #ifdef CONFIG_NEEDS_MANUAL_RELOC
 DECLARE_GLOBAL_DATA_PTR;
 #endif
 
-struct block_cache_node {
+/*
+ * The cache is made up of entries which each cover an aligned chunk of
+ * max_blocks_per_entry blocks of a single device. Each entry keeps a bitmap
+ * of the blocks within the chunk which hold valid data, so that adjacent
+ * small reads are merged into the same entry. Entries are found through a
+ * per-device hash table indexed by chunk number, and are evicted in LRU
+ * order across all devices once the entry count or the memory budget is
+ * exhausted.
+ */
+#define BLKCACHE_HASH_BITS	6
+#define BLKCACHE_HASH_SIZE	(1 << BLKCACHE_HASH_BITS)
+#define BLKCACHE_MAX_BLOCKS	BITS_PER_LONG_LONG
+#define BLKCACHE_BLOCKS		\
+	rounddown_pow_of_two(CONFIG_BLOCK_CACHE_BLOCKS_PER_ENTRY)
+/* smallest block size, which gives the most entries for a memory budget */
+#define BLKCACHE_MIN_BLKSZ	512
+
+/**
+ * struct block_cache_dev - per-device cache state
+ *
+ * @lh: link in the list of devices
+ * @iftype: IF_TYPE_x for type of device
+ * @devnum: device index of particular type
+ * @blksz: size in bytes of each block
+ * @hash: hash table of entries, indexed by chunk number
+ * @stats: statistics for this device
+ */
+struct block_cache_dev {
 	struct list_head lh;
 	int iftype;
 	int devnum;
-	lbaint_t start;
-	lbaint_t blkcnt;
 	unsigned long blksz;
-	char *cache;
+	struct hlist_head hash[BLKCACHE_HASH_SIZE];
+	struct block_cache_stats stats;
+};
+
+/**
+ * struct block_cache_node - a cached chunk of blocks
+ *
+ * @lh: link in the global LRU list
+ * @hn: link in the device hash table
+ * @bcd: device this entry belongs to
+ * @chunk: chunk number, i.e. first block number >> chunk_shift
+ * @valid: bitmap of blocks within the chunk that are present in @cache
+ * @cache: data for the chunk
+ */
+struct block_cache_node {
+	struct list_head lh;
+	struct hlist_node hn;
+	struct block_cache_dev *bcd;
+	lbaint_t chunk;
+	u64 valid;
+	char cache[];
 };
 
 static LIST_HEAD(block_cache);
+static LIST_HEAD(block_cache_devs);
 
 static struct block_cache_stats _stats = {
-	.max_blocks_per_entry = 8,
-	.max_entries = 32
+	.max_blocks_per_entry = BLKCACHE_BLOCKS,
+	.max_entries = CONFIG_BLOCK_CACHE_SIZE * 1024 /
+		(BLKCACHE_BLOCKS * BLKCACHE_MIN_BLKSZ),
+	.max_bytes = CONFIG_BLOCK_CACHE_SIZE * 1024,
 };
 
+static uint chunk_shift = ilog2(BLKCACHE_BLOCKS);
+
 #ifdef CONFIG_NEEDS_MANUAL_RELOC
 int blkcache_init(void)
 {
@@ -42,22 +94,111 @@ int blkcache_init(void)
 	head->next = (uintptr_t)head->next + gd->reloc_off;
 	head->prev = (uintptr_t)head->prev + gd->reloc_off;
 
+	head = &block_cache_devs;
+	head->next = (uintptr_t)head->next + gd->reloc_off;
+	head->prev = (uintptr_t)head->prev + gd->reloc_off;
+
 	return 0;
 }
 #endif
 
-static struct block_cache_node *cache_find(int iftype, int devnum,
-					   lbaint_t start, lbaint_t blkcnt,
-					   unsigned long blksz)
+static inline uint cache_hash(lbaint_t chunk)
+{
+	return (chunk ^ (chunk >> BLKCACHE_HASH_BITS)) &
+		(BLKCACHE_HASH_SIZE - 1);
+}
+
+static inline u64 cache_mask(uint first, uint count)
+{
+	return GENMASK_ULL(first + count - 1, first);
+}
+
+/*
+ * Number of entries a device may use: the configured limit, or fewer if
+ * entries of its block size would exceed the memory budget first
+ */
+static uint cache_max_entries(struct block_cache_dev *bcd)
+{
+	ulong bytes = bcd->blksz << chunk_shift;
+
+	return min_t(ulong, _stats.max_entries, _stats.max_bytes / bytes);
+}
+
+static struct block_cache_dev *cache_find_dev(int iftype, int devnum)
+{
+	struct block_cache_dev *bcd;
+
+	list_for_each_entry(bcd, &block_cache_devs, lh)
+		if (bcd->iftype == iftype && bcd->devnum == devnum)
+			return bcd;
+
+	return NULL;
+}
+
+/* drop an entry from the cache, without freeing it */
+static void cache_unlink(struct block_cache_node *node)
+{
+	ulong bytes = node->bcd->blksz << chunk_shift;
+
+	list_del(&node->lh);
+	hlist_del(&node->hn);
+	node->bcd->stats.entries--;
+	node->bcd->stats.bytes -= bytes;
+	_stats.entries--;
+	_stats.bytes -= bytes;
+}
+
+static void cache_drop_dev(struct block_cache_dev *bcd)
+{
+	struct hlist_node *pos, *tmp;
+	struct block_cache_node *node;
+	int i;
+
+	for (i = 0; i < BLKCACHE_HASH_SIZE; i++) {
+		hlist_for_each_entry_safe(node, pos, tmp, &bcd->hash[i], hn) {
+			cache_unlink(node);
+			free(node);
+		}
+	}
+}
+
+static struct block_cache_dev *cache_get_dev(int iftype, int devnum,
+					     unsigned long blksz)
+{
+	struct block_cache_dev *bcd;
+	int i;
+
+	bcd = cache_find_dev(iftype, devnum);
+	if (bcd) {
+		/* the device geometry changed, so nothing cached is valid */
+		if (bcd->blksz != blksz) {
+			cache_drop_dev(bcd);
+			bcd->blksz = blksz;
+		}
+		return bcd;
+	}
+
+	bcd = calloc(1, sizeof(*bcd));
+	if (!bcd)
+		return NULL;
+	bcd->iftype = iftype;
+	bcd->devnum = devnum;
+	bcd->blksz = blksz;
+	for (i = 0; i < BLKCACHE_HASH_SIZE; i++)
+		INIT_HLIST_HEAD(&bcd->hash[i]);
+	list_add(&bcd->lh, &block_cache_devs);
+
+	return bcd;
+}
+
+static struct block_cache_node *cache_find(struct block_cache_dev *bcd,
+					   lbaint_t chunk)
 {
 	struct block_cache_node *node;
+	struct hlist_node *pos;
 
-	list_for_each_entry(node, &block_cache, lh)
-		if ((node->iftype == iftype) &&
-		    (node->devnum == devnum) &&
-		    (node->blksz == blksz) &&
-		    (node->start <= start) &&
-		    (node->start + node->blkcnt >= start + blkcnt)) {
+	hlist_for_each_entry(node, pos, &bcd->hash[cache_hash(chunk)], hn)
+		if (node->chunk == chunk) {
 			if (block_cache.next != &node->lh) {
 				/* maintain MRU ordering */
 				list_del(&node->lh);
@@ -65,26 +206,99 @@ static struct block_cache_node *cache_find(int iftype, int devnum,
 			}
 			return node;
 		}
-	return 0;
+
+	return NULL;
+}
+
+static struct block_cache_node *cache_alloc(struct block_cache_dev *bcd,
+					    lbaint_t chunk)
+{
+	ulong bytes = bcd->blksz << chunk_shift;
+	uint max_entries = cache_max_entries(bcd);
+	struct block_cache_node *node = NULL, *victim;
+
+	if (!max_entries)
+		return NULL;
+
+	while (!list_empty(&block_cache) &&
+	       (_stats.entries >= max_entries ||
+		_stats.bytes + bytes > _stats.max_bytes)) {
+		/* pop LRU */
+		victim = list_last_entry(&block_cache, struct block_cache_node,
+					 lh);
+		debug("drop: chunk " LBAF "\n", victim->chunk);
+		cache_unlink(victim);
+		victim->bcd->stats.evictions++;
+		_stats.evictions++;
+		/* keep the memory if it is the right size */
+		if (!node && victim->bcd->blksz == bcd->blksz)
+			node = victim;
+		else
+			free(victim);
+	}
+
+	if (!node) {
+		node = malloc(sizeof(*node) + bytes);
+		if (!node)
+			return NULL;
+	}
+
+	node->bcd = bcd;
+	node->chunk = chunk;
+	node->valid = 0;
+	list_add(&node->lh, &block_cache);
+	hlist_add_head(&node->hn, &bcd->hash[cache_hash(chunk)]);
+	bcd->stats.entries++;
+	bcd->stats.bytes += bytes;
+	_stats.entries++;
+	_stats.bytes += bytes;
+
+	return node;
 }
 
 int blkcache_read(int iftype, int devnum,
 		  lbaint_t start, lbaint_t blkcnt,
 		  unsigned long blksz, void *buffer)
 {
-	struct block_cache_node *node = cache_find(iftype, devnum, start,
-						   blkcnt, blksz);
-	if (node) {
-		const char *src = node->cache + (start - node->start) * blksz;
-		memcpy(buffer, src, blksz * blkcnt);
-		debug("hit: start " LBAF ", count " LBAFU "\n",
-		      start, blkcnt);
-		++_stats.hits;
-		return 1;
+	struct block_cache_dev *bcd = cache_find_dev(iftype, devnum);
+	lbaint_t blk = start, end = start + blkcnt;
+	char *dst = buffer;
+
+	if (!bcd || bcd->blksz != blksz)
+		goto miss;
+
+	/*
+	 * Copy chunk by chunk; if a block turns out to be missing, the
+	 * caller reads the whole range from the device, overwriting whatever
+	 * was copied so far.
+	 */
+	while (blk < end) {
+		struct block_cache_node *node;
+		lbaint_t chunk = blk >> chunk_shift;
+		uint first = blk - (chunk << chunk_shift);
+		uint count = min_t(lbaint_t, end - blk,
+				   (1U << chunk_shift) - first);
+		u64 mask = cache_mask(first, count);
+
+		node = cache_find(bcd, chunk);
+		if (!node || (node->valid & mask) != mask)
+			goto miss;
+		memcpy(dst, node->cache + first * blksz, count * blksz);
+		dst += count * blksz;
+		blk += count;
 	}
 
+	debug("hit: start " LBAF ", count " LBAFU "\n",
+	      start, blkcnt);
+	++bcd->stats.hits;
+	++_stats.hits;
+	return 1;
+
+miss:
 	debug("miss: start " LBAF ", count " LBAFU "\n",
 	      start, blkcnt);
+	if (bcd)
+		++bcd->stats.misses;
 	++_stats.misses;
 	return 0;
 }
@@ -93,8 +307,9 @@ void blkcache_fill(int iftype, int devnum,
 		   lbaint_t start, lbaint_t blkcnt,
 		   unsigned long blksz, void const *buffer)
 {
-	lbaint_t bytes;
-	struct block_cache_node *node;
+	struct block_cache_dev *bcd;
+	lbaint_t blk = start, end = start + blkcnt;
+	const char *src = buffer;
 
 	/* don't cache big stuff */
 	if (blkcnt > _stats.max_blocks_per_entry)
@@ -103,83 +318,78 @@ void blkcache_fill(int iftype, int devnum,
 	if (_stats.max_entries == 0)
 		return;
 
-	bytes = blksz * blkcnt;
-	if (_stats.max_entries <= _stats.entries) {
-		/* pop LRU */
-		node = (struct block_cache_node *)block_cache.prev;
-		list_del(&node->lh);
-		_stats.entries--;
-		debug("drop: start " LBAF ", count " LBAFU "\n",
-		      node->start, node->blkcnt);
-		if (node->blkcnt * node->blksz < bytes) {
-			free(node->cache);
-			node->cache = 0;
-		}
-	} else {
-		node = malloc(sizeof(*node));
-		if (!node)
-			return;
-		node->cache = 0;
-	}
-
-	if (!node->cache) {
-		node->cache = malloc(bytes);
-		if (!node->cache) {
-			free(node);
-			return;
-		}
-	}
+	bcd = cache_get_dev(iftype, devnum, blksz);
+	if (!bcd)
+		return;
 
 	debug("fill: start " LBAF ", count " LBAFU "\n",
 	      start, blkcnt);
 
-	node->iftype = iftype;
-	node->devnum = devnum;
-	node->start = start;
-	node->blkcnt = blkcnt;
-	node->blksz = blksz;
-	memcpy(node->cache, buffer, bytes);
-	list_add(&node->lh, &block_cache);
-	_stats.entries++;
+	while (blk < end) {
+		struct block_cache_node *node;
+		lbaint_t chunk = blk >> chunk_shift;
+		uint first = blk - (chunk << chunk_shift);
+		uint count = min_t(lbaint_t, end - blk,
+				   (1U << chunk_shift) - first);
+
+		node = cache_find(bcd, chunk);
+		if (!node)
+			node = cache_alloc(bcd, chunk);
+		if (!node)
+			return;
+		memcpy(node->cache + first * blksz, src, count * blksz);
+		node->valid |= cache_mask(first, count);
+		src += count * blksz;
+		blk += count;
+	}
 }
 
 void blkcache_invalidate(int iftype, int devnum)
 {
-	struct list_head *entry, *n;
+	struct block_cache_dev *bcd = cache_find_dev(iftype, devnum);
+
+	if (bcd)
+		cache_drop_dev(bcd);
+}
+
+static void cache_drop_all(void)
+{
 	struct block_cache_node *node;
 
-	list_for_each_safe(entry, n, &block_cache) {
-		node = (struct block_cache_node *)entry;
-		if ((node->iftype == iftype) &&
-		    (node->devnum == devnum)) {
-			list_del(entry);
-			free(node->cache);
-			free(node);
-			--_stats.entries;
-		}
+	while (!list_empty(&block_cache)) {
+		node = list_first_entry(&block_cache, struct block_cache_node,
+					lh);
+		cache_unlink(node);
+		free(node);
 	}
 }
 
-void blkcache_configure(unsigned blocks, unsigned entries)
+void blkcache_configure(unsigned blocks, unsigned entries, ulong max_bytes)
 {
-	struct block_cache_node *node;
+	struct block_cache_dev *bcd;
+
+	/* entries cover an aligned power-of-two number of blocks */
+	blocks = clamp_t(unsigned, blocks, 1, BLKCACHE_MAX_BLOCKS);
+	blocks = rounddown_pow_of_two(blocks);
+
 	if ((blocks != _stats.max_blocks_per_entry) ||
-	    (entries != _stats.max_entries)) {
-		/* invalidate cache */
-		while (!list_empty(&block_cache)) {
-			node = (struct block_cache_node *)block_cache.next;
-			list_del(&node->lh);
-			free(node->cache);
-			free(node);
-		}
-		_stats.entries = 0;
-	}
+	    (entries != _stats.max_entries) ||
+	    (max_bytes != _stats.max_bytes))
+		cache_drop_all();
 
 	_stats.max_blocks_per_entry = blocks;
 	_stats.max_entries = entries;
+	_stats.max_bytes = max_bytes;
+	chunk_shift = ilog2(blocks);
 
 	_stats.hits = 0;
 	_stats.misses = 0;
+	_stats.evictions = 0;
+	list_for_each_entry(bcd, &block_cache_devs, lh) {
+		bcd->stats.hits = 0;
+		bcd->stats.misses = 0;
+		bcd->stats.evictions = 0;
+	}
 }
 
 void blkcache_stats(struct block_cache_stats *stats)
@@ -187,4 +397,23 @@ void blkcache_stats(struct block_cache_stats *stats)
 	memcpy(stats, &_stats, sizeof(*stats));
 	_stats.hits = 0;
 	_stats.misses = 0;
+	_stats.evictions = 0;
+}
+
+int blkcache_dev_stats(int iftype, int devnum, struct block_cache_stats *stats)
+{
+	struct block_cache_dev *bcd = cache_find_dev(iftype, devnum);
+
+	if (!bcd)
+		return -ENOENT;
+
+	memcpy(stats, &bcd->stats, sizeof(*stats));
+	stats->max_blocks_per_entry = _stats.max_blocks_per_entry;
+	stats->max_entries = cache_max_entries(bcd);
+	stats->max_bytes = _stats.max_bytes;
+	bcd->stats.hits = 0;
+	bcd->stats.misses = 0;
+	bcd->stats.evictions = 0;
+
+	return 0;
 }
@@ -15,7 +15,9 @@
 #include <command.h>
 #include <env.h>
 #include <fastboot.h>
+#include <log.h>
 #include <net/fastboot.h>
+#include <asm/cache.h>
 
 /**
  * fastboot_buf_addr - base address of the fastboot download buffer
@@ -181,5 +183,9 @@ void fastboot_init(void *buf_addr, u32 buf_size)
 	fastboot_buf_addr = buf_addr ? buf_addr :
 				       (void *)CONFIG_FASTBOOT_BUF_ADDR;
 	fastboot_buf_size = buf_size ? buf_size : CONFIG_FASTBOOT_BUF_SIZE;
+	/* Images are flashed straight from here, so avoid bouncing them */
+	if (!IS_ALIGNED((ulong)fastboot_buf_addr, ARCH_DMA_MINALIGN))
+		log_warning("Fastboot buffer %p is not aligned to %d bytes\n",
+			    fastboot_buf_addr, ARCH_DMA_MINALIGN);
 	fastboot_set_progress_callback(NULL);
 }
@@ -7,6 +7,7 @@
 
 #include <clk.h>
 #include <common.h>
+#include <cqhci.h>
 #include <dm.h>
 #include <malloc.h>
 #include <mmc.h>
@@ -24,6 +25,9 @@
 #define SLOTTYPE_MASK		GENMASK(31, 30)
 #define SLOTTYPE_EMBEDDED	BIT(30)
 
+/* CQHCI registers */
+#define AM654_SDHCI_CQE_BASE_ADDR	0x200
+
 /* PHY Registers */
 #define PHY_CTRL1	0x100
 #define PHY_CTRL2	0x104
@@ -556,6 +560,14 @@ static int am654_sdhci_probe(struct udevice *dev)
 	if (ret)
 		return ret;
 
+	if (CONFIG_IS_ENABLED(MMC_SDHCI_CQHCI) &&
+	    (cfg->host_caps & MMC_CAP_CQE)) {
+		ret = cqhci_init(host, host->ioaddr +
+				 AM654_SDHCI_CQE_BASE_ADDR);
+		if (ret)
+			return ret;
+	}
+
 	ret = sdhci_am654_get_otap_delay(dev, cfg);
 	if (ret)
 		return ret;
@@ -0,0 +1,265 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Command Queue Host Controller Interface (CQHCI) driver
+ *
+ * Each of the 32 task slots holds a task descriptor followed by a link
+ * descriptor pointing at that slot's ADMA2 transfer descriptors. Tasks are
+ * queued by ringing the doorbell and completion is polled, so no
+ * interrupts are used.
+ */
+
+#include <common.h>
+#include <cpu_func.h>
+#include <cqhci.h>
+#include <log.h>
+#include <malloc.h>
+#include <memalign.h>
+#include <mmc.h>
+#include <sdhci.h>
+#include <asm/cache.h>
+#include <asm/io.h>
+#include <linux/dma-mapping.h>
+#include <linux/iopoll.h>
+#include <phys2bus.h>
+
+/* Size of a task descriptor; 128-bit descriptors are not used */
+#define CQHCI_TASK_DESC_LEN	8
+
+#define CQHCI_HALT_TIMEOUT_US	100000
+
+static inline u32 cqhci_readl(struct cqhci_host *cq_host, int reg)
+{
+	return readl(cq_host->mmio + reg);
+}
+
+static inline void cqhci_writel(struct cqhci_host *cq_host, u32 val, int reg)
+{
+	writel(val, cq_host->mmio + reg);
+}
+
+static dma_addr_t cqhci_bus_addr(struct cqhci_host *cq_host, void *ptr)
+{
+	return dev_phys_to_bus(mmc_to_dev(cq_host->host->mmc),
+			       (phys_addr_t)(uintptr_t)ptr);
+}
+
+static u8 *cqhci_trans_desc(struct cqhci_host *cq_host, uint tag)
+{
+	return cq_host->trans_base +
+		tag * cq_host->max_trans * cq_host->trans_desc_len;
+}
+
+/* Transfer and link descriptors share the ADMA2 layout */
+static void cqhci_write_desc(struct cqhci_host *cq_host, u8 *desc, u8 attr,
+			     u16 len, dma_addr_t addr)
+{
+	__le32 *word = (__le32 *)desc;
+
+	word[0] = cpu_to_le32(attr | (u32)len << 16);
+	word[1] = cpu_to_le32(lower_32_bits(addr));
+	if (cq_host->dma64)
+		word[2] = cpu_to_le32(upper_32_bits(addr));
+}
+
+int cqhci_submit(struct cqhci_host *cq_host, uint tag,
+		 const struct mmc_cqe_task *task)
+{
+	u8 *slot = cq_host->desc_base + tag * cq_host->slot_sz;
+	u8 *trans = cqhci_trans_desc(cq_host, tag);
+	size_t len = task->blocks * MMC_MAX_BLOCK_LEN;
+	uint count = DIV_ROUND_UP(len, ADMA_MAX_LEN);
+	dma_addr_t addr;
+	u64 desc;
+	uint i;
+
+	if (tag >= CQHCI_NUM_SLOTS || cq_host->busy & BIT(tag) ||
+	    !task->blocks || task->blocks > 0xffff ||
+	    count > cq_host->max_trans)
+		return -EINVAL;
+
+	addr = dma_map_single(task->buf, len, task->write ? DMA_TO_DEVICE :
+			      DMA_FROM_DEVICE);
+	cq_host->dma_addr[tag] = addr;
+	addr = dev_phys_to_bus(mmc_to_dev(cq_host->host->mmc), addr);
+	cq_host->dma_len[tag] = len;
+	cq_host->dma_write[tag] = task->write;
+
+	for (i = 0; i < count; i++) {
+		u16 chunk = min_t(size_t, len, ADMA_MAX_LEN);
+		u8 attr = ADMA_DESC_ATTR_VALID | ADMA_DESC_TRANSFER_DATA;
+
+		if (i == count - 1)
+			attr |= ADMA_DESC_ATTR_END;
+		cqhci_write_desc(cq_host, trans + i * cq_host->trans_desc_len,
+				 attr, chunk, addr);
+		addr += chunk;
+		len -= chunk;
+	}
+
+	desc = CQHCI_VALID(1) | CQHCI_END(1) | CQHCI_INT(1) | CQHCI_ACT(0x5) |
+	       CQHCI_DATA_DIR(!task->write) | CQHCI_BLK_COUNT(task->blocks) |
+	       CQHCI_BLK_ADDR(task->blkaddr);
+	*(__le64 *)slot = cpu_to_le64(desc);
+	cqhci_write_desc(cq_host, slot + CQHCI_TASK_DESC_LEN,
+			 ADMA_DESC_ATTR_VALID | ADMA_DESC_LINK_DESC, 0,
+			 cqhci_bus_addr(cq_host, trans));
+
+	flush_dcache_range((ulong)slot,
+			   ALIGN((ulong)slot + cq_host->slot_sz,
+				 ARCH_DMA_MINALIGN));
+	flush_dcache_range((ulong)trans,
+			   ALIGN((ulong)trans + count * cq_host->trans_desc_len,
+				 ARCH_DMA_MINALIGN));
+
+	cq_host->busy |= BIT(tag);
+	cqhci_writel(cq_host, BIT(tag), CQHCI_TDBR);
+
+	return 0;
+}
+
+static void cqhci_finish(struct cqhci_host *cq_host, u32 tags)
+{
+	uint tag;
+
+	tags &= cq_host->busy;
+	for (tag = 0; tag < CQHCI_NUM_SLOTS; tag++) {
+		if (!(tags & BIT(tag)))
+			continue;
+		dma_unmap_single(cq_host->dma_addr[tag], cq_host->dma_len[tag],
+				 cq_host->dma_write[tag] ? DMA_TO_DEVICE :
+				 DMA_FROM_DEVICE);
+	}
+	cq_host->busy &= ~tags;
+}
+
+int cqhci_poll(struct cqhci_host *cq_host, u32 *done, u32 *failed)
+{
+	u32 status, terri, tcn;
+
+	*done = 0;
+	*failed = 0;
+
+	status = cqhci_readl(cq_host, CQHCI_IS);
+	if (!status)
+		return 0;
+	cqhci_writel(cq_host, status, CQHCI_IS);
+
+	if (status & CQHCI_IS_ERROR) {
+		terri = cqhci_readl(cq_host, CQHCI_TERRI);
+		if (terri & CQHCI_TERRI_C_VALID)
+			*failed |= BIT(CQHCI_TERRI_C_TASK(terri));
+		if (terri & CQHCI_TERRI_D_VALID)
+			*failed |= BIT(CQHCI_TERRI_D_TASK(terri));
+		*failed &= cq_host->busy;
+		log_debug("error status %x, task error info %x\n", status,
+			  terri);
+		if (!*failed)
+			return -EIO;
+	}
+
+	if (status & CQHCI_IS_TCC) {
+		tcn = cqhci_readl(cq_host, CQHCI_TCN);
+		cqhci_writel(cq_host, tcn, CQHCI_TCN);
+		*done = tcn & cq_host->busy;
+	}
+	*done |= *failed;
+	cqhci_finish(cq_host, *done);
+
+	return 0;
+}
+
+static int cqhci_halt(struct cqhci_host *cq_host)
+{
+	u32 ctl;
+	int ret;
+
+	cqhci_writel(cq_host, CQHCI_HALT, CQHCI_CTL);
+	ret = readl_poll_timeout(cq_host->mmio + CQHCI_CTL, ctl,
+				 ctl & CQHCI_HALT, CQHCI_HALT_TIMEOUT_US);
+	if (ret)
+		return ret;
+
+	if (!cq_host->busy)
+		return 0;
+
+	/* discard whatever is still queued */
+	cqhci_writel(cq_host, CQHCI_HALT | CQHCI_CLEAR_ALL_TASKS, CQHCI_CTL);
+	ret = readl_poll_timeout(cq_host->mmio + CQHCI_CTL, ctl,
+				 !(ctl & CQHCI_CLEAR_ALL_TASKS),
+				 CQHCI_HALT_TIMEOUT_US);
+	cqhci_finish(cq_host, cq_host->busy);
+
+	return ret;
+}
+
+int cqhci_enable(struct cqhci_host *cq_host, struct mmc *mmc, bool enable)
+{
+	dma_addr_t base = cqhci_bus_addr(cq_host, cq_host->desc_base);
+	u32 cfg;
+	int ret;
+
+	cfg = cqhci_readl(cq_host, CQHCI_CFG);
+	if (!enable) {
+		ret = cqhci_halt(cq_host);
+		cqhci_writel(cq_host, cfg & ~CQHCI_ENABLE, CQHCI_CFG);
+		return ret;
+	}
+
+	if (cfg & CQHCI_ENABLE)
+		cqhci_writel(cq_host, cfg & ~CQHCI_ENABLE, CQHCI_CFG);
+	cfg &= ~(CQHCI_DCMD | CQHCI_TASK_DESC_SZ | CQHCI_ENABLE);
+	cqhci_writel(cq_host, cfg, CQHCI_CFG);
+
+	cqhci_writel(cq_host, lower_32_bits(base), CQHCI_TDLBA);
+	cqhci_writel(cq_host, upper_32_bits(base), CQHCI_TDLBAU);
+	cqhci_writel(cq_host, mmc->rca, CQHCI_SSC2);
+
+	/* report status without raising interrupts */
+	cqhci_writel(cq_host, cqhci_readl(cq_host, CQHCI_IS), CQHCI_IS);
+	cqhci_writel(cq_host, CQHCI_IS_MASK, CQHCI_ISTE);
+	cqhci_writel(cq_host, 0, CQHCI_ISGE);
+
+	cqhci_writel(cq_host, cfg | CQHCI_ENABLE, CQHCI_CFG);
+	cqhci_writel(cq_host, 0, CQHCI_CTL);
+	cq_host->busy = 0;
+
+	return CQHCI_NUM_SLOTS;
+}
+
+int cqhci_init(struct sdhci_host *host, void *mmio)
+{
+	struct cqhci_host *cq_host;
+	uint link_desc_len;
+
+	cq_host = calloc(1, sizeof(*cq_host));
+	if (!cq_host)
+		return -ENOMEM;
+
+	cq_host->host = host;
+	cq_host->mmio = mmio;
+	cq_host->dma64 = !!(host->flags & USE_ADMA64);
+	cq_host->trans_desc_len = cq_host->dma64 ? 16 : 8;
+	link_desc_len = cq_host->trans_desc_len;
+	cq_host->slot_sz = CQHCI_TASK_DESC_LEN + link_desc_len;
+	cq_host->max_trans = DIV_ROUND_UP(CONFIG_MMC_CQE_TASK_SIZE * 1024,
+					  ADMA_MAX_LEN);
+
+	cq_host->desc_base = memalign(ARCH_DMA_MINALIGN,
+				      CQHCI_NUM_SLOTS * cq_host->slot_sz);
+	cq_host->trans_base = memalign(ARCH_DMA_MINALIGN, CQHCI_NUM_SLOTS *
+				       cq_host->max_trans *
+				       cq_host->trans_desc_len);
+	if (!cq_host->desc_base || !cq_host->trans_base) {
+		free(cq_host->desc_base);
+		free(cq_host->trans_base);
+		free(cq_host);
+		return -ENOMEM;
+	}
+	memset(cq_host->desc_base, '\0', CQHCI_NUM_SLOTS * cq_host->slot_sz);
+
+	log_debug("CQHCI version %x, %d-bit DMA\n",
+		  cqhci_readl(cq_host, CQHCI_VER), cq_host->dma64 ? 64 : 32);
+	host->cqe = cq_host;
+
+	return 0;
+}
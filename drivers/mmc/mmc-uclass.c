@@ -160,6 +160,51 @@ int mmc_hs400_prepare_ddr(struct mmc *mmc)
 	return dm_mmc_hs400_prepare_ddr(mmc->dev);
 }
 
+#if CONFIG_IS_ENABLED(MMC_CQE)
+static int dm_mmc_cqe_enable(struct udevice *dev, bool enable)
+{
+	struct dm_mmc_ops *ops = mmc_get_ops(dev);
+
+	if (!ops->cqe_enable)
+		return -ENOSYS;
+	return ops->cqe_enable(dev, enable);
+}
+
+int mmc_cqe_enable(struct mmc *mmc, bool enable)
+{
+	return dm_mmc_cqe_enable(mmc->dev, enable);
+}
+
+static int dm_mmc_cqe_submit(struct udevice *dev, uint tag,
+			     const struct mmc_cqe_task *task)
+{
+	struct dm_mmc_ops *ops = mmc_get_ops(dev);
+
+	if (!ops->cqe_submit)
+		return -ENOSYS;
+	return ops->cqe_submit(dev, tag, task);
+}
+
+int mmc_cqe_submit(struct mmc *mmc, uint tag, const struct mmc_cqe_task *task)
+{
+	return dm_mmc_cqe_submit(mmc->dev, tag, task);
+}
+
+static int dm_mmc_cqe_poll(struct udevice *dev, u32 *done, u32 *failed)
+{
+	struct dm_mmc_ops *ops = mmc_get_ops(dev);
+
+	if (!ops->cqe_poll)
+		return -ENOSYS;
+	return ops->cqe_poll(dev, done, failed);
+}
+
+int mmc_cqe_poll(struct mmc *mmc, u32 *done, u32 *failed)
+{
+	return dm_mmc_cqe_poll(mmc->dev, done, failed);
+}
+#endif
+
 static int dm_mmc_host_power_cycle(struct udevice *dev)
 {
 	struct dm_mmc_ops *ops = mmc_get_ops(dev);
@@ -256,6 +301,8 @@ int mmc_of_parse(struct udevice *dev, struct mmc_config *cfg)
 		cfg->host_caps |= MMC_CAP(MMC_HS_400);
 	if (dev_read_bool(dev, "mmc-hs400-enhanced-strobe"))
 		cfg->host_caps |= MMC_CAP(MMC_HS_400_ES);
+	if (dev_read_bool(dev, "supports-cqe"))
+		cfg->host_caps |= MMC_CAP_CQE;
 
 	if (dev_read_bool(dev, "non-removable")) {
 		cfg->host_caps |= MMC_CAP_NONREMOVABLE;
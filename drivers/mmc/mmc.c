@@ -494,6 +494,13 @@ ulong mmc_bread(struct blk_desc *block_dev, lbaint_t start, lbaint_t blkcnt,
 
 	b_max = mmc_get_b_max(mmc, dst, blkcnt);
 
+	if (mmc_cqe_usable(mmc, blkcnt)) {
+		err = mmc_cqe_rw(mmc, start, blkcnt, dst, b_max, false);
+		if (!err)
+			return blkcnt;
+		pr_debug("%s: Command queue read failed (%d)\n", __func__, err);
+	}
+
 	do {
 		cur = (blocks_todo > b_max) ? b_max : blocks_todo;
 		if (mmc_read_blocks(mmc, dst, start, cur) != cur) {
@@ -2321,6 +2328,13 @@ static int mmc_startup_v4(struct mmc *mmc)
 	part_completed = !!(ext_csd[EXT_CSD_PARTITION_SETTING] &
 			    EXT_CSD_PARTITION_SETTING_COMPLETED);
 
+#if CONFIG_IS_ENABLED(MMC_CQE)
+	mmc->cmdq_depth = 0;
+	if (mmc->version >= MMC_VERSION_5_1 &&
+	    (ext_csd[EXT_CSD_CMDQ_SUPPORT] & 0x1))
+		mmc->cmdq_depth = (ext_csd[EXT_CSD_CMDQ_DEPTH] & 0x1f) + 1;
+#endif
+
 	mmc->part_switch_time = ext_csd[EXT_CSD_PART_SWITCH_TIME];
 	/* Some eMMC set the value too low so set a minimum */
 	if (mmc->part_switch_time < MMC_MIN_PART_SWITCH_TIME && mmc->part_switch_time)
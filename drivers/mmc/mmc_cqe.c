@@ -0,0 +1,137 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * eMMC command queueing
+ *
+ * Large transfers are split into tasks which are queued on the host's
+ * command queue engine, keeping as many in flight as both the card and the
+ * engine allow. The card is only placed in command queue mode for the
+ * duration of such a transfer, so that every other operation still uses
+ * the legacy commands.
+ */
+
+#include <common.h>
+#include <dm.h>
+#include <log.h>
+#include <mmc.h>
+#include <time.h>
+#include <watchdog.h>
+#include <linux/bitops.h>
+#include "mmc_private.h"
+
+/* Time allowed without any task completing */
+#define MMC_CQE_TIMEOUT_MS	5000
+
+/* Number of 512-byte blocks in a task */
+#define MMC_CQE_TASK_BLOCKS	(CONFIG_MMC_CQE_TASK_SIZE * 2)
+
+bool mmc_cqe_usable(struct mmc *mmc, lbaint_t blkcnt)
+{
+	struct blk_desc *desc = mmc_get_blk_desc(mmc);
+
+	/* RPMB accesses cannot be queued */
+	return mmc->cmdq_depth && (mmc->cfg->host_caps & MMC_CAP_CQE) &&
+	       mmc->high_capacity && desc->hwpart != MMC_PART_RPMB &&
+	       blkcnt > MMC_CQE_TASK_BLOCKS;
+}
+
+static int mmc_cqe_set_mode(struct mmc *mmc, bool enable)
+{
+	return mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_CMDQ_MODE_EN,
+			  enable);
+}
+
+static int mmc_cqe_queue(struct mmc *mmc, lbaint_t start, lbaint_t blkcnt,
+			 void *buf, uint b_max, bool write, uint depth)
+{
+	uint tag_blocks[32];
+	struct mmc_cqe_task task;
+	lbaint_t issued = 0, done = 0;
+	u32 busy = 0, completed, failed;
+	ulong start_ms;
+	uint tag;
+	int ret;
+
+	b_max = min_t(uint, b_max, MMC_CQE_TASK_BLOCKS);
+	start_ms = get_timer(0);
+	while (done < blkcnt) {
+		/* keep every free tag busy */
+		for (tag = 0; tag < depth && issued < blkcnt; tag++) {
+			if (busy & BIT(tag))
+				continue;
+
+			task.write = write;
+			task.blkaddr = start + issued;
+			task.blocks = min_t(lbaint_t, blkcnt - issued, b_max);
+			task.buf = buf + issued * MMC_MAX_BLOCK_LEN;
+			ret = mmc_cqe_submit(mmc, tag, &task);
+			if (ret)
+				return ret;
+
+			tag_blocks[tag] = task.blocks;
+			busy |= BIT(tag);
+			issued += task.blocks;
+		}
+
+		ret = mmc_cqe_poll(mmc, &completed, &failed);
+		if (ret)
+			return ret;
+		completed &= busy;
+		if (failed & completed)
+			return -EIO;
+
+		if (completed) {
+			start_ms = get_timer(0);
+		} else if (get_timer(start_ms) > MMC_CQE_TIMEOUT_MS) {
+			log_debug("%s: timed out, tasks %x\n", mmc->dev->name,
+				  busy);
+			return -ETIMEDOUT;
+		}
+
+		for (tag = 0; tag < depth; tag++) {
+			if (completed & BIT(tag))
+				done += tag_blocks[tag];
+		}
+		busy &= ~completed;
+		WATCHDOG_RESET();
+	}
+
+	return 0;
+}
+
+int mmc_cqe_rw(struct mmc *mmc, lbaint_t start, lbaint_t blkcnt, void *buf,
+	       uint b_max, bool write)
+{
+	int depth, ret, err;
+
+	ret = mmc_cqe_set_mode(mmc, true);
+	if (ret)
+		return ret;
+
+	depth = mmc_cqe_enable(mmc, true);
+	if (depth < 0) {
+		ret = depth;
+		/* the host cannot do it, so don't try again */
+		if (ret == -ENOSYS)
+			mmc->cmdq_depth = 0;
+		goto out;
+	}
+	depth = min3(depth, (int)mmc->cmdq_depth, 32);
+	if (!depth) {
+		ret = -EINVAL;
+		goto out_disable;
+	}
+
+	ret = mmc_cqe_queue(mmc, start, blkcnt, buf, b_max, write, depth);
+
+out_disable:
+	/* this discards anything still queued after an error */
+	err = mmc_cqe_enable(mmc, false);
+	if (!ret)
+		ret = err;
+out:
+	err = mmc_cqe_set_mode(mmc, false);
+	if (!ret)
+		ret = err;
+
+	return ret;
+}
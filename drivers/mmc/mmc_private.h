@@ -132,4 +132,45 @@ int mmc_switch_part(struct mmc *mmc, unsigned int part_num);
  */
 int mmc_switch(struct mmc *mmc, u8 set, u8 index, u8 value);
 
+#if CONFIG_IS_ENABLED(MMC_CQE)
+/**
+ * mmc_cqe_usable() - Check whether a transfer should use command queueing
+ *
+ * @mmc:	MMC device
+ * @blkcnt:	Number of blocks to transfer
+ * Return: true if both card and host can queue commands and the transfer is
+ * large enough to benefit from it
+ */
+bool mmc_cqe_usable(struct mmc *mmc, lbaint_t blkcnt);
+
+/**
+ * mmc_cqe_rw() - Transfer blocks using the command queue engine
+ *
+ * The transfer is split into tasks which are kept queued on the host. If
+ * this fails, the caller may retry the transfer with legacy commands.
+ *
+ * @mmc:	MMC device
+ * @start:	First block to transfer
+ * @blkcnt:	Number of blocks to transfer
+ * @buf:	Buffer to read into or write from
+ * @b_max:	Maximum number of blocks in a single task
+ * @write:	true to write to the card, false to read from it
+ * Return: 0 if OK, -ve on error
+ */
+int mmc_cqe_rw(struct mmc *mmc, lbaint_t start, lbaint_t blkcnt, void *buf,
+	       uint b_max, bool write);
+#else
+static inline bool mmc_cqe_usable(struct mmc *mmc, lbaint_t blkcnt)
+{
+	return false;
+}
+
+static inline int mmc_cqe_rw(struct mmc *mmc, lbaint_t start,
+			     lbaint_t blkcnt, void *buf, uint b_max,
+			     bool write)
+{
+	return -ENOSYS;
+}
+#endif
+
 #endif /* _MMC_PRIVATE_H_ */
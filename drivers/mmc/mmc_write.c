@@ -210,6 +210,11 @@ ulong mmc_bwrite(struct blk_desc *block_dev, lbaint_t start, lbaint_t blkcnt,
 	if (mmc_set_blocklen(mmc, mmc->write_bl_len))
 		return 0;
 
+	if (mmc_cqe_usable(mmc, blkcnt) && start + blkcnt <= block_dev->lba &&
+	    !mmc_cqe_rw(mmc, start, blkcnt, (void *)src, mmc->cfg->b_max,
+			true))
+		return blkcnt;
+
 	do {
 		cur = (blocks_todo > mmc->cfg->b_max) ?
 			mmc->cfg->b_max : blocks_todo;
@@ -24,11 +24,16 @@ struct sandbox_mmc_plat {
 #define MMC_BL_LEN_SHIFT	10
 #define MMC_BL_LEN		BIT(MMC_BL_LEN_SHIFT)
 #define SIZE_MULTIPLE		((1 << (MMC_CMULT + 2)) * MMC_BL_LEN)
+#define SANDBOX_MMC_CQE_DEPTH	8
 
 struct sandbox_mmc_priv {
 	char *buf;
 	int csize;	/* CSIZE value to report */
 	int size;
+	bool cmdq_mode;	/* card is in command queue mode */
+	u32 cqe_queued;	/* bitmask of queued tags */
+	uint cqe_max_queued;
+	struct mmc_cqe_task cqe_tasks[SANDBOX_MMC_CQE_DEPTH];
 };
 
 /**
@@ -56,7 +61,7 @@ static int sandbox_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 		cmd->response[0] = 0xaa;
 		break;
 	case MMC_CMD_SEND_STATUS:
-		cmd->response[0] = MMC_STATUS_RDY_FOR_DATA;
+		cmd->response[0] = MMC_STATUS_RDY_FOR_DATA | MMC_STATE_TRANS;
 		break;
 	case MMC_CMD_SELECT_CARD:
 		break;
@@ -68,8 +73,12 @@ static int sandbox_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 		cmd->response[3] = 0;
 		break;
 	case SD_CMD_SWITCH_FUNC: {
-		if (!data)
+		if (!data) {
+			/* eMMC SWITCH, only the command queue is emulated */
+			if (((cmd->cmdarg >> 16) & 0xff) == EXT_CSD_CMDQ_MODE_EN)
+				priv->cmdq_mode = (cmd->cmdarg >> 8) & 0x1;
 			break;
+		}
 		u32 *resp = (u32 *)data->dest;
 		resp[3] = 0;
 		resp[7] = cpu_to_be32(SD_HIGHSPEED_BUSY);
@@ -133,10 +142,81 @@ static int sandbox_mmc_get_cd(struct udevice *dev)
 	return 1;
 }
 
+#if CONFIG_IS_ENABLED(MMC_CQE)
+static int sandbox_mmc_cqe_enable(struct udevice *dev, bool enable)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+
+	priv->cqe_queued = 0;
+
+	return enable ? SANDBOX_MMC_CQE_DEPTH : 0;
+}
+
+static int sandbox_mmc_cqe_submit(struct udevice *dev, uint tag,
+				  const struct mmc_cqe_task *task)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+
+	if (!priv->cmdq_mode)
+		return -EIO;
+	if (tag >= SANDBOX_MMC_CQE_DEPTH || priv->cqe_queued & BIT(tag))
+		return -EINVAL;
+
+	priv->cqe_tasks[tag] = *task;
+	priv->cqe_queued |= BIT(tag);
+
+	return 0;
+}
+
+/* Every queued task completes on the next poll */
+static int sandbox_mmc_cqe_poll(struct udevice *dev, u32 *done, u32 *failed)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+	struct mmc_cqe_task *task;
+	ulong offset, len;
+	uint tag;
+
+	priv->cqe_max_queued = max_t(uint, priv->cqe_max_queued,
+				     hweight32(priv->cqe_queued));
+	*done = priv->cqe_queued;
+	*failed = 0;
+	for (tag = 0; tag < SANDBOX_MMC_CQE_DEPTH; tag++) {
+		if (!(priv->cqe_queued & BIT(tag)))
+			continue;
+		task = &priv->cqe_tasks[tag];
+		offset = (ulong)task->blkaddr * MMC_MAX_BLOCK_LEN;
+		len = task->blocks * MMC_MAX_BLOCK_LEN;
+		if (offset + len > priv->size) {
+			*failed |= BIT(tag);
+			continue;
+		}
+		if (task->write)
+			memcpy(&priv->buf[offset], task->buf, len);
+		else
+			memcpy(task->buf, &priv->buf[offset], len);
+	}
+	priv->cqe_queued = 0;
+
+	return 0;
+}
+
+uint sandbox_mmc_cqe_max_queued(struct udevice *dev)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+
+	return priv->cqe_max_queued;
+}
+#endif
+
 static const struct dm_mmc_ops sandbox_mmc_ops = {
 	.send_cmd = sandbox_mmc_send_cmd,
 	.set_ios = sandbox_mmc_set_ios,
 	.get_cd = sandbox_mmc_get_cd,
+#if CONFIG_IS_ENABLED(MMC_CQE)
+	.cqe_enable = sandbox_mmc_cqe_enable,
+	.cqe_submit = sandbox_mmc_cqe_submit,
+	.cqe_poll = sandbox_mmc_cqe_poll,
+#endif
 };
 
 static int sandbox_mmc_of_to_plat(struct udevice *dev)
@@ -9,6 +9,7 @@
 
 #include <common.h>
 #include <cpu_func.h>
+#include <cqhci.h>
 #include <dm.h>
 #include <errno.h>
 #include <log.h>
@@ -814,6 +815,61 @@ static int sdhci_set_enhanced_strobe(struct udevice *dev)
 }
 #endif
 
+#if CONFIG_IS_ENABLED(MMC_SDHCI_CQHCI)
+static int sdhci_cqe_enable(struct udevice *dev, bool enable)
+{
+	struct mmc *mmc = mmc_get_mmc_dev(dev);
+	struct sdhci_host *host = mmc->priv;
+	u8 ctrl;
+
+	if (!host->cqe)
+		return -ENOSYS;
+
+	if (enable) {
+		/* the engine issues ADMA2 transfers of 512-byte blocks */
+		ctrl = sdhci_readb(host, SDHCI_HOST_CONTROL);
+		ctrl &= ~SDHCI_CTRL_DMA_MASK;
+		if (host->cqe->dma64)
+			ctrl |= SDHCI_CTRL_ADMA64;
+		else
+			ctrl |= SDHCI_CTRL_ADMA32;
+		sdhci_writeb(host, ctrl, SDHCI_HOST_CONTROL);
+		sdhci_writew(host, SDHCI_MAKE_BLKSZ(SDHCI_DEFAULT_BOUNDARY_ARG,
+						    MMC_MAX_BLOCK_LEN),
+			     SDHCI_BLOCK_SIZE);
+		sdhci_writel(host, SDHCI_INT_ALL_MASK, SDHCI_INT_STATUS);
+	}
+
+	return cqhci_enable(host->cqe, mmc, enable);
+}
+
+static int sdhci_cqe_submit(struct udevice *dev, uint tag,
+			    const struct mmc_cqe_task *task)
+{
+	struct mmc *mmc = mmc_get_mmc_dev(dev);
+	struct sdhci_host *host = mmc->priv;
+
+	return cqhci_submit(host->cqe, tag, task);
+}
+
+static int sdhci_cqe_poll(struct udevice *dev, u32 *done, u32 *failed)
+{
+	struct mmc *mmc = mmc_get_mmc_dev(dev);
+	struct sdhci_host *host = mmc->priv;
+	u32 stat;
+
+	/* data and bus errors are flagged by the SDHCI itself */
+	stat = sdhci_readl(host, SDHCI_INT_STATUS);
+	if (stat & SDHCI_INT_ERROR_MASK) {
+		sdhci_writel(host, stat, SDHCI_INT_STATUS);
+		log_debug("%s: error status %x\n", dev->name, stat);
+		return -EIO;
+	}
+
+	return cqhci_poll(host->cqe, done, failed);
+}
+#endif
+
 const struct dm_mmc_ops sdhci_ops = {
 	.send_cmd	= sdhci_send_command,
 	.set_ios	= sdhci_set_ios,
@@ -826,6 +882,11 @@ const struct dm_mmc_ops sdhci_ops = {
 #if CONFIG_IS_ENABLED(MMC_HS400_ES_SUPPORT)
 	.set_enhanced_strobe = sdhci_set_enhanced_strobe,
 #endif
+#if CONFIG_IS_ENABLED(MMC_SDHCI_CQHCI)
+	.cqe_enable	= sdhci_cqe_enable,
+	.cqe_submit	= sdhci_cqe_submit,
+	.cqe_poll	= sdhci_cqe_poll,
+#endif
 };
 #else
 static const struct mmc_ops sdhci_ops = {
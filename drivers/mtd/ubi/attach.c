@@ -84,6 +84,7 @@
 #endif
 
 #include <linux/math64.h>
+#include <bootstage.h>
 
 #include <ubi_uboot.h>
 #include "ubi.h"
@@ -832,6 +833,7 @@ static int scan_peb(struct ubi_device *ubi, struct ubi_attach_info *ai,
 		return 0;
 	}
 
+	ubi_io_read_hdrs(ubi, pnum);
 	err = ubi_io_read_ec_hdr(ubi, pnum, ech, 0);
 	if (err < 0)
 		return err;
@@ -1231,16 +1233,18 @@ static int scan_all(struct ubi_device *ubi, struct ubi_attach_info *ai,
 	struct ubi_ainf_volume *av;
 	struct ubi_ainf_peb *aeb;
 
+	bootstage_start(BOOTSTAGE_ID_ACCUM_UBI_SCAN, "ubi_scan");
 	err = -ENOMEM;
 
 	ech = kzalloc(ubi->ec_hdr_alsize, GFP_KERNEL);
 	if (!ech)
-		return err;
+		goto out;
 
 	vidh = ubi_zalloc_vid_hdr(ubi, GFP_KERNEL);
 	if (!vidh)
 		goto out_ech;
 
+	ubi_io_hdrs_init(ubi);
 	for (pnum = start; pnum < ubi->peb_count; pnum++) {
 		cond_resched();
 
@@ -1249,6 +1253,7 @@ static int scan_all(struct ubi_device *ubi, struct ubi_attach_info *ai,
 		if (err < 0)
 			goto out_vidh;
 	}
+	ubi_io_hdrs_free(ubi);
 
 	ubi_msg(ubi, "scanning is finished");
 
@@ -1289,13 +1294,17 @@ static int scan_all(struct ubi_device *ubi, struct ubi_attach_info *ai,
 
 	ubi_free_vid_hdr(ubi, vidh);
 	kfree(ech);
+	bootstage_accum(BOOTSTAGE_ID_ACCUM_UBI_SCAN);
 
 	return 0;
 
 out_vidh:
+	ubi_io_hdrs_free(ubi);
 	ubi_free_vid_hdr(ubi, vidh);
 out_ech:
 	kfree(ech);
+out:
+	bootstage_accum(BOOTSTAGE_ID_ACCUM_UBI_SCAN);
 	return err;
 }
 
@@ -1350,6 +1359,7 @@ static int scan_fast(struct ubi_device *ubi, struct ubi_attach_info **ai)
 	if (!vidh)
 		goto out_ech;
 
+	ubi_io_hdrs_init(ubi);
 	for (pnum = 0; pnum < UBI_FM_MAX_START; pnum++) {
 		int vol_id = -1;
 		unsigned long long sqnum = -1;
@@ -1365,6 +1375,7 @@ static int scan_fast(struct ubi_device *ubi, struct ubi_attach_info **ai)
 			fm_anchor = pnum;
 		}
 	}
+	ubi_io_hdrs_free(ubi);
 
 	ubi_free_vid_hdr(ubi, vidh);
 	kfree(ech);
@@ -1380,6 +1391,7 @@ static int scan_fast(struct ubi_device *ubi, struct ubi_attach_info **ai)
 	return ubi_scan_fastmap(ubi, *ai, fm_anchor);
 
 out_vidh:
+	ubi_io_hdrs_free(ubi);
 	ubi_free_vid_hdr(ubi, vidh);
 out_ech:
 	kfree(ech);
@@ -1389,6 +1401,40 @@ out:
 
 #endif
 
+/**
+ * init_volumes - set up volumes, wear-leveling and EBA from attaching info.
+ * @ubi: UBI device descriptor
+ * @ai: attaching information
+ *
+ * This function returns zero in case of success and a negative error code in
+ * case of failure, in which case nothing is left set up.
+ */
+static int init_volumes(struct ubi_device *ubi, struct ubi_attach_info *ai)
+{
+	int err;
+
+	err = ubi_read_volume_table(ubi, ai);
+	if (err)
+		return err;
+
+	err = ubi_wl_init(ubi, ai);
+	if (err)
+		goto out_vtbl;
+
+	err = ubi_eba_init(ubi, ai);
+	if (err)
+		goto out_wl;
+
+	return 0;
+
+out_wl:
+	ubi_wl_close(ubi);
+out_vtbl:
+	ubi_free_internal_volumes(ubi);
+	vfree(ubi->vtbl);
+	return err;
+}
+
 /**
  * ubi_attach - attach an MTD device.
  * @ubi: UBI device descriptor
@@ -1416,7 +1462,9 @@ int ubi_attach(struct ubi_device *ubi, int force_scan)
 	if (force_scan)
 		err = scan_all(ubi, ai, 0);
 	else {
+		bootstage_start(BOOTSTAGE_ID_ACCUM_UBI_FASTMAP, "ubi_fastmap");
 		err = scan_fast(ubi, &ai);
+		bootstage_accum(BOOTSTAGE_ID_ACCUM_UBI_FASTMAP);
 		if (err > 0 || mtd_is_eccerr(err)) {
 			if (err != UBI_NO_FASTMAP) {
 				destroy_ai(ai);
@@ -1443,18 +1491,12 @@ int ubi_attach(struct ubi_device *ubi, int force_scan)
 	ubi->mean_ec = ai->mean_ec;
 	dbg_gen("max. sequence number:       %llu", ai->max_sqnum);
 
-	err = ubi_read_volume_table(ubi, ai);
+	bootstage_start(BOOTSTAGE_ID_ACCUM_UBI_INIT, "ubi_init");
+	err = init_volumes(ubi, ai);
+	bootstage_accum(BOOTSTAGE_ID_ACCUM_UBI_INIT);
 	if (err)
 		goto out_ai;
 
-	err = ubi_wl_init(ubi, ai);
-	if (err)
-		goto out_vtbl;
-
-	err = ubi_eba_init(ubi, ai);
-	if (err)
-		goto out_wl;
-
 #ifdef CONFIG_MTD_UBI_FASTMAP
 	if (ubi->fm && ubi_dbg_chk_fastmap(ubi)) {
 		struct ubi_attach_info *scan_ai;
@@ -1484,7 +1526,6 @@ int ubi_attach(struct ubi_device *ubi, int force_scan)
 
 out_wl:
 	ubi_wl_close(ubi);
-out_vtbl:
 	ubi_free_internal_volumes(ubi);
 	vfree(ubi->vtbl);
 out_ai:
@@ -136,6 +136,11 @@ int ubi_io_read(const struct ubi_device *ubi, void *buf, int pnum, int offset,
 	if (err)
 		return err;
 
+	if (pnum == ubi->hdrs_pnum && offset + len <= ubi->hdrs_read) {
+		memcpy(buf, ubi->hdrs_buf + offset, len);
+		return 0;
+	}
+
 	/*
 	 * Deliberately corrupt the buffer to improve robustness. Indeed, if we
 	 * do not do this, the following may happen:
@@ -211,6 +216,72 @@ retry:
 	return err;
 }
 
+/**
+ * ubi_io_hdrs_init - set up reading both headers of a PEB at once.
+ * @ubi: UBI device description object
+ *
+ * Attaching by scanning asks every PEB in use for its EC header and then for
+ * its VID header, which are two separate MTD reads. Between
+ * ubi_io_hdrs_init() and ubi_io_hdrs_free(), ubi_io_read_hdrs() fetches both
+ * with one read and ubi_io_read() serves the headers from that copy. Only
+ * use this while no PEB is written or erased.
+ *
+ * Returns zero in case of success and %-ENOMEM if the buffer could not be
+ * allocated, in which case the headers are simply read one by one.
+ */
+int ubi_io_hdrs_init(struct ubi_device *ubi)
+{
+	ubi->hdrs_pnum = -1;
+	ubi->hdrs_ff = 0;
+	ubi->hdrs_len = ubi->vid_hdr_aloffset + ubi->vid_hdr_alsize;
+	ubi->hdrs_buf = kmalloc(ubi->hdrs_len, GFP_KERNEL);
+	if (!ubi->hdrs_buf)
+		return -ENOMEM;
+	return 0;
+}
+
+/**
+ * ubi_io_hdrs_free - stop reading both headers of a PEB at once.
+ * @ubi: UBI device description object
+ */
+void ubi_io_hdrs_free(struct ubi_device *ubi)
+{
+	kfree(ubi->hdrs_buf);
+	ubi->hdrs_buf = NULL;
+	ubi->hdrs_pnum = -1;
+}
+
+/**
+ * ubi_io_read_hdrs - read the EC and VID headers of a PEB at once.
+ * @ubi: UBI device description object
+ * @pnum: physical eraseblock number to read from
+ *
+ * Erased PEBs have no VID header and usually come in runs, so after a PEB
+ * whose EC header is erased only the EC header of the next one is read. If
+ * that one turns out to be in use, ubi_io_read() reads its VID header on its
+ * own. Any error, including corrected bit-flips, leaves the copy unused so
+ * that ubi_io_read() reads and reports each header on its own as before.
+ */
+void ubi_io_read_hdrs(struct ubi_device *ubi, int pnum)
+{
+	size_t read;
+	int err, len;
+
+	ubi->hdrs_pnum = -1;
+	if (!ubi->hdrs_buf)
+		return;
+
+	len = ubi->hdrs_ff ? ubi->ec_hdr_alsize : ubi->hdrs_len;
+	err = mtd_read(ubi->mtd, (loff_t)pnum * ubi->peb_size, len, &read,
+		       ubi->hdrs_buf);
+	if (err || read != len)
+		return;
+
+	ubi->hdrs_pnum = pnum;
+	ubi->hdrs_read = len;
+	ubi->hdrs_ff = ubi_check_pattern(ubi->hdrs_buf, 0xFF, UBI_EC_HDR_SIZE);
+}
+
 /**
  * ubi_io_write - write data to a physical eraseblock.
  * @ubi: UBI device description object
@@ -523,6 +523,12 @@ struct ubi_debug_info {
  * @max_write_size: maximum amount of bytes the underlying flash can write at a
  *                  time (MTD write buffer size)
  * @mtd: MTD device descriptor
+ * @hdrs_buf: EC and VID headers of PEB @hdrs_pnum, read in one go while
+ *            attaching
+ * @hdrs_len: size of @hdrs_buf
+ * @hdrs_read: how much of @hdrs_buf was read from @hdrs_pnum
+ * @hdrs_pnum: PEB held in @hdrs_buf, %-1 if none
+ * @hdrs_ff: if the EC header last read into @hdrs_buf was erased
  *
  * @peb_buf: a buffer of PEB size used for different purposes
  * @buf_mutex: protects @peb_buf
@@ -622,6 +628,11 @@ struct ubi_device {
 	unsigned int nor_flash:1;
 	int max_write_size;
 	struct mtd_info *mtd;
+	void *hdrs_buf;
+	int hdrs_len;
+	int hdrs_read;
+	int hdrs_pnum;
+	int hdrs_ff;
 
 	void *peb_buf;
 	struct mutex buf_mutex;
@@ -890,6 +901,9 @@ int ubi_io_write(struct ubi_device *ubi, const void *buf, int pnum, int offset,
 int ubi_io_sync_erase(struct ubi_device *ubi, int pnum, int torture);
 int ubi_io_is_bad(const struct ubi_device *ubi, int pnum);
 int ubi_io_mark_bad(const struct ubi_device *ubi, int pnum);
+int ubi_io_hdrs_init(struct ubi_device *ubi);
+void ubi_io_hdrs_free(struct ubi_device *ubi);
+void ubi_io_read_hdrs(struct ubi_device *ubi, int pnum);
 int ubi_io_read_ec_hdr(struct ubi_device *ubi, int pnum,
 		       struct ubi_ec_hdr *ec_hdr, int verbose);
 int ubi_io_write_ec_hdr(struct ubi_device *ubi, int pnum,
@@ -8,6 +8,7 @@
  */
 
 #include <common.h>
+#include <bootstage.h>
 #include <errno.h>
 #include <linux/bug.h>
 #include <u-boot/crc.h>
@@ -886,7 +887,10 @@ static void ipl_scan(struct ubi_scan_info *ubi)
 		 * Try to attach the fastmap, if that fails continue
 		 * scanning.
 		 */
-		if (!ubi_scan_fastmap(ubi, NULL, pnum))
+		bootstage_start(BOOTSTAGE_ID_ACCUM_UBI_FASTMAP, "ubi_fastmap");
+		res = ubi_scan_fastmap(ubi, NULL, pnum);
+		bootstage_accum(BOOTSTAGE_ID_ACCUM_UBI_FASTMAP);
+		if (!res)
 			return;
 		/*
 		 * Fastmap failed. Clear everything we have and start
@@ -901,8 +905,10 @@ static void ipl_scan(struct ubi_scan_info *ubi)
 	 * Continue scanning, ignore errors, we might find what we are
 	 * looking for,
 	 */
+	bootstage_start(BOOTSTAGE_ID_ACCUM_UBI_SCAN, "ubi_scan");
 	for (; pnum < ubi->peb_count; pnum++)
 		ubi_scan_vid_hdr(ubi, ubi->blockinfo + pnum, pnum);
+	bootstage_accum(BOOTSTAGE_ID_ACCUM_UBI_SCAN);
 }
 
 /*
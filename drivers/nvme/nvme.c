@@ -17,15 +17,14 @@
 #include <linux/compat.h>
 #include "nvme.h"
 
-#define NVME_Q_DEPTH		2
+#define NVME_Q_DEPTH		CONFIG_NVME_QUEUE_DEPTH
 #define NVME_AQ_DEPTH		2
-#define NVME_SQ_SIZE(depth)	(depth * sizeof(struct nvme_command))
-#define NVME_CQ_SIZE(depth)	(depth * sizeof(struct nvme_completion))
+#define NVME_SQ_SIZE(depth)	((depth) * sizeof(struct nvme_command))
+#define NVME_CQ_SIZE(depth)	((depth) * sizeof(struct nvme_completion))
 #define NVME_CQ_ALLOCATION	ALIGN(NVME_CQ_SIZE(NVME_Q_DEPTH), \
 				      ARCH_DMA_MINALIGN)
 #define ADMIN_TIMEOUT		60
 #define IO_TIMEOUT		30
-#define MAX_PRP_POOL		512
 
 static int nvme_wait_ready(struct nvme_dev *dev, bool enabled)
 {
@@ -45,8 +44,18 @@ static int nvme_wait_ready(struct nvme_dev *dev, bool enabled)
 	return -ETIME;
 }
 
-static int nvme_setup_prps(struct nvme_dev *dev, u64 *prp2,
-			   int total_len, u64 dma_addr)
+/**
+ * nvme_setup_prps() - set up the PRP entries for a transfer
+ *
+ * @dev:	NVMe device
+ * @slot:	Command slot, whose PRP list is (re)allocated if needed
+ * @prp2:	Returns the value for the command's PRP2 field
+ * @total_len:	Number of bytes to transfer
+ * @dma_addr:	Address of the buffer to transfer
+ * Return: 0 if OK, -ENOMEM if the PRP list could not be allocated
+ */
+static int nvme_setup_prps(struct nvme_dev *dev, struct nvme_io_slot *slot,
+			   u64 *prp2, int total_len, u64 dma_addr)
 {
 	u32 page_size = dev->page_size;
 	int offset = dma_addr & (page_size - 1);
@@ -72,39 +81,41 @@ static int nvme_setup_prps(struct nvme_dev *dev, u64 *prp2,
 	}
 
 	nprps = DIV_ROUND_UP(length, page_size);
-	num_pages = DIV_ROUND_UP(nprps, prps_per_page);
+	/* the last entry of each page points to the next page */
+	num_pages = DIV_ROUND_UP(nprps, prps_per_page - 1);
 
-	if (nprps > dev->prp_entry_num) {
-		free(dev->prp_pool);
+	if (num_pages * prps_per_page > slot->prp_entry_num) {
+		free(slot->prp_pool);
 		/*
 		 * Always increase in increments of pages.  It doesn't waste
 		 * much memory and reduces the number of allocations.
 		 */
-		dev->prp_pool = memalign(page_size, num_pages * page_size);
-		if (!dev->prp_pool) {
+		slot->prp_pool = memalign(page_size, num_pages * page_size);
+		if (!slot->prp_pool) {
 			printf("Error: malloc prp_pool fail\n");
+			slot->prp_entry_num = 0;
 			return -ENOMEM;
 		}
-		dev->prp_entry_num = prps_per_page * num_pages;
+		slot->prp_entry_num = prps_per_page * num_pages;
 	}
 
-	prp_pool = dev->prp_pool;
+	prp_pool = slot->prp_pool;
 	i = 0;
 	while (nprps) {
-		if (i == ((page_size >> 3) - 1)) {
+		if (i == prps_per_page - 1) {
 			*(prp_pool + i) = cpu_to_le64((ulong)prp_pool +
 					page_size);
 			i = 0;
-			prp_pool += page_size;
+			prp_pool += prps_per_page;
 		}
 		*(prp_pool + i++) = cpu_to_le64(dma_addr);
 		dma_addr += page_size;
 		nprps--;
 	}
-	*prp2 = (ulong)dev->prp_pool;
+	*prp2 = (ulong)slot->prp_pool;
 
-	flush_dcache_range((ulong)dev->prp_pool, (ulong)dev->prp_pool +
-			   dev->prp_entry_num * sizeof(u64));
+	flush_dcache_range((ulong)slot->prp_pool, (ulong)slot->prp_pool +
+			   num_pages * page_size);
 
 	return 0;
 }
@@ -159,52 +170,45 @@ static void nvme_submit_cmd(struct nvme_queue *nvmeq, struct nvme_command *cmd)
 	nvmeq->sq_tail = tail;
 }
 
-static int nvme_submit_sync_cmd(struct nvme_queue *nvmeq,
-				struct nvme_command *cmd,
-				u32 *result, unsigned timeout)
+/**
+ * nvme_read_completion() - consume the next completion on a queue, if any
+ *
+ * @nvmeq:	The queue to check
+ * @cmd:	The command which the completion is expected for, or NULL to
+ *		look it up in the queue's I/O command slots
+ * @result:	Returns the command-specific result, if not NULL
+ * @cid:	Returns the ID of the completed command, if not NULL
+ * Return: 0 if the command succeeded, -EAGAIN if no command has completed,
+ *	-EIO if the command failed
+ */
+static int nvme_read_completion(struct nvme_queue *nvmeq,
+				struct nvme_command *cmd, u32 *result,
+				u16 *cid)
 {
 	struct nvme_ops *ops;
 	u16 head = nvmeq->cq_head;
 	u16 phase = nvmeq->cq_phase;
-	u16 status;
-	ulong start_time;
-	ulong timeout_us = timeout * 100000;
-
-	cmd->common.command_id = nvme_get_cmd_id();
-	nvme_submit_cmd(nvmeq, cmd);
+	u16 status, id;
 
-	start_time = timer_get_us();
+	status = nvme_read_completion_status(nvmeq, head);
+	if ((status & 0x01) != phase)
+		return -EAGAIN;
 
-	for (;;) {
-		status = nvme_read_completion_status(nvmeq, head);
-		if ((status & 0x01) == phase)
-			break;
-		if (timeout_us > 0 && (timer_get_us() - start_time)
-		    >= timeout_us)
-			return -ETIMEDOUT;
-	}
+	id = readw(&nvmeq->cqes[head].command_id);
+	if (cid)
+		*cid = id;
+	if (!cmd && id < nvmeq->nr_slots)
+		cmd = &nvmeq->slots[id].cmd;
 
 	ops = (struct nvme_ops *)nvmeq->dev->udev->driver->ops;
 	if (ops && ops->complete_cmd)
 		ops->complete_cmd(nvmeq, cmd);
 
 	status >>= 1;
-	if (status) {
+	if (status)
 		printf("ERROR: status = %x, phase = %d, head = %d\n",
 		       status, phase, head);
-		status = 0;
-		if (++head == nvmeq->q_depth) {
-			head = 0;
-			phase = !phase;
-		}
-		writel(head, nvmeq->q_db + nvmeq->dev->db_stride);
-		nvmeq->cq_head = head;
-		nvmeq->cq_phase = phase;
-
-		return -EIO;
-	}
-
-	if (result)
+	else if (result)
 		*result = readl(&(nvmeq->cqes[head].result));
 
 	if (++head == nvmeq->q_depth) {
@@ -215,7 +219,30 @@ static int nvme_submit_sync_cmd(struct nvme_queue *nvmeq,
 	nvmeq->cq_head = head;
 	nvmeq->cq_phase = phase;
 
-	return status;
+	return status ? -EIO : 0;
+}
+
+static int nvme_submit_sync_cmd(struct nvme_queue *nvmeq,
+				struct nvme_command *cmd,
+				u32 *result, unsigned timeout)
+{
+	ulong start_time;
+	ulong timeout_us = timeout * 100000;
+	int ret;
+
+	cmd->common.command_id = nvme_get_cmd_id();
+	nvme_submit_cmd(nvmeq, cmd);
+
+	start_time = timer_get_us();
+
+	for (;;) {
+		ret = nvme_read_completion(nvmeq, cmd, result, NULL);
+		if (ret != -EAGAIN)
+			return ret;
+		if (timeout_us > 0 && (timer_get_us() - start_time)
+		    >= timeout_us)
+			return -ETIMEDOUT;
+	}
 }
 
 static int nvme_submit_admin_cmd(struct nvme_dev *dev, struct nvme_command *cmd,
@@ -246,6 +273,18 @@ static struct nvme_queue *nvme_alloc_queue(struct nvme_dev *dev,
 
 	nvmeq->dev = dev;
 
+	if (qid >= NVME_IO_Q) {
+		ops = (struct nvme_ops *)dev->udev->driver->ops;
+		/*
+		 * Controller-specific submission only copes with a single
+		 * command in flight at a time
+		 */
+		nvmeq->nr_slots = ops && ops->submit_cmd ? 1 : depth - 1;
+		nvmeq->slots = calloc(nvmeq->nr_slots, sizeof(*nvmeq->slots));
+		if (!nvmeq->slots)
+			goto free_sq;
+	}
+
 	nvmeq->cq_head = 0;
 	nvmeq->cq_phase = 1;
 	nvmeq->q_db = &dev->dbs[qid * 2 * dev->db_stride];
@@ -260,6 +299,8 @@ static struct nvme_queue *nvme_alloc_queue(struct nvme_dev *dev,
 
 	return nvmeq;
 
+ free_sq:
+	free(nvmeq->sq_cmds);
  free_queue:
 	free((void *)nvmeq->cqes);
  free_nvmeq:
@@ -309,6 +350,11 @@ static int nvme_disable_ctrl(struct nvme_dev *dev)
 
 static void nvme_free_queue(struct nvme_queue *nvmeq)
 {
+	int i;
+
+	for (i = 0; i < nvmeq->nr_slots; i++)
+		free(nvmeq->slots[i].prp_pool);
+	free(nvmeq->slots);
 	free((void *)nvmeq->cqes);
 	free(nvmeq->sq_cmds);
 	free(nvmeq);
@@ -584,19 +630,25 @@ static void nvme_create_io_queues(struct nvme_dev *dev)
 
 static int nvme_setup_io_queues(struct nvme_dev *dev)
 {
+	struct nvme_ops *ops = (struct nvme_ops *)dev->udev->driver->ops;
 	int nr_io_queues;
 	int result;
 
-	nr_io_queues = 1;
+	/* Controller-specific submission only supports a single I/O queue */
+	nr_io_queues = ops && ops->submit_cmd ? 1 : CONFIG_NVME_IO_QUEUES;
 	result = nvme_set_queue_count(dev, nr_io_queues);
 	if (result <= 0)
 		return result;
 
+	nr_io_queues = min(nr_io_queues, result);
 	dev->max_qid = nr_io_queues;
 
 	/* Free previously allocated queues */
 	nvme_free_queues(dev, nr_io_queues + 1);
 	nvme_create_io_queues(dev);
+	dev->nr_io_queues = dev->online_queues - 1;
+	if (!dev->nr_io_queues)
+		return -EIO;
 
 	return 0;
 }
@@ -719,65 +771,235 @@ static int nvme_blk_probe(struct udevice *udev)
 	return 0;
 }
 
-static ulong nvme_blk_rw(struct udevice *udev, lbaint_t blknr,
-			 lbaint_t blkcnt, void *buffer, bool read)
+/**
+ * struct nvme_io_state - progress of a block request
+ *
+ * @issued:	Number of blocks for which commands have been submitted
+ * @inflight:	Number of commands submitted but not yet completed
+ * @err:	First error seen, or 0
+ */
+struct nvme_io_state {
+	lbaint_t issued;
+	int inflight;
+	int err;
+};
+
+/*
+ * Requests are split into commands of at most the controller's maximum
+ * transfer size. Commands are spread over the I/O queues and as many are
+ * kept in flight as there are free command slots, so that large transfers
+ * are limited by bandwidth rather than per-command latency.
+ */
+static void nvme_io_finish(struct nvme_dev *dev, struct blk_request *req)
 {
-	struct nvme_ns *ns = dev_get_priv(udev);
-	struct nvme_dev *dev = ns->dev;
-	struct nvme_command c;
-	struct blk_desc *desc = dev_get_uclass_plat(udev);
-	int status;
+	struct blk_desc *desc = dev_get_uclass_plat(req->dev);
+	struct nvme_io_state *state = req->drv_priv;
+	int err = state->err;
+
+	if (req->op == BLK_REQ_READ)
+		invalidate_dcache_range((ulong)req->buffer, (ulong)req->buffer +
+					(req->blkcnt << desc->log2blksz));
+
+	list_del(&req->node);
+	free(state);
+	req->drv_priv = NULL;
+	blk_complete_request(req, err ? err : req->blkcnt);
+}
+
+static struct nvme_io_slot *nvme_io_get_slot(struct nvme_dev *dev,
+					     struct nvme_queue **nvmeqp,
+					     u16 *cid)
+{
+	struct nvme_queue *nvmeq;
+	unsigned int n, qid;
+	u16 i;
+
+	for (n = 0; n < dev->nr_io_queues; n++) {
+		qid = NVME_IO_Q + (dev->io_next_q + n) % dev->nr_io_queues;
+		nvmeq = dev->queues[qid];
+		for (i = 0; i < nvmeq->nr_slots; i++) {
+			struct nvme_io_slot *slot = &nvmeq->slots[i];
+
+			if (slot->req || slot->timed_out)
+				continue;
+			/* spread the next command onto the next queue */
+			dev->io_next_q = (qid - NVME_IO_Q + 1) %
+				dev->nr_io_queues;
+			*nvmeqp = nvmeq;
+			*cid = i;
+			return slot;
+		}
+	}
+
+	return NULL;
+}
+
+static void nvme_io_start(struct nvme_dev *dev)
+{
+	struct blk_request *req, *next;
+	struct nvme_io_state *state;
+	struct nvme_io_slot *slot;
+	struct nvme_queue *nvmeq;
+	struct nvme_command *c;
+	struct nvme_ns *ns;
+	uintptr_t buffer;
 	u64 prp2;
-	u64 total_len = blkcnt << desc->log2blksz;
-	u64 temp_len = total_len;
-	uintptr_t temp_buffer = (uintptr_t)buffer;
-
-	u64 slba = blknr;
-	u16 lbas = 1 << (dev->max_transfer_shift - ns->lba_shift);
-	u64 total_lbas = blkcnt;
-
-	flush_dcache_range((unsigned long)buffer,
-			   (unsigned long)buffer + total_len);
-
-	c.rw.opcode = read ? nvme_cmd_read : nvme_cmd_write;
-	c.rw.flags = 0;
-	c.rw.nsid = cpu_to_le32(ns->ns_id);
-	c.rw.control = 0;
-	c.rw.dsmgmt = 0;
-	c.rw.reftag = 0;
-	c.rw.apptag = 0;
-	c.rw.appmask = 0;
-	c.rw.metadata = 0;
-
-	while (total_lbas) {
-		if (total_lbas < lbas) {
-			lbas = (u16)total_lbas;
-			total_lbas = 0;
-		} else {
-			total_lbas -= lbas;
+	u16 lbas, cid;
+
+	list_for_each_entry_safe(req, next, &dev->io_reqs, node) {
+		ns = dev_get_priv(req->dev);
+		state = req->drv_priv;
+
+		while (!state->err && state->issued < req->blkcnt) {
+			slot = nvme_io_get_slot(dev, &nvmeq, &cid);
+			if (!slot)
+				return;
+
+			lbas = min_t(lbaint_t, req->blkcnt - state->issued,
+				     1 << (dev->max_transfer_shift -
+					   ns->lba_shift));
+			buffer = (uintptr_t)req->buffer +
+				(state->issued << ns->lba_shift);
+			if (nvme_setup_prps(dev, slot, &prp2,
+					    lbas << ns->lba_shift, buffer)) {
+				/* give up on the rest of the request */
+				state->err = -EIO;
+				break;
+			}
+
+			c = &slot->cmd;
+			memset(c, '\0', sizeof(*c));
+			c->rw.opcode = req->op == BLK_REQ_READ ? nvme_cmd_read :
+				nvme_cmd_write;
+			c->rw.command_id = cpu_to_le16(cid);
+			c->rw.nsid = cpu_to_le32(ns->ns_id);
+			c->rw.slba = cpu_to_le64(req->start + state->issued);
+			c->rw.length = cpu_to_le16(lbas - 1);
+			c->rw.prp1 = cpu_to_le64(buffer);
+			c->rw.prp2 = cpu_to_le64(prp2);
+
+			slot->req = req;
+			slot->lbas = lbas;
+			slot->start = timer_get_us();
+			state->issued += lbas;
+			state->inflight++;
+			nvme_submit_cmd(nvmeq, c);
 		}
 
-		if (nvme_setup_prps(dev, &prp2,
-				    lbas << ns->lba_shift, temp_buffer))
-			return -EIO;
-		c.rw.slba = cpu_to_le64(slba);
-		slba += lbas;
-		c.rw.length = cpu_to_le16(lbas - 1);
-		c.rw.prp1 = cpu_to_le64(temp_buffer);
-		c.rw.prp2 = cpu_to_le64(prp2);
-		status = nvme_submit_sync_cmd(dev->queues[NVME_IO_Q],
-				&c, NULL, IO_TIMEOUT);
-		if (status)
-			break;
-		temp_len -= (u32)lbas << ns->lba_shift;
-		temp_buffer += lbas << ns->lba_shift;
+		if (!state->inflight)
+			nvme_io_finish(dev, req);
 	}
+}
+
+static int nvme_io_complete(struct nvme_dev *dev, struct nvme_io_slot *slot,
+			    int err)
+{
+	struct blk_request *req = slot->req;
+	struct nvme_io_state *state = req->drv_priv;
+
+	slot->req = NULL;
+	if (err && !state->err)
+		state->err = err;
+	if (--state->inflight || (!state->err && state->issued < req->blkcnt))
+		return 0;
+
+	nvme_io_finish(dev, req);
+
+	return 1;
+}
+
+static int nvme_io_poll(struct nvme_dev *dev)
+{
+	struct nvme_io_slot *slot;
+	struct nvme_queue *nvmeq;
+	int count = 0;
+	unsigned int qid;
+	int ret;
+	u16 cid, i;
+
+	for (qid = NVME_IO_Q; qid < NVME_IO_Q + dev->nr_io_queues; qid++) {
+		nvmeq = dev->queues[qid];
+
+		for (;;) {
+			ret = nvme_read_completion(nvmeq, NULL, NULL, &cid);
+			if (ret == -EAGAIN)
+				break;
+			if (cid >= nvmeq->nr_slots) {
+				printf("ERROR: unexpected command id %u\n", cid);
+				continue;
+			}
+			slot = &nvmeq->slots[cid];
+			slot->timed_out = false;
+			if (slot->req)
+				count += nvme_io_complete(dev, slot, ret);
+		}
+
+		/* the slot stays reserved until the command completes */
+		for (i = 0; i < nvmeq->nr_slots; i++) {
+			slot = &nvmeq->slots[i];
+			if (slot->req && timer_get_us() - slot->start >=
+			    IO_TIMEOUT * 100000) {
+				slot->timed_out = true;
+				count += nvme_io_complete(dev, slot,
+							  -ETIMEDOUT);
+			}
+		}
+	}
+
+	nvme_io_start(dev);
 
-	if (read)
-		invalidate_dcache_range((unsigned long)buffer,
-					(unsigned long)buffer + total_len);
+	return count;
+}
+
+static int nvme_blk_submit(struct udevice *udev, struct blk_request *req)
+{
+	struct nvme_ns *ns = dev_get_priv(udev);
+	struct nvme_dev *dev = ns->dev;
+	struct blk_desc *desc = dev_get_uclass_plat(udev);
+	struct nvme_io_state *state;
+
+	state = calloc(1, sizeof(*state));
+	if (!state)
+		return -ENOMEM;
+	req->drv_priv = state;
+
+	flush_dcache_range((ulong)req->buffer, (ulong)req->buffer +
+			   (req->blkcnt << desc->log2blksz));
 
-	return (total_len - temp_len) >> desc->log2blksz;
+	list_add_tail(&req->node, &dev->io_reqs);
+	nvme_io_start(dev);
+
+	return 0;
+}
+
+static int nvme_blk_poll(struct udevice *udev)
+{
+	struct nvme_ns *ns = dev_get_priv(udev);
+
+	return nvme_io_poll(ns->dev);
+}
+
+static ulong nvme_blk_rw(struct udevice *udev, lbaint_t blknr,
+			 lbaint_t blkcnt, void *buffer, bool read)
+{
+	struct nvme_ns *ns = dev_get_priv(udev);
+	struct blk_request req = {
+		.op	= read ? BLK_REQ_READ : BLK_REQ_WRITE,
+		.start	= blknr,
+		.blkcnt	= blkcnt,
+		.buffer	= buffer,
+		.dev	= udev,
+	};
+
+	int ret;
+
+	ret = nvme_blk_submit(udev, &req);
+	if (ret)
+		return ret;
+	while (!req.done)
+		nvme_io_poll(ns->dev);
+
+	return req.result;
 }
 
 static ulong nvme_blk_read(struct udevice *udev, lbaint_t blknr,
@@ -795,6 +1017,8 @@ static ulong nvme_blk_write(struct udevice *udev, lbaint_t blknr,
 static const struct blk_ops nvme_blk_ops = {
 	.read	= nvme_blk_read,
 	.write	= nvme_blk_write,
+	.submit	= nvme_blk_submit,
+	.poll	= nvme_blk_poll,
 };
 
 U_BOOT_DRIVER(nvme_blk) = {
@@ -813,6 +1037,7 @@ int nvme_init(struct udevice *udev)
 
 	ndev->udev = udev;
 	INIT_LIST_HEAD(&ndev->namespaces);
+	INIT_LIST_HEAD(&ndev->io_reqs);
 	if (readl(&ndev->bar->csts) == -1) {
 		ret = -ENODEV;
 		printf("Error: %s: Out of memory!\n", udev->name);
@@ -836,15 +1061,6 @@ int nvme_init(struct udevice *udev)
 	if (ret)
 		goto free_queue;
 
-	/* Allocate after the page size is known */
-	ndev->prp_pool = memalign(ndev->page_size, MAX_PRP_POOL);
-	if (!ndev->prp_pool) {
-		ret = -ENOMEM;
-		printf("Error: %s: Out of memory!\n", udev->name);
-		goto free_nvme;
-	}
-	ndev->prp_entry_num = MAX_PRP_POOL >> 3;
-
 	ret = nvme_setup_io_queues(ndev);
 	if (ret)
 		goto free_queue;
@@ -7,6 +7,8 @@
 #ifndef __DRIVER_NVME_H__
 #define __DRIVER_NVME_H__
 
+#include <blk.h>
+#include <blk_req.h>
 #include <asm/io.h>
 
 struct nvme_id_power_state {
@@ -618,16 +620,45 @@ struct nvme_dev {
 	u32 stripe_size;
 	u32 page_size;
 	u8 vwc;
-	u64 *prp_pool;
-	u32 prp_entry_num;
 	u32 nn;
+	/* Number of I/O queues in use */
+	unsigned int nr_io_queues;
+	/* Index of the I/O queue to try first for the next command */
+	unsigned int io_next_q;
+	/* Block requests which still have commands to submit or complete */
+	struct list_head io_reqs;
 };
 
-/* Admin queue and a single I/O queue. */
+/* Admin queue followed by the I/O queues. */
 enum nvme_queue_id {
 	NVME_ADMIN_Q,
 	NVME_IO_Q,
-	NVME_Q_NUM,
+};
+
+#define NVME_Q_NUM	(NVME_IO_Q + CONFIG_NVME_IO_QUEUES)
+
+/**
+ * struct nvme_io_slot - an I/O command which may be in flight
+ *
+ * The index of the slot in its queue is used as the command ID.
+ *
+ * @req:	Block request the command is part of, NULL if the slot is free
+ * @cmd:	The command
+ * @lbas:	Number of blocks transferred by the command
+ * @timed_out:	true if the command timed out; the slot is not reused until
+ *		the controller completes it
+ * @start:	timer_get_us() when the command was submitted
+ * @prp_pool:	PRP list for the command
+ * @prp_entry_num: Number of entries allocated in @prp_pool
+ */
+struct nvme_io_slot {
+	struct blk_request *req;
+	struct nvme_command cmd;
+	u16 lbas;
+	bool timed_out;
+	ulong start;
+	u64 *prp_pool;
+	u32 prp_entry_num;
 };
 
 /*
@@ -647,6 +678,8 @@ struct nvme_queue {
 	u16 qid;
 	u8 cq_phase;
 	u8 cqe_seen;
+	struct nvme_io_slot *slots;
+	u16 nr_slots;
 	unsigned long cmdid_data[];
 };
 
@@ -6,69 +6,265 @@
 
 #include <common.h>
 #include <blk.h>
+#include <blk_req.h>
 #include <dm.h>
+#include <malloc.h>
 #include <part.h>
 #include <virtio_types.h>
 #include <virtio.h>
 #include <virtio_ring.h>
 #include "virtio_blk.h"
 
+/* Maximum number of data segments in a single virtio request */
+#define VIRTIO_BLK_MAX_SEGS	32
+
 struct virtio_blk_priv {
 	struct virtqueue *vq;
+	u32 seg_size;
+	unsigned int max_segs;
+	lbaint_t max_blocks;
+	bool kick;
+	struct list_head io_reqs;
 };
 
-static ulong virtio_blk_do_req(struct udevice *dev, u64 sector,
-			       lbaint_t blkcnt, void *buffer, u32 type)
+/**
+ * struct virtio_blk_req - a request in flight on the virtqueue
+ *
+ * @out_hdr:	Request header. This must be first, since its address is
+ *		what virtqueue_get_buf() returns on completion
+ * @status:	Status written by the device
+ * @req:	Block request being handled
+ */
+struct virtio_blk_req {
+	struct virtio_blk_outhdr out_hdr;
+	u8 status;
+	struct blk_request *req;
+};
+
+/**
+ * struct virtio_blk_io_state - progress of a block request
+ *
+ * @issued:	Number of blocks for which virtio requests have been queued
+ * @inflight:	Number of virtio requests queued but not yet completed
+ * @err:	First error seen, or 0
+ */
+struct virtio_blk_io_state {
+	lbaint_t issued;
+	int inflight;
+	int err;
+};
+
+/*
+ * Block requests are split into virtio requests of at most max_blocks
+ * sectors, and as many are placed on the virtqueue as it has room for.
+ * The device is only notified once per batch, when the caller polls, so
+ * a large transfer costs a single notification rather than one per chunk.
+ */
+static int virtio_blk_add(struct udevice *dev, struct blk_request *req,
+			  lbaint_t offset, lbaint_t blkcnt)
 {
 	struct virtio_blk_priv *priv = dev_get_priv(dev);
-	unsigned int num_out = 0, num_in = 0;
-	struct virtio_sg *sgs[3];
-	u8 status;
+	struct virtio_sg sg[VIRTIO_BLK_MAX_SEGS + 2];
+	struct virtio_sg *sgs[VIRTIO_BLK_MAX_SEGS + 2];
+	unsigned int num_out = 0, num_in = 0, n = 0;
+	struct virtio_blk_req *vreq;
+	size_t len = blkcnt * 512;
+	u8 *buf = req->buffer + offset * 512;
+	u32 type;
 	int ret;
 
-	struct virtio_blk_outhdr out_hdr = {
-		.type = cpu_to_virtio32(dev, type),
-		.sector = cpu_to_virtio64(dev, sector),
-	};
-	struct virtio_sg hdr_sg = { &out_hdr, sizeof(out_hdr) };
-	struct virtio_sg data_sg = { buffer, blkcnt * 512 };
-	struct virtio_sg status_sg = { &status, sizeof(status) };
+	vreq = malloc(sizeof(*vreq));
+	if (!vreq)
+		return -ENOMEM;
 
-	sgs[num_out++] = &hdr_sg;
+	type = req->op == BLK_REQ_WRITE ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;
+	vreq->out_hdr.type = cpu_to_virtio32(dev, type);
+	vreq->out_hdr.ioprio = 0;
+	vreq->out_hdr.sector = cpu_to_virtio64(dev, req->start + offset);
+	vreq->req = req;
 
-	if (type & VIRTIO_BLK_T_OUT)
-		sgs[num_out++] = &data_sg;
-	else
-		sgs[num_out + num_in++] = &data_sg;
+	sg[n].addr = &vreq->out_hdr;
+	sg[n].length = sizeof(vreq->out_hdr);
+	sgs[n] = &sg[n];
+	n++;
+	num_out++;
+
+	/* split the data into segments of at most seg_size bytes */
+	while (len) {
+		if (n > priv->max_segs) {
+			free(vreq);
+			return -EINVAL;
+		}
+		sg[n].addr = buf;
+		sg[n].length = priv->seg_size ? min_t(size_t, len,
+						      priv->seg_size) : len;
+		sgs[n] = &sg[n];
+		buf += sg[n].length;
+		len -= sg[n].length;
+		n++;
+		if (type & VIRTIO_BLK_T_OUT)
+			num_out++;
+		else
+			num_in++;
+	}
 
-	sgs[num_out + num_in++] = &status_sg;
+	sg[n].addr = &vreq->status;
+	sg[n].length = sizeof(vreq->status);
+	sgs[n] = &sg[n];
+	num_in++;
 
 	ret = virtqueue_add(priv->vq, sgs, num_out, num_in);
-	if (ret)
+	if (ret) {
+		free(vreq);
 		return ret;
+	}
+	priv->kick = true;
 
-	virtqueue_kick(priv->vq);
+	return 0;
+}
+
+static void virtio_blk_kick(struct virtio_blk_priv *priv)
+{
+	if (priv->kick) {
+		virtqueue_kick(priv->vq);
+		priv->kick = false;
+	}
+}
+
+static void virtio_blk_io_finish(struct blk_request *req)
+{
+	struct virtio_blk_io_state *state = req->drv_priv;
+	int err = state->err;
+
+	list_del(&req->node);
+	free(state);
+	req->drv_priv = NULL;
+	blk_complete_request(req, err ? err : req->blkcnt);
+}
 
-	while (!virtqueue_get_buf(priv->vq, NULL))
-		;
+static void virtio_blk_io_start(struct udevice *dev)
+{
+	struct virtio_blk_priv *priv = dev_get_priv(dev);
+	struct virtio_blk_io_state *state;
+	struct blk_request *req, *next;
+	lbaint_t count;
+	int ret;
+
+	list_for_each_entry_safe(req, next, &priv->io_reqs, node) {
+		state = req->drv_priv;
 
-	return status == VIRTIO_BLK_S_OK ? blkcnt : -EIO;
+		while (!state->err && state->issued < req->blkcnt) {
+			count = min(req->blkcnt - state->issued,
+				    priv->max_blocks);
+			ret = virtio_blk_add(dev, req, state->issued, count);
+			/*
+			 * Wait for room on the ring, unless nothing is in
+			 * flight, as then none will ever be made
+			 */
+			if (ret == -ENOSPC && priv->vq->num_free !=
+			    virtqueue_get_vring_size(priv->vq))
+				goto out;
+			if (ret) {
+				/* give up on the rest of the request */
+				state->err = ret;
+				break;
+			}
+			state->issued += count;
+			state->inflight++;
+		}
+
+		if (!state->inflight)
+			virtio_blk_io_finish(req);
+	}
+
+out:
+	virtio_blk_kick(priv);
+}
+
+static int virtio_blk_submit(struct udevice *dev, struct blk_request *req)
+{
+	struct virtio_blk_priv *priv = dev_get_priv(dev);
+	struct virtio_blk_io_state *state;
+
+	state = calloc(1, sizeof(*state));
+	if (!state)
+		return -ENOMEM;
+	req->drv_priv = state;
+
+	list_add_tail(&req->node, &priv->io_reqs);
+	virtio_blk_io_start(dev);
+
+	return 0;
+}
+
+static int virtio_blk_poll(struct udevice *dev)
+{
+	struct virtio_blk_priv *priv = dev_get_priv(dev);
+	struct virtio_blk_io_state *state;
+	struct virtio_blk_req *vreq;
+	struct blk_request *req;
+	int count = 0;
+
+	while ((vreq = virtqueue_get_buf(priv->vq, NULL))) {
+		req = vreq->req;
+		state = req->drv_priv;
+		if (vreq->status != VIRTIO_BLK_S_OK && !state->err)
+			state->err = -EIO;
+		free(vreq);
+		if (--state->inflight ||
+		    (!state->err && state->issued < req->blkcnt))
+			continue;
+		virtio_blk_io_finish(req);
+		count++;
+	}
+
+	/* refill the ring with whatever did not fit before */
+	virtio_blk_io_start(dev);
+
+	return count;
+}
+
+static ulong virtio_blk_do_req(struct udevice *dev, u64 sector,
+			       lbaint_t blkcnt, void *buffer,
+			       enum blk_req_op op)
+{
+	struct blk_request req = {
+		.op	= op,
+		.start	= sector,
+		.blkcnt	= blkcnt,
+		.buffer	= buffer,
+		.dev	= dev,
+	};
+	int ret;
+
+	ret = virtio_blk_submit(dev, &req);
+	if (ret)
+		return ret;
+
+	while (!req.done)
+		virtio_blk_poll(dev);
+
+	return req.result;
 }
 
 static ulong virtio_blk_read(struct udevice *dev, lbaint_t start,
 			     lbaint_t blkcnt, void *buffer)
 {
-	return virtio_blk_do_req(dev, start, blkcnt, buffer,
-				 VIRTIO_BLK_T_IN);
+	return virtio_blk_do_req(dev, start, blkcnt, buffer, BLK_REQ_READ);
 }
 
 static ulong virtio_blk_write(struct udevice *dev, lbaint_t start,
 			      lbaint_t blkcnt, const void *buffer)
 {
 	return virtio_blk_do_req(dev, start, blkcnt, (void *)buffer,
-				 VIRTIO_BLK_T_OUT);
+				 BLK_REQ_WRITE);
 }
 
+static const u32 feature[] = {
+	VIRTIO_BLK_F_SIZE_MAX,
+	VIRTIO_BLK_F_SEG_MAX,
+};
+
 static int virtio_blk_bind(struct udevice *dev)
 {
 	struct virtio_dev_priv *uc_priv = dev_get_uclass_priv(dev->parent);
@@ -98,7 +294,8 @@ static int virtio_blk_bind(struct udevice *dev)
 	desc->bdev = dev;
 
 	/* Indicate what driver features we support */
-	virtio_driver_features_init(uc_priv, NULL, 0, NULL, 0);
+	virtio_driver_features_init(uc_priv, feature, ARRAY_SIZE(feature),
+				    NULL, 0);
 
 	return 0;
 }
@@ -107,6 +304,7 @@ static int virtio_blk_probe(struct udevice *dev)
 {
 	struct virtio_blk_priv *priv = dev_get_priv(dev);
 	struct blk_desc *desc = dev_get_uclass_plat(dev);
+	u32 seg_max;
 	u64 cap;
 	int ret;
 
@@ -114,6 +312,34 @@ static int virtio_blk_probe(struct udevice *dev)
 	if (ret)
 		return ret;
 
+	INIT_LIST_HEAD(&priv->io_reqs);
+
+	priv->max_segs = VIRTIO_BLK_MAX_SEGS;
+	if (virtio_has_feature(dev, VIRTIO_BLK_F_SEG_MAX)) {
+		virtio_cread(dev, struct virtio_blk_config, seg_max, &seg_max);
+		if (seg_max)
+			priv->max_segs = min_t(u32, seg_max, priv->max_segs);
+	}
+	/*
+	 * Without indirect descriptors each segment takes up a ring slot. The
+	 * indirect table is allocated for each request and may not be, so
+	 * requests must always fit on the ring without it.
+	 */
+	priv->max_segs = min(priv->max_segs,
+			     virtqueue_get_vring_size(priv->vq) - 2);
+
+	priv->seg_size = 0;
+	if (virtio_has_feature(dev, VIRTIO_BLK_F_SIZE_MAX))
+		virtio_cread(dev, struct virtio_blk_config, size_max,
+			     &priv->seg_size);
+
+	priv->max_blocks = CONFIG_VIRTIO_BLK_MAX_XFER * 2;
+	if (priv->seg_size)
+		priv->max_blocks = min_t(lbaint_t, priv->max_blocks,
+					 priv->max_segs * priv->seg_size / 512);
+	if (!priv->max_blocks)
+		priv->max_blocks = 1;
+
 	desc->blksz = 512;
 	desc->log2blksz = 9;
 	virtio_cread(dev, struct virtio_blk_config, capacity, &cap);
@@ -125,6 +351,8 @@ static int virtio_blk_probe(struct udevice *dev)
 static const struct blk_ops virtio_blk_ops = {
 	.read	= virtio_blk_read,
 	.write	= virtio_blk_write,
+	.submit	= virtio_blk_submit,
+	.poll	= virtio_blk_poll,
 };
 
 U_BOOT_DRIVER(virtio_blk) = {
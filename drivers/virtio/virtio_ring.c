@@ -36,10 +36,42 @@ static unsigned int virtqueue_attach_desc(struct virtqueue *vq, unsigned int i,
 	return desc_shadow->next;
 }
 
+static struct vring_desc *alloc_indirect(struct virtqueue *vq,
+					 struct virtio_sg *sgs[],
+					 unsigned int out_sgs,
+					 unsigned int in_sgs)
+{
+	unsigned int total_sg = out_sgs + in_sgs;
+	struct vring_desc *desc;
+	unsigned int n;
+
+	desc = malloc(total_sg * sizeof(struct vring_desc));
+	if (!desc)
+		return NULL;
+
+	for (n = 0; n < total_sg; n++) {
+		u16 flags = VRING_DESC_F_NEXT;
+
+		if (n >= out_sgs)
+			flags |= VRING_DESC_F_WRITE;
+		if (n == total_sg - 1)
+			flags &= ~VRING_DESC_F_NEXT;
+
+		desc[n].addr = cpu_to_virtio64(vq->vdev,
+					       (u64)(uintptr_t)sgs[n]->addr);
+		desc[n].len = cpu_to_virtio32(vq->vdev, sgs[n]->length);
+		desc[n].flags = cpu_to_virtio16(vq->vdev, flags);
+		desc[n].next = cpu_to_virtio16(vq->vdev, n + 1);
+	}
+
+	return desc;
+}
+
 int virtqueue_add(struct virtqueue *vq, struct virtio_sg *sgs[],
 		  unsigned int out_sgs, unsigned int in_sgs)
 {
 	struct vring_desc *desc;
+	struct vring_desc *indir_desc = NULL;
 	unsigned int descs_used = out_sgs + in_sgs;
 	unsigned int i, n, avail, uninitialized_var(prev);
 	int head;
@@ -51,7 +83,25 @@ int virtqueue_add(struct virtqueue *vq, struct virtio_sg *sgs[],
 	desc = vq->vring.desc;
 	i = head;
 
-	if (vq->num_free < descs_used) {
+	/*
+	 * Use an indirect table for multi-element buffers, falling back to
+	 * a direct chain if the table cannot be allocated
+	 */
+	if (vq->indirect && descs_used > 1 && vq->num_free)
+		indir_desc = alloc_indirect(vq, sgs, out_sgs, in_sgs);
+
+	if (indir_desc) {
+		struct virtio_sg sg = {
+			.addr	= indir_desc,
+			.length	= descs_used * sizeof(struct vring_desc),
+		};
+
+		prev = i;
+		i = virtqueue_attach_desc(vq, i, &sg, VRING_DESC_F_INDIRECT);
+		vq->vring_desc_shadow[head].indir_desc = indir_desc;
+		/* The indirect table only takes a single ring slot */
+		descs_used = 1;
+	} else if (vq->num_free < descs_used) {
 		debug("Can't add buf len %i - avail = %i\n",
 		      descs_used, vq->num_free);
 		/*
@@ -62,20 +112,21 @@ int virtqueue_add(struct virtqueue *vq, struct virtio_sg *sgs[],
 		if (out_sgs)
 			virtio_notify(vq->vdev, vq);
 		return -ENOSPC;
+	} else {
+		for (n = 0; n < descs_used; n++) {
+			u16 flags = VRING_DESC_F_NEXT;
+
+			if (n >= out_sgs)
+				flags |= VRING_DESC_F_WRITE;
+			prev = i;
+			i = virtqueue_attach_desc(vq, i, sgs[n], flags);
+		}
+		/* Last one doesn't continue */
+		vq->vring_desc_shadow[prev].flags &= ~VRING_DESC_F_NEXT;
+		desc[prev].flags = cpu_to_virtio16(vq->vdev,
+				vq->vring_desc_shadow[prev].flags);
 	}
 
-	for (n = 0; n < descs_used; n++) {
-		u16 flags = VRING_DESC_F_NEXT;
-
-		if (n >= out_sgs)
-			flags |= VRING_DESC_F_WRITE;
-		prev = i;
-		i = virtqueue_attach_desc(vq, i, sgs[n], flags);
-	}
-	/* Last one doesn't continue */
-	vq->vring_desc_shadow[prev].flags &= ~VRING_DESC_F_NEXT;
-	desc[prev].flags = cpu_to_virtio16(vq->vdev, vq->vring_desc_shadow[prev].flags);
-
 	/* We're using some buffers from the free list. */
 	vq->num_free -= descs_used;
 
@@ -143,12 +194,22 @@ void virtqueue_kick(struct virtqueue *vq)
 		virtio_notify(vq->vdev, vq);
 }
 
-static void detach_buf(struct virtqueue *vq, unsigned int head)
+static void *detach_buf(struct virtqueue *vq, unsigned int head)
 {
+	struct vring_desc_shadow *head_shadow = &vq->vring_desc_shadow[head];
+	void *buf = (void *)(uintptr_t)head_shadow->addr;
 	unsigned int i;
 
 	/* Unmark the descriptor as the head of a chain. */
-	vq->vring_desc_shadow[head].chain_head = false;
+	head_shadow->chain_head = false;
+
+	/* The buffer handed to virtqueue_add() is the first indirect entry */
+	if (head_shadow->indir_desc) {
+		buf = (void *)(uintptr_t)virtio64_to_cpu(vq->vdev,
+				head_shadow->indir_desc[0].addr);
+		free(head_shadow->indir_desc);
+		head_shadow->indir_desc = NULL;
+	}
 
 	/* Put back on free list: unmap first-level descriptors and find end */
 	i = head;
@@ -163,6 +224,8 @@ static void detach_buf(struct virtqueue *vq, unsigned int head)
 
 	/* Plus final descriptor */
 	vq->num_free++;
+
+	return buf;
 }
 
 static inline bool more_used(const struct virtqueue *vq)
@@ -175,6 +238,7 @@ void *virtqueue_get_buf(struct virtqueue *vq, unsigned int *len)
 {
 	unsigned int i;
 	u16 last_used;
+	void *buf;
 
 	if (!more_used(vq)) {
 		debug("(%s.%d): No more buffers in queue\n",
@@ -206,7 +270,7 @@ void *virtqueue_get_buf(struct virtqueue *vq, unsigned int *len)
 		return NULL;
 	}
 
-	detach_buf(vq, i);
+	buf = detach_buf(vq, i);
 	vq->last_used_idx++;
 	/*
 	 * If we expect an interrupt for the next entry, tell host
@@ -217,7 +281,7 @@ void *virtqueue_get_buf(struct virtqueue *vq, unsigned int *len)
 		virtio_store_mb(&vring_used_event(&vq->vring),
 				cpu_to_virtio16(vq->vdev, vq->last_used_idx));
 
-	return (void *)(uintptr_t)vq->vring_desc_shadow[i].addr;
+	return buf;
 }
 
 static struct virtqueue *__vring_new_virtqueue(unsigned int index,
@@ -252,6 +316,7 @@ static struct virtqueue *__vring_new_virtqueue(unsigned int index,
 	list_add_tail(&vq->list, &uc_priv->vqs);
 
 	vq->event = virtio_has_feature(vdev, VIRTIO_RING_F_EVENT_IDX);
+	vq->indirect = virtio_has_feature(vdev, VIRTIO_RING_F_INDIRECT_DESC);
 
 	/* Tell other side not to bother us */
 	vq->avail_flags_shadow |= VRING_AVAIL_F_NO_INTERRUPT;
@@ -314,6 +379,10 @@ struct virtqueue *vring_create_virtqueue(unsigned int index, unsigned int num,
 
 void vring_del_virtqueue(struct virtqueue *vq)
 {
+	unsigned int i;
+
+	for (i = 0; i < vq->vring.num; i++)
+		free(vq->vring_desc_shadow[i].indir_desc);
 	free(vq->vring.desc);
 	free(vq->vring_desc_shadow);
 	list_del(&vq->list);
@@ -30,6 +30,7 @@
 #include <search.h>
 #include <errno.h>
 #include <ext4fs.h>
+#include <fs.h>
 #include <mmc.h>
 #include <scsi.h>
 #include <asm/global_data.h>
@@ -74,6 +75,7 @@ static int env_ext4_save_buffer(env_t *env_new)
 	if (part < 0)
 		return 1;
 
+	fs_invalidate_mount();
 	dev = dev_desc->devnum;
 	ext4fs_set_blk_dev(dev_desc, &info);
 
@@ -157,6 +159,7 @@ static int env_ext4_load(void)
 	if (part < 0)
 		goto err_env_relocate;
 
+	fs_invalidate_mount();
 	dev = dev_desc->devnum;
 	ext4fs_set_blk_dev(dev_desc, &info);
 
@@ -16,6 +16,7 @@
 #include <search.h>
 #include <errno.h>
 #include <fat.h>
+#include <fs.h>
 #include <mmc.h>
 #include <scsi.h>
 #include <asm/cache.h>
@@ -78,6 +79,7 @@ static int env_fat_save(void)
 	if (part < 0)
 		return 1;
 
+	fs_invalidate_mount();
 	dev = dev_desc->devnum;
 	if (fat_set_blk_dev(dev_desc, &info) != 0) {
 		/*
@@ -140,6 +142,7 @@ static int env_fat_load(void)
 	if (part < 0)
 		goto err_env_relocate;
 
+	fs_invalidate_mount();
 	dev = dev_desc->devnum;
 	if (fat_set_blk_dev(dev_desc, &info) != 0) {
 		/*
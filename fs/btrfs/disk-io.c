@@ -448,7 +448,8 @@ struct extent_buffer* read_tree_block(struct btrfs_fs_info *fs_info, u64 bytenr,
 	struct extent_buffer *eb;
 	u64 best_transid = 0;
 	u32 sectorsize = fs_info->sectorsize;
-	int mirror_num = 1;
+	int mirror_num;
+	int first_mirror;
 	int good_mirror = 0;
 	int candidate_mirror = 0;
 	int num_copies;
@@ -470,10 +471,19 @@ struct extent_buffer* read_tree_block(struct btrfs_fs_info *fs_info, u64 bytenr,
 	if (!eb)
 		return ERR_PTR(-ENOMEM);
 
-	if (btrfs_buffer_uptodate(eb, parent_transid))
+	/*
+	 * A cached copy is only trusted if it carries the generation the
+	 * parent expects, otherwise it is read again.
+	 */
+	if (extent_buffer_uptodate(eb) &&
+	    (!parent_transid ||
+	     btrfs_header_generation(eb) == parent_transid))
 		return eb;
+	clear_extent_buffer_uptodate(eb);
 
 	num_copies = btrfs_num_copies(fs_info, eb->start, eb->len);
+	mirror_num = btrfs_first_mirror(fs_info, eb->start);
+	first_mirror = mirror_num;
 	while (1) {
 		ret = read_whole_eb(fs_info, eb, mirror_num);
 		if (ret == 0 && csum_tree_block(fs_info, eb, 1) == 0 &&
@@ -519,8 +529,8 @@ struct extent_buffer* read_tree_block(struct btrfs_fs_info *fs_info, u64 bytenr,
 			best_transid = btrfs_header_generation(eb);
 			good_mirror = mirror_num;
 		}
-		mirror_num++;
-		if (mirror_num > num_copies) {
+		mirror_num = mirror_num % num_copies + 1;
+		if (mirror_num == first_mirror) {
 			if (candidate_mirror > 0)
 				mirror_num = candidate_mirror;
 			else
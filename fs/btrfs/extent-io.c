@@ -19,6 +19,8 @@ void extent_io_tree_init(struct extent_io_tree *tree)
 	cache_tree_init(&tree->state);
 	cache_tree_init(&tree->cache);
 	tree->cache_size = 0;
+	INIT_LIST_HEAD(&tree->lru);
+	tree->lru_count = 0;
 }
 
 static struct extent_state *alloc_extent_state(void)
@@ -54,6 +56,13 @@ static void free_extent_state_func(struct cache_extent *cache)
 static void free_extent_buffer_final(struct extent_buffer *eb);
 void extent_io_tree_cleanup(struct extent_io_tree *tree)
 {
+	struct extent_buffer *eb, *tmp;
+
+	list_for_each_entry_safe(eb, tmp, &tree->lru, lru) {
+		list_del_init(&eb->lru);
+		tree->lru_count--;
+		free_extent_buffer_final(eb);
+	}
 	cache_tree_free_extents(&tree->state, free_extent_state_func);
 }
 
@@ -582,6 +591,7 @@ static struct extent_buffer *__alloc_extent_buffer(struct btrfs_fs_info *info,
 	eb->cache_node.start = bytenr;
 	eb->cache_node.size = blocksize;
 	eb->fs_info = info;
+	INIT_LIST_HEAD(&eb->lru);
 	memset_extent_buffer(eb, 0, 0, blocksize);
 
 	return eb;
@@ -615,6 +625,37 @@ static void free_extent_buffer_final(struct extent_buffer *eb)
 	free(eb);
 }
 
+/*
+ * Park an unreferenced eb on the LRU so the next walk through the same tree
+ * block does not have to read it again, and drop the oldest ones once there
+ * are more than CONFIG_FS_BTRFS_TREE_CACHE_BLOCKS of them.
+ */
+static void extent_buffer_park(struct extent_buffer *eb)
+{
+	struct extent_io_tree *tree = &eb->fs_info->extent_cache;
+	struct extent_buffer *old;
+
+	list_add(&eb->lru, &tree->lru);
+	tree->lru_count++;
+
+	while (tree->lru_count > CONFIG_FS_BTRFS_TREE_CACHE_BLOCKS) {
+		old = list_last_entry(&tree->lru, struct extent_buffer, lru);
+		list_del_init(&old->lru);
+		tree->lru_count--;
+		free_extent_buffer_final(old);
+	}
+}
+
+/* Take a reference, pulling @eb off the LRU if it was idle */
+static void extent_buffer_grab(struct extent_buffer *eb)
+{
+	if (!eb->refs && !list_empty(&eb->lru)) {
+		list_del_init(&eb->lru);
+		eb->fs_info->extent_cache.lru_count--;
+	}
+	eb->refs++;
+}
+
 static void free_extent_buffer_internal(struct extent_buffer *eb, bool free_now)
 {
 	if (!eb || IS_ERR(eb))
@@ -630,12 +671,17 @@ static void free_extent_buffer_internal(struct extent_buffer *eb, bool free_now)
 		}
 		if (eb->flags & EXTENT_BUFFER_DUMMY || free_now)
 			free_extent_buffer_final(eb);
+		else
+			extent_buffer_park(eb);
 	}
 }
 
 void free_extent_buffer(struct extent_buffer *eb)
 {
-	free_extent_buffer_internal(eb, 1);
+	/* only blocks that were read and verified are worth keeping */
+	free_extent_buffer_internal(eb, !CONFIG_FS_BTRFS_TREE_CACHE_BLOCKS ||
+				    !extent_buffer_uptodate(eb) ||
+				    (eb->flags & EXTENT_DIRTY));
 }
 
 struct extent_buffer *find_extent_buffer(struct extent_io_tree *tree,
@@ -648,7 +694,7 @@ struct extent_buffer *find_extent_buffer(struct extent_io_tree *tree,
 	if (cache && cache->start == bytenr &&
 	    cache->size == blocksize) {
 		eb = container_of(cache, struct extent_buffer, cache_node);
-		eb->refs++;
+		extent_buffer_grab(eb);
 	}
 	return eb;
 }
@@ -662,7 +708,7 @@ struct extent_buffer *find_first_extent_buffer(struct extent_io_tree *tree,
 	cache = search_cache_extent(&tree->cache, start);
 	if (cache) {
 		eb = container_of(cache, struct extent_buffer, cache_node);
-		eb->refs++;
+		extent_buffer_grab(eb);
 	}
 	return eb;
 }
@@ -678,14 +724,20 @@ struct extent_buffer *alloc_extent_buffer(struct btrfs_fs_info *fs_info,
 	if (cache && cache->start == bytenr &&
 	    cache->size == blocksize) {
 		eb = container_of(cache, struct extent_buffer, cache_node);
-		eb->refs++;
+		extent_buffer_grab(eb);
 	} else {
 		int ret;
 
 		if (cache) {
 			eb = container_of(cache, struct extent_buffer,
 					  cache_node);
-			free_extent_buffer(eb);
+			if (eb->refs) {
+				free_extent_buffer(eb);
+			} else {
+				/* an idle eb overlapping the new one */
+				extent_buffer_grab(eb);
+				free_extent_buffer_internal(eb, 1);
+			}
 		}
 		eb = __alloc_extent_buffer(fs_info, bytenr, blocksize);
 		if (!eb)
@@ -8,7 +8,8 @@
  *   Use pointer to provide better alignment.
  * - Remove max_cache_size related interfaces
  *   Includes free_extent_buffer_nocache()
- *   As we don't cache eb in U-boot.
+ *   Unused ebs are kept on a simple LRU bounded by
+ *   CONFIG_FS_BTRFS_TREE_CACHE_BLOCKS instead.
  * - Include headers
  *
  * Write related functions are kept as we still need to modify dummy extent
@@ -67,6 +68,9 @@ struct extent_io_tree {
 	struct cache_tree state;
 	struct cache_tree cache;
 	u64 cache_size;
+	/* uptodate ebs with no reference left, least recently used last */
+	struct list_head lru;
+	unsigned int lru_count;
 };
 
 struct extent_state {
@@ -85,6 +89,7 @@ struct extent_buffer {
 	int refs;
 	u32 flags;
 	struct btrfs_fs_info *fs_info;
+	struct list_head lru;
 	char *data;
 };
 
@@ -433,6 +433,7 @@ int btrfs_read_extent_reg(struct btrfs_path *path,
 	u32 dsize;
 	bool finished = false;
 	int num_copies;
+	int mirror;
 	int i;
 	int slot = path->slots[0];
 	int ret;
@@ -460,8 +461,11 @@ int btrfs_read_extent_reg(struct btrfs_path *path,
 		read = len;
 
 		num_copies = btrfs_num_copies(fs_info, logical, len);
-		for (i = 1; i <= num_copies; i++) {
-			ret = read_extent_data(fs_info, dest, logical, &read, i);
+		mirror = btrfs_first_mirror(fs_info, logical);
+		for (i = 0; i < num_copies; i++) {
+			ret = read_extent_data(fs_info, dest, logical, &read,
+					       mirror);
+			mirror = mirror % num_copies + 1;
 			if (ret < 0 || read != len)
 				continue;
 			finished = true;
@@ -476,6 +480,7 @@ int btrfs_read_extent_reg(struct btrfs_path *path,
 	dsize = btrfs_file_extent_ram_bytes(leaf, fi);
 	disk_bytenr = btrfs_file_extent_disk_bytenr(leaf, fi);
 	num_copies = btrfs_num_copies(fs_info, disk_bytenr, csize);
+	mirror = btrfs_first_mirror(fs_info, disk_bytenr);
 
 	cbuf = malloc_cache_aligned(csize);
 	dbuf = malloc_cache_aligned(dsize);
@@ -484,10 +489,11 @@ int btrfs_read_extent_reg(struct btrfs_path *path,
 		goto out;
 	}
 	/* For compressed extent, we must read the whole on-disk extent */
-	for (i = 1; i <= num_copies; i++) {
+	for (i = 0; i < num_copies; i++) {
 		read = csize;
 		ret = read_extent_data(fs_info, cbuf, disk_bytenr,
-				       &read, i);
+				       &read, mirror);
+		mirror = mirror % num_copies + 1;
 		if (ret < 0 || read != csize)
 			continue;
 		finished = true;
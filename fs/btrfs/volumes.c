@@ -883,6 +883,62 @@ int btrfs_num_copies(struct btrfs_fs_info *fs_info, u64 logical, u64 len)
 	return ret;
 }
 
+/*
+ * Return the mirror to try first when reading @logical.
+ *
+ * For profiles whose copies live on different devices (RAID1*, RAID10) this
+ * rotates with the stripe number among the copies whose device is present,
+ * so walking a tree or reading a file spreads the reads over all mirrors
+ * instead of always hitting the first device. Everything else, including
+ * RAID5/6 where mirror > 1 means recovery, starts with mirror 1 as before.
+ */
+int btrfs_first_mirror(struct btrfs_fs_info *fs_info, u64 logical)
+{
+	struct btrfs_mapping_tree *map_tree = &fs_info->mapping_tree;
+	struct cache_extent *ce;
+	struct map_lookup *map;
+	int first, copies, present = 0;
+	int stripe_nr;
+	int i;
+
+	ce = search_cache_extent(&map_tree->cache_tree, logical);
+	if (!ce || ce->start > logical)
+		return 1;
+	map = container_of(ce, struct map_lookup, ce);
+	stripe_nr = (logical - ce->start) / map->stripe_len;
+
+	if (map->type & (BTRFS_BLOCK_GROUP_RAID1 |
+			 BTRFS_BLOCK_GROUP_RAID1C3 |
+			 BTRFS_BLOCK_GROUP_RAID1C4)) {
+		first = 0;
+		copies = map->num_stripes;
+	} else if (map->type & BTRFS_BLOCK_GROUP_RAID10) {
+		int factor = map->num_stripes / map->sub_stripes;
+
+		first = stripe_nr % factor * map->sub_stripes;
+		copies = map->sub_stripes;
+		stripe_nr /= factor;
+	} else {
+		return 1;
+	}
+
+	for (i = 0; i < copies; i++)
+		if (map->stripes[first + i].dev->desc)
+			present++;
+	if (!present)
+		return 1;
+
+	/* pick the (stripe_nr % present)th copy on a present device */
+	stripe_nr %= present;
+	for (i = 0; i < copies; i++) {
+		if (!map->stripes[first + i].dev->desc)
+			continue;
+		if (!stripe_nr--)
+			return i + 1;
+	}
+	return 1;
+}
+
 int btrfs_next_bg(struct btrfs_fs_info *fs_info, u64 *logical,
 		  u64 *size, u64 type)
 {
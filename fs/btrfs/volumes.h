@@ -188,6 +188,7 @@ int btrfs_open_devices(struct btrfs_fs_devices *fs_devices);
 int btrfs_close_devices(struct btrfs_fs_devices *fs_devices);
 void btrfs_close_all_devices(void);
 int btrfs_num_copies(struct btrfs_fs_info *fs_info, u64 logical, u64 len);
+int btrfs_first_mirror(struct btrfs_fs_info *fs_info, u64 logical);
 int btrfs_scan_one_device(struct blk_desc *desc, struct disk_partition *part,
 			  struct btrfs_fs_devices **fs_devices_ret,
 			  u64 *total_devs);
@@ -206,6 +206,205 @@ static int erofs_read_raw_data(struct erofs_inode *inode, char *buffer,
 	return 0;
 }
 
+/*
+ * Extents that a read only partially covers (the first and the last one of
+ * the request) are decompressed as a whole into this cache, so that a caller
+ * walking a file in chunks does not inflate the same pcluster for every
+ * chunk that touches it.
+ */
+struct z_erofs_cache_entry {
+	erofs_off_t pa;
+	unsigned int deviceid;
+	unsigned int len;	/* decompressed bytes held, 0 if unused */
+	unsigned int bufsize;
+	unsigned long stamp;
+	char *data;
+};
+
+/* a pcluster queued for the next batched device read */
+struct z_erofs_batch_extent {
+	erofs_off_t pa;
+	unsigned int plen;
+	unsigned int llen;
+	char *out;
+	unsigned int skip, length;
+	unsigned int alg;
+	bool partial;
+	bool cache;
+};
+
+#define Z_EROFS_BATCH_EXTENTS	16
+
+struct z_erofs_batch {
+	unsigned int deviceid;
+	erofs_off_t pa;		/* lowest address of the queued pclusters */
+	unsigned int plen;	/* total bytes queued */
+	unsigned int count;
+	struct z_erofs_batch_extent ext[Z_EROFS_BATCH_EXTENTS];
+	char *raw;
+	unsigned int bufsize;
+};
+
+#if IS_ENABLED(CONFIG_FS_EROFS_ZIP)
+#define Z_EROFS_CACHE_ENTRIES	CONFIG_FS_EROFS_PCLUSTER_CACHE_ENTRIES
+#define Z_EROFS_BATCH_BYTES	CONFIG_FS_EROFS_BATCH_READ_SIZE
+#else
+#define Z_EROFS_CACHE_ENTRIES	1
+#define Z_EROFS_BATCH_BYTES	0
+#endif
+
+static struct z_erofs_cache_entry z_erofs_cache[Z_EROFS_CACHE_ENTRIES];
+static unsigned long z_erofs_cache_clock;
+
+void z_erofs_cache_free(void)
+{
+	int i;
+
+	for (i = 0; i < Z_EROFS_CACHE_ENTRIES; i++)
+		free(z_erofs_cache[i].data);
+	memset(z_erofs_cache, 0, sizeof(z_erofs_cache));
+	z_erofs_cache_clock = 0;
+}
+
+static struct z_erofs_cache_entry *
+z_erofs_cache_find(unsigned int deviceid, erofs_off_t pa, unsigned int len)
+{
+	struct z_erofs_cache_entry *e;
+	int i;
+
+	for (i = 0; i < Z_EROFS_CACHE_ENTRIES; i++) {
+		e = &z_erofs_cache[i];
+		if (e->len == len && e->pa == pa && e->deviceid == deviceid) {
+			e->stamp = ++z_erofs_cache_clock;
+			return e;
+		}
+	}
+	return NULL;
+}
+
+/* take the least recently used entry and make room for @len bytes */
+static struct z_erofs_cache_entry *z_erofs_cache_evict(unsigned int len)
+{
+	struct z_erofs_cache_entry *e = &z_erofs_cache[0];
+	char *data;
+	int i;
+
+	for (i = 1; i < Z_EROFS_CACHE_ENTRIES; i++)
+		if (z_erofs_cache[i].stamp < e->stamp)
+			e = &z_erofs_cache[i];
+
+	e->len = 0;
+	e->stamp = 0;
+	if (e->bufsize < len) {
+		data = realloc(e->data, len);
+		if (!data)
+			return NULL;
+		e->data = data;
+		e->bufsize = len;
+	}
+	return e;
+}
+
+static int z_erofs_decompress_extent(unsigned int deviceid,
+				     struct z_erofs_batch_extent *ext,
+				     char *in)
+{
+	struct z_erofs_cache_entry *e = NULL;
+	int ret;
+
+	if (ext->cache)
+		e = z_erofs_cache_evict(ext->llen);
+	if (!e)
+		return z_erofs_decompress(&(struct z_erofs_decompress_req) {
+					.in = in,
+					.out = ext->out,
+					.decodedskip = ext->skip,
+					.inputsize = ext->plen,
+					.decodedlength = ext->length,
+					.alg = ext->alg,
+					.partial_decoding = ext->partial
+					 });
+
+	ret = z_erofs_decompress(&(struct z_erofs_decompress_req) {
+				.in = in,
+				.out = e->data,
+				.inputsize = ext->plen,
+				.decodedlength = ext->llen,
+				.alg = ext->alg,
+				.partial_decoding = true
+				 });
+	if (ret < 0)
+		return ret;
+
+	e->pa = ext->pa;
+	e->deviceid = deviceid;
+	e->len = ext->llen;
+	e->stamp = ++z_erofs_cache_clock;
+	memcpy(ext->out, e->data + ext->skip, ext->length - ext->skip);
+	return 0;
+}
+
+/* read all queued pclusters with one device access and decompress them */
+static int z_erofs_batch_flush(struct z_erofs_batch *b)
+{
+	struct z_erofs_batch_extent *ext;
+	unsigned int i;
+	int ret;
+
+	if (!b->count)
+		return 0;
+
+	ret = erofs_dev_read(b->deviceid, b->raw, b->pa, b->plen);
+	if (ret < 0)
+		return ret;
+
+	for (i = 0; i < b->count; i++) {
+		ext = &b->ext[i];
+		ret = z_erofs_decompress_extent(b->deviceid, ext,
+						b->raw + (ext->pa - b->pa));
+		if (ret < 0)
+			return ret;
+	}
+	b->count = 0;
+	b->plen = 0;
+	return 0;
+}
+
+/*
+ * Extents are walked from the end of the request backwards, so a pcluster
+ * joins the batch when it ends right where the queued ones start.
+ */
+static int z_erofs_batch_add(struct z_erofs_batch *b,
+			     struct z_erofs_batch_extent *ext,
+			     unsigned int deviceid)
+{
+	char *raw;
+	int ret;
+
+	if (b->count && (b->count == Z_EROFS_BATCH_EXTENTS ||
+			 b->deviceid != deviceid ||
+			 ext->pa + ext->plen != b->pa ||
+			 b->plen + ext->plen > Z_EROFS_BATCH_BYTES)) {
+		ret = z_erofs_batch_flush(b);
+		if (ret < 0)
+			return ret;
+	}
+
+	if (b->plen + ext->plen > b->bufsize) {
+		raw = realloc(b->raw, b->plen + ext->plen);
+		if (!raw)
+			return -ENOMEM;
+		b->raw = raw;
+		b->bufsize = b->plen + ext->plen;
+	}
+
+	b->deviceid = deviceid;
+	b->pa = ext->pa;
+	b->plen += ext->plen;
+	b->ext[b->count++] = *ext;
+	return 0;
+}
+
 static int z_erofs_read_data(struct erofs_inode *inode, char *buffer,
 			     erofs_off_t size, erofs_off_t offset)
 {
@@ -214,16 +413,18 @@ static int z_erofs_read_data(struct erofs_inode *inode, char *buffer,
 		.index = UINT_MAX,
 	};
 	struct erofs_map_dev mdev;
-	bool partial;
-	unsigned int bufsize = 0;
-	char *raw = NULL;
+	struct z_erofs_cache_entry *e;
+	struct z_erofs_batch batch = { };
+	bool partial, cache;
 	int ret = 0;
 
 	end = offset + size;
 	while (end > offset) {
 		map.m_la = end - 1;
 
-		ret = z_erofs_map_blocks_iter(inode, &map, 0);
+		/* ask for the exact extent length so it can be cached whole */
+		ret = z_erofs_map_blocks_iter(inode, &map,
+					      EROFS_GET_BLOCKS_FIEMAP);
 		if (ret)
 			break;
 
@@ -259,37 +460,40 @@ static int z_erofs_read_data(struct erofs_inode *inode, char *buffer,
 		}
 
 		if (!(map.m_flags & EROFS_MAP_MAPPED)) {
-			memset(buffer + end - offset, 0, length);
+			memset(buffer + end - offset, 0, length - skip);
 			end = map.m_la;
 			continue;
 		}
 
-		if (map.m_plen > bufsize) {
-			bufsize = map.m_plen;
-			raw = realloc(raw, bufsize);
-			if (!raw) {
-				ret = -ENOMEM;
-				break;
+		cache = (skip || length < map.m_llen) &&
+			(map.m_flags & EROFS_MAP_FULL_MAPPED);
+		if (cache) {
+			e = z_erofs_cache_find(mdev.m_deviceid, mdev.m_pa,
+					       map.m_llen);
+			if (e) {
+				memcpy(buffer + end - offset, e->data + skip,
+				       length - skip);
+				continue;
 			}
 		}
-		ret = erofs_dev_read(mdev.m_deviceid, raw, mdev.m_pa, map.m_plen);
-		if (ret < 0)
-			break;
 
-		ret = z_erofs_decompress(&(struct z_erofs_decompress_req) {
-					.in = raw,
+		ret = z_erofs_batch_add(&batch, &(struct z_erofs_batch_extent) {
+					.pa = mdev.m_pa,
+					.plen = map.m_plen,
+					.llen = map.m_llen,
 					.out = buffer + end - offset,
-					.decodedskip = skip,
-					.inputsize = map.m_plen,
-					.decodedlength = length,
+					.skip = skip,
+					.length = length,
 					.alg = map.m_algorithmformat,
-					.partial_decoding = partial
-					 });
+					.partial = partial,
+					.cache = cache,
+					}, mdev.m_deviceid);
 		if (ret < 0)
 			break;
 	}
-	if (raw)
-		free(raw);
+	if (!ret)
+		ret = z_erofs_batch_flush(&batch);
+	free(batch.raw);
 	return ret < 0 ? ret : 0;
 }
 
@@ -36,6 +36,7 @@ int erofs_probe(struct blk_desc *fs_dev_desc,
 
 	ctxt.cur_dev = fs_dev_desc;
 	ctxt.cur_part_info = *fs_partition;
+	z_erofs_cache_free();
 
 	ret = erofs_read_superblock();
 	if (ret)
@@ -252,6 +253,7 @@ int erofs_read(const char *filename, void *buf, loff_t offset, loff_t len,
 
 void erofs_close(void)
 {
+	z_erofs_cache_free();
 	ctxt.cur_dev = NULL;
 }
 
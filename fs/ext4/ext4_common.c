@@ -1642,6 +1642,133 @@ int ext4fs_read_inode(struct ext2_data *data, int ino, struct ext2_inode *inode)
 	return 1;
 }
 
+/* Add a run to the extent map of a node, merging it with the previous one */
+static int ext4fs_add_run(struct ext2fs_node *node, int *alloced,
+			  uint32_t lblk, uint32_t len, uint64_t pblk)
+{
+	struct ext4_extent_run *run;
+
+	if (node->nr_runs) {
+		run = &node->runs[node->nr_runs - 1];
+		if (lblk < run->lblk + run->len)
+			return -EINVAL;
+		if (run->lblk + run->len == lblk &&
+		    (pblk ? run->pblk && run->pblk + run->len == pblk :
+		     !run->pblk)) {
+			run->len += len;
+			return 0;
+		}
+	}
+	if (node->nr_runs == *alloced) {
+		*alloced = *alloced ? *alloced * 2 : 16;
+		run = realloc(node->runs, *alloced * sizeof(*run));
+		if (!run)
+			return -ENOMEM;
+		node->runs = run;
+	}
+	run = &node->runs[node->nr_runs++];
+	run->lblk = lblk;
+	run->len = len;
+	run->pblk = pblk;
+
+	return 0;
+}
+
+static int ext4fs_map_extent_tree(struct ext2fs_node *node,
+				  struct ext4_extent_header *eh, int level,
+				  int *alloced)
+{
+	int blksz = EXT2_BLOCK_SIZE(node->data);
+	int log2_blksz = LOG2_BLOCK_SIZE(node->data) -
+			 get_fs()->dev_desc->log2blksz;
+	int entries = le16_to_cpu(eh->eh_entries);
+	struct ext4_extent_idx *index;
+	struct ext4_extent *extent;
+	uint64_t block;
+	uint32_t len;
+	char *buf;
+	int i, ret;
+
+	if (le16_to_cpu(eh->eh_magic) != EXT4_EXT_MAGIC ||
+	    entries > le16_to_cpu(eh->eh_max) || level > EXT4_EXT_MAX_DEPTH)
+		return -EINVAL;
+
+	if (!eh->eh_depth) {
+		extent = (struct ext4_extent *)(eh + 1);
+		for (i = 0; i < entries; i++) {
+			len = le16_to_cpu(extent[i].ee_len);
+			block = le16_to_cpu(extent[i].ee_start_hi);
+			block = (block << 32) +
+				le32_to_cpu(extent[i].ee_start_lo);
+			if (len > EXT4_EXT_INIT_MAX_LEN) {
+				len -= EXT4_EXT_INIT_MAX_LEN;
+				block = 0;
+			}
+			ret = ext4fs_add_run(node, alloced,
+					     le32_to_cpu(extent[i].ee_block),
+					     len, block);
+			if (ret)
+				return ret;
+		}
+
+		return 0;
+	}
+
+	buf = memalign(ARCH_DMA_MINALIGN, blksz);
+	if (!buf)
+		return -ENOMEM;
+	index = (struct ext4_extent_idx *)(eh + 1);
+	for (i = 0; i < entries; i++) {
+		block = le16_to_cpu(index[i].ei_leaf_hi);
+		block = (block << 32) + le32_to_cpu(index[i].ei_leaf_lo);
+		if (!ext4fs_devread(block << log2_blksz, 0, blksz, buf)) {
+			ret = -EIO;
+			break;
+		}
+		ret = ext4fs_map_extent_tree(node,
+					     (struct ext4_extent_header *)buf,
+					     level + 1, alloced);
+		if (ret)
+			break;
+	}
+	free(buf);
+
+	return ret;
+}
+
+/**
+ * ext4fs_load_extents() - build the extent map of a node
+ *
+ * This walks the whole extent tree of an inode once, so that reads can be
+ * split into the largest possible device reads without looking up each
+ * block. Adjacent extents which are also contiguous on disk are merged.
+ *
+ * @node:	node to map, whose inode must use extents
+ * Return:	0 if OK, -ve on error, in which case no map is kept
+ */
+int ext4fs_load_extents(struct ext2fs_node *node)
+{
+	int alloced = 0;
+	int ret;
+
+	free(node->runs);
+	node->runs = NULL;
+	node->nr_runs = 0;
+	if (!(le32_to_cpu(node->inode.flags) & EXT4_EXTENTS_FL))
+		return -EINVAL;
+
+	ret = ext4fs_map_extent_tree(node, (struct ext4_extent_header *)
+				     node->inode.b.blocks.dir_blocks, 0,
+				     &alloced);
+	if (ret) {
+		free(node->runs);
+		node->runs = NULL;
+		node->nr_runs = 0;
+	}
+
+	return ret;
+}
+
 long int read_allocated_block(struct ext2_inode *inode, int fileblock,
 			      struct ext_block_cache *cache)
 {
@@ -2035,13 +2162,183 @@ void ext4fs_close(void)
 		ext4fs_file = NULL;
 	}
 	if (ext4fs_root != NULL) {
+		/* ext4fs_free_node() leaves the root node to us */
+		free(ext4fs_root->diropen.runs);
 		free(ext4fs_root);
 		ext4fs_root = NULL;
 	}
 
+	ext4fs_dcache_flush();
 	ext4fs_reinit_global();
 }
 
+/* A directory entry found by an earlier lookup */
+struct ext4_dentry {
+	int parent;		/* inode of the directory, 0 if the slot is free */
+	int ino;
+	int type;
+	ulong last_used;
+	char *name;
+};
+
+#if CONFIG_EXT4_DENTRY_CACHE_SIZE
+static struct ext4_dentry ext4_dcache[CONFIG_EXT4_DENTRY_CACHE_SIZE];
+static ulong ext4_dcache_tick;
+
+static struct ext4_dentry *ext4fs_dcache_find(int parent, const char *name)
+{
+	struct ext4_dentry *de;
+
+	for (de = ext4_dcache; de < ext4_dcache + ARRAY_SIZE(ext4_dcache);
+	     de++) {
+		if (de->parent == parent && !strcmp(de->name, name)) {
+			de->last_used = ++ext4_dcache_tick;
+			return de;
+		}
+	}
+
+	return NULL;
+}
+
+static void ext4fs_dcache_add(int parent, const char *name, int ino,
+			      int type)
+{
+	struct ext4_dentry *de, *victim = ext4_dcache;
+	char *copy;
+
+	if (!parent)
+		return;
+	for (de = ext4_dcache; de < ext4_dcache + ARRAY_SIZE(ext4_dcache);
+	     de++) {
+		if (!de->parent) {
+			victim = de;
+			break;
+		}
+		if (de->last_used < victim->last_used)
+			victim = de;
+	}
+
+	copy = strdup(name);
+	if (!copy)
+		return;
+	free(victim->name);
+	victim->parent = parent;
+	victim->ino = ino;
+	victim->type = type;
+	victim->name = copy;
+	victim->last_used = ++ext4_dcache_tick;
+}
+
+void ext4fs_dcache_flush(void)
+{
+	struct ext4_dentry *de;
+
+	for (de = ext4_dcache; de < ext4_dcache + ARRAY_SIZE(ext4_dcache);
+	     de++) {
+		free(de->name);
+		de->name = NULL;
+		de->parent = 0;
+	}
+}
+#else
+static struct ext4_dentry *ext4fs_dcache_find(int parent, const char *name)
+{
+	return NULL;
+}
+
+static void ext4fs_dcache_add(int parent, const char *name, int ino,
+			      int type)
+{
+}
+
+void ext4fs_dcache_flush(void)
+{
+}
+#endif
+
+/* Set up a node for the directory entry @ino in @diro and work out its type */
+static int ext4fs_dir_node(struct ext2fs_node *diro, int ino, int filetype,
+			   struct ext2fs_node **fnode, int *ftype)
+{
+	struct ext2fs_node *fdiro;
+	int type = FILETYPE_UNKNOWN;
+	int status;
+
+	fdiro = zalloc(sizeof(struct ext2fs_node));
+	if (!fdiro)
+		return 0;
+
+	fdiro->data = diro->data;
+	fdiro->ino = ino;
+
+	if (filetype != FILETYPE_UNKNOWN) {
+		fdiro->inode_read = 0;
+
+		if (filetype == FILETYPE_DIRECTORY)
+			type = FILETYPE_DIRECTORY;
+		else if (filetype == FILETYPE_SYMLINK)
+			type = FILETYPE_SYMLINK;
+		else if (filetype == FILETYPE_REG)
+			type = FILETYPE_REG;
+	} else {
+		status = ext4fs_read_inode(diro->data, ino, &fdiro->inode);
+		if (status == 0) {
+			free(fdiro);
+			return 0;
+		}
+		fdiro->inode_read = 1;
+
+		if ((le16_to_cpu(fdiro->inode.mode) & FILETYPE_INO_MASK) ==
+		    FILETYPE_INO_DIRECTORY) {
+			type = FILETYPE_DIRECTORY;
+		} else if ((le16_to_cpu(fdiro->inode.mode) &
+			    FILETYPE_INO_MASK) == FILETYPE_INO_SYMLINK) {
+			type = FILETYPE_SYMLINK;
+		} else if ((le16_to_cpu(fdiro->inode.mode) &
+			    FILETYPE_INO_MASK) == FILETYPE_INO_REG) {
+			type = FILETYPE_REG;
+		}
+	}
+
+	*fnode = fdiro;
+	*ftype = type;
+
+	return 1;
+}
+
+/*
+ * Look @name up without scanning @diro: from the dentry cache or through the
+ * directory's hash index. Return 1 if found, 0 if not or -ve if the
+ * directory must be scanned instead
+ */
+static int ext4fs_dir_lookup(struct ext2fs_node *diro, const char *name,
+			     struct ext2fs_node **fnode, int *ftype)
+{
+	struct ext4_dentry *de;
+	int filetype, ret;
+	u32 ino;
+
+	de = ext4fs_dcache_find(diro->ino, name);
+	if (de)
+		return ext4fs_dir_node(diro, de->ino, de->type, fnode, ftype);
+
+	ret = ext4fs_htree_lookup(diro, name, &ino, &filetype);
+	if (ret < 0) {
+		if (ret != -EOPNOTSUPP)
+			debug("htree lookup of %s failed (err=%d)\n", name,
+			      ret);
+		return ret;
+	}
+	if (!ret)
+		return 0;
+
+	ret = ext4fs_dir_node(diro, ino, filetype, fnode, ftype);
+	if (ret)
+		ext4fs_dcache_add(diro->ino, name, ino, *ftype);
+
+	return ret;
+}
+
 int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 				struct ext2fs_node **fnode, int *ftype)
 {
@@ -2059,6 +2356,11 @@ int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 		if (status == 0)
 			return 0;
 	}
+	if (name && fnode && ftype) {
+		status = ext4fs_dir_lookup(diro, name, fnode, ftype);
+		if (status >= 0)
+			return status;
+	}
 	/* Search the file.  */
 	while (fpos < le32_to_cpu(diro->inode.size)) {
 		struct ext2_dirent dirent;
@@ -2087,55 +2389,22 @@ int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 			if (status < 0)
 				return 0;
 
-			fdiro = zalloc(sizeof(struct ext2fs_node));
-			if (!fdiro)
-				return 0;
-
-			fdiro->data = diro->data;
-			fdiro->ino = le32_to_cpu(dirent.inode);
-
 			filename[dirent.namelen] = '\0';
 
-			if (dirent.filetype != FILETYPE_UNKNOWN) {
-				fdiro->inode_read = 0;
-
-				if (dirent.filetype == FILETYPE_DIRECTORY)
-					type = FILETYPE_DIRECTORY;
-				else if (dirent.filetype == FILETYPE_SYMLINK)
-					type = FILETYPE_SYMLINK;
-				else if (dirent.filetype == FILETYPE_REG)
-					type = FILETYPE_REG;
-			} else {
-				status = ext4fs_read_inode(diro->data,
-							   le32_to_cpu
-							   (dirent.inode),
-							   &fdiro->inode);
-				if (status == 0) {
-					free(fdiro);
-					return 0;
-				}
-				fdiro->inode_read = 1;
-
-				if ((le16_to_cpu(fdiro->inode.mode) &
-				     FILETYPE_INO_MASK) ==
-				    FILETYPE_INO_DIRECTORY) {
-					type = FILETYPE_DIRECTORY;
-				} else if ((le16_to_cpu(fdiro->inode.mode)
-					    & FILETYPE_INO_MASK) ==
-					   FILETYPE_INO_SYMLINK) {
-					type = FILETYPE_SYMLINK;
-				} else if ((le16_to_cpu(fdiro->inode.mode)
-					    & FILETYPE_INO_MASK) ==
-					   FILETYPE_INO_REG) {
-					type = FILETYPE_REG;
-				}
-			}
+			status = ext4fs_dir_node(diro,
+						 le32_to_cpu(dirent.inode),
+						 dirent.filetype, &fdiro,
+						 &type);
+			if (status == 0)
+				return 0;
 #ifdef DEBUG
 			printf("iterate >%s<\n", filename);
 #endif /* of DEBUG */
 			if ((name != NULL) && (fnode != NULL)
 			    && (ftype != NULL)) {
 				if (strcmp(filename, name) == 0) {
+					ext4fs_dcache_add(diro->ino, name,
+							  fdiro->ino, type);
 					*ftype = type;
 					*fnode = fdiro;
 					return 1;
@@ -2341,7 +2610,11 @@ int ext4fs_open(const char *filename, loff_t *len)
 	if (ext4fs_root == NULL)
 		return -1;
 
-	ext4fs_file = NULL;
+	/* The filesystem may have stayed mounted since the last open */
+	if (ext4fs_file) {
+		ext4fs_free_node(ext4fs_file, &ext4fs_root->diropen);
+		ext4fs_file = NULL;
+	}
 	status = ext4fs_find_file(filename, &ext4fs_root->diropen, &fdiro,
 				  FILETYPE_REG);
 	if (status == 0)
@@ -2354,6 +2627,9 @@ int ext4fs_open(const char *filename, loff_t *len)
 			goto fail;
 	}
 	*len = le32_to_cpu(fdiro->inode.size);
+	/* Without a map, reads fall back to looking up each block */
+	if (le32_to_cpu(fdiro->inode.flags) & EXT4_EXTENTS_FL)
+		ext4fs_load_extents(fdiro);
 	ext4fs_file = fdiro;
 
 	return 0;
@@ -2368,6 +2644,8 @@ int ext4fs_mount(unsigned part_length)
 	struct ext2_data *data;
 	int status;
 	struct ext_filesystem *fs = get_fs();
+
+	ext4fs_dcache_flush();
 	data = zalloc(SUPERBLOCK_SIZE);
 	if (!data)
 		return 0;
@@ -56,6 +56,30 @@ int ext4fs_find_file(const char *path, struct ext2fs_node *rootnode,
 			struct ext2fs_node **foundnode, int expecttype);
 int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 			struct ext2fs_node **fnode, int *ftype);
+int ext4fs_load_extents(struct ext2fs_node *node);
+void ext4fs_dcache_flush(void);
+
+#if IS_ENABLED(CONFIG_EXT4_HTREE)
+/**
+ * ext4fs_htree_lookup() - look a name up through a directory's hash index
+ *
+ * @dir:	Directory to search, with its inode read
+ * @name:	Name of the entry to find
+ * @inop:	Returns the inode number of the entry
+ * @filetypep:	Returns the file type recorded in the entry
+ * Return: 1 if found, 0 if not, -EOPNOTSUPP if @dir is not indexed (or uses
+ * an unsupported hash) or other -ve on error
+ */
+int ext4fs_htree_lookup(struct ext2fs_node *dir, const char *name, u32 *inop,
+			int *filetypep);
+#else
+static inline int ext4fs_htree_lookup(struct ext2fs_node *dir,
+				      const char *name, u32 *inop,
+				      int *filetypep)
+{
+	return -EOPNOTSUPP;
+}
+#endif
 
 #if defined(CONFIG_EXT4_WRITE)
 uint32_t ext4fs_div_roundup(uint32_t size, uint32_t n);
@@ -0,0 +1,520 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Hashed directory (htree) lookups for ext4
+ *
+ * An indexed directory keeps its entries in leaf blocks sorted by the hash
+ * of their names, with a tree of index blocks mapping hash ranges to leaves.
+ * Looking a name up then needs one block per tree level rather than a scan
+ * of the whole directory.
+ *
+ * The hash functions are taken from Linux fs/ext4/hash.c:
+ * Copyright (C) 2002 by Theodore Ts'o
+ */
+
+#include <common.h>
+#include <blk.h>
+#include <ext_common.h>
+#include <ext4fs.h>
+#include <malloc.h>
+#include <linux/bitops.h>
+#include <linux/errno.h>
+#include <linux/string.h>
+#include "ext4_common.h"
+
+#define DX_HASH_LEGACY			0
+#define DX_HASH_HALF_MD4		1
+#define DX_HASH_TEA			2
+#define DX_HASH_LEGACY_UNSIGNED		3
+#define DX_HASH_HALF_MD4_UNSIGNED	4
+#define DX_HASH_TEA_UNSIGNED		5
+
+/* Superblock flag selecting the unsigned variants of the hashes */
+#define EXT2_FLAGS_UNSIGNED_HASH	0x0002
+
+#define EXT4_HTREE_EOF_32BIT		((1UL << (32 - 1)) - 1)
+
+/* Index levels below the root, without and with the largedir feature */
+#define DX_MAX_LEVELS			2
+#define DX_MAX_LEVELS_LARGEDIR		3
+
+/* The root block starts with the "." and ".." entries, 12 bytes each */
+#define DX_ROOT_INFO_OFFSET		24
+/* Other index blocks start with an empty entry covering the whole block */
+#define DX_NODE_ENTRIES_OFFSET		8
+
+struct dx_root_info {
+	__le32 reserved_zero;
+	u8 hash_version;
+	u8 info_length;
+	u8 indirect_levels;
+	u8 unused_flags;
+};
+
+/* The first entry of an index block holds its limit and count instead */
+struct dx_entry {
+	__le32 hash;
+	__le32 block;
+};
+
+struct dx_countlimit {
+	__le16 limit;
+	__le16 count;
+};
+
+/* Where a lookup is in each level of the tree */
+struct dx_frame {
+	char *buf;
+	struct dx_entry *entries;
+	struct dx_entry *at;		/* entry followed to the next level */
+	unsigned int count;
+};
+
+#define DELTA 0x9E3779B9
+
+static void TEA_transform(u32 buf[4], u32 const in[])
+{
+	u32 sum = 0;
+	u32 b0 = buf[0], b1 = buf[1];
+	u32 a = in[0], b = in[1], c = in[2], d = in[3];
+	int n = 16;
+
+	do {
+		sum += DELTA;
+		b0 += ((b1 << 4) + a) ^ (b1 + sum) ^ ((b1 >> 5) + b);
+		b1 += ((b0 << 4) + c) ^ (b0 + sum) ^ ((b0 >> 5) + d);
+	} while (--n);
+
+	buf[0] += b0;
+	buf[1] += b1;
+}
+
+/* F, G and H are basic MD4 functions: selection, majority, parity */
+#define F(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define G(x, y, z) (((x) & (y)) + (((x) ^ (y)) & (z)))
+#define H(x, y, z) ((x) ^ (y) ^ (z))
+
+/*
+ * The generic round function. The application is so specific that
+ * we don't bother protecting all the arguments with parens, as is generally
+ * good macro practice, in favor of extra legibility.
+ * Rotation is separate from addition to prevent recomputation
+ */
+#define MD4_ROUND(f, a, b, c, d, x, s)	\
+	(a += f(b, c, d) + x, a = rol32(a, s))
+#define K1 0
+#define K2 013240474631UL
+#define K3 015666365641UL
+
+/* Basic cut-down MD4 transform */
+static void half_md4_transform(u32 buf[4], u32 const in[8])
+{
+	u32 a = buf[0], b = buf[1], c = buf[2], d = buf[3];
+
+	/* Round 1 */
+	MD4_ROUND(F, a, b, c, d, in[0] + K1,  3);
+	MD4_ROUND(F, d, a, b, c, in[1] + K1,  7);
+	MD4_ROUND(F, c, d, a, b, in[2] + K1, 11);
+	MD4_ROUND(F, b, c, d, a, in[3] + K1, 19);
+	MD4_ROUND(F, a, b, c, d, in[4] + K1,  3);
+	MD4_ROUND(F, d, a, b, c, in[5] + K1,  7);
+	MD4_ROUND(F, c, d, a, b, in[6] + K1, 11);
+	MD4_ROUND(F, b, c, d, a, in[7] + K1, 19);
+
+	/* Round 2 */
+	MD4_ROUND(G, a, b, c, d, in[1] + K2,  3);
+	MD4_ROUND(G, d, a, b, c, in[3] + K2,  5);
+	MD4_ROUND(G, c, d, a, b, in[5] + K2,  9);
+	MD4_ROUND(G, b, c, d, a, in[7] + K2, 13);
+	MD4_ROUND(G, a, b, c, d, in[0] + K2,  3);
+	MD4_ROUND(G, d, a, b, c, in[2] + K2,  5);
+	MD4_ROUND(G, c, d, a, b, in[4] + K2,  9);
+	MD4_ROUND(G, b, c, d, a, in[6] + K2, 13);
+
+	/* Round 3 */
+	MD4_ROUND(H, a, b, c, d, in[3] + K3,  3);
+	MD4_ROUND(H, d, a, b, c, in[7] + K3,  9);
+	MD4_ROUND(H, c, d, a, b, in[2] + K3, 11);
+	MD4_ROUND(H, b, c, d, a, in[6] + K3, 15);
+	MD4_ROUND(H, a, b, c, d, in[1] + K3,  3);
+	MD4_ROUND(H, d, a, b, c, in[5] + K3,  9);
+	MD4_ROUND(H, c, d, a, b, in[0] + K3, 11);
+	MD4_ROUND(H, b, c, d, a, in[4] + K3, 15);
+
+	buf[0] += a;
+	buf[1] += b;
+	buf[2] += c;
+	buf[3] += d;
+}
+
+#undef MD4_ROUND
+#undef K1
+#undef K2
+#undef K3
+#undef F
+#undef G
+#undef H
+
+/* The old legacy hash */
+static u32 dx_hack_hash_unsigned(const char *name, int len)
+{
+	u32 hash, hash0 = 0x12a3fe2d, hash1 = 0x37abe8f9;
+	const unsigned char *ucp = (const unsigned char *)name;
+
+	while (len--) {
+		hash = hash1 + (hash0 ^ (((int)*ucp++) * 7152373));
+
+		if (hash & 0x80000000)
+			hash -= 0x7fffffff;
+		hash1 = hash0;
+		hash0 = hash;
+	}
+	return hash0 << 1;
+}
+
+static u32 dx_hack_hash_signed(const char *name, int len)
+{
+	u32 hash, hash0 = 0x12a3fe2d, hash1 = 0x37abe8f9;
+	const signed char *scp = (const signed char *)name;
+
+	while (len--) {
+		hash = hash1 + (hash0 ^ (((int)*scp++) * 7152373));
+
+		if (hash & 0x80000000)
+			hash -= 0x7fffffff;
+		hash1 = hash0;
+		hash0 = hash;
+	}
+	return hash0 << 1;
+}
+
+static void str2hashbuf_signed(const char *msg, int len, u32 *buf, int num)
+{
+	u32 pad, val;
+	int i;
+	const signed char *scp = (const signed char *)msg;
+
+	pad = (u32)len | ((u32)len << 8);
+	pad |= pad << 16;
+
+	val = pad;
+	if (len > num * 4)
+		len = num * 4;
+	for (i = 0; i < len; i++) {
+		val = ((int)scp[i]) + (val << 8);
+		if ((i % 4) == 3) {
+			*buf++ = val;
+			val = pad;
+			num--;
+		}
+	}
+	if (--num >= 0)
+		*buf++ = val;
+	while (--num >= 0)
+		*buf++ = pad;
+}
+
+static void str2hashbuf_unsigned(const char *msg, int len, u32 *buf, int num)
+{
+	u32 pad, val;
+	int i;
+	const unsigned char *ucp = (const unsigned char *)msg;
+
+	pad = (u32)len | ((u32)len << 8);
+	pad |= pad << 16;
+
+	val = pad;
+	if (len > num * 4)
+		len = num * 4;
+	for (i = 0; i < len; i++) {
+		val = ((int)ucp[i]) + (val << 8);
+		if ((i % 4) == 3) {
+			*buf++ = val;
+			val = pad;
+			num--;
+		}
+	}
+	if (--num >= 0)
+		*buf++ = val;
+	while (--num >= 0)
+		*buf++ = pad;
+}
+
+/**
+ * ext4fs_dirhash() - hash a file name as the directory index does
+ *
+ * @name:	Name to hash
+ * @len:	Length of @name
+ * @seed:	Hash seed from the superblock
+ * @version:	DX_HASH_... algorithm
+ * Return: major hash of the name, with the lowest bit clear
+ */
+static u32 ext4fs_dirhash(const char *name, int len, const __le32 seed[4],
+			  int version)
+{
+	void (*str2hashbuf)(const char *, int, u32 *, int) =
+		str2hashbuf_signed;
+	u32 buf[4], in[8];
+	const char *p;
+	u32 hash = 0;
+	int i;
+
+	/* Initialize the default seed for the hash checksum functions */
+	buf[0] = 0x67452301;
+	buf[1] = 0xefcdab89;
+	buf[2] = 0x98badcfe;
+	buf[3] = 0x10325476;
+
+	/* Check to see if the seed is all zero's */
+	if (seed[0] || seed[1] || seed[2] || seed[3]) {
+		for (i = 0; i < 4; i++)
+			buf[i] = le32_to_cpu(seed[i]);
+	}
+
+	switch (version) {
+	case DX_HASH_LEGACY_UNSIGNED:
+		hash = dx_hack_hash_unsigned(name, len);
+		break;
+	case DX_HASH_LEGACY:
+		hash = dx_hack_hash_signed(name, len);
+		break;
+	case DX_HASH_HALF_MD4_UNSIGNED:
+		str2hashbuf = str2hashbuf_unsigned;
+		fallthrough;
+	case DX_HASH_HALF_MD4:
+		p = name;
+		while (len > 0) {
+			str2hashbuf(p, len, in, 8);
+			half_md4_transform(buf, in);
+			len -= 32;
+			p += 32;
+		}
+		hash = buf[1];
+		break;
+	case DX_HASH_TEA_UNSIGNED:
+		str2hashbuf = str2hashbuf_unsigned;
+		fallthrough;
+	case DX_HASH_TEA:
+		p = name;
+		while (len > 0) {
+			str2hashbuf(p, len, in, 4);
+			TEA_transform(buf, in);
+			len -= 16;
+			p += 16;
+		}
+		hash = buf[0];
+		break;
+	}
+
+	hash &= ~1;
+	if (hash == (EXT4_HTREE_EOF_32BIT << 1))
+		hash = (EXT4_HTREE_EOF_32BIT - 1) << 1;
+
+	return hash;
+}
+
+static int dx_read_block(struct ext2fs_node *dir, u32 lblk, char *buf)
+{
+	int blksz = EXT2_BLOCK_SIZE(dir->data);
+	loff_t actread;
+	int ret;
+
+	ret = ext4fs_read_file(dir, (loff_t)lblk * blksz, blksz, buf,
+			       &actread);
+	if (ret < 0 || actread != blksz)
+		return -EIO;
+
+	return 0;
+}
+
+static u32 dx_get_block(struct dx_entry *entry)
+{
+	return le32_to_cpu(entry->block) & 0x0fffffff;
+}
+
+/* Check the count and limit of an index block and note its entry count */
+static int dx_check_frame(struct dx_frame *frame, int blksz)
+{
+	struct dx_countlimit *cl = (struct dx_countlimit *)frame->entries;
+	unsigned int limit = le16_to_cpu(cl->limit);
+	unsigned int count = le16_to_cpu(cl->count);
+
+	if (!count || count > limit ||
+	    (char *)(frame->entries + limit) > frame->buf + blksz)
+		return -EINVAL;
+	frame->count = count;
+
+	return 0;
+}
+
+/* Find the last entry whose hash is not above @hash */
+static struct dx_entry *dx_search(struct dx_frame *frame, u32 hash)
+{
+	struct dx_entry *p = frame->entries + 1;
+	struct dx_entry *q = frame->entries + frame->count - 1;
+	struct dx_entry *m;
+
+	while (p <= q) {
+		m = p + (q - p) / 2;
+		if (le32_to_cpu(m->hash) > hash)
+			q = m - 1;
+		else
+			p = m + 1;
+	}
+
+	return p - 1;
+}
+
+/*
+ * Move to the next leaf, if names with @hash may continue there. Return 1 if
+ * so, 0 if not or -ve on error
+ */
+static int dx_next_leaf(struct ext2fs_node *dir, struct dx_frame *frames,
+			int levels, u32 hash)
+{
+	int blksz = EXT2_BLOCK_SIZE(dir->data);
+	struct dx_frame *frame;
+	int lvl = levels;
+	int ret;
+
+	/* Find the lowest level which has an entry after the current one */
+	while (frames[lvl].at + 1 == frames[lvl].entries + frames[lvl].count) {
+		if (!lvl)
+			return 0;
+		lvl--;
+	}
+	frame = &frames[lvl];
+	frame->at++;
+
+	/* A set low bit marks a hash carried over from the previous block */
+	if ((le32_to_cpu(frame->at->hash) & ~1) != hash)
+		return 0;
+
+	for (; lvl < levels; lvl++) {
+		frame = &frames[lvl + 1];
+		ret = dx_read_block(dir, dx_get_block(frames[lvl].at),
+				    frame->buf);
+		if (ret)
+			return ret;
+		ret = dx_check_frame(frame, blksz);
+		if (ret)
+			return ret;
+		frame->at = frame->entries;
+	}
+
+	return 1;
+}
+
+/* Look @name up in one leaf block; return 1 if found, 0 if not, -ve on error */
+static int dx_search_leaf(char *leaf, int blksz, const char *name, int len,
+			  u32 *inop, int *filetypep)
+{
+	int pos = 0;
+
+	while (pos + sizeof(struct ext2_dirent) <= blksz) {
+		struct ext2_dirent *de = (struct ext2_dirent *)(leaf + pos);
+		int reclen = le16_to_cpu(de->direntlen);
+
+		if (reclen < sizeof(*de) || pos + reclen > blksz)
+			return -EINVAL;
+		if (de->inode && de->namelen == len &&
+		    sizeof(*de) + len <= reclen &&
+		    !memcmp(de + 1, name, len)) {
+			*inop = le32_to_cpu(de->inode);
+			*filetypep = de->filetype;
+			return 1;
+		}
+		pos += reclen;
+	}
+
+	return 0;
+}
+
+int ext4fs_htree_lookup(struct ext2fs_node *dir, const char *name, u32 *inop,
+			int *filetypep)
+{
+	struct ext2_sblock *sb = &dir->data->sblock;
+	int blksz = EXT2_BLOCK_SIZE(dir->data);
+	struct dx_frame frames[DX_MAX_LEVELS_LARGEDIR + 1];
+	struct dx_root_info *info;
+	int levels, max_levels, version, lvl, ret;
+	int len = strlen(name);
+	char *buf, *leaf;
+	u32 hash;
+
+	if (!(le32_to_cpu(sb->feature_compatibility) &
+	      EXT4_FEATURE_COMPAT_DIR_INDEX) ||
+	    !(le32_to_cpu(dir->inode.flags) & EXT4_INDEX_FL))
+		return -EOPNOTSUPP;
+	/* These live in the root block, outside the leaves */
+	if (!strcmp(name, ".") || !strcmp(name, ".."))
+		return -EOPNOTSUPP;
+
+	buf = malloc(blksz);
+	if (!buf)
+		return -ENOMEM;
+	ret = dx_read_block(dir, 0, buf);
+	if (ret)
+		goto out;
+
+	info = (struct dx_root_info *)(buf + DX_ROOT_INFO_OFFSET);
+	version = info->hash_version;
+	levels = info->indirect_levels;
+	max_levels = le32_to_cpu(sb->feature_incompat) &
+		     EXT4_FEATURE_INCOMPAT_LARGEDIR ? DX_MAX_LEVELS_LARGEDIR :
+						      DX_MAX_LEVELS;
+	/* Casefolded and encrypted directories use hashes we cannot compute */
+	if (info->reserved_zero || version > DX_HASH_TEA ||
+	    info->info_length < sizeof(*info) || levels >= max_levels) {
+		ret = -EOPNOTSUPP;
+		goto out;
+	}
+	if (le32_to_cpu(sb->flags) & EXT2_FLAGS_UNSIGNED_HASH)
+		version += DX_HASH_LEGACY_UNSIGNED;
+	hash = ext4fs_dirhash(name, len, sb->hash_seed, version);
+
+	/* One block per index level, then the leaf */
+	leaf = realloc(buf, (levels + 2) * blksz);
+	if (!leaf) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	buf = leaf;
+	info = (struct dx_root_info *)(buf + DX_ROOT_INFO_OFFSET);
+
+	frames[0].buf = buf;
+	frames[0].entries = (struct dx_entry *)((char *)info +
+						info->info_length);
+	for (lvl = 0;; lvl++) {
+		struct dx_frame *frame = &frames[lvl];
+
+		ret = dx_check_frame(frame, blksz);
+		if (ret)
+			goto out;
+		frame->at = dx_search(frame, hash);
+		if (lvl == levels)
+			break;
+
+		frame[1].buf = buf + (lvl + 1) * blksz;
+		frame[1].entries = (struct dx_entry *)(frame[1].buf +
+						       DX_NODE_ENTRIES_OFFSET);
+		ret = dx_read_block(dir, dx_get_block(frame->at), frame[1].buf);
+		if (ret)
+			goto out;
+	}
+
+	leaf = buf + (levels + 1) * blksz;
+	do {
+		ret = dx_read_block(dir, dx_get_block(frames[levels].at), leaf);
+		if (ret)
+			break;
+		ret = dx_search_leaf(leaf, blksz, name, len, inop, filetypep);
+		if (ret)
+			break;
+		ret = dx_next_leaf(dir, frames, levels, hash);
+	} while (ret > 0);
+
+out:
+	free(buf);
+
+	return ret;
+}
@@ -602,6 +602,9 @@ int ext4fs_init(void)
 	uint32_t real_free_blocks = 0;
 	struct ext_filesystem *fs = get_fs();
 
+	/* directories are about to change under any cached lookups */
+	ext4fs_dcache_flush();
+
 	/* populate fs */
 	fs->blksz = EXT2_BLOCK_SIZE(ext4fs_root);
 	fs->sect_perblk = fs->blksz >> fs->dev_desc->log2blksz;
@@ -702,6 +705,8 @@ void ext4fs_deinit(void)
 	struct ext_filesystem *fs = get_fs();
 	uint32_t new_feature_incompat;
 
+	ext4fs_dcache_flush();
+
 	/* free journal */
 	char *temp_buff = zalloc(fs->blksz);
 	if (temp_buff) {
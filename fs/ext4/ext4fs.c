@@ -29,6 +29,7 @@
 #include <malloc.h>
 #include <part.h>
 #include <uuid.h>
+#include <linux/sizes.h>
 
 int ext4fs_symlinknest;
 struct ext_filesystem ext_fs;
@@ -40,8 +41,64 @@ struct ext_filesystem *get_fs(void)
 
 void ext4fs_free_node(struct ext2fs_node *node, struct ext2fs_node *currroot)
 {
-	if ((node != &ext4fs_root->diropen) && (node != currroot))
+	if ((node != &ext4fs_root->diropen) && (node != currroot)) {
+		free(node->runs);
 		free(node);
+	}
+}
+
+/*
+ * Read using the extent map of a node, with one device read per run
+ */
+static int ext4fs_read_runs(struct ext2fs_node *node, loff_t pos,
+			    loff_t len, char *buf)
+{
+	struct ext_filesystem *fs = get_fs();
+	int log2blksz = fs->dev_desc->log2blksz;
+	int log2_fs_blocksize = LOG2_BLOCK_SIZE(node->data) - log2blksz;
+	int blocksize = 1 << (log2_fs_blocksize + log2blksz);
+	loff_t end = pos + len;
+	loff_t rstart, rend, n;
+	int i;
+
+	for (i = 0; i < node->nr_runs && pos < end; i++) {
+		struct ext4_extent_run *run = &node->runs[i];
+
+		rstart = (loff_t)run->lblk * blocksize;
+		rend = rstart + (loff_t)run->len * blocksize;
+		if (rend <= pos)
+			continue;
+		if (rstart >= end)
+			break;
+
+		/* Sparse file: nothing is mapped before this run */
+		if (rstart > pos) {
+			memset(buf, 0, rstart - pos);
+			buf += rstart - pos;
+			pos = rstart;
+		}
+
+		while (pos < min(rend, end)) {
+			/* Keep each read within the range of an int */
+			n = min(min(rend, end) - pos, (loff_t)SZ_1G);
+			if (!run->pblk) {
+				memset(buf, 0, n);
+			} else if (!ext4fs_devread((run->pblk <<
+						    log2_fs_blocksize) +
+						   ((pos - rstart) >> log2blksz),
+						   (pos - rstart) &
+						   (fs->dev_desc->blksz - 1),
+						   n, buf)) {
+				return -1;
+			}
+			buf += n;
+			pos += n;
+		}
+	}
+	if (pos < end)
+		memset(buf, 0, end - pos);
+
+	return 0;
 }
 
 /*
@@ -80,6 +137,14 @@ int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 		return -1;
 	}
 
+	if (node->runs) {
+		ext_cache_fini(&cache);
+		if (ext4fs_read_runs(node, pos, len, buf))
+			return -1;
+		*actread = len;
+		return 0;
+	}
+
 	blockcnt = lldiv(((len + pos) + blocksize - 1), blocksize);
 
 	for (i = lldiv(pos, blocksize); i < blockcnt; i++) {
@@ -22,6 +22,8 @@
 #include <asm/cache.h>
 #include <linux/compiler.h>
 #include <linux/ctype.h>
+#include <linux/math64.h>
+#include <linux/sizes.h>
 
 /*
  * Convert a string to lowercase.  Converts at most 'len' characters,
@@ -39,6 +41,9 @@ static void downcase(char *str, size_t len)
 static struct blk_desc *cur_dev;
 static struct disk_partition cur_part_info;
 
+/* Upper bound on the bounce buffer used for misaligned destinations */
+#define FAT_BOUNCE_SIZE		SZ_64K
+
 #define DOS_BOOT_MAGIC_OFFSET	0x1fe
 #define DOS_FS_TYPE_OFFSET	0x36
 #define DOS_FS32_TYPE_OFFSET	0x52
@@ -157,6 +162,97 @@ int flush_dirty_fat_buffer(fsdata *mydata)
 }
 #endif
 
+/**
+ * fat_cache_alloc() - allocate an empty FAT cache
+ *
+ * @mydata:	filesystem description, with sect_size set
+ * Return:	0 on success, -1 if out of memory
+ */
+static int fat_cache_alloc(fsdata *mydata)
+{
+	int i;
+
+	mydata->fatbuf = NULL;
+	mydata->fatbufnum = -1;
+	mydata->fat_dirty = 0;
+	mydata->fatcachetick = 0;
+	for (i = 0; i < FAT_CACHE_WINDOWS; i++) {
+		mydata->fatcachenum[i] = -1;
+		mydata->fatcacheused[i] = 0;
+		mydata->fatcachedirty[i] = 0;
+	}
+	mydata->fatcache = malloc_cache_aligned(FATBUFSIZE * FAT_CACHE_WINDOWS);
+	if (!mydata->fatcache)
+		return -1;
+
+	return 0;
+}
+
+/**
+ * fat_cache_load() - make a window of the FAT the current FAT buffer
+ *
+ * If the window is not already cached, it is read into the least recently
+ * used buffer. Without CONFIG_FAT_WRITE_BACK only the current buffer can be
+ * dirty, as it is written back before switching away from it. Otherwise
+ * dirty buffers are only written back when one of them must be reused, or
+ * when flush_dirty_fat_buffer() is called at the end of an operation.
+ *
+ * @mydata:	filesystem description
+ * @bufnum:	window number, i.e. FAT sector / FATBUFBLOCKS
+ * Return:	0 on success, -1 on error
+ */
+static int fat_cache_load(fsdata *mydata, __u32 bufnum)
+{
+	__u32 getsize = FATBUFBLOCKS;
+	__u32 fatlength = mydata->fatlength;
+	__u32 startblock = bufnum * FATBUFBLOCKS;
+	int i, oldest = 0;
+	__u8 *bufptr;
+
+	if (bufnum == mydata->fatbufnum)
+		return 0;
+
+	/* Write back the fatbuf to the disk */
+	if (!IS_ENABLED(CONFIG_FAT_WRITE_BACK) &&
+	    flush_dirty_fat_buffer(mydata) < 0)
+		return -1;
+
+	for (i = 0; i < FAT_CACHE_WINDOWS; i++) {
+		if (mydata->fatcachenum[i] == bufnum) {
+			oldest = i;
+			goto found;
+		}
+		if (mydata->fatcacheused[i] < mydata->fatcacheused[oldest])
+			oldest = i;
+	}
+
+	/* Cap length if fatlength is not a multiple of FATBUFBLOCKS */
+	if (startblock + getsize > fatlength)
+		getsize = fatlength - startblock;
+
+	startblock += mydata->fat_sect;	/* Offset from start of disk */
+
+	/* Write back all changes in one go, rather than just this buffer */
+	if (mydata->fatcachedirty[oldest] &&
+	    flush_dirty_fat_buffer(mydata) < 0)
+		return -1;
+
+	bufptr = mydata->fatcache + oldest * FATBUFSIZE;
+	mydata->fatcachenum[oldest] = -1;
+	if (disk_read(startblock, getsize, bufptr) < 0) {
+		debug("Error reading FAT blocks\n");
+		mydata->fatbufnum = -1;
+		return -1;
+	}
+	mydata->fatcachenum[oldest] = bufnum;
+found:
+	mydata->fatbuf = mydata->fatcache + oldest * FATBUFSIZE;
+	mydata->fatbufnum = bufnum;
+	mydata->fatcacheused[oldest] = ++mydata->fatcachetick;
+
+	return 0;
+}
+
 /*
  * Get the entry at index 'entry' in a FAT (12/16/32) table.
  * On failure 0x00 is returned.
@@ -195,28 +291,8 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 	       mydata->fatsize, entry, entry, offset, offset);
 
 	/* Read a new block of FAT entries into the cache. */
-	if (bufnum != mydata->fatbufnum) {
-		__u32 getsize = FATBUFBLOCKS;
-		__u8 *bufptr = mydata->fatbuf;
-		__u32 fatlength = mydata->fatlength;
-		__u32 startblock = bufnum * FATBUFBLOCKS;
-
-		/* Cap length if fatlength is not a multiple of FATBUFBLOCKS */
-		if (startblock + getsize > fatlength)
-			getsize = fatlength - startblock;
-
-		startblock += mydata->fat_sect;	/* Offset from start of disk */
-
-		/* Write back the fatbuf to the disk */
-		if (flush_dirty_fat_buffer(mydata) < 0)
-			return -1;
-
-		if (disk_read(startblock, getsize, bufptr) < 0) {
-			debug("Error reading FAT blocks\n");
-			return ret;
-		}
-		mydata->fatbufnum = bufnum;
-	}
+	if (fat_cache_load(mydata, bufnum))
+		return ret;
 
 	/* Get the actual entry from the table */
 	switch (mydata->fatsize) {
@@ -242,39 +318,53 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 }
 
 /*
- * Read at most 'size' bytes from the specified cluster into 'buffer'.
+ * Read 'size' bytes starting at sector 'startsect' into 'buffer'.
  * Return 0 on success, -1 otherwise.
  */
 static int
-get_cluster(fsdata *mydata, __u32 clustnum, __u8 *buffer, unsigned long size)
+get_sectors(fsdata *mydata, __u32 startsect, __u8 *buffer, unsigned long size)
 {
-	__u32 startsect;
 	int ret;
 
-	if (clustnum > 0) {
-		startsect = clust_to_sect(mydata, clustnum);
-	} else {
-		startsect = mydata->rootdir_sect;
-	}
-
-	debug("gc - clustnum: %d, startsect: %d\n", clustnum, startsect);
-
 	if ((unsigned long)buffer & (ARCH_DMA_MINALIGN - 1)) {
-		ALLOC_CACHE_ALIGN_BUFFER(__u8, tmpbuf, mydata->sect_size);
+		__u32 chunk = min(size, (unsigned long)FAT_BOUNCE_SIZE) /
+			      mydata->sect_size;
+		__u8 *tmpbuf;
 
 		debug("FAT: Misaligned buffer address (%p)\n", buffer);
 
+		/*
+		 * Bounce through as many sectors at a time as we can get,
+		 * rather than issuing one single-sector read per sector.
+		 */
+		tmpbuf = chunk > 1 ? malloc_cache_aligned(chunk *
+							  mydata->sect_size) :
+				     NULL;
+		if (!tmpbuf) {
+			chunk = 1;
+			tmpbuf = malloc_cache_aligned(mydata->sect_size);
+			if (!tmpbuf)
+				return -1;
+		}
+
 		while (size >= mydata->sect_size) {
-			ret = disk_read(startsect++, 1, tmpbuf);
-			if (ret != 1) {
+			__u32 count = min((unsigned long)chunk,
+					  size / mydata->sect_size);
+			__u32 bytes = count * mydata->sect_size;
+
+			ret = disk_read(startsect, count, tmpbuf);
+			if (ret != count) {
 				debug("Error reading data (got %d)\n", ret);
+				free(tmpbuf);
 				return -1;
 			}
 
-			memcpy(buffer, tmpbuf, mydata->sect_size);
-			buffer += mydata->sect_size;
-			size -= mydata->sect_size;
+			memcpy(buffer, tmpbuf, bytes);
+			startsect += count;
+			buffer += bytes;
+			size -= bytes;
 		}
+		free(tmpbuf);
 	} else if (size >= mydata->sect_size) {
 		__u32 bytes_read;
 		__u32 sect_count = size / mydata->sect_size;
@@ -304,6 +394,97 @@ get_cluster(fsdata *mydata, __u32 clustnum, __u8 *buffer, unsigned long size)
 	return 0;
 }
 
+/**
+ * struct fat_extent - run of contiguous clusters in a file
+ *
+ * @clust:	first cluster of the run
+ * @count:	number of clusters in the run
+ */
+struct fat_extent {
+	__u32 clust;
+	__u32 count;
+};
+
+/**
+ * fat_map_extents() - map part of a cluster chain into extents
+ *
+ * This walks the FAT once, so that the data can then be read with one
+ * disk_read() per extent rather than interleaving FAT and data reads.
+ *
+ * @mydata:	file system description
+ * @clust:	first cluster to map
+ * @nclust:	number of clusters to map
+ * @extp:	returns an allocated array of extents, to be freed by the caller
+ * Return:	number of extents, or -1 on error
+ */
+static int fat_map_extents(fsdata *mydata, __u32 clust, __u32 nclust,
+			   struct fat_extent **extp)
+{
+	struct fat_extent *ext = NULL, *new;
+	int count = 0, alloced = 0;
+
+	while (nclust) {
+		if (CHECK_CLUST(clust, mydata->fatsize)) {
+			debug("curclust: 0x%x\n", clust);
+			printf("Invalid FAT entry\n");
+			goto err;
+		}
+		if (count && ext[count - 1].clust + ext[count - 1].count ==
+		    clust) {
+			ext[count - 1].count++;
+		} else {
+			if (count == alloced) {
+				alloced = alloced ? alloced * 2 : 16;
+				new = realloc(ext, alloced * sizeof(*ext));
+				if (!new)
+					goto err;
+				ext = new;
+			}
+			ext[count].clust = clust;
+			ext[count].count = 1;
+			count++;
+		}
+		if (--nclust)
+			clust = get_fatent(mydata, clust);
+	}
+	*extp = ext;
+
+	return count;
+err:
+	free(ext);
+	return -1;
+}
+
+/*
+ * Read 'size' bytes from 'offset' bytes into the extent starting at cluster
+ * 'clust' into 'buffer'.
+ * Return 0 on success, -1 otherwise.
+ */
+static int get_extent(fsdata *mydata, __u32 clust, unsigned int offset,
+		      __u8 *buffer, unsigned long size)
+{
+	__u32 startsect = clust_to_sect(mydata, clust) +
+			  offset / mydata->sect_size;
+
+	offset %= mydata->sect_size;
+	if (offset) {
+		ALLOC_CACHE_ALIGN_BUFFER(__u8, tmpbuf, mydata->sect_size);
+		unsigned long len = min_t(unsigned long, size,
+					  mydata->sect_size - offset);
+
+		if (disk_read(startsect, 1, tmpbuf) != 1) {
+			debug("Error reading data\n");
+			return -1;
+		}
+		memcpy(buffer, tmpbuf + offset, len);
+		buffer += len;
+		size -= len;
+		startsect++;
+	}
+
+	return get_sectors(mydata, startsect, buffer, size);
+}
+
 /**
  * get_contents() - read from file
  *
@@ -325,8 +506,10 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 	loff_t filesize = FAT2CPU32(dentptr->size);
 	unsigned int bytesperclust = mydata->clust_size * mydata->sect_size;
 	__u32 curclust = START(dentptr);
-	__u32 endclust, newclust;
-	loff_t actsize;
+	struct fat_extent *ext;
+	__u32 skip, nclust, offset;
+	unsigned long actsize;
+	int count, i, ret = 0;
 
 	*gotsize = 0;
 	debug("Filesize: %llu bytes\n", filesize);
@@ -341,101 +524,39 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 
 	debug("%llu bytes\n", filesize);
 
-	actsize = bytesperclust;
-
 	/* go to cluster at pos */
-	while (actsize <= pos) {
+	skip = div_u64_rem(pos, bytesperclust, &offset);
+	nclust = div_u64(filesize + bytesperclust - 1, bytesperclust) - skip;
+	while (skip--) {
 		curclust = get_fatent(mydata, curclust);
 		if (CHECK_CLUST(curclust, mydata->fatsize)) {
 			debug("curclust: 0x%x\n", curclust);
 			printf("Invalid FAT entry\n");
 			return -1;
 		}
-		actsize += bytesperclust;
 	}
 
-	/* actsize > pos */
-	actsize -= bytesperclust;
-	filesize -= actsize;
-	pos -= actsize;
-
-	/* align to beginning of next cluster if any */
-	if (pos) {
-		__u8 *tmp_buffer;
-
-		actsize = min(filesize, (loff_t)bytesperclust);
-		tmp_buffer = malloc_cache_aligned(actsize);
-		if (!tmp_buffer) {
-			debug("Error: allocating buffer\n");
-			return -1;
-		}
+	count = fat_map_extents(mydata, curclust, nclust, &ext);
+	if (count < 0)
+		return -1;
 
-		if (get_cluster(mydata, curclust, tmp_buffer, actsize) != 0) {
+	for (i = 0; i < count; i++) {
+		actsize = min_t(loff_t, filesize - pos,
+				(loff_t)ext[i].count * bytesperclust - offset);
+		if (get_extent(mydata, ext[i].clust, offset, buffer,
+			       actsize)) {
 			printf("Error reading cluster\n");
-			free(tmp_buffer);
-			return -1;
+			ret = -1;
+			break;
 		}
-		filesize -= actsize;
-		actsize -= pos;
-		memcpy(buffer, tmp_buffer + pos, actsize);
-		free(tmp_buffer);
 		*gotsize += actsize;
-		if (!filesize)
-			return 0;
 		buffer += actsize;
-
-		curclust = get_fatent(mydata, curclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
-			printf("Invalid FAT entry\n");
-			return -1;
-		}
+		pos += actsize;
+		offset = 0;
 	}
+	free(ext);
 
-	actsize = bytesperclust;
-	endclust = curclust;
-
-	do {
-		/* search for consecutive clusters */
-		while (actsize < filesize) {
-			newclust = get_fatent(mydata, endclust);
-			if ((newclust - 1) != endclust)
-				goto getit;
-			if (CHECK_CLUST(newclust, mydata->fatsize)) {
-				debug("curclust: 0x%x\n", newclust);
-				printf("Invalid FAT entry\n");
-				return -1;
-			}
-			endclust = newclust;
-			actsize += bytesperclust;
-		}
-
-		/* get remaining bytes */
-		actsize = filesize;
-		if (get_cluster(mydata, curclust, buffer, (int)actsize) != 0) {
-			printf("Error reading cluster\n");
-			return -1;
-		}
-		*gotsize += actsize;
-		return 0;
-getit:
-		if (get_cluster(mydata, curclust, buffer, (int)actsize) != 0) {
-			printf("Error reading cluster\n");
-			return -1;
-		}
-		*gotsize += (int)actsize;
-		filesize -= actsize;
-		buffer += actsize;
-
-		curclust = get_fatent(mydata, endclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
-			printf("Invalid FAT entry\n");
-			return -1;
-		}
-		actsize = bytesperclust;
-		endclust = curclust;
-	} while (1);
+	return ret;
 }
 
 /*
@@ -623,10 +744,7 @@ static int get_fs_info(fsdata *mydata)
 		mydata->root_cluster = 0;
 	}
 
-	mydata->fatbufnum = -1;
-	mydata->fat_dirty = 0;
-	mydata->fatbuf = malloc_cache_aligned(FATBUFSIZE);
-	if (mydata->fatbuf == NULL) {
+	if (fat_cache_alloc(mydata)) {
 		debug("Error: allocating memory\n");
 		return -1;
 	}
@@ -1178,7 +1296,7 @@ int fat_exists(const char *filename)
 		goto out;
 
 	ret = fat_itr_resolve(itr, filename, TYPE_ANY);
-	free(fsdata.fatbuf);
+	free(fsdata.fatcache);
 out:
 	free(itr);
 	return ret == 0;
@@ -1225,7 +1343,7 @@ int fat_size(const char *filename, loff_t *size)
 		 * Directories don't have size, but fs_size() is not
 		 * expected to fail if passed a directory path:
 		 */
-		free(fsdata.fatbuf);
+		free(fsdata.fatcache);
 		ret = fat_itr_root(itr, &fsdata);
 		if (ret)
 			goto out_free_itr;
@@ -1237,7 +1355,7 @@ int fat_size(const char *filename, loff_t *size)
 
 	*size = FAT2CPU32(itr->dent->size);
 out_free_both:
-	free(fsdata.fatbuf);
+	free(fsdata.fatcache);
 out_free_itr:
 	free(itr);
 	return ret;
@@ -1269,7 +1387,7 @@ int file_fat_read_at(const char *filename, loff_t pos, void *buffer,
 	ret = get_contents(&fsdata, dentptr, pos, buffer, maxsize, actread);
 
 out_free_both:
-	free(fsdata.fatbuf);
+	free(fsdata.fatcache);
 out_free_itr:
 	free(itr);
 	return ret;
@@ -1328,7 +1446,7 @@ int fat_opendir(const char *filename, struct fs_dir_stream **dirsp)
 	return 0;
 
 fail_free_both:
-	free(dir->fsdata.fatbuf);
+	free(dir->fsdata.fatcache);
 fail_free_dir:
 	free(dir);
 	return ret;
@@ -1368,7 +1486,7 @@ int fat_readdir(struct fs_dir_stream *dirs, struct fs_dirent **dentp)
 void fat_closedir(struct fs_dir_stream *dirs)
 {
 	fat_dir *dir = (fat_dir *)dirs;
-	free(dir->fsdata.fatbuf);
+	free(dir->fsdata.fatcache);
 	free(dir);
 }
 
@@ -187,6 +187,12 @@ out:
 }
 
 static int total_sector;
+
+/* Longest run of free clusters to look for when allocating */
+#define FAT_ALLOC_RUN	256
+/* FAT entries to scan before settling for a shorter run of free clusters */
+#define FAT_ALLOC_SCAN	(8 * FAT_ALLOC_RUN)
+
 static int disk_write(__u32 block, __u32 nr_blocks, void *buf)
 {
 	ulong ret;
@@ -208,46 +214,90 @@ static int disk_write(__u32 block, __u32 nr_blocks, void *buf)
 }
 
 /*
- * Write fat buffer into block device
+ * Write the dirty sectors of FAT buffer 'idx' into each copy of the FAT
  */
-static int flush_dirty_fat_buffer(fsdata *mydata)
+static int flush_fat_window(fsdata *mydata, int idx)
 {
-	int getsize = FATBUFBLOCKS;
-	__u32 fatlength = mydata->fatlength;
-	__u8 *bufptr = mydata->fatbuf;
-	__u32 startblock = mydata->fatbufnum * FATBUFBLOCKS;
+	__u8 *bufptr = mydata->fatcache + idx * FATBUFSIZE;
+	__u32 startblock = mydata->fatcachenum[idx] * FATBUFBLOCKS;
+	__u8 dirty = mydata->fatcachedirty[idx];
+	__u32 first, last;
+	int fat;
+
+	debug("debug: evicting %d, dirty: %#x\n", mydata->fatcachenum[idx],
+	      dirty);
+
+	for (first = 0; first < FATBUFBLOCKS; first = last) {
+		last = first + 1;
+		if (!(dirty & (1 << first)))
+			continue;
+		while (last < FATBUFBLOCKS && (dirty & (1 << last)))
+			last++;
 
-	debug("debug: evicting %d, dirty: %d\n", mydata->fatbufnum,
-	      (int)mydata->fat_dirty);
+		/* Cap length if fatlength is not a multiple of FATBUFBLOCKS */
+		if (startblock + last > mydata->fatlength)
+			last = mydata->fatlength - startblock;
+		if (last <= first)
+			break;
 
-	if ((!mydata->fat_dirty) || (mydata->fatbufnum == -1))
-		return 0;
+		for (fat = 0; fat < mydata->fats; fat++) {
+			if (disk_write(mydata->fat_sect +
+				       fat * mydata->fatlength +
+				       startblock + first, last - first,
+				       bufptr + first * mydata->sect_size) < 0) {
+				debug("error: writing FAT blocks\n");
+				return -1;
+			}
+		}
+	}
+	mydata->fatcachedirty[idx] = 0;
 
-	/* Cap length if fatlength is not a multiple of FATBUFBLOCKS */
-	if (startblock + getsize > fatlength)
-		getsize = fatlength - startblock;
+	return 0;
+}
 
-	startblock += mydata->fat_sect;
+/*
+ * Write all modified FAT buffers into block device
+ */
+static int flush_dirty_fat_buffer(fsdata *mydata)
+{
+	int i, next;
 
-	/* Write FAT buf */
-	if (disk_write(startblock, getsize, bufptr) < 0) {
-		debug("error: writing FAT blocks\n");
-		return -1;
-	}
+	if (!mydata->fat_dirty)
+		return 0;
 
-	if (mydata->fats == 2) {
-		/* Update corresponding second FAT blocks */
-		startblock += mydata->fatlength;
-		if (disk_write(startblock, getsize, bufptr) < 0) {
-			debug("error: writing second FAT blocks\n");
-			return -1;
+	/* Write the windows in order so that the device sees ascending I/O */
+	do {
+		next = -1;
+		for (i = 0; i < FAT_CACHE_WINDOWS; i++) {
+			if (!mydata->fatcachedirty[i])
+				continue;
+			if (next < 0 || mydata->fatcachenum[i] <
+					mydata->fatcachenum[next])
+				next = i;
 		}
-	}
+		if (next >= 0 && flush_fat_window(mydata, next))
+			return -1;
+	} while (next >= 0);
 	mydata->fat_dirty = 0;
 
 	return 0;
 }
 
+/*
+ * Mark 'len' bytes at 'offset' in the current FAT buffer as modified
+ */
+static void set_fatbuf_dirty(fsdata *mydata, __u32 offset, __u32 len)
+{
+	int idx = (mydata->fatbuf - mydata->fatcache) / FATBUFSIZE;
+	__u32 sect;
+
+	for (sect = offset / mydata->sect_size;
+	     sect <= (offset + len - 1) / mydata->sect_size &&
+	     sect < FATBUFBLOCKS; sect++)
+		mydata->fatcachedirty[idx] |= 1 << sect;
+	mydata->fat_dirty = 1;
+}
+
 /**
  * fat_find_empty_dentries() - find a sequence of available directory entries
  *
@@ -457,30 +507,15 @@ static int set_fatent_value(fsdata *mydata, __u32 entry, __u32 entry_value)
 	}
 
 	/* Read a new block of FAT entries into the cache. */
-	if (bufnum != mydata->fatbufnum) {
-		int getsize = FATBUFBLOCKS;
-		__u8 *bufptr = mydata->fatbuf;
-		__u32 fatlength = mydata->fatlength;
-		__u32 startblock = bufnum * FATBUFBLOCKS;
-
-		/* Cap length if fatlength is not a multiple of FATBUFBLOCKS */
-		if (startblock + getsize > fatlength)
-			getsize = fatlength - startblock;
-
-		if (flush_dirty_fat_buffer(mydata) < 0)
-			return -1;
-
-		startblock += mydata->fat_sect;
-
-		if (disk_read(startblock, getsize, bufptr) < 0) {
-			debug("Error reading FAT blocks\n");
-			return -1;
-		}
-		mydata->fatbufnum = bufnum;
-	}
+	if (fat_cache_load(mydata, bufnum))
+		return -1;
 
-	/* Mark as dirty */
-	mydata->fat_dirty = 1;
+	/* Mark the sectors holding the entry as dirty */
+	if (mydata->fatsize == 12)
+		set_fatbuf_dirty(mydata, (offset * 3) / 4 * 2, 4);
+	else
+		set_fatbuf_dirty(mydata, offset * (mydata->fatsize / 8),
+				 mydata->fatsize / 8);
 
 	/* Set the actual entry */
 	switch (mydata->fatsize) {
@@ -537,22 +572,97 @@ static int set_fatent_value(fsdata *mydata, __u32 entry, __u32 entry_value)
 }
 
 /*
- * Determine the next free cluster after 'entry' in a FAT (12/16/32) table
- * and link it to 'entry'. EOC marker is not set on returned entry.
+ * Return the number of the last cluster on the filesystem
  */
-static __u32 determine_fatent(fsdata *mydata, __u32 entry)
+static __u32 fat_max_cluster(fsdata *mydata)
 {
-	__u32 next_fat, next_entry = entry + 1;
+	__u32 max = (mydata->total_sect - mydata->data_begin) /
+		    mydata->clust_size - 1;
+	__u32 entries = lldiv((u64)mydata->fatlength * mydata->sect_size * 8,
+			      mydata->fatsize);
 
-	while (1) {
-		next_fat = get_fatent(mydata, next_entry);
-		if (next_fat == 0) {
-			/* found free entry, link to entry */
-			set_fatent_value(mydata, entry, next_entry);
-			break;
+	return min(max, entries - 1);
+}
+
+/*
+ * Return the number of clusters needed to hold 'size' bytes, capped at
+ * FAT_ALLOC_RUN
+ */
+static __u32 fat_alloc_count(fsdata *mydata, u64 size)
+{
+	unsigned int bytesperclust = mydata->clust_size * mydata->sect_size;
+
+	return min_t(u64, lldiv(size + bytesperclust - 1, bytesperclust),
+		     FAT_ALLOC_RUN);
+}
+
+/*
+ * Find a run of 'count' free clusters, searching from 'start' and wrapping
+ * around. A 'start' of 3 means anywhere, in which case the search continues
+ * after the previous allocation. Once FAT_ALLOC_SCAN entries have been
+ * looked at, the longest run seen so far is taken instead, so that a
+ * fragmented FAT is not scanned from end to end for every fragment. Return
+ * a cluster past the end of the filesystem if it is full.
+ *
+ * The cluster before 'start' is treated as in use, since callers extending a
+ * chain pass the cluster after its last one, which is not yet marked as end
+ * of chain.
+ */
+static __u32 find_empty_cluster(fsdata *mydata, __u32 start, __u32 count)
+{
+	__u32 max = fat_max_cluster(mydata);
+	__u32 prev = start - 1;
+	__u32 entry, run = 0, best = 0, best_run = 0, i;
+
+	if (start == 3 && mydata->next_free)
+		start = mydata->next_free;
+	if (start < 3 || start > max)
+		start = 3;
+	if (!count)
+		count = 1;
+
+	for (entry = start, i = 0; i <= max - 3; i++) {
+		if (entry != prev && get_fatent(mydata, entry) == 0) {
+			if (++run > best_run) {
+				best = entry - run + 1;
+				best_run = run;
+			}
+			if (run == count)
+				break;
+		} else {
+			run = 0;
+			if (best_run && i >= FAT_ALLOC_SCAN)
+				break;
+		}
+		if (++entry > max) {
+			entry = 3;
+			run = 0;
 		}
-		next_entry++;
 	}
+
+	if (!best_run)
+		return max + 1;
+	mydata->next_free = best + best_run;
+
+	return best;
+}
+
+/*
+ * Determine the next free cluster after 'entry' in a FAT (12/16/32) table
+ * and link it to 'entry'. If the cluster just after 'entry' is in use, look
+ * for a run of 'count' free clusters instead. EOC marker is not set on
+ * returned entry.
+ */
+static __u32 determine_fatent(fsdata *mydata, __u32 entry, __u32 count)
+{
+	__u32 next_entry = entry + 1;
+
+	if (next_entry > fat_max_cluster(mydata) ||
+	    get_fatent(mydata, next_entry) != 0)
+		next_entry = find_empty_cluster(mydata, next_entry, count);
+
+	/* link to entry */
+	set_fatent_value(mydata, entry, next_entry);
 	debug("FAT%d: entry: %08x, entry_value: %04x\n",
 	       mydata->fatsize, entry, next_entry);
 
@@ -794,23 +904,6 @@ get_set_cluster(fsdata *mydata, __u32 clustnum, loff_t pos, __u8 *buffer,
 	return 0;
 }
 
-/*
- * Find the first empty cluster
- */
-static int find_empty_cluster(fsdata *mydata)
-{
-	__u32 fat_val, entry = 3;
-
-	while (1) {
-		fat_val = get_fatent(mydata, entry);
-		if (fat_val == 0)
-			break;
-		entry++;
-	}
-
-	return entry;
-}
-
 /**
  * new_dir_table() - allocate a cluster for additional directory entries
  *
@@ -824,7 +917,7 @@ static int new_dir_table(fat_itr *itr)
 	int dir_oldclust = itr->clust;
 	unsigned int bytesperclust = mydata->clust_size * mydata->sect_size;
 
-	dir_newclust = find_empty_cluster(mydata);
+	dir_newclust = find_empty_cluster(mydata, 3, 1);
 
 	/*
 	 * Flush before updating FAT to ensure valid directory structure
@@ -844,7 +937,8 @@ static int new_dir_table(fat_itr *itr)
 	else if (mydata->fatsize == 12)
 		set_fatent_value(mydata, dir_newclust, 0xff8);
 
-	if (flush_dirty_fat_buffer(mydata) < 0)
+	if (!IS_ENABLED(CONFIG_FAT_WRITE_BACK) &&
+	    flush_dirty_fat_buffer(mydata) < 0)
 		return -EIO;
 
 	itr->dent = (dir_entry *)itr->block;
@@ -871,8 +965,9 @@ static int clear_fatent(fsdata *mydata, __u32 entry)
 		entry = fat_val;
 	}
 
-	/* Flush fat buffer */
-	if (flush_dirty_fat_buffer(mydata) < 0)
+	/* Flush fat buffer, unless this is left to the end of the operation */
+	if (!IS_ENABLED(CONFIG_FAT_WRITE_BACK) &&
+	    flush_dirty_fat_buffer(mydata) < 0)
 		return -1;
 
 	return 0;
@@ -1066,14 +1161,15 @@ set_clusters:
 
 	/* Assure that curclust is valid */
 	if (!curclust) {
-		curclust = find_empty_cluster(mydata);
+		curclust = find_empty_cluster(mydata, 3,
+					      fat_alloc_count(mydata, filesize));
 		set_start_cluster(mydata, dentptr, curclust);
 	} else {
 		newclust = get_fatent(mydata, curclust);
 
 		if (IS_LAST_CLUST(newclust, mydata->fatsize)) {
-			newclust = determine_fatent(mydata, curclust);
-			set_fatent_value(mydata, curclust, newclust);
+			newclust = determine_fatent(mydata, curclust,
+					fat_alloc_count(mydata, filesize));
 			curclust = newclust;
 		} else {
 			debug("error: something wrong\n");
@@ -1092,7 +1188,9 @@ set_clusters:
 	do {
 		/* search for consecutive clusters */
 		while (actsize < filesize) {
-			newclust = determine_fatent(mydata, endclust);
+			newclust = determine_fatent(mydata, endclust,
+					fat_alloc_count(mydata,
+							filesize - actsize));
 
 			if ((newclust - 1) != endclust)
 				/* write to <curclust..endclust> */
@@ -1308,7 +1406,7 @@ int file_fat_write_at(const char *filename, loff_t pos, void *buffer,
 		      loff_t size, loff_t *actwrite)
 {
 	dir_entry *retdent;
-	fsdata datablock = { .fatbuf = NULL, };
+	fsdata datablock = { .fatcache = NULL, };
 	fsdata *mydata = &datablock;
 	fat_itr *itr = NULL;
 	int ret = -1;
@@ -1426,7 +1524,7 @@ int file_fat_write_at(const char *filename, loff_t pos, void *buffer,
 
 exit:
 	free(filename_copy);
-	free(mydata->fatbuf);
+	free(mydata->fatcache);
 	free(itr);
 	return ret;
 }
@@ -1440,8 +1538,7 @@ int file_fat_write(const char *filename, void *buffer, loff_t offset,
 static int fat_dir_entries(fat_itr *itr)
 {
 	fat_itr *dirs;
-	fsdata fsdata = { .fatbuf = NULL, }, *mydata = &fsdata;
-						/* for FATBUFSIZE */
+	fsdata fsdata = { .fatcache = NULL, };
 	int count;
 
 	dirs = malloc_cache_aligned(sizeof(fat_itr));
@@ -1456,20 +1553,18 @@ static int fat_dir_entries(fat_itr *itr)
 	fsdata = *dirs->fsdata;
 
 	/* allocate local fat buffer */
-	fsdata.fatbuf = malloc_cache_aligned(FATBUFSIZE);
-	if (!fsdata.fatbuf) {
+	if (fat_cache_alloc(&fsdata)) {
 		debug("Error: allocating memory\n");
 		count = -ENOMEM;
 		goto exit;
 	}
-	fsdata.fatbufnum = -1;
 	dirs->fsdata = &fsdata;
 
 	for (count = 0; fat_itr_next(dirs); count++)
 		;
 
 exit:
-	free(fsdata.fatbuf);
+	free(fsdata.fatcache);
 	free(dirs);
 	return count;
 }
@@ -1560,7 +1655,7 @@ static int delete_dentry_long(fat_itr *itr)
 
 int fat_unlink(const char *filename)
 {
-	fsdata fsdata = { .fatbuf = NULL, };
+	fsdata fsdata = { .fatcache = NULL, };
 	fat_itr *itr = NULL;
 	int n_entries, ret;
 	char *filename_copy, *dirname, *basename;
@@ -1622,7 +1717,7 @@ int fat_unlink(const char *filename)
 	ret = delete_dentry_long(itr);
 
 exit:
-	free(fsdata.fatbuf);
+	free(fsdata.fatcache);
 	free(itr);
 	free(filename_copy);
 
@@ -1632,7 +1727,7 @@ exit:
 int fat_mkdir(const char *dirname)
 {
 	dir_entry *retdent;
-	fsdata datablock = { .fatbuf = NULL, };
+	fsdata datablock = { .fatcache = NULL, };
 	fsdata *mydata = &datablock;
 	fat_itr *itr = NULL;
 	char *dirname_copy, *parent, *basename;
@@ -1766,7 +1861,7 @@ int fat_mkdir(const char *dirname)
 
 exit:
 	free(dirname_copy);
-	free(mydata->fatbuf);
+	free(mydata->fatcache);
 	free(itr);
 	free(dotdent);
 	return ret;
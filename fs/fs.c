@@ -10,9 +10,14 @@
 #include <display_options.h>
 #include <errno.h>
 #include <common.h>
+#include <blk_dma.h>
 #include <env.h>
+#include <hash.h>
+#include <hexdump.h>
+#include <image.h>
 #include <lmb.h>
 #include <log.h>
+#include <malloc.h>
 #include <mapmem.h>
 #include <part.h>
 #include <ext4fs.h>
@@ -37,6 +42,22 @@ static int fs_dev_part;
 static struct disk_partition fs_partition;
 static int fs_type = FS_TYPE_ANY;
 
+/*
+ * The filesystem whose driver state is set up, i.e. which has been probed
+ * and not yet closed. With CONFIG_FS_MOUNT_CACHE this outlives fs_close()
+ * so that the next fs_set_blk_dev() on the same partition can use it
+ */
+static struct {
+	bool valid;
+	int fstype;
+	struct blk_desc *desc;
+	int part;
+	int hwpart;
+	lbaint_t start;
+	lbaint_t size;
+	ulong change_count;
+} fs_mount;
+
 void fs_set_type(int type)
 {
 	fs_type = type;
@@ -152,6 +173,18 @@ struct fstype_info {
 	 * filesystem.
 	 */
 	bool null_dev_desc_ok;
+	/*
+	 * Can the filesystem stay mounted after fs_close()? This requires
+	 * that all driver state is set up by .probe() and torn down by
+	 * .close(), with each operation working from that state alone.
+	 */
+	bool keep_mounted;
+	/*
+	 * Can .read() be called again at a later offset without probing the
+	 * filesystem again? Loads that are hashed on the fly are read in
+	 * chunks when this is set.
+	 */
+	bool chunked_read;
 	int (*probe)(struct blk_desc *fs_dev_desc,
 		     struct disk_partition *fs_partition);
 	int (*ls)(const char *dirname);
@@ -188,6 +221,8 @@ static struct fstype_info fstypes[] = {
 		.fstype = FS_TYPE_FAT,
 		.name = "fat",
 		.null_dev_desc_ok = false,
+		.keep_mounted = true,
+		.chunked_read = true,
 		.probe = fat_set_blk_dev,
 		.close = fat_close,
 		.ls = fs_ls_generic,
@@ -216,6 +251,8 @@ static struct fstype_info fstypes[] = {
 		.fstype = FS_TYPE_EXT,
 		.name = "ext4",
 		.null_dev_desc_ok = false,
+		.keep_mounted = true,
+		.chunked_read = true,
 		.probe = ext4fs_probe,
 		.close = ext4fs_close,
 		.ls = ext4fs_ls,
@@ -300,6 +337,8 @@ static struct fstype_info fstypes[] = {
 		.fstype = FS_TYPE_BTRFS,
 		.name = "btrfs",
 		.null_dev_desc_ok = false,
+		.keep_mounted = true,
+		.chunked_read = true,
 		.probe = btrfs_probe,
 		.close = btrfs_close,
 		.ls = btrfs_ls,
@@ -320,6 +359,7 @@ static struct fstype_info fstypes[] = {
 		.fstype = FS_TYPE_SQUASHFS,
 		.name = "squashfs",
 		.null_dev_desc_ok = false,
+		.keep_mounted = true,
 		.probe = sqfs_probe,
 		.opendir = sqfs_opendir,
 		.readdir = sqfs_readdir,
@@ -341,6 +381,8 @@ static struct fstype_info fstypes[] = {
 		.fstype = FS_TYPE_EROFS,
 		.name = "erofs",
 		.null_dev_desc_ok = false,
+		.keep_mounted = true,
+		.chunked_read = true,
 		.probe = erofs_probe,
 		.opendir = erofs_opendir,
 		.readdir = erofs_readdir,
@@ -416,6 +458,72 @@ const char *fs_get_type_name(void)
 	return fs_get_info(fs_type)->name;
 }
 
+static void fs_mount_close(void)
+{
+	if (fs_mount.valid) {
+		fs_mount.valid = false;
+		fs_get_info(fs_mount.fstype)->close();
+	}
+}
+
+#if CONFIG_IS_ENABLED(FS_MOUNT_CACHE)
+void fs_invalidate_mount(void)
+{
+	if (fs_type == FS_TYPE_ANY)
+		fs_mount_close();
+}
+#endif
+
+/*
+ * Use the filesystem left mounted on the selected partition, if any and if
+ * the block device has not changed since; otherwise close it. Return 0 if it
+ * was reused
+ */
+static int fs_mount_reuse(int fstype, int part)
+{
+	if (!fs_mount.valid)
+		return -ENOENT;
+
+	if (CONFIG_IS_ENABLED(FS_MOUNT_CACHE) && fs_dev_desc &&
+	    fs_dev_desc == fs_mount.desc && part == fs_mount.part &&
+	    fs_dev_desc->hwpart == fs_mount.hwpart &&
+	    fs_partition.start == fs_mount.start &&
+	    fs_partition.size == fs_mount.size &&
+	    blk_get_change_count() == fs_mount.change_count &&
+	    (fstype == FS_TYPE_ANY || fstype == fs_mount.fstype)) {
+		fs_type = fs_mount.fstype;
+		fs_dev_part = part;
+		return 0;
+	}
+	fs_mount_close();
+
+	return -ENOENT;
+}
+
+/* Probe the selected partition with one filesystem driver */
+static int fs_mount_probe(struct fstype_info *info, int part)
+{
+	ulong change_count = blk_get_change_count();
+
+	if (info->probe(fs_dev_desc, &fs_partition))
+		return -1;
+
+	fs_type = info->fstype;
+	fs_dev_part = part;
+	if (info->keep_mounted && fs_dev_desc) {
+		fs_mount.valid = true;
+		fs_mount.fstype = info->fstype;
+		fs_mount.desc = fs_dev_desc;
+		fs_mount.part = part;
+		fs_mount.hwpart = fs_dev_desc->hwpart;
+		fs_mount.start = fs_partition.start;
+		fs_mount.size = fs_partition.size;
+		fs_mount.change_count = change_count;
+	}
+
+	return 0;
+}
+
 int fs_set_blk_dev(const char *ifname, const char *dev_part_str, int fstype)
 {
 	struct fstype_info *info;
@@ -442,6 +550,9 @@ int fs_set_blk_dev(const char *ifname, const char *dev_part_str, int fstype)
 	if (part < 0)
 		return -1;
 
+	if (!fs_mount_reuse(fstype, part))
+		return 0;
+
 	for (i = 0, info = fstypes; i < ARRAY_SIZE(fstypes); i++, info++) {
 		if (fstype != FS_TYPE_ANY && info->fstype != FS_TYPE_ANY &&
 				fstype != info->fstype)
@@ -450,11 +561,8 @@ int fs_set_blk_dev(const char *ifname, const char *dev_part_str, int fstype)
 		if (!fs_dev_desc && !info->null_dev_desc_ok)
 			continue;
 
-		if (!info->probe(fs_dev_desc, &fs_partition)) {
-			fs_type = info->fstype;
-			fs_dev_part = part;
+		if (!fs_mount_probe(info, part))
 			return 0;
-		}
 	}
 
 	return -1;
@@ -474,12 +582,12 @@ int fs_set_blk_dev_with_part(struct blk_desc *desc, int part)
 		return ret;
 	fs_dev_desc = desc;
 
+	if (!fs_mount_reuse(FS_TYPE_ANY, part))
+		return 0;
+
 	for (i = 0, info = fstypes; i < ARRAY_SIZE(fstypes); i++, info++) {
-		if (!info->probe(fs_dev_desc, &fs_partition)) {
-			fs_type = info->fstype;
-			fs_dev_part = part;
+		if (!fs_mount_probe(info, part))
 			return 0;
-		}
 	}
 
 	return -1;
@@ -489,11 +597,29 @@ void fs_close(void)
 {
 	struct fstype_info *info = fs_get_info(fs_type);
 
-	info->close();
+	if (fs_type == FS_TYPE_ANY)
+		return;
+
+	/* A filesystem recorded by fs_mount_probe() stays mounted for reuse */
+	if (!CONFIG_IS_ENABLED(FS_MOUNT_CACHE) || !fs_mount.valid ||
+	    fs_mount.fstype != fs_type) {
+		fs_mount.valid = false;
+		info->close();
+	}
 
 	fs_type = FS_TYPE_ANY;
 }
 
+ulong fs_dma_align(void)
+{
+	return blk_dma_align(fs_dev_desc);
+}
+
+void *fs_dma_alloc(size_t size)
+{
+	return blk_dma_alloc(fs_dev_desc, size);
+}
+
 int fs_uuid(char *uuid_str)
 {
 	struct fstype_info *info = fs_get_info(fs_type);
@@ -575,8 +701,104 @@ static int fs_read_lmb_check(const char *filename, ulong addr, loff_t offset,
 }
 #endif
 
+#if CONFIG_IS_ENABLED(FS_LOAD_HASH)
+/* Feed @len bytes at @buf to @algo, a chunk at a time */
+static int fs_hash_buf(struct hash_algo *algo, void *ctx, const void *buf,
+		       loff_t len)
+{
+	loff_t done = 0;
+	int ret;
+
+	do {
+		loff_t chunk = min_t(loff_t, len - done,
+				     CONFIG_FS_LOAD_CHUNK_SIZE);
+
+		ret = algo->hash_update(algo, ctx, buf + done, chunk,
+					done + chunk == len);
+		if (ret)
+			return ret;
+		done += chunk;
+	} while (done < len);
+
+	return 0;
+}
+
+/*
+ * Read a file and hash it as it arrives. Where the driver allows it the file
+ * is read in chunks, each of which is hashed while it is still in the cache,
+ * so that loading and hashing take a single pass over memory. Otherwise the
+ * file is read whole and hashed afterwards.
+ *
+ * The digest is only valid if 0 is returned.
+ */
+static int fs_read_hashed(struct fstype_info *info, const char *filename,
+			  void *buf, loff_t offset, loff_t len,
+			  struct hash_algo *algo, u8 *digest, loff_t *actread)
+{
+	loff_t size, got;
+	void *ctx;
+	int ret;
+
+	*actread = 0;
+	ret = algo->hash_init(algo, &ctx);
+	if (ret)
+		return ret;
+
+	if (!info->chunked_read) {
+		ret = info->read(filename, buf, offset, len, actread);
+		if (!ret)
+			ret = fs_hash_buf(algo, ctx, buf, *actread);
+		if (ret)
+			goto err;
+
+		return algo->hash_finish(algo, ctx, digest, algo->digest_size);
+	}
+
+	ret = info->size(filename, &size);
+	if (ret)
+		goto err;
+	size = offset < size ? size - offset : 0;
+	if (len && len < size)
+		size = len;
+
+	while (*actread < size) {
+		loff_t chunk = min_t(loff_t, size - *actread,
+				     CONFIG_FS_LOAD_CHUNK_SIZE);
+
+		ret = info->read(filename, buf + *actread, offset + *actread,
+				 chunk, &got);
+		if (ret)
+			goto err;
+		if (!got)
+			break;
+
+		ret = algo->hash_update(algo, ctx, buf + *actread, got,
+					*actread + got >= size);
+		*actread += got;
+		if (ret)
+			goto err;
+	}
+
+	return algo->hash_finish(algo, ctx, digest, algo->digest_size);
+
+err:
+	/* Nothing useful to report, but this frees the context */
+	algo->hash_finish(algo, ctx, digest, algo->digest_size);
+
+	return ret;
+}
+#else
+static int fs_read_hashed(struct fstype_info *info, const char *filename,
+			  void *buf, loff_t offset, loff_t len,
+			  struct hash_algo *algo, u8 *digest, loff_t *actread)
+{
+	return -ENOSYS;
+}
+#endif
+
 static int _fs_read(const char *filename, ulong addr, loff_t offset, loff_t len,
-		    int do_lmb_check, loff_t *actread)
+		    int do_lmb_check, struct hash_algo *algo, u8 *digest,
+		    loff_t *actread)
 {
 	struct fstype_info *info = fs_get_info(fs_type);
 	void *buf;
@@ -595,7 +817,11 @@ static int _fs_read(const char *filename, ulong addr, loff_t offset, loff_t len,
 	 * means read the whole file.
 	 */
 	buf = map_sysmem(addr, len);
-	ret = info->read(filename, buf, offset, len, actread);
+	if (algo)
+		ret = fs_read_hashed(info, filename, buf, offset, len, algo,
+				     digest, actread);
+	else
+		ret = info->read(filename, buf, offset, len, actread);
 	unmap_sysmem(buf);
 
 	/* If we requested a specific number of bytes, check we got it */
@@ -609,8 +835,130 @@ static int _fs_read(const char *filename, ulong addr, loff_t offset, loff_t len,
 int fs_read(const char *filename, ulong addr, loff_t offset, loff_t len,
 	    loff_t *actread)
 {
-	return _fs_read(filename, addr, offset, len, 0, actread);
+	return _fs_read(filename, addr, offset, len, 0, NULL, NULL, actread);
+}
+
+#if CONFIG_IS_ENABLED(FS_LOAD_HASH)
+int fs_read_hash(const char *filename, ulong addr, loff_t offset, loff_t len,
+		 struct hash_algo *algo, u8 *digest, loff_t *actread)
+{
+	return _fs_read(filename, addr, offset, len, 0, algo, digest, actread);
+}
+#endif
+
+#if CONFIG_IS_ENABLED(FS_LOAD_DECOMP)
+int fs_read_decomp(const char *filename, ulong addr, loff_t offset, loff_t len,
+		   loff_t *actread, ulong *unc_size)
+{
+	struct fstype_info *info = fs_get_info(fs_type);
+	struct image_decomp_stream s;
+	loff_t size, chunk_size, got;
+	void *buf, *chunk = NULL, *stage = NULL, *load_buf;
+	ulong free_size, stage_addr = 0, unc_len;
+	struct lmb lmb;
+	int comp, ret, err;
+
+	*actread = 0;
+	*unc_size = 0;
+	ret = info->size(filename, &size);
+	if (ret)
+		goto out;
+	size = offset < size ? size - offset : 0;
+	if (len && len < size)
+		size = len;
+	if (!size)
+		goto out;
+
+	/* The output may use all the free memory at @addr */
+	lmb_init_and_reserve(&lmb, gd->bd, (void *)gd->fdt_blob);
+	free_size = lmb_get_free_size(&lmb, addr);
+	if (!free_size)
+		goto err_nospc;
+
+	/*
+	 * Drivers which cannot read in chunks, and algorithms without a
+	 * streaming decoder, need the whole compressed file in memory. It is
+	 * put at the top of the free memory, past the output.
+	 */
+	if (size < free_size)
+		stage_addr = ALIGN_DOWN(addr + free_size - size,
+					ARCH_DMA_MINALIGN);
+	if (stage_addr <= addr)
+		stage_addr = 0;
+
+	if (info->chunked_read) {
+		chunk_size = min_t(loff_t, size, CONFIG_FS_LOAD_CHUNK_SIZE);
+		chunk = malloc(chunk_size);
+		if (!chunk) {
+			ret = -ENOMEM;
+			goto out;
+		}
+		buf = chunk;
+	} else {
+		if (!stage_addr)
+			goto err_nospc;
+		chunk_size = size;
+		stage = map_sysmem(stage_addr, size);
+		buf = stage;
+	}
+
+	ret = info->read(filename, buf, offset, chunk_size, &got);
+	if (ret || !got)
+		goto out_free;
+
+	/* The first chunk tells which decompressor to use */
+	comp = image_decomp_type(buf, got);
+	if (comp < 0)
+		comp = IH_COMP_NONE;
+	if (!stage && !image_decomp_can_stream(comp)) {
+		if (!stage_addr)
+			goto err_nospc;
+		stage = map_sysmem(stage_addr, size);
+	}
+
+	unc_len = stage ? stage_addr - addr : free_size;
+	load_buf = map_sysmem(addr, unc_len);
+	ret = image_decomp_stream_start(&s, comp, load_buf, unc_len, stage,
+					size);
+	if (ret)
+		goto out_unmap;
+
+	for (;;) {
+		*actread += got;
+		ret = image_decomp_stream_feed(&s, buf, got);
+		if (ret || *actread >= size || !info->chunked_read)
+			break;
+
+		/* Collected input is read straight into place */
+		if (stage)
+			buf = stage + *actread;
+		ret = info->read(filename, buf, offset + *actread,
+				 min_t(loff_t, size - *actread, chunk_size),
+				 &got);
+		if (ret || !got)
+			break;
+	}
+	err = image_decomp_stream_end(&s, unc_size);
+	if (!ret)
+		ret = err;
+
+out_unmap:
+	unmap_sysmem(load_buf);
+out_free:
+	if (stage)
+		unmap_sysmem(stage);
+	free(chunk);
+out:
+	fs_close();
+
+	return ret;
+
+err_nospc:
+	log_err("** Reading file would overwrite reserved memory **\n");
+	ret = -ENOSPC;
+	goto out_free;
 }
+#endif
 
 int fs_write(const char *filename, ulong addr, loff_t offset, loff_t len,
 	     loff_t *actwrite)
@@ -754,10 +1102,38 @@ int do_load(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[],
 	loff_t bytes;
 	loff_t pos;
 	loff_t len_read;
+	struct hash_algo *algo = NULL;
+	u8 digest[HASH_MAX_DIGEST_SIZE];
+	bool decomp = false;
+	ulong unc_size = 0;
 	int ret;
 	unsigned long time;
 	char *ep;
 
+	while (argc > 1 && argv[1][0] == '-') {
+		const char *opt = argv[1];
+
+		argc--;
+		argv++;
+		if (CONFIG_IS_ENABLED(FS_LOAD_DECOMP) && !strcmp(opt, "-z")) {
+			decomp = true;
+		} else if (CONFIG_IS_ENABLED(FS_LOAD_HASH) &&
+			   !strcmp(opt, "-h") && argc > 1) {
+			if (hash_progressive_lookup_algo(argv[1], &algo)) {
+				log_err("Unknown hash algorithm '%s'\n",
+					argv[1]);
+				return CMD_RET_USAGE;
+			}
+			argc--;
+			argv++;
+		} else {
+			return CMD_RET_USAGE;
+		}
+	}
+
+	/* The hash would be of the compressed file, which is not loaded */
+	if (decomp && algo)
+		return CMD_RET_USAGE;
 	if (argc < 2)
 		return CMD_RET_USAGE;
 	if (argc > 7)
@@ -798,7 +1174,12 @@ int do_load(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[],
 		pos = 0;
 
 	time = get_timer(0);
-	ret = _fs_read(filename, addr, pos, bytes, 1, &len_read);
+	if (CONFIG_IS_ENABLED(FS_LOAD_DECOMP) && decomp)
+		ret = fs_read_decomp(filename, addr, pos, bytes, &len_read,
+				     &unc_size);
+	else
+		ret = _fs_read(filename, addr, pos, bytes, 1, algo, digest,
+			       &len_read);
 	time = get_timer(time);
 	if (ret < 0) {
 		log_err("Failed to load '%s'\n", filename);
@@ -808,7 +1189,7 @@ int do_load(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[],
 	if (IS_ENABLED(CONFIG_CMD_BOOTEFI))
 		efi_set_bootdev(argv[1], (argc > 2) ? argv[2] : "",
 				(argc > 4) ? argv[4] : "", map_sysmem(addr, 0),
-				len_read);
+				decomp ? unc_size : len_read);
 
 	printf("%llu bytes read in %lu ms", len_read, time);
 	if (time > 0) {
@@ -819,7 +1200,20 @@ int do_load(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[],
 	puts("\n");
 
 	env_set_hex("fileaddr", addr);
-	env_set_hex("filesize", len_read);
+	if (CONFIG_IS_ENABLED(FS_LOAD_DECOMP) && decomp) {
+		printf("%lu bytes uncompressed\n", unc_size);
+		env_set_hex("filesize", unc_size);
+	} else {
+		env_set_hex("filesize", len_read);
+	}
+
+	if (CONFIG_IS_ENABLED(FS_LOAD_HASH) && algo) {
+		char hex[HASH_MAX_DIGEST_SIZE * 2 + 1];
+
+		*bin2hex(hex, digest, algo->digest_size) = '\0';
+		printf("%s: %s\n", algo->name, hex);
+		env_set("filehash", hex);
+	}
 
 	return 0;
 }
@@ -11,6 +11,7 @@
 #include <div64.h>
 #include <errno.h>
 #include <fs.h>
+#include <fs_internal.h>
 #include <linux/types.h>
 #include <asm/byteorder.h>
 #include <linux/compat.h>
@@ -42,6 +43,29 @@ static int sqfs_disk_read(__u32 block, __u32 nr_blocks, void *buf)
 	return ret;
 }
 
+/*
+ * Read @len bytes at byte @offset of the image straight into @buf. Only the
+ * partial sectors at either end are bounced; whole sectors go directly to
+ * the destination.
+ */
+static int sqfs_read_direct(u64 offset, u32 len, void *buf)
+{
+	lbaint_t sector;
+	int byte_offset;
+
+	if (!ctxt.cur_dev)
+		return -ENODEV;
+
+	sector = lldiv(offset, ctxt.cur_dev->blksz);
+	byte_offset = offset - (u64)sector * ctxt.cur_dev->blksz;
+
+	if (!fs_devread(ctxt.cur_dev, &ctxt.cur_part_info, sector, byte_offset,
+			len, buf))
+		return -EIO;
+
+	return 0;
+}
+
 static int sqfs_read_sblk(struct squashfs_super_block **sblk)
 {
 	*sblk = malloc_cache_aligned(ctxt.cur_dev->blksz);
@@ -77,126 +101,473 @@ static int sqfs_count_tokens(const char *filename)
 }
 
 /*
- * Calculates how many blocks are needed for the buffer used in sqfs_disk_read.
- * The memory section (e.g. inode table) start offset and its end (i.e. the next
- * table start) must be specified. It also calculates the offset from which to
- * start reading the buffer.
+ * Decompressed metadata blocks and fragment blocks are kept for as long as the
+ * filesystem stays mounted, so that loading several files does not read and
+ * decompress the same inode, directory and fragment blocks over and over
+ * again. Entries are keyed by the on-disk byte offset of the block and the
+ * least recently used one is recycled on a miss.
  */
-static int sqfs_calc_n_blks(__le64 start, __le64 end, u64 *offset)
+struct sqfs_cache_entry {
+	u64 start;	/* on-disk byte offset of the block, 0 if unused */
+	u32 disk_size;	/* on-disk size, including any header */
+	u32 len;	/* decompressed size */
+	ulong stamp;	/* last use, for LRU eviction */
+	unsigned char *data;
+};
+
+struct sqfs_cache {
+	struct sqfs_cache_entry *entries;
+	int count;
+	u32 data_size;
+	ulong clock;
+};
+
+static struct sqfs_cache sqfs_meta_cache;
+static struct sqfs_cache sqfs_frag_cache;
+/* Fragment index table, i.e. the location of each fragment metadata block */
+static u64 *sqfs_frag_index;
+
+static int sqfs_cache_init(struct sqfs_cache *cache, int count, u32 data_size)
+{
+	cache->entries = calloc(max(count, 1), sizeof(*cache->entries));
+	if (!cache->entries)
+		return -ENOMEM;
+
+	cache->count = max(count, 1);
+	cache->data_size = data_size;
+	cache->clock = 0;
+
+	return 0;
+}
+
+static void sqfs_cache_free(struct sqfs_cache *cache)
+{
+	int i;
+
+	for (i = 0; i < cache->count; i++)
+		free(cache->entries[i].data);
+
+	free(cache->entries);
+	cache->entries = NULL;
+	cache->count = 0;
+}
+
+static struct sqfs_cache_entry *sqfs_cache_find(struct sqfs_cache *cache,
+						u64 start)
 {
-	u64 start_, table_size;
+	int i;
 
-	table_size = le64_to_cpu(end) - le64_to_cpu(start);
-	start_ = le64_to_cpu(start) / ctxt.cur_dev->blksz;
-	*offset = le64_to_cpu(start) - (start_ * ctxt.cur_dev->blksz);
+	for (i = 0; i < cache->count; i++) {
+		if (cache->entries[i].start == start &&
+		    cache->entries[i].data) {
+			cache->entries[i].stamp = ++cache->clock;
+			return &cache->entries[i];
+		}
+	}
 
-	return DIV_ROUND_UP(table_size + *offset, ctxt.cur_dev->blksz);
+	return NULL;
 }
 
 /*
- * Retrieves fragment block entry and returns true if the fragment block is
- * compressed
+ * Picks the least recently used entry and invalidates it, so that a failed
+ * refill neither leaves stale data behind nor keeps the entry from being
+ * picked again.
  */
-static int sqfs_frag_lookup(u32 inode_fragment_index,
-			    struct squashfs_fragment_block_entry *e)
+static struct sqfs_cache_entry *sqfs_cache_evict(struct sqfs_cache *cache)
 {
-	u64 start, n_blks, src_len, table_offset, start_block;
-	unsigned char *metadata_buffer, *metadata, *table;
-	struct squashfs_fragment_block_entry *entries;
-	struct squashfs_super_block *sblk = ctxt.sblk;
+	struct sqfs_cache_entry *e = &cache->entries[0];
+	int i;
+
+	for (i = 1; i < cache->count; i++) {
+		if (cache->entries[i].stamp < e->stamp)
+			e = &cache->entries[i];
+	}
+
+	if (!e->data) {
+		e->data = malloc(cache->data_size);
+		if (!e->data)
+			return NULL;
+	}
+
+	e->start = 0;
+	e->stamp = 0;
+
+	return e;
+}
+
+/*
+ * Reads the device blocks covering @size bytes at byte offset @pos. The data
+ * starts at *@skip bytes into the returned buffer, which must be freed by the
+ * caller.
+ */
+static unsigned char *sqfs_read_range(u64 pos, u32 size, u32 *skip)
+{
+	u32 blksz = ctxt.cur_dev->blksz;
+	u64 start = lldiv(pos, blksz);
+	unsigned char *buf;
+	u32 n_blks;
+
+	*skip = pos - start * blksz;
+	n_blks = DIV_ROUND_UP(size + *skip, blksz);
+
+	buf = malloc_cache_aligned(n_blks * blksz);
+	if (!buf)
+		return NULL;
+
+	if (sqfs_disk_read(start, n_blks, buf) < 0) {
+		free(buf);
+		return NULL;
+	}
+
+	return buf;
+}
+
+/*
+ * Returns the decompressed metadata block stored at byte offset @pos, only
+ * reading it from the disk if it is not cached yet. The entry is valid until
+ * the next call.
+ */
+static int sqfs_get_metablock(u64 pos, struct sqfs_cache_entry **ep)
+{
+	u32 blksz = ctxt.cur_dev->blksz, skip, src_len, n_blks, hdr_blks;
+	struct sqfs_cache_entry *e;
 	unsigned long dest_len;
-	int block, offset, ret;
-	u16 header;
+	unsigned char *buf;
+	bool compressed;
+	u64 start;
+	int ret;
 
-	metadata_buffer = NULL;
-	entries = NULL;
-	table = NULL;
+	e = sqfs_cache_find(&sqfs_meta_cache, pos);
+	if (e) {
+		*ep = e;
+		return 0;
+	}
 
-	if (inode_fragment_index >= get_unaligned_le32(&sblk->fragments))
-		return -EINVAL;
+	e = sqfs_cache_evict(&sqfs_meta_cache);
+	if (!e)
+		return -ENOMEM;
 
-	start = get_unaligned_le64(&sblk->fragment_table_start) /
-		ctxt.cur_dev->blksz;
-	n_blks = sqfs_calc_n_blks(sblk->fragment_table_start,
-				  sblk->export_table_start,
-				  &table_offset);
+	start = lldiv(pos, blksz);
+	skip = pos - start * blksz;
+	buf = malloc_cache_aligned(ALIGN(skip + SQFS_HEADER_SIZE +
+					 SQFS_METADATA_BLOCK_SIZE, blksz));
+	if (!buf)
+		return -ENOMEM;
 
-	/* Allocate a proper sized buffer to store the fragment index table */
-	table = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
-	if (!table) {
-		ret = -ENOMEM;
+	/* The header tells how much more has to be read */
+	hdr_blks = DIV_ROUND_UP(skip + SQFS_HEADER_SIZE, blksz);
+	if (sqfs_disk_read(start, hdr_blks, buf) < 0) {
+		ret = -EIO;
 		goto out;
 	}
 
-	if (sqfs_disk_read(start, n_blks, table) < 0) {
-		ret = -EINVAL;
+	ret = sqfs_read_metablock(buf, skip, &compressed, &src_len);
+	if (ret)
+		goto out;
+
+	n_blks = DIV_ROUND_UP(skip + SQFS_HEADER_SIZE + src_len, blksz);
+	if (n_blks > hdr_blks &&
+	    sqfs_disk_read(start + hdr_blks, n_blks - hdr_blks,
+			   buf + hdr_blks * blksz) < 0) {
+		ret = -EIO;
 		goto out;
 	}
 
-	block = SQFS_FRAGMENT_INDEX(inode_fragment_index);
-	offset = SQFS_FRAGMENT_INDEX_OFFSET(inode_fragment_index);
+	if (compressed) {
+		dest_len = SQFS_METADATA_BLOCK_SIZE;
+		ret = sqfs_decompress(&ctxt, e->data, &dest_len,
+				      buf + skip + SQFS_HEADER_SIZE, src_len);
+		if (ret) {
+			ret = -EINVAL;
+			goto out;
+		}
+	} else {
+		memcpy(e->data, buf + skip + SQFS_HEADER_SIZE, src_len);
+		dest_len = src_len;
+	}
 
-	/*
-	 * Get the start offset of the metadata block that contains the right
-	 * fragment block entry
-	 */
-	start_block = get_unaligned_le64(table + table_offset + block *
-					 sizeof(u64));
+	e->start = pos;
+	e->disk_size = SQFS_HEADER_SIZE + src_len;
+	e->len = dest_len;
+	e->stamp = ++sqfs_meta_cache.clock;
+	*ep = e;
 
-	start = start_block / ctxt.cur_dev->blksz;
-	n_blks = sqfs_calc_n_blks(cpu_to_le64(start_block),
-				  sblk->fragment_table_start, &table_offset);
+out:
+	free(buf);
 
-	metadata_buffer = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
-	if (!metadata_buffer) {
-		ret = -ENOMEM;
-		goto out;
+	return ret;
+}
+
+/*
+ * Position in a metadata stream, such as the inode or the directory table:
+ * the on-disk byte offset of a metadata block and an offset into its
+ * decompressed data.
+ */
+struct sqfs_meta_pos {
+	u64 block;
+	u32 offset;
+};
+
+/*
+ * Copies @len bytes from a metadata stream into @buf, moving on to the
+ * following metadata blocks as needed, and advances @pos past them.
+ */
+static int sqfs_read_meta(struct sqfs_meta_pos *pos, void *buf, u32 len)
+{
+	struct sqfs_cache_entry *metablock;
+	u32 chunk;
+	int ret;
+
+	while (len) {
+		ret = sqfs_get_metablock(pos->block, &metablock);
+		if (ret)
+			return ret;
+
+		if (pos->offset >= metablock->len) {
+			/* Only the last block of a table may be shorter */
+			if (metablock->len < SQFS_METADATA_BLOCK_SIZE)
+				return -EINVAL;
+
+			pos->offset -= metablock->len;
+			pos->block += metablock->disk_size;
+			continue;
+		}
+
+		chunk = min(len, metablock->len - pos->offset);
+		memcpy(buf, metablock->data + pos->offset, chunk);
+		buf += chunk;
+		len -= chunk;
+		pos->offset += chunk;
 	}
 
-	if (sqfs_disk_read(start, n_blks, metadata_buffer) < 0) {
-		ret = -EINVAL;
-		goto out;
+	return 0;
+}
+
+/*
+ * Reads the inode referenced by @ref, that is the offset of its metadata block
+ * from the start of the inode table in the upper bits and the offset into that
+ * block in the lower 16 bits. Unless @full is set, only the fixed part of the
+ * inode is read, otherwise regular files come with their block list and
+ * symlinks with their target. The index of extended directories is never
+ * read. The returned inode must be freed by the caller.
+ */
+static int sqfs_read_inode(u64 ref, bool full, void **inodep)
+{
+	struct squashfs_super_block *sblk = ctxt.sblk;
+	struct squashfs_base_inode base;
+	struct sqfs_meta_pos pos;
+	int size, full_size, ret;
+	void *inode, *tmp;
+
+	pos.block = get_unaligned_le64(&sblk->inode_table_start) + (ref >> 16);
+	pos.offset = ref & 0xffff;
+
+	ret = sqfs_read_meta(&pos, &base, sizeof(base));
+	if (ret)
+		return ret;
+
+	size = sqfs_inode_base_size(get_unaligned_le16(&base.inode_type));
+	if (size < 0)
+		return size;
+
+	inode = malloc(size);
+	if (!inode)
+		return -ENOMEM;
+
+	memcpy(inode, &base, sizeof(base));
+	ret = sqfs_read_meta(&pos, inode + sizeof(base), size - sizeof(base));
+	if (ret)
+		goto err;
+
+	switch (get_unaligned_le16(&base.inode_type)) {
+	case SQFS_REG_TYPE:
+	case SQFS_LREG_TYPE:
+	case SQFS_SYMLINK_TYPE:
+	case SQFS_LSYMLINK_TYPE:
+		if (!full)
+			break;
+
+		full_size = sqfs_inode_size(inode,
+					    get_unaligned_le32(&sblk->block_size));
+		if (full_size <= size)
+			break;
+
+		tmp = realloc(inode, full_size);
+		if (!tmp) {
+			ret = -ENOMEM;
+			goto err;
+		}
+		inode = tmp;
+
+		ret = sqfs_read_meta(&pos, inode + size, full_size - size);
+		if (ret)
+			goto err;
+		break;
 	}
 
-	/* Every metadata block starts with a 16-bit header */
-	header = get_unaligned_le16(metadata_buffer + table_offset);
-	metadata = metadata_buffer + table_offset + SQFS_HEADER_SIZE;
+	*inodep = inode;
 
-	if (!metadata || !header) {
-		ret = -ENOMEM;
-		goto out;
+	return 0;
+
+err:
+	free(inode);
+
+	return ret;
+}
+
+/*
+ * The fragment index table is tiny, one u64 per 512 fragments, so it is read
+ * once and kept until the filesystem is closed.
+ */
+static int sqfs_read_frag_index(void)
+{
+	struct squashfs_super_block *sblk = ctxt.sblk;
+	u32 size, skip;
+	unsigned char *buf;
+
+	size = DIV_ROUND_UP(get_unaligned_le32(&sblk->fragments),
+			    SQFS_MAX_ENTRIES) * sizeof(u64);
+
+	sqfs_frag_index = malloc(size);
+	if (!sqfs_frag_index)
+		return -ENOMEM;
+
+	buf = sqfs_read_range(get_unaligned_le64(&sblk->fragment_table_start),
+			      size, &skip);
+	if (!buf) {
+		free(sqfs_frag_index);
+		sqfs_frag_index = NULL;
+		return -EIO;
 	}
 
-	entries = malloc(SQFS_METADATA_BLOCK_SIZE);
-	if (!entries) {
-		ret = -ENOMEM;
-		goto out;
+	memcpy(sqfs_frag_index, buf + skip, size);
+	free(buf);
+
+	return 0;
+}
+
+/*
+ * Retrieves fragment block entry and returns true if the fragment block is
+ * compressed
+ */
+static int sqfs_frag_lookup(u32 inode_fragment_index,
+			    struct squashfs_fragment_block_entry *e)
+{
+	struct squashfs_super_block *sblk = ctxt.sblk;
+	struct sqfs_cache_entry *metablock;
+	int block, offset, ret;
+
+	if (inode_fragment_index >= get_unaligned_le32(&sblk->fragments))
+		return -EINVAL;
+
+	if (!sqfs_frag_index) {
+		ret = sqfs_read_frag_index();
+		if (ret)
+			return ret;
 	}
 
-	if (SQFS_COMPRESSED_METADATA(header)) {
-		src_len = SQFS_METADATA_SIZE(header);
-		dest_len = SQFS_METADATA_BLOCK_SIZE;
-		ret = sqfs_decompress(&ctxt, entries, &dest_len, metadata,
-				      src_len);
+	block = SQFS_FRAGMENT_INDEX(inode_fragment_index);
+	offset = SQFS_FRAGMENT_INDEX_OFFSET(inode_fragment_index);
+
+	/* Get the metadata block that contains the right fragment block entry */
+	ret = sqfs_get_metablock(get_unaligned_le64(&sqfs_frag_index[block]),
+				 &metablock);
+	if (ret)
+		return ret;
+
+	if ((offset + 1) * sizeof(*e) > metablock->len)
+		return -EINVAL;
+
+	memcpy(e, metablock->data + offset * sizeof(*e), sizeof(*e));
+
+	return SQFS_COMPRESSED_BLOCK(e->size);
+}
+
+/*
+ * Returns the decompressed fragment block described by @fentry, only reading
+ * it from the disk if it is not cached yet. The entry is valid until the next
+ * call.
+ */
+static int sqfs_get_fragment(struct squashfs_fragment_block_entry *fentry,
+			     struct sqfs_cache_entry **ep)
+{
+	u64 start = get_unaligned_le64(&fentry->start);
+	u32 size = get_unaligned_le32(&fentry->size);
+	struct sqfs_cache_entry *e;
+	unsigned long dest_len;
+	unsigned char *buf;
+	u32 skip;
+	int ret = 0;
+
+	e = sqfs_cache_find(&sqfs_frag_cache, start);
+	if (e) {
+		*ep = e;
+		return 0;
+	}
+
+	if (SQFS_BLOCK_SIZE(size) > sqfs_frag_cache.data_size)
+		return -EINVAL;
+
+	e = sqfs_cache_evict(&sqfs_frag_cache);
+	if (!e)
+		return -ENOMEM;
+
+	buf = sqfs_read_range(start, SQFS_BLOCK_SIZE(size), &skip);
+	if (!buf)
+		return -EIO;
+
+	if (SQFS_COMPRESSED_BLOCK(size)) {
+		dest_len = sqfs_frag_cache.data_size;
+		ret = sqfs_decompress(&ctxt, e->data, &dest_len, buf + skip,
+				      SQFS_BLOCK_SIZE(size));
 		if (ret) {
 			ret = -EINVAL;
 			goto out;
 		}
 	} else {
-		memcpy(entries, metadata, SQFS_METADATA_SIZE(header));
+		memcpy(e->data, buf + skip, SQFS_BLOCK_SIZE(size));
+		dest_len = SQFS_BLOCK_SIZE(size);
 	}
 
-	*e = entries[offset];
-	ret = SQFS_COMPRESSED_BLOCK(e->size);
+	e->start = start;
+	e->disk_size = SQFS_BLOCK_SIZE(size);
+	e->len = dest_len;
+	e->stamp = ++sqfs_frag_cache.clock;
+	*ep = e;
 
 out:
-	free(entries);
-	free(metadata_buffer);
-	free(table);
+	free(buf);
+
+	return ret;
+}
+
+static int sqfs_cache_setup(void)
+{
+	int ret;
+
+	ret = sqfs_cache_init(&sqfs_meta_cache,
+			      CONFIG_SQUASHFS_METADATA_CACHE_BLOCKS,
+			      SQFS_METADATA_BLOCK_SIZE);
+	if (ret)
+		return ret;
+
+	ret = sqfs_cache_init(&sqfs_frag_cache,
+			      CONFIG_SQUASHFS_FRAGMENT_CACHE_BLOCKS,
+			      get_unaligned_le32(&ctxt.sblk->block_size));
+	if (ret)
+		sqfs_cache_free(&sqfs_meta_cache);
 
 	return ret;
 }
 
+static void sqfs_cache_cleanup(void)
+{
+	sqfs_cache_free(&sqfs_meta_cache);
+	sqfs_cache_free(&sqfs_frag_cache);
+	free(sqfs_frag_index);
+	sqfs_frag_index = NULL;
+}
+
 /*
  * The entry name is a flexible array member, and we don't know its size before
  * actually reading the entry. So we need a first copy to retrieve this size so
@@ -438,468 +809,387 @@ static char *sqfs_resolve_symlink(struct squashfs_symlink_inode *sym,
 }
 
 /*
- * m_list contains each metadata block's position, and m_count is the number of
- * elements of m_list. Those metadata blocks come from the compressed directory
- * table.
+ * Returns the inode reference of the entry last returned by sqfs_readdir(), see
+ * sqfs_read_inode().
  */
-static int sqfs_search_dir(struct squashfs_dir_stream *dirs, char **token_list,
-			   int token_count, u32 *m_list, int m_count)
+static u64 sqfs_entry_ref(struct squashfs_dir_stream *dirs)
 {
-	struct squashfs_super_block *sblk = ctxt.sblk;
-	char *path, *target, **sym_tokens, *res, *rem;
-	int j, ret = 0, new_inode_number, offset;
-	struct squashfs_symlink_inode *sym;
-	struct squashfs_ldir_inode *ldir;
-	struct squashfs_dir_inode *dir;
-	struct fs_dir_stream *dirsp;
-	struct fs_dirent *dent;
-	unsigned char *table;
-
-	res = NULL;
-	rem = NULL;
-	path = NULL;
-	target = NULL;
-	sym_tokens = NULL;
+	return ((u64)dirs->dir_header->start << 16) | dirs->entry->offset;
+}
 
-	dirsp = (struct fs_dir_stream *)dirs;
+/*
+ * Reads the next entry of @dirs. The size of regular files is only filled in
+ * when @stat is set, as it takes reading their inode.
+ */
+static int sqfs_next_entry(struct squashfs_dir_stream *dirs,
+			   struct fs_dirent **dentp, bool stat)
+{
+	struct squashfs_lreg_inode *lreg;
+	struct squashfs_base_inode *base;
+	struct squashfs_reg_inode *reg;
+	struct fs_dirent *dent;
+	int offset = 0, ret;
+	void *ipos;
+	u16 name_size;
 
-	/* Start by root inode */
-	table = sqfs_find_inode(dirs->inode_table, le32_to_cpu(sblk->inodes),
-				sblk->inodes, sblk->block_size);
+	if (!dirs->size) {
+		*dentp = NULL;
+		return -SQFS_STOP_READDIR;
+	}
 
-	dir = (struct squashfs_dir_inode *)table;
-	ldir = (struct squashfs_ldir_inode *)table;
+	dent = &dirs->dentp;
 
-	/* get directory offset in directory table */
-	offset = sqfs_dir_offset(table, m_list, m_count);
-	dirs->table = &dirs->dir_table[offset];
+	if (!dirs->entry_count) {
+		if (dirs->size > SQFS_DIR_HEADER_SIZE) {
+			dirs->size -= SQFS_DIR_HEADER_SIZE;
+		} else {
+			*dentp = NULL;
+			dirs->size = 0;
+			return -SQFS_STOP_READDIR;
+		}
 
-	/* Setup directory header */
-	dirs->dir_header = malloc(SQFS_DIR_HEADER_SIZE);
-	if (!dirs->dir_header)
-		return -ENOMEM;
+		if (dirs->size > SQFS_EMPTY_FILE_SIZE) {
+			/* Read follow-up (emitted) dir. header */
+			memcpy(dirs->dir_header, dirs->table,
+			       SQFS_DIR_HEADER_SIZE);
+			dirs->entry_count = dirs->dir_header->count + 1;
+			ret = sqfs_read_entry(&dirs->entry, dirs->table +
+					      SQFS_DIR_HEADER_SIZE);
+			if (ret)
+				return -SQFS_STOP_READDIR;
 
-	memcpy(dirs->dir_header, dirs->table, SQFS_DIR_HEADER_SIZE);
-
-	/* Initialize squashfs_dir_stream members */
-	dirs->table += SQFS_DIR_HEADER_SIZE;
-	dirs->size = get_unaligned_le16(&dir->file_size) - SQFS_DIR_HEADER_SIZE;
-	dirs->entry_count = dirs->dir_header->count + 1;
-
-	/* No path given -> root directory */
-	if (!strcmp(token_list[0], "/")) {
-		dirs->table = &dirs->dir_table[offset];
-		memcpy(&dirs->i_dir, dir, sizeof(*dir));
-		return 0;
-	}
-
-	for (j = 0; j < token_count; j++) {
-		if (!sqfs_is_dir(get_unaligned_le16(&dir->inode_type))) {
-			printf("** Cannot find directory. **\n");
-			ret = -EINVAL;
-			goto out;
-		}
-
-		while (!sqfs_readdir(dirsp, &dent)) {
-			ret = strcmp(dent->name, token_list[j]);
-			if (!ret)
-				break;
-			free(dirs->entry);
-			dirs->entry = NULL;
-		}
-
-		if (ret) {
-			printf("** Cannot find directory. **\n");
-			ret = -EINVAL;
-			goto out;
+			dirs->table += SQFS_DIR_HEADER_SIZE;
 		}
+	} else {
+		ret = sqfs_read_entry(&dirs->entry, dirs->table);
+		if (ret)
+			return -SQFS_STOP_READDIR;
+	}
 
-		/* Redefine inode as the found token */
-		new_inode_number = dirs->entry->inode_offset +
-			dirs->dir_header->inode_number;
-
-		/* Get reference to inode in the inode table */
-		table = sqfs_find_inode(dirs->inode_table, new_inode_number,
-					sblk->inodes, sblk->block_size);
-		dir = (struct squashfs_dir_inode *)table;
-
-		/* Check for symbolic link and inode type sanity */
-		if (get_unaligned_le16(&dir->inode_type) == SQFS_SYMLINK_TYPE) {
-			sym = (struct squashfs_symlink_inode *)table;
-			/* Get first j + 1 tokens */
-			path = sqfs_concat_tokens(token_list, j + 1);
-			if (!path) {
-				ret = -ENOMEM;
-				goto out;
-			}
-			/* Resolve for these tokens */
-			target = sqfs_resolve_symlink(sym, path);
-			if (!target) {
-				ret = -ENOMEM;
-				goto out;
-			}
-			/* Join remaining tokens */
-			rem = sqfs_concat_tokens(token_list + j + 1, token_count -
-						 j - 1);
-			if (!rem) {
-				ret = -ENOMEM;
-				goto out;
-			}
-			/* Concatenate remaining tokens and symlink's target */
-			res = malloc(strlen(rem) + strlen(target) + 1);
-			if (!res) {
-				ret = -ENOMEM;
-				goto out;
-			}
-			strcpy(res, target);
-			res[strlen(target)] = '/';
-			strcpy(res + strlen(target) + 1, rem);
-			token_count = sqfs_count_tokens(res);
-
-			if (token_count < 0) {
-				ret = -EINVAL;
-				goto out;
-			}
-
-			sym_tokens = malloc(token_count * sizeof(char *));
-			if (!sym_tokens) {
-				ret = -EINVAL;
-				goto out;
-			}
+	/* Set entry type and size */
+	switch (dirs->entry->type) {
+	case SQFS_DIR_TYPE:
+	case SQFS_LDIR_TYPE:
+		dent->type = FS_DT_DIR;
+		break;
+	case SQFS_REG_TYPE:
+	case SQFS_LREG_TYPE:
+		dent->type = FS_DT_REG;
+		dent->size = 0;
+		if (!stat)
+			break;
 
-			/* Fill tokens list */
-			ret = sqfs_tokenize(sym_tokens, token_count, res);
-			if (ret) {
-				ret = -EINVAL;
-				goto out;
-			}
-			free(dirs->entry);
-			dirs->entry = NULL;
+		ret = sqfs_read_inode(sqfs_entry_ref(dirs), false, &ipos);
+		if (ret)
+			return -SQFS_STOP_READDIR;
 
-			ret = sqfs_search_dir(dirs, sym_tokens, token_count,
-					      m_list, m_count);
-			goto out;
-		} else if (!sqfs_is_dir(get_unaligned_le16(&dir->inode_type))) {
-			printf("** Cannot find directory. **\n");
-			free(dirs->entry);
-			dirs->entry = NULL;
-			ret = -EINVAL;
-			goto out;
+		/*
+		 * Entries do not differentiate extended from regular types, so
+		 * it needs to be verified manually.
+		 */
+		base = ipos;
+		if (get_unaligned_le16(&base->inode_type) == SQFS_LREG_TYPE) {
+			lreg = ipos;
+			dent->size = get_unaligned_le64(&lreg->file_size);
+		} else {
+			reg = ipos;
+			dent->size = get_unaligned_le32(&reg->file_size);
 		}
+		free(ipos);
+		break;
+	case SQFS_BLKDEV_TYPE:
+	case SQFS_CHRDEV_TYPE:
+	case SQFS_LBLKDEV_TYPE:
+	case SQFS_LCHRDEV_TYPE:
+	case SQFS_FIFO_TYPE:
+	case SQFS_SOCKET_TYPE:
+	case SQFS_LFIFO_TYPE:
+	case SQFS_LSOCKET_TYPE:
+		dent->type = SQFS_MISC_ENTRY_TYPE;
+		break;
+	case SQFS_SYMLINK_TYPE:
+	case SQFS_LSYMLINK_TYPE:
+		dent->type = FS_DT_LNK;
+		break;
+	default:
+		return -SQFS_STOP_READDIR;
+	}
 
-		/* Check if it is an extended dir. */
-		if (get_unaligned_le16(&dir->inode_type) == SQFS_LDIR_TYPE)
-			ldir = (struct squashfs_ldir_inode *)table;
-
-		/* Get dir. offset into the directory table */
-		offset = sqfs_dir_offset(table, m_list, m_count);
-		dirs->table = &dirs->dir_table[offset];
-
-		/* Copy directory header */
-		memcpy(dirs->dir_header, &dirs->dir_table[offset],
-		       SQFS_DIR_HEADER_SIZE);
+	/* Set entry name (capped at FS_DIRENT_NAME_LEN which is a U-Boot limitation) */
+	name_size = min_t(u16, dirs->entry->name_size + 1, FS_DIRENT_NAME_LEN - 1);
+	strncpy(dent->name, dirs->entry->name, name_size);
+	dent->name[name_size] = '\0';
 
-		/* Check for empty directory */
-		if (sqfs_is_empty_dir(table)) {
-			printf("Empty directory.\n");
-			free(dirs->entry);
-			dirs->entry = NULL;
-			ret = SQFS_EMPTY_DIR;
-			goto out;
-		}
+	offset = dirs->entry->name_size + 1 + SQFS_ENTRY_BASE_LENGTH;
+	dirs->entry_count--;
 
-		dirs->table += SQFS_DIR_HEADER_SIZE;
-		dirs->size = get_unaligned_le16(&dir->file_size);
-		dirs->entry_count = dirs->dir_header->count + 1;
-		dirs->size -= SQFS_DIR_HEADER_SIZE;
-		free(dirs->entry);
-		dirs->entry = NULL;
-	}
+	/* Decrement size to be read */
+	if (dirs->size > offset)
+		dirs->size -= offset;
+	else
+		dirs->size = 0;
 
-	offset = sqfs_dir_offset(table, m_list, m_count);
-	dirs->table = &dirs->dir_table[offset];
+	/* Keep a reference to the current entry before incrementing it */
+	dirs->table += offset;
 
-	if (get_unaligned_le16(&dir->inode_type) == SQFS_DIR_TYPE)
-		memcpy(&dirs->i_dir, dir, sizeof(*dir));
-	else
-		memcpy(&dirs->i_ldir, ldir, sizeof(*ldir));
+	*dentp = dent;
 
-out:
-	free(res);
-	free(rem);
-	free(path);
-	free(target);
-	free(sym_tokens);
-	return ret;
+	return 0;
 }
 
 /*
- * Inode and directory tables are stored as a series of metadata blocks, and
- * given the compressed size of this table, we can calculate how much metadata
- * blocks are needed to store the result of the decompression, since a
- * decompressed metadata block should have a size of 8KiB.
+ * Looks @name up in @dirs, leaving dirs->entry pointing at it. Only names are
+ * compared, so the inodes of the entries on the way are not read.
  */
-static int sqfs_count_metablks(void *table, u32 offset, int table_size)
+static int sqfs_find_entry(struct squashfs_dir_stream *dirs, const char *name)
 {
-	int count = 0, cur_size = 0, ret;
-	u32 data_size;
-	bool comp;
+	struct fs_dirent *dent;
 
-	do {
-		ret = sqfs_read_metablock(table, offset + cur_size, &comp,
-					  &data_size);
-		if (ret)
-			return -EINVAL;
-		cur_size += data_size + SQFS_HEADER_SIZE;
-		count++;
-	} while (cur_size < table_size);
+	while (!sqfs_next_entry(dirs, &dent, false)) {
+		if (!strcmp(dent->name, name))
+			return 0;
 
-	return count;
+		free(dirs->entry);
+		dirs->entry = NULL;
+	}
+
+	return -ENOENT;
 }
 
 /*
- * Storing the metadata blocks header's positions will be useful while looking
- * for an entry in the directory table, using the reference (index and offset)
- * given by its inode.
+ * Reads the listing of the directory whose inode is @dir_i out of the
+ * directory table, and sets @dirs up to iterate over it from the first entry.
+ * Only the metadata blocks that this listing covers are decompressed.
  */
-static int sqfs_get_metablk_pos(u32 *pos_list, void *table, u32 offset,
-				int metablks_count)
+static int sqfs_open_listing(struct squashfs_dir_stream *dirs, void *dir_i)
 {
-	u32 data_size, cur_size = 0;
-	int j, ret = 0;
-	bool comp;
+	struct squashfs_super_block *sblk = ctxt.sblk;
+	struct squashfs_base_inode *base = dir_i;
+	struct squashfs_ldir_inode *ldir;
+	struct squashfs_dir_inode *dir;
+	struct sqfs_meta_pos pos;
+	u32 start_block, size;
+	int ret;
 
-	if (!metablks_count)
+	switch (get_unaligned_le16(&base->inode_type)) {
+	case SQFS_DIR_TYPE:
+		dir = dir_i;
+		start_block = get_unaligned_le32(&dir->start_block);
+		pos.offset = get_unaligned_le16(&dir->offset);
+		size = get_unaligned_le16(&dir->file_size);
+		memcpy(&dirs->i_dir, dir, sizeof(*dir));
+		break;
+	case SQFS_LDIR_TYPE:
+		ldir = dir_i;
+		start_block = get_unaligned_le32(&ldir->start_block);
+		pos.offset = get_unaligned_le16(&ldir->offset);
+		size = get_unaligned_le32(&ldir->file_size);
+		memcpy(&dirs->i_ldir, ldir, sizeof(*ldir));
+		break;
+	default:
+		printf("Error: this is not a directory.\n");
 		return -EINVAL;
-
-	for (j = 0; j < metablks_count; j++) {
-		ret = sqfs_read_metablock(table, offset + cur_size, &comp,
-					  &data_size);
-		if (ret)
-			return -EINVAL;
-
-		cur_size += data_size + SQFS_HEADER_SIZE;
-		pos_list[j] = cur_size;
 	}
 
-	return ret;
-}
+	free(dirs->entry);
+	dirs->entry = NULL;
+	free(dirs->dir_table);
+	dirs->dir_table = NULL;
+	dirs->table = NULL;
+	dirs->entry_count = 0;
+	dirs->size = 0;
 
-static int sqfs_read_inode_table(unsigned char **inode_table)
-{
-	struct squashfs_super_block *sblk = ctxt.sblk;
-	u64 start, n_blks, table_offset, table_size;
-	int j, ret = 0, metablks_count;
-	unsigned char *src_table, *itb;
-	u32 src_len, dest_offset = 0;
-	unsigned long dest_len = 0;
-	bool compressed;
+	/*
+	 * The directory size accounts for 3 more bytes than the listing
+	 * actually takes, for the implicit '.' and '..' entries.
+	 */
+	if (size <= SQFS_EMPTY_FILE_SIZE)
+		return 0;
 
-	table_size = get_unaligned_le64(&sblk->directory_table_start) -
-		get_unaligned_le64(&sblk->inode_table_start);
-	start = get_unaligned_le64(&sblk->inode_table_start) /
-		ctxt.cur_dev->blksz;
-	n_blks = sqfs_calc_n_blks(sblk->inode_table_start,
-				  sblk->directory_table_start, &table_offset);
+	if (size < SQFS_EMPTY_FILE_SIZE + SQFS_DIR_HEADER_SIZE)
+		return -EINVAL;
 
-	/* Allocate a proper sized buffer (itb) to store the inode table */
-	itb = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
-	if (!itb)
+	dirs->dir_table = malloc(size - SQFS_EMPTY_FILE_SIZE);
+	if (!dirs->dir_table)
 		return -ENOMEM;
 
-	if (sqfs_disk_read(start, n_blks, itb) < 0) {
-		ret = -EINVAL;
-		goto free_itb;
-	}
-
-	/* Parse inode table (metadata block) header */
-	ret = sqfs_read_metablock(itb, table_offset, &compressed, &src_len);
+	pos.block = get_unaligned_le64(&sblk->directory_table_start) +
+		start_block;
+	ret = sqfs_read_meta(&pos, dirs->dir_table,
+			     size - SQFS_EMPTY_FILE_SIZE);
 	if (ret) {
-		ret = -EINVAL;
-		goto free_itb;
-	}
-
-	/* Calculate size to store the whole decompressed table */
-	metablks_count = sqfs_count_metablks(itb, table_offset, table_size);
-	if (metablks_count < 1) {
-		ret = -EINVAL;
-		goto free_itb;
-	}
-
-	*inode_table = kcalloc(metablks_count, SQFS_METADATA_BLOCK_SIZE,
-			       GFP_KERNEL);
-	if (!*inode_table) {
-		ret = -ENOMEM;
-		printf("Error: failed to allocate squashfs inode_table of size %i, increasing CONFIG_SYS_MALLOC_LEN could help\n",
-		       metablks_count * SQFS_METADATA_BLOCK_SIZE);
-		goto free_itb;
+		free(dirs->dir_table);
+		dirs->dir_table = NULL;
+		return ret;
 	}
 
-	src_table = itb + table_offset + SQFS_HEADER_SIZE;
-
-	/* Extract compressed Inode table */
-	for (j = 0; j < metablks_count; j++) {
-		sqfs_read_metablock(itb, table_offset, &compressed, &src_len);
-		if (compressed) {
-			dest_len = SQFS_METADATA_BLOCK_SIZE;
-			ret = sqfs_decompress(&ctxt, *inode_table +
-					      dest_offset, &dest_len,
-					      src_table, src_len);
-			if (ret) {
-				free(*inode_table);
-				*inode_table = NULL;
-				goto free_itb;
-			}
-
-			dest_offset += dest_len;
-		} else {
-			memcpy(*inode_table + (j * SQFS_METADATA_BLOCK_SIZE),
-			       src_table, src_len);
-		}
-
-		/*
-		 * Offsets to the decompression destination, to the metadata
-		 * buffer 'itb' and to the decompression source, respectively.
-		 */
-
-		table_offset += src_len + SQFS_HEADER_SIZE;
-		src_table += src_len + SQFS_HEADER_SIZE;
-	}
-
-free_itb:
-	free(itb);
+	/* Setup directory header */
+	memcpy(dirs->dir_header, dirs->dir_table, SQFS_DIR_HEADER_SIZE);
+	dirs->entry_count = dirs->dir_header->count + 1;
+	dirs->table = dirs->dir_table + SQFS_DIR_HEADER_SIZE;
+	dirs->size = size - SQFS_DIR_HEADER_SIZE;
 
-	return ret;
+	return 0;
 }
 
-static int sqfs_read_directory_table(unsigned char **dir_table, u32 **pos_list)
+/*
+ * Walks the path in @token_list from the root directory, only reading the
+ * inodes and directory listings on the way, and leaves @dirs set up to read
+ * the last directory.
+ */
+static int sqfs_search_dir(struct squashfs_dir_stream *dirs, char **token_list,
+			   int token_count)
 {
-	u64 start, n_blks, table_offset, table_size;
 	struct squashfs_super_block *sblk = ctxt.sblk;
-	int j, ret = 0, metablks_count = -1;
-	unsigned char *src_table, *dtb;
-	u32 src_len, dest_offset = 0;
-	unsigned long dest_len = 0;
-	bool compressed;
+	char *path, *target, **sym_tokens, *res, *rem;
+	struct squashfs_symlink_inode *sym;
+	struct squashfs_base_inode *base;
+	void *inode = NULL;
+	int j, ret = 0;
+	u16 type;
 
-	*dir_table = NULL;
-	*pos_list = NULL;
-	/* DIRECTORY TABLE */
-	table_size = get_unaligned_le64(&sblk->fragment_table_start) -
-		get_unaligned_le64(&sblk->directory_table_start);
-	start = get_unaligned_le64(&sblk->directory_table_start) /
-		ctxt.cur_dev->blksz;
-	n_blks = sqfs_calc_n_blks(sblk->directory_table_start,
-				  sblk->fragment_table_start, &table_offset);
-
-	/* Allocate a proper sized buffer (dtb) to store the directory table */
-	dtb = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
-	if (!dtb)
-		return -ENOMEM;
+	res = NULL;
+	rem = NULL;
+	path = NULL;
+	target = NULL;
+	sym_tokens = NULL;
 
-	if (sqfs_disk_read(start, n_blks, dtb) < 0)
-		goto out;
+	/* Start by root inode */
+	ret = sqfs_read_inode(get_unaligned_le64(&sblk->root_inode), false,
+			      &inode);
+	if (ret)
+		return ret;
 
-	/* Parse directory table (metadata block) header */
-	ret = sqfs_read_metablock(dtb, table_offset, &compressed, &src_len);
+	ret = sqfs_open_listing(dirs, inode);
 	if (ret)
 		goto out;
 
-	/* Calculate total size to store the whole decompressed table */
-	metablks_count = sqfs_count_metablks(dtb, table_offset, table_size);
-	if (metablks_count < 1)
+	/* No path given -> root directory */
+	if (!strcmp(token_list[0], "/"))
 		goto out;
 
-	*dir_table = malloc(metablks_count * SQFS_METADATA_BLOCK_SIZE);
-	if (!*dir_table)
-		goto out;
+	for (j = 0; j < token_count; j++) {
+		ret = sqfs_find_entry(dirs, token_list[j]);
+
+		if (ret) {
+			printf("** Cannot find directory. **\n");
+			ret = -EINVAL;
+			goto out;
+		}
+
+		/* Redefine inode as the found token */
+		free(inode);
+		inode = NULL;
+		ret = sqfs_read_inode(sqfs_entry_ref(dirs), true, &inode);
+		if (ret)
+			goto out;
+
+		base = inode;
+		type = get_unaligned_le16(&base->inode_type);
+
+		/* Check for symbolic link and inode type sanity */
+		if (type == SQFS_SYMLINK_TYPE || type == SQFS_LSYMLINK_TYPE) {
+			sym = inode;
+			/* Get first j + 1 tokens */
+			path = sqfs_concat_tokens(token_list, j + 1);
+			if (!path) {
+				ret = -ENOMEM;
+				goto out;
+			}
+			/* Resolve for these tokens */
+			target = sqfs_resolve_symlink(sym, path);
+			if (!target) {
+				ret = -ENOMEM;
+				goto out;
+			}
+			/* Join remaining tokens */
+			rem = sqfs_concat_tokens(token_list + j + 1, token_count -
+						 j - 1);
+			if (!rem) {
+				ret = -ENOMEM;
+				goto out;
+			}
+			/* Concatenate remaining tokens and symlink's target */
+			res = malloc(strlen(rem) + strlen(target) + 2);
+			if (!res) {
+				ret = -ENOMEM;
+				goto out;
+			}
+			strcpy(res, target);
+			res[strlen(target)] = '/';
+			strcpy(res + strlen(target) + 1, rem);
+			token_count = sqfs_count_tokens(res);
 
-	*pos_list = malloc(metablks_count * sizeof(u32));
-	if (!*pos_list)
-		goto out;
+			if (token_count < 0) {
+				ret = -EINVAL;
+				goto out;
+			}
 
-	ret = sqfs_get_metablk_pos(*pos_list, dtb, table_offset,
-				   metablks_count);
-	if (ret) {
-		metablks_count = -1;
-		goto out;
-	}
+			sym_tokens = malloc(token_count * sizeof(char *));
+			if (!sym_tokens) {
+				ret = -EINVAL;
+				goto out;
+			}
 
-	src_table = dtb + table_offset + SQFS_HEADER_SIZE;
-
-	/* Extract compressed Directory table */
-	dest_offset = 0;
-	for (j = 0; j < metablks_count; j++) {
-		sqfs_read_metablock(dtb, table_offset, &compressed, &src_len);
-		if (compressed) {
-			dest_len = SQFS_METADATA_BLOCK_SIZE;
-			ret = sqfs_decompress(&ctxt, *dir_table +
-					      (j * SQFS_METADATA_BLOCK_SIZE),
-					      &dest_len, src_table, src_len);
+			/* Fill tokens list */
+			ret = sqfs_tokenize(sym_tokens, token_count, res);
 			if (ret) {
-				metablks_count = -1;
+				ret = -EINVAL;
 				goto out;
 			}
 
-			if (dest_len < SQFS_METADATA_BLOCK_SIZE) {
-				dest_offset += dest_len;
-				break;
-			}
+			ret = sqfs_search_dir(dirs, sym_tokens, token_count);
+			goto out;
+		} else if (!sqfs_is_dir(type)) {
+			printf("** Cannot find directory. **\n");
+			free(dirs->entry);
+			dirs->entry = NULL;
+			ret = -EINVAL;
+			goto out;
+		}
 
-			dest_offset += dest_len;
-		} else {
-			memcpy(*dir_table + (j * SQFS_METADATA_BLOCK_SIZE),
-			       src_table, src_len);
+		/* Check for empty directory */
+		if (sqfs_is_empty_dir(inode)) {
+			printf("Empty directory.\n");
+			free(dirs->entry);
+			dirs->entry = NULL;
+			ret = SQFS_EMPTY_DIR;
+			goto out;
 		}
 
-		/*
-		 * Offsets to the decompression destination, to the metadata
-		 * buffer 'dtb' and to the decompression source, respectively.
-		 */
-		table_offset += src_len + SQFS_HEADER_SIZE;
-		src_table += src_len + SQFS_HEADER_SIZE;
+		ret = sqfs_open_listing(dirs, inode);
+		if (ret)
+			goto out;
 	}
 
 out:
-	if (metablks_count < 1) {
-		free(*dir_table);
-		free(*pos_list);
-		*dir_table = NULL;
-		*pos_list = NULL;
-	}
-	free(dtb);
-
-	return metablks_count;
+	free(inode);
+	free(res);
+	free(rem);
+	free(path);
+	free(target);
+	free(sym_tokens);
+	return ret;
 }
 
 int sqfs_opendir(const char *filename, struct fs_dir_stream **dirsp)
 {
-	unsigned char *inode_table = NULL, *dir_table = NULL;
-	int j, token_count = 0, ret = 0, metablks_count;
+	int j, token_count = 0, ret = 0;
 	struct squashfs_dir_stream *dirs;
 	char **token_list = NULL, *path = NULL;
-	u32 *pos_list = NULL;
 
 	dirs = calloc(1, sizeof(*dirs));
 	if (!dirs)
 		return -EINVAL;
 
 	/* these should be set to NULL to prevent dangling pointers */
-	dirs->dir_header = NULL;
 	dirs->entry = NULL;
 	dirs->table = NULL;
-	dirs->inode_table = NULL;
 	dirs->dir_table = NULL;
 
-	ret = sqfs_read_inode_table(&inode_table);
-	if (ret) {
-		ret = -EINVAL;
-		goto out;
-	}
-
-	metablks_count = sqfs_read_directory_table(&dir_table, &pos_list);
-	if (metablks_count < 1) {
-		ret = -EINVAL;
+	dirs->dir_header = malloc(SQFS_DIR_HEADER_SIZE);
+	if (!dirs->dir_header) {
+		ret = -ENOMEM;
 		goto out;
 	}
 
@@ -926,160 +1216,32 @@ int sqfs_opendir(const char *filename, struct fs_dir_stream **dirsp)
 	ret = sqfs_tokenize(token_list, token_count, path);
 	if (ret)
 		goto out;
+
 	/*
-	 * ldir's (extended directory) size is greater than dir, so it works as
-	 * a general solution for the malloc size, since 'i' is a union.
+	 * Only the inodes and directory listings along the path are read, so
+	 * the cost does not grow with the size of the image.
 	 */
-	dirs->inode_table = inode_table;
-	dirs->dir_table = dir_table;
-	ret = sqfs_search_dir(dirs, token_list, token_count, pos_list,
-			      metablks_count);
+	ret = sqfs_search_dir(dirs, token_list, token_count);
 	if (ret)
 		goto out;
 
-	if (le16_to_cpu(dirs->i_dir.inode_type) == SQFS_DIR_TYPE)
-		dirs->size = le16_to_cpu(dirs->i_dir.file_size);
-	else
-		dirs->size = le32_to_cpu(dirs->i_ldir.file_size);
-
-	/* Setup directory header */
-	memcpy(dirs->dir_header, dirs->table, SQFS_DIR_HEADER_SIZE);
-	dirs->entry_count = dirs->dir_header->count + 1;
-	dirs->size -= SQFS_DIR_HEADER_SIZE;
-
-	/* Setup entry */
-	dirs->entry = NULL;
-	dirs->table += SQFS_DIR_HEADER_SIZE;
-
 	*dirsp = (struct fs_dir_stream *)dirs;
 
 out:
 	for (j = 0; j < token_count; j++)
 		free(token_list[j]);
 	free(token_list);
-	free(pos_list);
 	free(path);
-	if (ret) {
-		free(inode_table);
-		free(dirs);
-	}
+	if (ret)
+		sqfs_closedir((struct fs_dir_stream *)dirs);
 
 	return ret;
 }
 
 int sqfs_readdir(struct fs_dir_stream *fs_dirs, struct fs_dirent **dentp)
 {
-	struct squashfs_super_block *sblk = ctxt.sblk;
-	struct squashfs_dir_stream *dirs;
-	struct squashfs_lreg_inode *lreg;
-	struct squashfs_base_inode *base;
-	struct squashfs_reg_inode *reg;
-	int i_number, offset = 0, ret;
-	struct fs_dirent *dent;
-	unsigned char *ipos;
-	u16 name_size;
-
-	dirs = (struct squashfs_dir_stream *)fs_dirs;
-	if (!dirs->size) {
-		*dentp = NULL;
-		return -SQFS_STOP_READDIR;
-	}
-
-	dent = &dirs->dentp;
-
-	if (!dirs->entry_count) {
-		if (dirs->size > SQFS_DIR_HEADER_SIZE) {
-			dirs->size -= SQFS_DIR_HEADER_SIZE;
-		} else {
-			*dentp = NULL;
-			dirs->size = 0;
-			return -SQFS_STOP_READDIR;
-		}
-
-		if (dirs->size > SQFS_EMPTY_FILE_SIZE) {
-			/* Read follow-up (emitted) dir. header */
-			memcpy(dirs->dir_header, dirs->table,
-			       SQFS_DIR_HEADER_SIZE);
-			dirs->entry_count = dirs->dir_header->count + 1;
-			ret = sqfs_read_entry(&dirs->entry, dirs->table +
-					      SQFS_DIR_HEADER_SIZE);
-			if (ret)
-				return -SQFS_STOP_READDIR;
-
-			dirs->table += SQFS_DIR_HEADER_SIZE;
-		}
-	} else {
-		ret = sqfs_read_entry(&dirs->entry, dirs->table);
-		if (ret)
-			return -SQFS_STOP_READDIR;
-	}
-
-	i_number = dirs->dir_header->inode_number + dirs->entry->inode_offset;
-	ipos = sqfs_find_inode(dirs->inode_table, i_number, sblk->inodes,
-			       sblk->block_size);
-
-	base = (struct squashfs_base_inode *)ipos;
-
-	/* Set entry type and size */
-	switch (dirs->entry->type) {
-	case SQFS_DIR_TYPE:
-	case SQFS_LDIR_TYPE:
-		dent->type = FS_DT_DIR;
-		break;
-	case SQFS_REG_TYPE:
-	case SQFS_LREG_TYPE:
-		/*
-		 * Entries do not differentiate extended from regular types, so
-		 * it needs to be verified manually.
-		 */
-		if (get_unaligned_le16(&base->inode_type) == SQFS_LREG_TYPE) {
-			lreg = (struct squashfs_lreg_inode *)ipos;
-			dent->size = get_unaligned_le64(&lreg->file_size);
-		} else {
-			reg = (struct squashfs_reg_inode *)ipos;
-			dent->size = get_unaligned_le32(&reg->file_size);
-		}
-
-		dent->type = FS_DT_REG;
-		break;
-	case SQFS_BLKDEV_TYPE:
-	case SQFS_CHRDEV_TYPE:
-	case SQFS_LBLKDEV_TYPE:
-	case SQFS_LCHRDEV_TYPE:
-	case SQFS_FIFO_TYPE:
-	case SQFS_SOCKET_TYPE:
-	case SQFS_LFIFO_TYPE:
-	case SQFS_LSOCKET_TYPE:
-		dent->type = SQFS_MISC_ENTRY_TYPE;
-		break;
-	case SQFS_SYMLINK_TYPE:
-	case SQFS_LSYMLINK_TYPE:
-		dent->type = FS_DT_LNK;
-		break;
-	default:
-		return -SQFS_STOP_READDIR;
-	}
-
-	/* Set entry name (capped at FS_DIRENT_NAME_LEN which is a U-Boot limitation) */
-	name_size = min_t(u16, dirs->entry->name_size + 1, FS_DIRENT_NAME_LEN - 1);
-	strncpy(dent->name, dirs->entry->name, name_size);
-	dent->name[name_size] = '\0';
-
-	offset = dirs->entry->name_size + 1 + SQFS_ENTRY_BASE_LENGTH;
-	dirs->entry_count--;
-
-	/* Decrement size to be read */
-	if (dirs->size > offset)
-		dirs->size -= offset;
-	else
-		dirs->size = 0;
-
-	/* Keep a reference to the current entry before incrementing it */
-	dirs->table += offset;
-
-	*dentp = dent;
-
-	return 0;
+	return sqfs_next_entry((struct squashfs_dir_stream *)fs_dirs, dentp,
+			       true);
 }
 
 int sqfs_probe(struct blk_desc *fs_dev_desc, struct disk_partition *fs_partition)
@@ -1108,6 +1270,12 @@ int sqfs_probe(struct blk_desc *fs_dev_desc, struct disk_partition *fs_partition
 		goto error;
 	}
 
+	ret = sqfs_cache_setup();
+	if (ret) {
+		sqfs_decompressor_cleanup(&ctxt);
+		goto error;
+	}
+
 	return 0;
 error:
 	ctxt.cur_dev = NULL;
@@ -1314,10 +1482,11 @@ static int sqfs_get_lregfile_info(struct squashfs_lreg_inode *lreg,
 int sqfs_read(const char *filename, void *buf, loff_t offset, loff_t len,
 	      loff_t *actread)
 {
-	char *dir = NULL, *fragment_block, *datablock = NULL;
-	char *fragment = NULL, *file = NULL, *resolved, *data;
+	char *dir = NULL, *datablock = NULL, *file = NULL, *resolved, *data;
+	char *data_buffer = NULL;
+	struct sqfs_cache_entry *fragment;
 	u64 start, n_blks, table_size, data_offset, table_offset, sparse_size;
-	int ret, j, i_number, datablk_count = 0;
+	int ret, j, datablk_count = 0;
 	struct squashfs_super_block *sblk = ctxt.sblk;
 	struct squashfs_fragment_block_entry frag_entry;
 	struct squashfs_file_info finfo = {0};
@@ -1328,8 +1497,7 @@ int sqfs_read(const char *filename, void *buf, loff_t offset, loff_t len,
 	struct squashfs_base_inode *base;
 	struct squashfs_reg_inode *reg;
 	unsigned long dest_len;
-	struct fs_dirent *dent;
-	unsigned char *ipos;
+	unsigned char *ipos = NULL;
 
 	*actread = 0;
 
@@ -1354,14 +1522,7 @@ int sqfs_read(const char *filename, void *buf, loff_t offset, loff_t len,
 	dirs = (struct squashfs_dir_stream *)dirsp;
 
 	/* For now, only regular files are able to be loaded */
-	while (!sqfs_readdir(dirsp, &dent)) {
-		ret = strcmp(dent->name, file);
-		if (!ret)
-			break;
-
-		free(dirs->entry);
-		dirs->entry = NULL;
-	}
+	ret = sqfs_find_entry(dirs, file);
 
 	if (ret) {
 		printf("File not found.\n");
@@ -1370,9 +1531,9 @@ int sqfs_read(const char *filename, void *buf, loff_t offset, loff_t len,
 		goto out;
 	}
 
-	i_number = dirs->dir_header->inode_number + dirs->entry->inode_offset;
-	ipos = sqfs_find_inode(dirs->inode_table, i_number, sblk->inodes,
-			       sblk->block_size);
+	ret = sqfs_read_inode(sqfs_entry_ref(dirs), true, (void **)&ipos);
+	if (ret)
+		goto out;
 
 	base = (struct squashfs_base_inode *)ipos;
 	switch (get_unaligned_le16(&base->inode_type)) {
@@ -1443,73 +1604,102 @@ int sqfs_read(const char *filename, void *buf, loff_t offset, loff_t len,
 		}
 	}
 
-	for (j = 0; j < datablk_count; j++) {
-		char *data_buffer;
+	for (j = 0; j < datablk_count && *actread < len; ) {
+		u32 blk_len = get_unaligned_le32(&sblk->block_size);
+		loff_t remaining = len - *actread;
+
+		/* Don't load any data for sparse blocks */
+		if (finfo.blk_sizes[j] == 0) {
+			sparse_size = min_t(loff_t, blk_len, remaining);
+			memset(buf + *actread, 0, sparse_size);
+			*actread += sparse_size;
+			j++;
+			continue;
+		}
 
-		start = lldiv(data_offset, ctxt.cur_dev->blksz);
 		table_size = SQFS_BLOCK_SIZE(finfo.blk_sizes[j]);
+
+		if (!SQFS_COMPRESSED_BLOCK(finfo.blk_sizes[j])) {
+			u64 run = 0;
+
+			/*
+			 * Uncompressed blocks are stored back to back, so read
+			 * the whole run straight into the caller's buffer and
+			 * let fs_devread() bounce only the unaligned ends.
+			 */
+			while (j < datablk_count && run < remaining &&
+			       run <= INT_MAX - blk_len &&
+			       finfo.blk_sizes[j] &&
+			       !SQFS_COMPRESSED_BLOCK(finfo.blk_sizes[j])) {
+				run += SQFS_BLOCK_SIZE(finfo.blk_sizes[j]);
+				j++;
+			}
+
+			if (run > remaining)
+				run = remaining;
+
+			ret = sqfs_read_direct(data_offset, run, buf + *actread);
+			if (ret)
+				goto out;
+
+			data_offset += run;
+			*actread += run;
+			continue;
+		}
+
+		start = lldiv(data_offset, ctxt.cur_dev->blksz);
 		table_offset = data_offset - (start * ctxt.cur_dev->blksz);
 		n_blks = DIV_ROUND_UP(table_size + table_offset,
 				      ctxt.cur_dev->blksz);
 
-		/* Don't load any data for sparse blocks */
-		if (finfo.blk_sizes[j] == 0) {
-			n_blks = 0;
-			table_offset = 0;
-			data_buffer = NULL;
-			data = NULL;
-		} else {
-			data_buffer = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
-
+		/* Compressed blocks never exceed block_size, reuse one buffer */
+		if (!data_buffer) {
+			data_buffer = malloc_cache_aligned(blk_len +
+							   2 * ctxt.cur_dev->blksz);
 			if (!data_buffer) {
 				ret = -ENOMEM;
 				goto out;
 			}
+		}
 
-			ret = sqfs_disk_read(start, n_blks, data_buffer);
-			if (ret < 0) {
-				/*
-				 * Possible causes: too many data blocks or too large
-				 * SquashFS block size. Tip: re-compile the SquashFS
-				 * image with mksquashfs's -b <block_size> option.
-				 */
-				printf("Error: too many data blocks to be read.\n");
-				goto out;
-			}
-
-			data = data_buffer + table_offset;
+		ret = sqfs_disk_read(start, n_blks, data_buffer);
+		if (ret < 0) {
+			/*
+			 * Possible causes: too many data blocks or too large
+			 * SquashFS block size. Tip: re-compile the SquashFS
+			 * image with mksquashfs's -b <block_size> option.
+			 */
+			printf("Error: too many data blocks to be read.\n");
+			goto out;
 		}
 
-		/* Load the data */
-		if (finfo.blk_sizes[j] == 0) {
-			/* This is a sparse block */
-			sparse_size = get_unaligned_le32(&sblk->block_size);
-			if ((*actread + sparse_size) > len)
-				sparse_size = len - *actread;
-			memset(buf + *actread, 0, sparse_size);
-			*actread += sparse_size;
-		} else if (SQFS_COMPRESSED_BLOCK(finfo.blk_sizes[j])) {
-			dest_len = get_unaligned_le32(&sblk->block_size);
+		data = data_buffer + table_offset;
+
+		/*
+		 * A full block fits in the destination, so decompress in
+		 * place; only the file's trailing partial block goes through
+		 * the temporary buffer.
+		 */
+		dest_len = blk_len;
+		if (remaining >= blk_len) {
+			ret = sqfs_decompress(&ctxt, buf + *actread, &dest_len,
+					      data, table_size);
+			if (ret)
+				goto out;
+		} else {
 			ret = sqfs_decompress(&ctxt, datablock, &dest_len,
 					      data, table_size);
 			if (ret)
 				goto out;
 
-			if ((*actread + dest_len) > len)
-				dest_len = len - *actread;
+			if (dest_len > remaining)
+				dest_len = remaining;
 			memcpy(buf + *actread, datablock, dest_len);
-			*actread += dest_len;
-		} else {
-			if ((*actread + table_size) > len)
-				table_size = len - *actread;
-			memcpy(buf + *actread, data, table_size);
-			*actread += table_size;
 		}
 
+		*actread += dest_len;
 		data_offset += table_size;
-		free(data_buffer);
-		if (*actread >= len)
-			break;
+		j++;
 	}
 
 	/*
@@ -1520,53 +1710,22 @@ int sqfs_read(const char *filename, void *buf, loff_t offset, loff_t len,
 		goto out;
 	}
 
-	start = lldiv(frag_entry.start, ctxt.cur_dev->blksz);
-	table_size = SQFS_BLOCK_SIZE(frag_entry.size);
-	table_offset = frag_entry.start - (start * ctxt.cur_dev->blksz);
-	n_blks = DIV_ROUND_UP(table_size + table_offset, ctxt.cur_dev->blksz);
-
-	fragment = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
-
-	if (!fragment) {
-		ret = -ENOMEM;
+	ret = sqfs_get_fragment(&frag_entry, &fragment);
+	if (ret)
 		goto out;
-	}
 
-	ret = sqfs_disk_read(start, n_blks, fragment);
-	if (ret < 0)
+	if (finfo.offset + finfo.size - *actread > fragment->len) {
+		ret = -EINVAL;
 		goto out;
-
-	/* File compressed and fragmented */
-	if (finfo.frag && finfo.comp) {
-		dest_len = get_unaligned_le32(&sblk->block_size);
-		fragment_block = malloc(dest_len);
-		if (!fragment_block) {
-			ret = -ENOMEM;
-			goto out;
-		}
-
-		ret = sqfs_decompress(&ctxt, fragment_block, &dest_len,
-				      (void *)fragment  + table_offset,
-				      frag_entry.size);
-		if (ret) {
-			free(fragment_block);
-			goto out;
-		}
-
-		memcpy(buf + *actread, &fragment_block[finfo.offset], finfo.size - *actread);
-		*actread = finfo.size;
-
-		free(fragment_block);
-
-	} else if (finfo.frag && !finfo.comp) {
-		fragment_block = (void *)fragment + table_offset;
-
-		memcpy(buf + *actread, &fragment_block[finfo.offset], finfo.size - *actread);
-		*actread = finfo.size;
 	}
 
+	memcpy(buf + *actread, fragment->data + finfo.offset,
+	       finfo.size - *actread);
+	*actread = finfo.size;
+
 out:
-	free(fragment);
+	free(ipos);
+	free(data_buffer);
 	free(datablock);
 	free(file);
 	free(dir);
@@ -1578,7 +1737,6 @@ out:
 
 int sqfs_size(const char *filename, loff_t *size)
 {
-	struct squashfs_super_block *sblk = ctxt.sblk;
 	struct squashfs_symlink_inode *symlink;
 	struct fs_dir_stream *dirsp = NULL;
 	struct squashfs_base_inode *base;
@@ -1586,9 +1744,8 @@ int sqfs_size(const char *filename, loff_t *size)
 	struct squashfs_lreg_inode *lreg;
 	struct squashfs_reg_inode *reg;
 	char *dir, *file, *resolved;
-	struct fs_dirent *dent;
-	unsigned char *ipos;
-	int ret, i_number;
+	unsigned char *ipos = NULL;
+	int ret;
 
 	sqfs_split_path(&file, &dir, filename);
 	/*
@@ -1603,13 +1760,7 @@ int sqfs_size(const char *filename, loff_t *size)
 
 	dirs = (struct squashfs_dir_stream *)dirsp;
 
-	while (!sqfs_readdir(dirsp, &dent)) {
-		ret = strcmp(dent->name, file);
-		if (!ret)
-			break;
-		free(dirs->entry);
-		dirs->entry = NULL;
-	}
+	ret = sqfs_find_entry(dirs, file);
 
 	if (ret) {
 		printf("File not found.\n");
@@ -1618,11 +1769,11 @@ int sqfs_size(const char *filename, loff_t *size)
 		goto free_strings;
 	}
 
-	i_number = dirs->dir_header->inode_number + dirs->entry->inode_offset;
-	ipos = sqfs_find_inode(dirs->inode_table, i_number, sblk->inodes,
-			       sblk->block_size);
+	ret = sqfs_read_inode(sqfs_entry_ref(dirs), true, (void **)&ipos);
 	free(dirs->entry);
 	dirs->entry = NULL;
+	if (ret)
+		goto free_strings;
 
 	base = (struct squashfs_base_inode *)ipos;
 	switch (get_unaligned_le16(&base->inode_type)) {
@@ -1657,6 +1808,7 @@ int sqfs_size(const char *filename, loff_t *size)
 	}
 
 free_strings:
+	free(ipos);
 	free(dir);
 	free(file);
 
@@ -1670,7 +1822,6 @@ int sqfs_exists(const char *filename)
 	struct fs_dir_stream *dirsp = NULL;
 	struct squashfs_dir_stream *dirs;
 	char *dir, *file;
-	struct fs_dirent *dent;
 	int ret;
 
 	sqfs_split_path(&file, &dir, filename);
@@ -1686,13 +1837,7 @@ int sqfs_exists(const char *filename)
 
 	dirs = (struct squashfs_dir_stream *)dirsp;
 
-	while (!sqfs_readdir(dirsp, &dent)) {
-		ret = strcmp(dent->name, file);
-		if (!ret)
-			break;
-		free(dirs->entry);
-		dirs->entry = NULL;
-	}
+	ret = sqfs_find_entry(dirs, file);
 
 	sqfs_closedir(dirsp);
 
@@ -1705,6 +1850,7 @@ free_strings:
 
 void sqfs_close(void)
 {
+	sqfs_cache_cleanup();
 	sqfs_decompressor_cleanup(&ctxt);
 	free(ctxt.sblk);
 	ctxt.sblk = NULL;
@@ -1719,7 +1865,7 @@ void sqfs_closedir(struct fs_dir_stream *dirs)
 		return;
 
 	sqfs_dirs = (struct squashfs_dir_stream *)dirs;
-	free(sqfs_dirs->inode_table);
+	free(sqfs_dirs->entry);
 	free(sqfs_dirs->dir_table);
 	free(sqfs_dirs->dir_header);
 	free(sqfs_dirs);
@@ -264,19 +264,19 @@ struct squashfs_dir_stream {
 	struct squashfs_directory_header *dir_header;
 	struct squashfs_directory_entry *entry;
 	/*
-	 * 'table' points to a position into the directory table. Both 'table'
-	 * and 'inode' are defined for the first time in sqfs_opendir().
-	 * 'table's value changes in sqfs_readdir().
+	 * 'table' points to a position into the directory listing. Both
+	 * 'table' and 'inode' are defined for the first time in
+	 * sqfs_opendir(). 'table's value changes in sqfs_readdir().
 	 */
 	unsigned char *table;
 	union squashfs_inode i;
 	struct squashfs_dir_inode i_dir;
 	struct squashfs_ldir_inode i_ldir;
 	/*
-	 * References to the tables' beginnings. They are assigned in
-	 * sqfs_opendir() and freed in sqfs_closedir().
+	 * Listing of the directory being read, only as much of the directory
+	 * table as this directory uses. It is assigned in sqfs_opendir() and
+	 * freed in sqfs_closedir().
 	 */
-	unsigned char *inode_table;
 	unsigned char *dir_table;
 };
 
@@ -295,10 +295,9 @@ struct squashfs_file_info {
 	bool comp;
 };
 
-void *sqfs_find_inode(void *inode_table, int inode_number, __le32 inode_count,
-		      __le32 block_size);
+int sqfs_inode_size(struct squashfs_base_inode *inode, u32 blk_size);
 
-int sqfs_dir_offset(void *dir_i, u32 *m_list, int m_count);
+int sqfs_inode_base_size(u16 type);
 
 int sqfs_read_metablock(unsigned char *file_mapping, int offset,
 			bool *compressed, u32 *data_size);
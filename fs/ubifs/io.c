@@ -87,6 +87,106 @@ void ubifs_ro_mode(struct ubifs_info *c, int err)
 	}
 }
 
+/*
+ * LEB read cache.
+ *
+ * Index and data nodes are each fetched with their own ubi_read(), which on
+ * NAND means one or more page reads per node. Nodes written together, such
+ * as the data nodes of a file, are mostly laid out one after the other, so a
+ * missed read fetches a window of CONFIG_UBIFS_READAHEAD_SIZE bytes starting
+ * at the request and the following nodes are then copied from memory.
+ */
+struct ubifs_leb_cache {
+	const struct ubifs_info *c;
+	int lnum;
+	int offs;
+	int len;
+	unsigned long stamp;
+	void *buf;
+};
+
+static struct ubifs_leb_cache leb_cache[CONFIG_UBIFS_READ_CACHE_ENTRIES];
+static unsigned long leb_cache_clock;
+
+/**
+ * ubifs_leb_cache_drop - forget cached data of a LEB.
+ * @c: UBIFS file-system description object
+ * @lnum: LEB number, or %-1 to drop every LEB of @c
+ */
+void ubifs_leb_cache_drop(const struct ubifs_info *c, int lnum)
+{
+	int i;
+
+	for (i = 0; i < CONFIG_UBIFS_READ_CACHE_ENTRIES; i++)
+		if (leb_cache[i].c == c &&
+		    (lnum < 0 || leb_cache[i].lnum == lnum))
+			leb_cache[i].c = NULL;
+}
+
+/**
+ * ubifs_leb_cache_free - drop all cached data and release the buffers.
+ */
+void ubifs_leb_cache_free(void)
+{
+	int i;
+
+	for (i = 0; i < CONFIG_UBIFS_READ_CACHE_ENTRIES; i++)
+		free(leb_cache[i].buf);
+	memset(leb_cache, 0, sizeof(leb_cache));
+	leb_cache_clock = 0;
+}
+
+/*
+ * Serve a read from the cache, filling the least recently used window on a
+ * miss. Returns %0 if @buf was filled, otherwise the caller reads directly.
+ */
+static int ubifs_leb_cache_read(const struct ubifs_info *c, int lnum,
+				void *buf, int offs, int len)
+{
+	struct ubifs_leb_cache *e, *lru = &leb_cache[0];
+	int i, start, end, err;
+
+	if (!CONFIG_UBIFS_READAHEAD_SIZE || len >= CONFIG_UBIFS_READAHEAD_SIZE)
+		return -EINVAL;
+
+	for (i = 0; i < CONFIG_UBIFS_READ_CACHE_ENTRIES; i++) {
+		e = &leb_cache[i];
+		if (e->c == c && e->lnum == lnum && offs >= e->offs &&
+		    offs + len <= e->offs + e->len) {
+			memcpy(buf, e->buf + offs - e->offs, len);
+			e->stamp = ++leb_cache_clock;
+			return 0;
+		}
+		if (e->stamp < lru->stamp)
+			lru = e;
+	}
+
+	start = round_down(offs, c->min_io_size);
+	end = min(start + CONFIG_UBIFS_READAHEAD_SIZE, c->leb_size);
+	if (offs + len > end)
+		return -EINVAL;
+
+	if (!lru->buf) {
+		lru->buf = malloc(CONFIG_UBIFS_READAHEAD_SIZE);
+		if (!lru->buf)
+			return -ENOMEM;
+	}
+
+	lru->c = NULL;
+	lru->stamp = 0;
+	err = ubi_read(c->ubi, lnum, lru->buf, start, end - start);
+	if (err)
+		return err;
+
+	lru->c = c;
+	lru->lnum = lnum;
+	lru->offs = start;
+	lru->len = end - start;
+	lru->stamp = ++leb_cache_clock;
+	memcpy(buf, lru->buf + offs - start, len);
+	return 0;
+}
+
 /*
  * Below are simple wrappers over UBI I/O functions which include some
  * additional checks and UBIFS debugging stuff. See corresponding UBI function
@@ -98,6 +198,13 @@ int ubifs_leb_read(const struct ubifs_info *c, int lnum, void *buf, int offs,
 {
 	int err;
 
+	/*
+	 * A failed window read, e.g. due to an ECC error outside of the
+	 * requested range, is retried on the exact range below.
+	 */
+	if (!ubifs_leb_cache_read(c, lnum, buf, offs, len))
+		return 0;
+
 	err = ubi_read(c->ubi, lnum, buf, offs, len);
 	/*
 	 * In case of %-EBADMSG print the error message only if the
@@ -119,6 +226,7 @@ int ubifs_leb_write(struct ubifs_info *c, int lnum, const void *buf, int offs,
 	ubifs_assert(!c->ro_media && !c->ro_mount);
 	if (c->ro_error)
 		return -EROFS;
+	ubifs_leb_cache_drop(c, lnum);
 	if (!dbg_is_tst_rcvry(c))
 		err = ubi_leb_write(c->ubi, lnum, buf, offs, len);
 #ifndef __UBOOT__
@@ -141,6 +249,7 @@ int ubifs_leb_change(struct ubifs_info *c, int lnum, const void *buf, int len)
 	ubifs_assert(!c->ro_media && !c->ro_mount);
 	if (c->ro_error)
 		return -EROFS;
+	ubifs_leb_cache_drop(c, lnum);
 	if (!dbg_is_tst_rcvry(c))
 		err = ubi_leb_change(c->ubi, lnum, buf, len);
 #ifndef __UBOOT__
@@ -163,6 +272,7 @@ int ubifs_leb_unmap(struct ubifs_info *c, int lnum)
 	ubifs_assert(!c->ro_media && !c->ro_mount);
 	if (c->ro_error)
 		return -EROFS;
+	ubifs_leb_cache_drop(c, lnum);
 	if (!dbg_is_tst_rcvry(c))
 		err = ubi_leb_unmap(c->ubi, lnum);
 #ifndef __UBOOT__
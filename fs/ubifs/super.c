@@ -1757,6 +1757,7 @@ void ubifs_umount(struct ubifs_info *c)
 	kfree(c->bottom_up_buf);
 	ubifs_debugging_exit(c);
 #ifdef __UBOOT__
+	ubifs_leb_cache_free();
 	ubi_close_volume(c->ubi);
 	mutex_unlock(&c->umount_mutex);
 	/* Finally free U-Boot's global copy of superblock */
@@ -2700,6 +2701,7 @@ int uboot_ubifs_mount(char *vol_name)
 	 */
 	if (ubifs_sb)
 		ubifs_umount(ubifs_sb->s_fs_info);
+	ubifs_leb_cache_free();
 
 	/*
 	 * Mount in read-only mode
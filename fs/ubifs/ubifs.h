@@ -2089,6 +2089,8 @@ int ubifs_leb_write(struct ubifs_info *c, int lnum, const void *buf, int offs,
 int ubifs_leb_change(struct ubifs_info *c, int lnum, const void *buf, int len);
 int ubifs_leb_unmap(struct ubifs_info *c, int lnum);
 int ubifs_leb_map(struct ubifs_info *c, int lnum);
+void ubifs_leb_cache_drop(const struct ubifs_info *c, int lnum);
+void ubifs_leb_cache_free(void);
 int ubifs_is_mapped(const struct ubifs_info *c, int lnum);
 int ubifs_wbuf_write_nolock(struct ubifs_wbuf *wbuf, void *buf, int len);
 int ubifs_wbuf_seek_nolock(struct ubifs_wbuf *wbuf, int lnum, int offs);
@@ -84,6 +84,8 @@ struct blk_desc {
 	lbaint_t	lba;		/* number of blocks */
 	unsigned long	blksz;		/* block size */
 	int		log2blksz;	/* for convenience: log2(blksz) */
+	/* preferred buffer alignment, 0 for ARCH_DMA_MINALIGN */
+	unsigned long	dma_align;
 	char		vendor[BLK_VEN_SIZE + 1]; /* device vendor string */
 	char		product[BLK_PRD_SIZE + 1]; /* device product number */
 	char		revision[BLK_REV_SIZE + 1]; /* firmware revision */
@@ -170,10 +172,13 @@ void blkcache_invalidate(int iftype, int dev);
 /**
  * blkcache_configure() - configure block cache
  *
- * @param blocks - maximum blocks per entry
+ * Changing any of the limits discards the contents of the cache.
+ *
+ * @param blocks - maximum blocks per entry, rounded down to a power of two
  * @param entries - maximum entries in cache
+ * @param max_bytes - maximum memory used for cached data, in bytes
  */
-void blkcache_configure(unsigned blocks, unsigned entries);
+void blkcache_configure(unsigned blocks, unsigned entries, ulong max_bytes);
 
 /*
  * statistics of the block cache
@@ -181,9 +186,12 @@ void blkcache_configure(unsigned blocks, unsigned entries);
 struct block_cache_stats {
 	unsigned hits;
 	unsigned misses;
+	unsigned evictions;
 	unsigned entries; /* current entry count */
+	ulong bytes; /* current memory used for cached data */
 	unsigned max_blocks_per_entry;
 	unsigned max_entries;
+	ulong max_bytes;
 };
 
 /**
@@ -193,6 +201,17 @@ struct block_cache_stats {
  */
 void blkcache_stats(struct block_cache_stats *stats);
 
+/**
+ * blkcache_dev_stats() - return statistics for one device and reset
+ *
+ * @param iftype - IF_TYPE_x for type of device
+ * @param dev - device index of particular type
+ * @param stats - statistics are copied here
+ *
+ * Return: 0 if OK, -ENOENT if nothing was ever cached for the device
+ */
+int blkcache_dev_stats(int iftype, int dev, struct block_cache_stats *stats);
+
 #else
 
 static inline int blkcache_read(int iftype, int dev,
@@ -210,9 +229,27 @@ static inline void blkcache_invalidate(int iftype, int dev) {}
 
 #endif
 
+/**
+ * blk_note_change() - record that the contents of a block device changed
+ *
+ * This is called on every write and erase, and when a block device goes
+ * away, so that anything holding on to data read from a device (such as a
+ * mounted filesystem) can tell that it may be stale.
+ */
+void blk_note_change(void);
+
+/**
+ * blk_get_change_count() - get the number of block-device changes so far
+ *
+ * Return: a counter which is bumped by each call to blk_note_change()
+ */
+ulong blk_get_change_count(void);
+
 #if CONFIG_IS_ENABLED(BLK)
 struct udevice;
 
+struct blk_request;
+
 /* Operations on block devices */
 struct blk_ops {
 	/**
@@ -271,6 +308,30 @@ struct blk_ops {
 	 * @return 0 if OK, -ve on error
 	 */
 	int (*select_hwpart)(struct udevice *dev, int hwpart);
+
+	/**
+	 * submit() - start an asynchronous request
+	 *
+	 * This is optional. The driver starts the transfer and returns
+	 * without waiting for it to finish. When it finishes, the driver
+	 * calls blk_complete_request() from its poll() method.
+	 *
+	 * @dev:	Device to use
+	 * @req:	Request to start
+	 * @return 0 if OK, -EBUSY if the device cannot accept another
+	 * request until one completes, other -ve on error
+	 */
+	int (*submit)(struct udevice *dev, struct blk_request *req);
+
+	/**
+	 * poll() - make progress on outstanding asynchronous requests
+	 *
+	 * This must be provided if submit() is. It must not block.
+	 *
+	 * @dev:	Device to poll
+	 * @return number of requests completed, or -ve on error
+	 */
+	int (*poll)(struct udevice *dev);
 };
 
 #define blk_get_ops(dev)	((struct blk_ops *)(dev)->driver->ops)
@@ -288,6 +349,44 @@ unsigned long blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 unsigned long blk_derase(struct blk_desc *block_dev, lbaint_t start,
 			 lbaint_t blkcnt);
 
+/**
+ * struct blk_readahead_stats - readahead statistics for a block device
+ *
+ * @issued: Number of blocks read from the device ahead of being requested
+ * @hits: Number of requested blocks which were found in the readahead buffer
+ * @wasted: Number of prefetched blocks which were discarded without being
+ *	requested
+ */
+struct blk_readahead_stats {
+	ulong issued;
+	ulong hits;
+	ulong wasted;
+};
+
+/**
+ * blk_set_readahead() - set the readahead window for a block device
+ *
+ * Once a device sees two consecutive reads, each read smaller than the
+ * window is extended to cover the whole window and the extra blocks are
+ * kept for subsequent reads. Any buffered data is discarded and the
+ * statistics are reset.
+ *
+ * @dev:	Block device to update
+ * @size:	Window size in bytes, 0 to disable readahead
+ * Return: 0 if OK, -ENOSYS if readahead is not supported
+ */
+int blk_set_readahead(struct udevice *dev, ulong size);
+
+/**
+ * blk_get_readahead_stats() - get readahead statistics for a block device
+ *
+ * @dev:	Block device to check
+ * @stats:	Returns the statistics
+ * Return: 0 if OK, -ENOSYS if readahead is not supported
+ */
+int blk_get_readahead_stats(struct udevice *dev,
+			    struct blk_readahead_stats *stats);
+
 /**
  * blk_find_device() - Find a block device
  *
@@ -483,6 +582,7 @@ static inline ulong blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 			       lbaint_t blkcnt, const void *buffer)
 {
 	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+	blk_note_change();
 	return block_dev->block_write(block_dev, start, blkcnt, buffer);
 }
 
@@ -490,6 +590,7 @@ static inline ulong blk_derase(struct blk_desc *block_dev, lbaint_t start,
 			       lbaint_t blkcnt)
 {
 	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+	blk_note_change();
 	return block_dev->block_erase(block_dev, start, blkcnt);
 }
 
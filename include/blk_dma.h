@@ -0,0 +1,49 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Buffers for block-device transfers
+ */
+
+#ifndef BLK_DMA_H
+#define BLK_DMA_H
+
+#include <blk.h>
+#include <memalign.h>
+#include <linux/kernel.h>
+
+/**
+ * blk_dma_align() - get the preferred buffer alignment for a block device
+ *
+ * Buffers with this alignment, and a size which is a multiple of it, can be
+ * handed to the device without the driver having to bounce them. This is
+ * never less than ARCH_DMA_MINALIGN.
+ *
+ * @desc:	Block device descriptor, or NULL for the default alignment
+ * Return: alignment in bytes (a power of two)
+ */
+static inline ulong blk_dma_align(struct blk_desc *desc)
+{
+	if (desc && desc->dma_align > ARCH_DMA_MINALIGN)
+		return desc->dma_align;
+
+	return ARCH_DMA_MINALIGN;
+}
+
+/**
+ * blk_dma_alloc() - allocate a buffer suitable for block-device transfers
+ *
+ * The buffer is aligned to blk_dma_align() and its size is rounded up to a
+ * multiple of that, so that cache maintenance on it cannot affect other data.
+ * Free it with free().
+ *
+ * @desc:	Block device descriptor, or NULL for the default alignment
+ * @size:	Minimum number of bytes to allocate
+ * Return: pointer to the buffer, or NULL if out of memory
+ */
+static inline void *blk_dma_alloc(struct blk_desc *desc, size_t size)
+{
+	ulong align = blk_dma_align(desc);
+
+	return memalign(align, ALIGN(size, align));
+}
+
+#endif
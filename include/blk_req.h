@@ -0,0 +1,113 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Asynchronous block-device requests
+ */
+
+#ifndef BLK_REQ_H
+#define BLK_REQ_H
+
+#include <blk.h>
+#include <linux/list.h>
+
+struct udevice;
+struct blk_request;
+
+/**
+ * enum blk_req_op - operation requested by a struct blk_request
+ *
+ * @BLK_REQ_READ:	Read blocks from the device
+ * @BLK_REQ_WRITE:	Write blocks to the device
+ */
+enum blk_req_op {
+	BLK_REQ_READ,
+	BLK_REQ_WRITE,
+};
+
+/**
+ * blk_req_complete_t - function called when a request completes
+ *
+ * @req:	Request which completed. Its @result and @done fields are
+ *		valid
+ */
+typedef void (*blk_req_complete_t)(struct blk_request *req);
+
+/**
+ * struct blk_request - an asynchronous block-device request
+ *
+ * The caller fills in the fields up to @priv and passes the request to
+ * blk_submit(). The request must stay valid until it has completed.
+ *
+ * @op:		Operation to perform
+ * @start:	Start block number (0=first)
+ * @blkcnt:	Number of blocks to transfer
+ * @buffer:	Buffer to transfer to or from
+ * @complete:	Function to call when the request completes, or NULL
+ * @priv:	Private data for use by the caller
+ * @dev:	Block device which the request was submitted to
+ * @result:	Number of blocks transferred, or -ve error number, set when
+ *		the request completes
+ * @done:	true once the request has completed
+ * @node:	For use by the driver while the request is in flight
+ * @drv_priv:	For use by the driver while the request is in flight
+ */
+struct blk_request {
+	enum blk_req_op op;
+	lbaint_t start;
+	lbaint_t blkcnt;
+	void *buffer;
+	blk_req_complete_t complete;
+	void *priv;
+
+	struct udevice *dev;
+	long result;
+	bool done;
+	struct list_head node;
+	void *drv_priv;
+};
+
+/**
+ * blk_submit() - submit an asynchronous request to a block device
+ *
+ * Drivers which do not support asynchronous requests perform the transfer
+ * before this function returns, so @req may already be complete on return.
+ * Otherwise the transfer continues in the background and progresses each
+ * time blk_poll() or blk_wait() is called.
+ *
+ * @dev:	Block device to use
+ * @req:	Request to submit, with fields up to @priv filled in
+ * Return: 0 if OK, -ve on error, in which case @req is not submitted
+ */
+int blk_submit(struct udevice *dev, struct blk_request *req);
+
+/**
+ * blk_poll() - make progress on a block device's asynchronous requests
+ *
+ * Completion functions of any requests which finish are called from here.
+ *
+ * @dev:	Block device to poll
+ * Return: number of requests completed, or -ve on error
+ */
+int blk_poll(struct udevice *dev);
+
+/**
+ * blk_wait() - wait for an asynchronous request to complete
+ *
+ * @dev:	Block device the request was submitted to
+ * @req:	Request to wait for
+ * Return: 0 if all blocks were transferred, -EIO if only some were,
+ *	other -ve on error
+ */
+int blk_wait(struct udevice *dev, struct blk_request *req);
+
+/**
+ * blk_complete_request() - mark an asynchronous request as complete
+ *
+ * This is for use by drivers. It records the result and calls the
+ * request's completion function.
+ *
+ * @req:	Request which has completed
+ * @result:	Number of blocks transferred, or -ve error number
+ */
+void blk_complete_request(struct blk_request *req, long result);
+
+#endif
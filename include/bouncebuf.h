@@ -83,4 +83,28 @@ int bounce_buffer_start_extalign(struct bounce_buffer *state, void *data,
  */
 int bounce_buffer_stop(struct bounce_buffer *state);
 
+/**
+ * struct bounce_buffer_stats - bounce buffer usage counters
+ *
+ * @sessions:	Number of bounce_buffer_start() calls
+ * @bounced:	Number of sessions which had to allocate a bounce buffer
+ * @bytes:	Number of bytes which went through a bounce buffer
+ */
+struct bounce_buffer_stats {
+	ulong sessions;
+	ulong bounced;
+	ulong bytes;
+};
+
+/**
+ * bounce_buffer_get_stats() -- Get the bounce buffer usage counters
+ * stats:	returns the counters accumulated since the last reset
+ */
+void bounce_buffer_get_stats(struct bounce_buffer_stats *stats);
+
+/**
+ * bounce_buffer_reset_stats() -- Reset the bounce buffer usage counters
+ */
+void bounce_buffer_reset_stats(void);
+
 #endif
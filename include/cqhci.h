@@ -0,0 +1,146 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Command Queue Host Controller Interface (CQHCI) as defined in the
+ * JEDEC eMMC 5.1 specification
+ */
+
+#ifndef __CQHCI_H
+#define __CQHCI_H
+
+#include <linux/bitops.h>
+#include <linux/types.h>
+
+/* registers */
+#define CQHCI_VER		0x00
+#define CQHCI_CAP		0x04
+#define CQHCI_CFG		0x08
+#define  CQHCI_DCMD		BIT(12)
+#define  CQHCI_TASK_DESC_SZ	BIT(8)
+#define  CQHCI_ENABLE		BIT(0)
+#define CQHCI_CTL		0x0c
+#define  CQHCI_CLEAR_ALL_TASKS	BIT(8)
+#define  CQHCI_HALT		BIT(0)
+#define CQHCI_IS		0x10
+#define  CQHCI_IS_HAC		BIT(0)
+#define  CQHCI_IS_TCC		BIT(1)
+#define  CQHCI_IS_RED		BIT(2)
+#define  CQHCI_IS_TCL		BIT(3)
+#define  CQHCI_IS_GCE		BIT(4)
+#define  CQHCI_IS_ICCE		BIT(5)
+#define  CQHCI_IS_ERROR		(CQHCI_IS_RED | CQHCI_IS_GCE | CQHCI_IS_ICCE)
+#define  CQHCI_IS_MASK		(CQHCI_IS_TCC | CQHCI_IS_ERROR)
+#define CQHCI_ISTE		0x14
+#define CQHCI_ISGE		0x18
+#define CQHCI_IC		0x1c
+#define CQHCI_TDLBA		0x20
+#define CQHCI_TDLBAU		0x24
+#define CQHCI_TDBR		0x28
+#define CQHCI_TCN		0x2c
+#define CQHCI_DQS		0x30
+#define CQHCI_DPT		0x34
+#define CQHCI_TCLR		0x38
+#define CQHCI_SSC1		0x40
+#define CQHCI_SSC2		0x44
+#define CQHCI_CRDCT		0x48
+#define CQHCI_RMEM		0x50
+#define CQHCI_TERRI		0x54
+#define  CQHCI_TERRI_C_TASK(x)	(((x) >> 8) & 0x1f)
+#define  CQHCI_TERRI_C_VALID	BIT(15)
+#define  CQHCI_TERRI_D_TASK(x)	(((x) >> 24) & 0x1f)
+#define  CQHCI_TERRI_D_VALID	BIT(31)
+#define CQHCI_CRI		0x58
+#define CQHCI_CRA		0x5c
+
+/* task descriptor fields */
+#define CQHCI_VALID(x)		(((x) & 1) << 0)
+#define CQHCI_END(x)		(((x) & 1) << 1)
+#define CQHCI_INT(x)		(((x) & 1) << 2)
+#define CQHCI_ACT(x)		(((x) & 0x7) << 3)
+#define CQHCI_FORCED_PROG(x)	(((x) & 1) << 6)
+#define CQHCI_DATA_DIR(x)	(((x) & 1) << 12)
+#define CQHCI_BLK_COUNT(x)	(((x) & 0xffff) << 16)
+#define CQHCI_BLK_ADDR(x)	(((u64)(x) & 0xffffffff) << 32)
+
+#define CQHCI_NUM_SLOTS		32
+
+struct sdhci_host;
+struct mmc;
+struct mmc_cqe_task;
+
+/**
+ * struct cqhci_host - state of a command queue engine
+ *
+ * @host:	SDHCI host the engine belongs to
+ * @mmio:	Base address of the CQHCI registers
+ * @dma64:	true if the engine uses 64-bit DMA addresses
+ * @slot_sz:	Size of a task descriptor plus its link descriptor
+ * @trans_desc_len: Size of a transfer descriptor
+ * @max_trans:	Number of transfer descriptors available to each task
+ * @desc_base:	Task descriptor list, one slot per tag
+ * @trans_base:	Transfer descriptors, @max_trans per tag
+ * @busy:	Tags which have been queued but not completed
+ * @dma_addr:	DMA address of the data buffer of each busy tag
+ * @dma_len:	Length of the data buffer of each busy tag
+ * @dma_write:	Whether each busy tag writes to the card
+ */
+struct cqhci_host {
+	struct sdhci_host *host;
+	void *mmio;
+	bool dma64;
+	uint slot_sz;
+	uint trans_desc_len;
+	uint max_trans;
+	u8 *desc_base;
+	u8 *trans_base;
+	u32 busy;
+	dma_addr_t dma_addr[CQHCI_NUM_SLOTS];
+	size_t dma_len[CQHCI_NUM_SLOTS];
+	bool dma_write[CQHCI_NUM_SLOTS];
+};
+
+/**
+ * cqhci_init() - Set up the command queue engine of an SDHCI host
+ *
+ * This must be called after sdhci_setup_cfg(), since the DMA mode of the
+ * host selects the descriptor format.
+ *
+ * @host:	SDHCI host the engine belongs to
+ * @mmio:	Base address of the CQHCI registers
+ * Return: 0 if OK, -ve on error
+ */
+int cqhci_init(struct sdhci_host *host, void *mmio);
+
+/**
+ * cqhci_enable() - Switch the engine on or off
+ *
+ * Disabling the engine halts it and discards any tasks still queued.
+ *
+ * @cq_host:	Command queue engine
+ * @mmc:	MMC device the engine talks to
+ * @enable:	true to enable the engine, false to disable it
+ * Return: queue depth if enabled, 0 if disabled, -ve on error
+ */
+int cqhci_enable(struct cqhci_host *cq_host, struct mmc *mmc, bool enable);
+
+/**
+ * cqhci_submit() - Queue a data transfer
+ *
+ * @cq_host:	Command queue engine
+ * @tag:	Free task tag to use
+ * @task:	Transfer to queue
+ * Return: 0 if OK, -ve on error
+ */
+int cqhci_submit(struct cqhci_host *cq_host, uint tag,
+		 const struct mmc_cqe_task *task);
+
+/**
+ * cqhci_poll() - Collect completed tasks
+ *
+ * @cq_host:	Command queue engine
+ * @done:	Returns a bitmask of the tags which completed
+ * @failed:	Returns a bitmask of the tags in @done which failed
+ * Return: 0 if OK, -ve if the engine reported an error not tied to a task
+ */
+int cqhci_poll(struct cqhci_host *cq_host, u32 *done, u32 *failed);
+
+#endif /* __CQHCI_H */
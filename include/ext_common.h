@@ -198,11 +198,20 @@ struct ext2_dirent {
 	__u8 filetype;
 };
 
+/* A run of file blocks which are contiguous on disk */
+struct ext4_extent_run {
+	uint32_t lblk;		/* first logical block */
+	uint32_t len;		/* number of blocks */
+	uint64_t pblk;		/* first physical block, 0 for a hole */
+};
+
 struct ext2fs_node {
 	struct ext2_data *data;
 	struct ext2_inode inode;
 	int ino;
 	int inode_read;
+	struct ext4_extent_run *runs;	/* extent map, NULL if not loaded */
+	int nr_runs;
 };
 
 /* Information about a "mounted" ext2 filesystem. */
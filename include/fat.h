@@ -31,6 +31,13 @@ struct disk_partition;
 #define FAT16BUFSIZE	(FATBUFSIZE/2)
 #define FAT32BUFSIZE	(FATBUFSIZE/4)
 
+/* Number of FATBUFSIZE windows of the FAT kept in memory */
+#if CONFIG_IS_ENABLED(FS_FAT)
+#define FAT_CACHE_WINDOWS	CONFIG_VAL(FS_FAT_CACHE_WINDOWS)
+#else
+#define FAT_CACHE_WINDOWS	1
+#endif
+
 /* Maximum number of entry for long file name according to spec */
 #define MAX_LFN_SLOT	20
 
@@ -168,11 +175,16 @@ typedef struct dir_slot {
  * (see FAT32 accesses)
  */
 typedef struct {
-	__u8	*fatbuf;	/* Current FAT buffer */
+	__u8	*fatbuf;	/* Current FAT buffer, within fatcache */
+	__u8	*fatcache;	/* FAT_CACHE_WINDOWS buffers of FATBUFSIZE */
+	int	fatcachenum[FAT_CACHE_WINDOWS];	/* Window in each, or -1 */
+	uint	fatcacheused[FAT_CACHE_WINDOWS]; /* Last use of each buffer */
+	uint	fatcachetick;	/* Incremented on each window switch */
 	int	fatsize;	/* Size of FAT in bits */
 	__u32	fatlength;	/* Length of FAT in sectors */
 	__u16	fat_sect;	/* Starting sector of the FAT */
-	__u8	fat_dirty;      /* Set if fatbuf has been modified */
+	__u8	fat_dirty;      /* Set if any FAT buffer has been modified */
+	__u8	fatcachedirty[FAT_CACHE_WINDOWS]; /* Dirty sectors in each */
 	__u32	rootdir_sect;	/* Start sector of root directory */
 	__u16	sect_size;	/* Size of sectors in bytes */
 	__u16	clust_size;	/* Size of clusters in sectors */
@@ -182,6 +194,7 @@ typedef struct {
 	__u32	root_cluster;	/* First cluster of root dir for FAT32 */
 	u32	total_sect;	/* Number of sectors */
 	int	fats;		/* Number of FATs */
+	__u32	next_free;	/* Where to look for free clusters, 0 if unknown */
 } fsdata;
 
 struct fat_itr;
@@ -21,6 +21,7 @@ struct cmd_tbl;
 #define FS_TYPE_SEMIHOSTING 8
 
 struct blk_desc;
+struct hash_algo;
 
 /**
  * do_fat_fsload - Run the fatload command
@@ -88,9 +89,47 @@ int fs_set_blk_dev_with_part(struct blk_desc *desc, int part);
  * Many file functions implicitly call fs_close(), e.g. fs_closedir(),
  * fs_exist(), fs_ln(), fs_ls(), fs_mkdir(), fs_read(), fs_size(), fs_write(),
  * fs_unlink().
+ *
+ * With CONFIG_FS_MOUNT_CACHE some filesystems stay mounted after this, so
+ * that selecting the same partition again does not need to probe it. See
+ * fs_invalidate_mount().
  */
 void fs_close(void);
 
+/**
+ * fs_invalidate_mount() - unmount a filesystem kept mounted by fs_close()
+ *
+ * This must be called by code which uses a filesystem driver directly
+ * rather than through fs_set_blk_dev(), since that changes the driver state
+ * behind the back of the kept mount. Changes to the underlying block device
+ * are noticed automatically.
+ */
+#if CONFIG_IS_ENABLED(FS_MOUNT_CACHE)
+void fs_invalidate_mount(void);
+#else
+static inline void fs_invalidate_mount(void) {}
+#endif
+
+/**
+ * fs_dma_alloc() - allocate a buffer to read files into
+ *
+ * The buffer is aligned and padded to suit the block device most recently
+ * selected with fs_set_blk_dev(), so that fs_read() into it can go straight
+ * to the device without bouncing. Free it with free().
+ *
+ * @size:	Minimum number of bytes to allocate
+ * Return: pointer to the buffer, or NULL if out of memory
+ */
+void *fs_dma_alloc(size_t size);
+
+/**
+ * fs_dma_align() - get the preferred alignment for fs_read() buffers
+ *
+ * Return: alignment in bytes for the block device most recently selected
+ * with fs_set_blk_dev(), or ARCH_DMA_MINALIGN if there is none
+ */
+ulong fs_dma_align(void);
+
 /**
  * fs_get_type() - Get type of current filesystem
  *
@@ -151,6 +190,48 @@ int fs_size(const char *filename, loff_t *size);
 int fs_read(const char *filename, ulong addr, loff_t offset, loff_t len,
 	    loff_t *actread);
 
+/**
+ * fs_read_hash() - read a file and hash it while it is loaded
+ *
+ * This works like fs_read(), but also feeds the data to @algo as it arrives,
+ * so that there is no need for a second pass over the loaded file. Drivers
+ * which can read at an offset are read in chunks of
+ * CONFIG_FS_LOAD_CHUNK_SIZE bytes, each hashed while still in the cache.
+ *
+ * @filename:	full path of the file to read from
+ * @addr:	address of the buffer to write to
+ * @offset:	offset in the file from where to start reading
+ * @len:	the number of bytes to read. Use 0 to read entire file.
+ * @algo:	progressive hash algorithm, see hash_progressive_lookup_algo()
+ * @digest:	returns the digest, must hold @algo->digest_size bytes
+ * @actread:	returns the actual number of bytes read
+ * Return:	0 if OK with valid *actread and @digest, -ve on error
+ */
+int fs_read_hash(const char *filename, ulong addr, loff_t offset, loff_t len,
+		 struct hash_algo *algo, u8 *digest, loff_t *actread);
+
+/**
+ * fs_read_decomp() - read a compressed file and decompress it while loading
+ *
+ * The compression is detected from the start of the file, which is then
+ * decompressed to @addr, using up to all the free memory there. Drivers
+ * which can read at an offset are read in chunks of
+ * CONFIG_FS_LOAD_CHUNK_SIZE bytes into a temporary buffer, so gzip and lz4
+ * files are never held in memory as a whole. Otherwise the whole compressed
+ * file is read to the top of the free memory and the output must fit below
+ * it.
+ *
+ * @filename:	full path of the file to read from
+ * @addr:	address of the buffer to decompress to
+ * @offset:	offset in the file from where to start reading
+ * @len:	the number of bytes to read. Use 0 to read entire file.
+ * @actread:	returns the actual number of (compressed) bytes read
+ * @unc_size:	returns the number of uncompressed bytes
+ * Return:	0 if OK with valid *actread and *unc_size, -ve on error
+ */
+int fs_read_decomp(const char *filename, ulong addr, loff_t offset, loff_t len,
+		   loff_t *actread, ulong *unc_size);
+
 /**
  * fs_write() - write file to the partition previously set by fs_set_blk_dev()
  *
@@ -10,7 +10,22 @@
 
 #include <part.h>
 
-int fs_devread(struct blk_desc *, struct disk_partition *, lbaint_t, int, int,
-	       char *);
+/**
+ * fs_devread() - read bytes from a partition
+ *
+ * Whole sectors are read straight into @buf; only a partial sector at the
+ * start or end of the range goes through a bounce buffer. Filesystems should
+ * use this for file data so that large reads avoid an extra copy.
+ *
+ * @blk:		block device to read from
+ * @partition:		partition on @blk
+ * @sector:		first sector, relative to @partition
+ * @byte_offset:	offset into @sector
+ * @byte_len:		number of bytes to read
+ * @buf:		destination buffer
+ * Return: 1 on success, 0 on error
+ */
+int fs_devread(struct blk_desc *blk, struct disk_partition *partition,
+	       lbaint_t sector, int byte_offset, int byte_len, char *buf);
 
 #endif /* __U_BOOT_FS_INTERNAL_H__ */
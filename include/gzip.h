@@ -8,6 +8,7 @@
 #define __GZIP_H
 
 struct blk_desc;
+struct gunzip_stream;
 
 /**
  * gzip_parse_header() - Parse a header from a gzip file
@@ -45,6 +46,44 @@ int gunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp);
 int zunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp,
 	   int stoponerr, int offset);
 
+/**
+ * gunzip_stream_init() - Start decompressing gzipped data a chunk at a time
+ *
+ * The compressed data is then handed over with gunzip_stream_feed(), in
+ * chunks of any size. Unlike gunzip(), the CRC in the gzip trailer is
+ * checked.
+ *
+ * @sp: Returns the stream state, which is allocated
+ * @dst: Destination for uncompressed data
+ * @dstlen: Size of destination buffer
+ * Return: 0 if OK, -ENOMEM if out of memory
+ */
+int gunzip_stream_init(struct gunzip_stream **sp, void *dst, ulong dstlen);
+
+/**
+ * gunzip_stream_feed() - Decompress the next chunk of gzipped data
+ *
+ * Data after the end of the compressed stream is ignored.
+ *
+ * @s: Stream state
+ * @src: Next chunk of compressed data
+ * @len: Length of @src
+ * Return: 0 if OK, -ENOSPC if the destination buffer is full, -EINVAL if
+ *	the data is corrupted
+ */
+int gunzip_stream_feed(struct gunzip_stream *s, const void *src, ulong len);
+
+/**
+ * gunzip_stream_end() - Finish decompressing gzipped data
+ *
+ * This frees @s, and must be called even if gunzip_stream_feed() failed.
+ *
+ * @s: Stream state
+ * @lenp: Returns length of uncompressed data
+ * Return: 0 if OK, -EINVAL if the compressed stream did not end
+ */
+int gunzip_stream_end(struct gunzip_stream *s, ulong *lenp);
+
 /**
  * gzwrite progress indicators: defined weak to allow board-specific
  * overrides:
@@ -22,6 +22,8 @@
 /* Define this to avoid #ifdefs later on */
 struct lmb;
 struct fdt_region;
+struct gunzip_stream;
+struct ulz4_stream;
 
 #ifdef USE_HOSTCC
 #include <sys/types.h>
@@ -854,6 +856,90 @@ int image_decomp(int comp, ulong load, ulong image_start, int type,
 		 void *load_buf, void *image_buf, ulong image_len,
 		 uint unc_len, ulong *load_end);
 
+/**
+ * struct image_decomp_stream - state of a streaming image decompression
+ *
+ * gzip and lz4 input is decompressed as it is fed in, so the compressed
+ * image never has to be held in memory as a whole. Input for the other
+ * algorithms is collected in a buffer provided by the caller and
+ * decompressed by image_decomp_stream_end().
+ *
+ * @comp:	Compression algorithm that is used (IH_COMP_...)
+ * @load_buf:	Place to decompress to
+ * @unc_len:	Available space for decompression
+ * @unc_size:	Number of bytes copied so far, for IH_COMP_NONE
+ * @gz:		gzip decompression state
+ * @lz4:	lz4 decompression state
+ * @stage:	Collected input of algorithms without a streaming decoder
+ * @stage_len:	Number of bytes in @stage
+ * @stage_size:	Size of @stage
+ */
+struct image_decomp_stream {
+	int comp;
+	void *load_buf;
+	ulong unc_len;
+	ulong unc_size;
+	struct gunzip_stream *gz;
+	struct ulz4_stream *lz4;
+	void *stage;
+	ulong stage_len;
+	ulong stage_size;
+};
+
+/**
+ * image_decomp_can_stream() - check if an algorithm decompresses as it goes
+ *
+ * @comp:	Compression algorithm (IH_COMP_...)
+ * Return: true if image_decomp_stream_start() needs no stage buffer for
+ *	@comp, false if the whole input has to be collected first
+ */
+bool image_decomp_can_stream(int comp);
+
+/**
+ * image_decomp_stream_start() - start a streaming image decompression
+ *
+ * @s:		Stream state to set up
+ * @comp:	Compression algorithm that is used (IH_COMP_...)
+ * @load_buf:	Place to decompress to
+ * @unc_len:	Available space for decompression, of which at most UINT_MAX
+ *		bytes are used
+ * @stage:	Buffer to collect the whole input in, must not overlap
+ *		@load_buf. Only needed if image_decomp_can_stream() is false
+ *		for @comp, may be NULL otherwise.
+ * @stage_size:	Size of @stage
+ * Return: 0 if OK, -ENOSYS if @comp is not supported, -EINVAL if @stage is
+ *	needed but missing, -ENOMEM if out of memory
+ */
+int image_decomp_stream_start(struct image_decomp_stream *s, int comp,
+			      void *load_buf, ulong unc_len, void *stage,
+			      ulong stage_size);
+
+/**
+ * image_decomp_stream_feed() - decompress the next chunk of an image
+ *
+ * If the input is being collected, @buf may point at the end of the data in
+ * the stage buffer already, in which case it is not copied.
+ *
+ * @s:		Stream state
+ * @buf:	Next chunk of the compressed image
+ * @len:	Number of bytes in @buf
+ * Return: 0 if OK, -ENOSPC if the stage buffer is full, other -ve on error
+ */
+int image_decomp_stream_feed(struct image_decomp_stream *s, const void *buf,
+			     ulong len);
+
+/**
+ * image_decomp_stream_end() - finish a streaming image decompression
+ *
+ * This frees the resources held by @s. Once image_decomp_stream_start()
+ * succeeded it must be called, even if image_decomp_stream_feed() failed.
+ *
+ * @s:		Stream state
+ * @unc_size:	Returns the number of uncompressed bytes
+ * Return: 0 if OK, -ve on error
+ */
+int image_decomp_stream_end(struct image_decomp_stream *s, ulong *unc_size);
+
 /**
  * Set up properties in the FDT
  *
@@ -1173,6 +1259,29 @@ int fit_check_ramdisk(const void *fit, int os_noffset,
 int calculate_hash(const void *data, int data_len, const char *algo,
 			uint8_t *value, int *value_len);
 
+/**
+ * struct fit_hash_job - a hash node to be checked while verifying a FIT
+ *
+ * The hash nodes of the images being verified are collected into jobs
+ * before any of them is calculated, so that the hashes of an image can be
+ * calculated in a single pass over its data.
+ *
+ * @data:	Image data to hash
+ * @size:	Size of image data
+ * @algo:	Hash algorithm to use
+ * @noffset:	Offset of the hash node this job belongs to
+ * @value:	Calculated hash value, algo->digest_size bytes long
+ * @ret:	0 once @value is valid, -ve error code otherwise
+ */
+struct fit_hash_job {
+	const void *data;
+	size_t size;
+	struct hash_algo *algo;
+	int noffset;
+	uint8_t value[FIT_MAX_HASH_LEN];
+	int ret;
+};
+
 /*
  * At present we only support signing on the host, and verification on the
  * device
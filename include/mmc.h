@@ -74,6 +74,7 @@ struct bd_info;
 #define MMC_CAP_NONREMOVABLE	BIT(14)
 #define MMC_CAP_NEEDS_POLL	BIT(15)
 #define MMC_CAP_CD_ACTIVE_HIGH  BIT(16)
+#define MMC_CAP_CQE		BIT(17)
 
 #define MMC_MODE_8BIT		BIT(30)
 #define MMC_MODE_4BIT		BIT(29)
@@ -213,6 +214,7 @@ static inline bool mmc_is_tuning_cmd(uint cmdidx)
 /*
  * EXT_CSD fields
  */
+#define EXT_CSD_CMDQ_MODE_EN		15	/* R/W */
 #define EXT_CSD_ENH_START_ADDR		136	/* R/W */
 #define EXT_CSD_ENH_SIZE_MULT		140	/* R/W */
 #define EXT_CSD_GP_SIZE_MULT		143	/* R/W */
@@ -242,6 +244,8 @@ static inline bool mmc_is_tuning_cmd(uint cmdidx)
 #define EXT_CSD_HC_ERASE_GRP_SIZE	224	/* RO */
 #define EXT_CSD_BOOT_MULT		226	/* RO */
 #define EXT_CSD_GENERIC_CMD6_TIME       248     /* RO */
+#define EXT_CSD_CMDQ_DEPTH		307	/* RO */
+#define EXT_CSD_CMDQ_SUPPORT		308	/* RO */
 #define EXT_CSD_BKOPS_SUPPORT		502	/* RO */
 
 /*
@@ -426,6 +430,21 @@ struct mmc_data {
 	uint blocksize;
 };
 
+/**
+ * struct mmc_cqe_task - a data transfer queued on the command queue engine
+ *
+ * @write:	true to write to the card, false to read from it
+ * @blkaddr:	Block address on the card
+ * @blocks:	Number of 512-byte blocks to transfer (at most 65535)
+ * @buf:	Buffer to read into or write from
+ */
+struct mmc_cqe_task {
+	bool write;
+	u32 blkaddr;
+	uint blocks;
+	void *buf;
+};
+
 /* forward decl. */
 struct mmc;
 
@@ -539,6 +558,45 @@ struct dm_mmc_ops {
 	 * @return 0 if success, -ve on error
 	 */
 	int (*hs400_prepare_ddr)(struct udevice *dev);
+
+#if CONFIG_IS_ENABLED(MMC_CQE)
+	/**
+	 * cqe_enable() - Switch the host's command queue engine on or off
+	 *
+	 * The card has already been placed in command queue mode when this
+	 * is called to enable the engine, and is taken out of it after the
+	 * engine is disabled.
+	 *
+	 * @dev:	Device to update
+	 * @enable:	true to enable the engine, false to disable it
+	 * @return queue depth supported by the engine if enabled, 0 if
+	 * disabled, -ve on error
+	 */
+	int (*cqe_enable)(struct udevice *dev, bool enable);
+
+	/**
+	 * cqe_submit() - Queue a data transfer on the engine
+	 *
+	 * @dev:	Device to use
+	 * @tag:	Task tag, less than the depth returned by cqe_enable()
+	 * @task:	Transfer to queue
+	 * @return 0 if OK, -ve on error
+	 */
+	int (*cqe_submit)(struct udevice *dev, uint tag,
+			  const struct mmc_cqe_task *task);
+
+	/**
+	 * cqe_poll() - Collect completed tasks
+	 *
+	 * @dev:	Device to check
+	 * @done:	Returns a bitmask of the tags which completed since the
+	 *		last call
+	 * @failed:	Returns a bitmask of the tags in @done which completed
+	 *		with an error
+	 * @return 0 if OK, -ve if the engine itself failed
+	 */
+	int (*cqe_poll)(struct udevice *dev, u32 *done, u32 *failed);
+#endif
 };
 
 #define mmc_get_ops(dev)        ((struct dm_mmc_ops *)(dev)->driver->ops)
@@ -555,6 +613,9 @@ int mmc_deferred_probe(struct mmc *mmc);
 int mmc_reinit(struct mmc *mmc);
 int mmc_get_b_max(struct mmc *mmc, void *dst, lbaint_t blkcnt);
 int mmc_hs400_prepare_ddr(struct mmc *mmc);
+int mmc_cqe_enable(struct mmc *mmc, bool enable);
+int mmc_cqe_submit(struct mmc *mmc, uint tag, const struct mmc_cqe_task *task);
+int mmc_cqe_poll(struct mmc *mmc, u32 *done, u32 *failed);
 #else
 struct mmc_ops {
 	int (*send_cmd)(struct mmc *mmc,
@@ -684,6 +745,9 @@ struct mmc {
 	u8 part_config;
 	u8 gen_cmd6_time;	/* units: 10 ms */
 	u8 part_switch_time;	/* units: 10 ms */
+#if CONFIG_IS_ENABLED(MMC_CQE)
+	u8 cmdq_depth;		/* 0 if the card has no command queue */
+#endif
 	uint tran_speed;
 	uint legacy_speed; /* speed for the legacy mode provided by the card */
 	uint read_bl_len;
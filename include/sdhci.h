@@ -317,6 +317,8 @@ struct sdhci_adma_desc {
 #endif
 } __packed;
 
+struct cqhci_host;
+
 struct sdhci_host {
 	const char *name;
 	void *ioaddr;
@@ -349,6 +351,9 @@ struct sdhci_host {
 #if CONFIG_IS_ENABLED(MMC_SDHCI_ADMA)
 	struct sdhci_adma_desc *adma_desc_table;
 #endif
+#if CONFIG_IS_ENABLED(MMC_SDHCI_CQHCI)
+	struct cqhci_host *cqe;	/* Command queue engine, if any */
+#endif
 };
 
 #ifdef CONFIG_MMC_SDHCI_IO_ACCESSORS
@@ -6,21 +6,115 @@
 #ifndef __LZ4_H
 #define __LZ4_H
 
+#include <linux/types.h>
+
 /**
  * ulz4fn() - Decompress LZ4 data
  *
+ * All frames in @src are decompressed, one after the other. Data after the
+ * last frame that does not start with a frame magic number is ignored.
+ *
  * @src: Source data to decompress
  * @srcn: Length of source data
  * @dst: Destination for uncompressed data
  * @dstn: Returns length of uncompressed data
  * Return: 0 if OK, -EPROTONOSUPPORT if the magic number or version number are
- *	not recognised or independent blocks are used, -EINVAL if the reserved
- *	fields are non-zero, or input is overrun, -EENOBUFS if the destination
+ *	not recognised, -EINVAL if the reserved fields are non-zero, or input
+ *	is overrun, -EENOBUFS if the destination
  *	buffer is overrun, -EEPROTO if the compressed data causes an error in
  *	the decompression algorithm
  */
 int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn);
 
+/**
+ * struct ulz4_stream - state of a streaming LZ4 decompression
+ *
+ * The input can be handed over in chunks of any size, e.g. as it is read
+ * from storage. It may hold several concatenated frames, which are
+ * decompressed one after the other; skippable frames are skipped. The
+ * output is written to a single buffer, which is what allows linked
+ * (non-independent) blocks to refer back to earlier output.
+ *
+ * @dst: Start of the destination buffer
+ * @out: Next byte of the destination buffer to write
+ * @end: End of the destination buffer
+ * @frame: Start of the output of the current frame
+ * @buf: Buffer collecting a compressed block that is split over chunks
+ * @buf_size: Size of @buf
+ * @block_header: Header of the current block
+ * @block_size: Size of the current block
+ * @block_len: Bytes of the current block seen so far
+ * @max_block_size: Largest block size allowed by the current frame
+ * @skip: Input bytes still to be skipped, e.g. checksums
+ * @field: Bytes of a header field that is split over chunks
+ * @field_len: Number of bytes in @field
+ * @independent_blocks: Blocks of the current frame do not refer to each other
+ * @has_block_checksum: Blocks of the current frame are followed by a checksum
+ * @has_content_checksum: Current frame ends with a checksum
+ * @frames: Number of frames completed so far
+ * @state: Current position in the frame format
+ * @err: Error code, once decompression has failed
+ */
+struct ulz4_stream {
+	void *dst;
+	void *out;
+	void *end;
+	void *frame;
+	uint8_t *buf;
+	size_t buf_size;
+	uint32_t block_header;
+	uint32_t block_size;
+	uint32_t block_len;
+	uint32_t max_block_size;
+	size_t skip;
+	uint8_t field[4];
+	size_t field_len;
+	bool independent_blocks;
+	bool has_block_checksum;
+	bool has_content_checksum;
+	uint frames;
+	int state;
+	int err;
+};
+
+/**
+ * ulz4_stream_init() - Start a streaming LZ4 decompression
+ *
+ * @s: Stream state to set up
+ * @dst: Destination for uncompressed data
+ * @dstn: Size of the destination buffer
+ */
+void ulz4_stream_init(struct ulz4_stream *s, void *dst, size_t dstn);
+
+/**
+ * ulz4_stream_feed() - Decompress the next chunk of LZ4 input
+ *
+ * Everything that can be decompressed from the input seen so far is
+ * written to the destination before this returns; s->out - s->dst is the
+ * number of bytes written.
+ *
+ * @s: Stream state
+ * @src: Next chunk of compressed data
+ * @srcn: Length of @src
+ * Return: 0 if OK, or an error code as for ulz4fn(), except that input
+ *	overrun is only reported by ulz4_stream_end(), -ENOMEM if a block
+ *	split over chunks cannot be buffered
+ */
+int ulz4_stream_feed(struct ulz4_stream *s, const void *src, size_t srcn);
+
+/**
+ * ulz4_stream_end() - Finish a streaming LZ4 decompression
+ *
+ * This frees the resources held by @s, and must be called even if
+ * ulz4_stream_feed() failed.
+ *
+ * @s: Stream state
+ * Return: 0 if the input ended after a complete frame, -EINVAL if it ended
+ *	inside a frame or no frame was seen, or the error that made
+ *	ulz4_stream_feed() fail
+ */
+int ulz4_stream_end(struct ulz4_stream *s);
+
 /**
  * LZ4_decompress_safe() - Decompression protected against buffer overflow
  * @source: source address of the compressed data
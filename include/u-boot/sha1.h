@@ -81,6 +81,21 @@ void sha1_csum(const unsigned char *input, unsigned int ilen,
 void sha1_csum_wd(const unsigned char *input, unsigned int ilen,
 		unsigned char *output, unsigned int chunk_sz);
 
+/**
+ * \brief	   Hash whole 64-byte blocks into the context
+ *
+ * Architectures with SHA-1 instructions override sha1_process() and can
+ * fall back to sha1_process_generic() when the CPU lacks them.
+ *
+ * \param ctx	   SHA-1 context
+ * \param data	   blocks to hash
+ * \param blocks   number of 64-byte blocks
+ */
+void sha1_process(sha1_context *ctx, const unsigned char *data,
+		  unsigned int blocks);
+void sha1_process_generic(sha1_context *ctx, const unsigned char *data,
+			  unsigned int blocks);
+
 /**
  * \brief	   Output = HMAC-SHA-1( input buffer, hmac key )
  *
@@ -22,4 +22,14 @@ void sha256_finish(sha256_context * ctx, uint8_t digest[SHA256_SUM_LEN]);
 void sha256_csum_wd(const unsigned char *input, unsigned int ilen,
 		unsigned char *output, unsigned int chunk_sz);
 
+/*
+ * Hash whole 64-byte blocks into the context. Architectures with SHA-256
+ * instructions override sha256_process() and can fall back to the C version,
+ * sha256_process_generic(), when the CPU lacks them.
+ */
+void sha256_process(sha256_context *ctx, const unsigned char *data,
+		    unsigned int blocks);
+void sha256_process_generic(sha256_context *ctx, const unsigned char *data,
+			    unsigned int blocks);
+
 #endif /* _SHA256_H */
@@ -25,6 +25,17 @@ void sha512_finish(sha512_context * ctx, uint8_t digest[SHA512_SUM_LEN]);
 void sha512_csum_wd(const unsigned char *input, unsigned int ilen,
 		unsigned char *output, unsigned int chunk_sz);
 
+/*
+ * Hash whole 128-byte blocks into the context, for SHA-384 and SHA-512.
+ * Architectures with SHA-512 instructions override sha512_process() and can
+ * fall back to the C version, sha512_process_generic(), when the CPU lacks
+ * them.
+ */
+void sha512_process(sha512_context *ctx, const unsigned char *data,
+		    unsigned int blocks);
+void sha512_process_generic(sha512_context *ctx, const unsigned char *data,
+			    unsigned int blocks);
+
 extern const uint8_t sha384_der_prefix[];
 
 void sha384_starts(sha512_context * ctx);
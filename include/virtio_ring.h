@@ -63,6 +63,8 @@ struct vring_desc_shadow {
 	u16 next;
 	/* Metadata about the descriptor. */
 	bool chain_head;
+	/* Indirect descriptor table hung off this head, if any */
+	struct vring_desc *indir_desc;
 };
 
 struct vring_avail {
@@ -101,6 +103,7 @@ struct vring {
  * @vring: actual memory layout for this queue
  * @vring_desc_shadow: guest-only copy of descriptors
  * @event: host publishes avail event idx
+ * @indirect: indirect descriptors may be used for multi-element buffers
  * @free_head: head of free buffer list
  * @num_added: number we've added since last sync
  * @last_used_idx: last used index we've seen
@@ -115,6 +118,7 @@ struct virtqueue {
 	struct vring vring;
 	struct vring_desc_shadow *vring_desc_shadow;
 	bool event;
+	bool indirect;
 	unsigned int free_head;
 	unsigned int num_added;
 	u16 last_used_idx;
@@ -182,6 +186,13 @@ struct virtio_sg;
  * @in_sgs:	the number of scatterlists which are writable
  *		(after readable ones)
  *
+ * If VIRTIO_RING_F_INDIRECT_DESC was negotiated, a buffer made of more
+ * than one scatterlist is described by an indirect table so that it only
+ * takes up a single slot in the ring.
+ *
+ * The other side is not notified; call virtqueue_kick() once after a batch
+ * of buffers has been added.
+ *
  * Caller must ensure we don't call this with other virtqueue operations
  * at the same time (except where noted).
  *
@@ -196,7 +207,9 @@ int virtqueue_add(struct virtqueue *vq, struct virtio_sg *sgs[],
  * @vq:		the struct virtqueue
  *
  * After one or more virtqueue_add() calls, invoke this to kick
- * the other side.
+ * the other side. If VIRTIO_RING_F_EVENT_IDX was negotiated, the
+ * notification is skipped unless the other side asked for one within
+ * the batch of buffers added since the last kick.
  *
  * Caller must ensure we don't call this with other virtqueue
  * operations at the same time (except where noted).
@@ -308,3 +308,67 @@ int zunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp,
 
 	return err;
 }
+
+struct gunzip_stream {
+	z_stream s;
+	bool done;
+};
+
+int gunzip_stream_init(struct gunzip_stream **sp, void *dst, ulong dstlen)
+{
+	struct gunzip_stream *gs;
+	int r;
+
+	gs = calloc(1, sizeof(*gs));
+	if (!gs)
+		return -ENOMEM;
+
+	gs->s.zalloc = gzalloc;
+	gs->s.zfree = gzfree;
+
+	/* Let zlib parse the gzip header, which may be split over chunks */
+	r = inflateInit2(&gs->s, 16 + MAX_WBITS);
+	if (r != Z_OK) {
+		printf("Error: inflateInit2() returned %d\n", r);
+		free(gs);
+		return -ENOMEM;
+	}
+	gs->s.next_out = dst;
+	gs->s.avail_out = dstlen;
+	*sp = gs;
+
+	return 0;
+}
+
+int gunzip_stream_feed(struct gunzip_stream *gs, const void *src, ulong len)
+{
+	int r;
+
+	gs->s.next_in = (unsigned char *)src;
+	gs->s.avail_in = len;
+	while (!gs->done && gs->s.avail_in) {
+		r = inflate(&gs->s, Z_NO_FLUSH);
+		if (r == Z_STREAM_END) {
+			gs->done = true;
+		} else if (r == Z_BUF_ERROR && !gs->s.avail_out) {
+			return -ENOSPC;
+		} else if (r != Z_OK) {
+			printf("Error: inflate() returned %d\n", r);
+			return -EINVAL;
+		}
+		WATCHDOG_RESET();
+	}
+
+	return 0;
+}
+
+int gunzip_stream_end(struct gunzip_stream *gs, ulong *lenp)
+{
+	int ret = gs->done ? 0 : -EINVAL;
+
+	*lenp = gs->s.total_out;
+	inflateEnd(&gs->s);
+	free(gs);
+
+	return ret;
+}
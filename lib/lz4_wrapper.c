@@ -6,6 +6,7 @@
 #include <common.h>
 #include <compiler.h>
 #include <image.h>
+#include <malloc.h>
 #include <linux/kernel.h>
 #include <linux/types.h>
 #include <asm/unaligned.h>
@@ -15,95 +16,280 @@
 #include "lz4.c"	/* #include for inlining, do not link! */
 
 #define LZ4F_BLOCKUNCOMPRESSED_FLAG 0x80000000U
+#define LZ4F_SKIPPABLE_MAGIC	0x184d2a50
+#define LZ4F_SKIPPABLE_MASK	0xfffffff0
 
-int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn)
+enum {
+	ULZ4_MAGIC,		/* frame magic number */
+	ULZ4_DESCRIPTOR,	/* FLG and BD bytes */
+	ULZ4_SKIPPABLE_SIZE,	/* size of a skippable frame */
+	ULZ4_BLOCK_HEADER,	/* block size, or end mark */
+	ULZ4_BLOCK,		/* block data */
+	ULZ4_DONE,		/* trailing data after the last frame */
+	ULZ4_ERROR,
+};
+
+void ulz4_stream_init(struct ulz4_stream *s, void *dst, size_t dstn)
+{
+	memset(s, 0, sizeof(*s));
+	s->dst = dst;
+	s->out = dst;
+	s->end = dst + dstn;
+	s->state = ULZ4_MAGIC;
+}
+
+/*
+ * Gather a field of @n bytes from the input, which may be split over
+ * several chunks. Returns a pointer to the whole field, or NULL if more
+ * input is needed. The field is read straight from the input when it is
+ * all there, so nothing is copied in the common case.
+ */
+static const u8 *ulz4_gather(struct ulz4_stream *s, const u8 **in,
+			     size_t *len, size_t n)
+{
+	const u8 *field = *in;
+	size_t size;
+
+	if (!s->field_len && *len >= n) {
+		*in += n;
+		*len -= n;
+		return field;
+	}
+
+	size = min(n - s->field_len, *len);
+	memcpy(s->field + s->field_len, *in, size);
+	s->field_len += size;
+	*in += size;
+	*len -= size;
+	if (s->field_len < n)
+		return NULL;
+
+	s->field_len = 0;
+	return s->field;
+}
+
+static int ulz4_decode_block(struct ulz4_stream *s, const void *in)
 {
-	const void *end = dst + *dstn;
-	const void *in = src;
-	void *out = dst;
-	int has_block_checksum;
 	int ret;
-	*dstn = 0;
-
-	{ /* With in-place decompression the header may become invalid later. */
-		u32 magic;
-		u8 flags, version, independent_blocks, has_content_size;
-		u8 block_desc;
-
-		if (srcn < sizeof(u32) + 3*sizeof(u8))
-			return -EINVAL;	/* input overrun */
-
-		magic = get_unaligned_le32(in);
-		in += sizeof(u32);
-		flags = *(u8 *)in;
-		in += sizeof(u8);
-		block_desc = *(u8 *)in;
-		in += sizeof(u8);
-
-		version = (flags >> 6) & 0x3;
-		independent_blocks = (flags >> 5) & 0x1;
-		has_block_checksum = (flags >> 4) & 0x1;
-		has_content_size = (flags >> 3) & 0x1;
-
-		/* We assume there's always only a single, standard frame. */
-		if (magic != LZ4F_MAGIC || version != 1)
-			return -EPROTONOSUPPORT;	/* unknown format */
-		if ((flags & 0x03) || (block_desc & 0x8f))
-			return -EINVAL;	/* reserved bits must be zero */
-		if (!independent_blocks)
-			return -EPROTONOSUPPORT; /* we can't support this yet */
-
-		if (has_content_size) {
-			if (srcn < sizeof(u32) + 3*sizeof(u8) + sizeof(u64))
-				return -EINVAL;	/* input overrun */
-			in += sizeof(u64);
+
+	/*
+	 * Linked blocks may refer back to the output of earlier blocks of the
+	 * same frame, which is still in the destination buffer.
+	 */
+	/* constant folding essential, do not touch params! */
+	ret = LZ4_decompress_generic(in, s->out, s->block_size,
+				     s->end - s->out, endOnInputSize,
+				     decode_full_block, noDict,
+				     s->independent_blocks ? s->out : s->frame,
+				     NULL, 0);
+	if (ret < 0)
+		return -EPROTO;	/* decompression error */
+	s->out += ret;
+
+	return 0;
+}
+
+static int ulz4_frame_header(struct ulz4_stream *s, const u8 *desc)
+{
+	u8 flags = desc[0], block_desc = desc[1];
+	u8 version = (flags >> 6) & 0x3;
+	u8 has_content_size = (flags >> 3) & 0x1;
+	u8 block_max = (block_desc >> 4) & 0x7;
+
+	if (version != 1)
+		return -EPROTONOSUPPORT;	/* unknown format */
+	if ((flags & 0x03) || (block_desc & 0x8f))
+		return -EINVAL;	/* reserved bits must be zero */
+	if (block_max < 4)
+		return -EINVAL;	/* reserved block maximum size */
+
+	/* 4 to 7 stand for 64KiB, 256KiB, 1MiB and 4MiB */
+	s->max_block_size = 1 << (8 + 2 * block_max);
+	s->independent_blocks = (flags >> 5) & 0x1;
+	s->has_block_checksum = (flags >> 4) & 0x1;
+	s->has_content_checksum = (flags >> 2) & 0x1;
+	s->frame = s->out;
+
+	/* Skip the content size (unused) and the header checksum byte */
+	s->skip = (has_content_size ? sizeof(u64) : 0) + sizeof(u8);
+
+	return 0;
+}
+
+static int ulz4_block(struct ulz4_stream *s, const u8 **in, size_t *len)
+{
+	size_t size;
+	int ret;
+
+	if (s->block_header & LZ4F_BLOCKUNCOMPRESSED_FLAG) {
+		/* Stored blocks are copied as they arrive */
+		size = min_t(size_t, s->block_size - s->block_len, *len);
+		if (size > (size_t)(s->end - s->out)) {
+			memcpy(s->out, *in, s->end - s->out);
+			s->out = s->end;
+			return -ENOBUFS;	/* output overrun */
+		}
+		memcpy(s->out, *in, size);
+		s->out += size;
+	} else if (!s->block_len && *len >= s->block_size) {
+		/* The whole block is there, decompress it in place */
+		size = s->block_size;
+		ret = ulz4_decode_block(s, *in);
+		if (ret)
+			return ret;
+	} else {
+		/* Collect the block until it is complete */
+		if (s->buf_size < s->block_size) {
+			free(s->buf);
+			s->buf = malloc(s->block_size);
+			if (!s->buf) {
+				s->buf_size = 0;
+				return -ENOMEM;
+			}
+			s->buf_size = s->block_size;
+		}
+		size = min_t(size_t, s->block_size - s->block_len, *len);
+		memcpy(s->buf + s->block_len, *in, size);
+		if (s->block_len + size == s->block_size) {
+			ret = ulz4_decode_block(s, s->buf);
+			if (ret)
+				return ret;
 		}
-		/* Header checksum byte */
-		in += sizeof(u8);
 	}
 
-	while (1) {
-		u32 block_header, block_size;
+	*in += size;
+	*len -= size;
+	s->block_len += size;
+	if (s->block_len == s->block_size) {
+		s->skip = s->has_block_checksum ? sizeof(u32) : 0;
+		s->state = ULZ4_BLOCK_HEADER;
+	}
 
-		block_header = get_unaligned_le32(in);
-		in += sizeof(u32);
-		block_size = block_header & ~LZ4F_BLOCKUNCOMPRESSED_FLAG;
+	return 0;
+}
 
-		if (in - src + block_size > srcn) {
-			ret = -EINVAL;		/* input overrun */
-			break;
-		}
+static int ulz4_stream_step(struct ulz4_stream *s, const u8 **in, size_t *len)
+{
+	const u8 *field;
+	size_t size;
+	u32 magic;
 
-		if (!block_size) {
-			ret = 0;	/* decompression successful */
-			break;
-		}
+	if (s->skip) {
+		size = min(s->skip, *len);
+		*in += size;
+		*len -= size;
+		s->skip -= size;
+		return 0;
+	}
 
-		if (block_header & LZ4F_BLOCKUNCOMPRESSED_FLAG) {
-			size_t size = min((ptrdiff_t)block_size, (ptrdiff_t)(end - out));
-			memcpy(out, in, size);
-			out += size;
-			if (size < block_size) {
-				ret = -ENOBUFS;	/* output overrun */
-				break;
-			}
+	switch (s->state) {
+	case ULZ4_MAGIC:
+		field = ulz4_gather(s, in, len, sizeof(u32));
+		if (!field)
+			return 0;
+		magic = get_unaligned_le32(field);
+		if (magic == LZ4F_MAGIC) {
+			s->state = ULZ4_DESCRIPTOR;
+		} else if ((magic & LZ4F_SKIPPABLE_MASK) ==
+			   LZ4F_SKIPPABLE_MAGIC) {
+			s->state = ULZ4_SKIPPABLE_SIZE;
+		} else if (s->frames) {
+			/* Anything after the last frame is ignored */
+			s->state = ULZ4_DONE;
 		} else {
-			/* constant folding essential, do not touch params! */
-			ret = LZ4_decompress_generic(in, out, block_size,
-					end - out, endOnInputSize,
-					decode_full_block, noDict, out, NULL, 0);
-			if (ret < 0) {
-				ret = -EPROTO;	/* decompression error */
-				break;
-			}
-			out += ret;
+			return -EPROTONOSUPPORT;	/* unknown format */
+		}
+		return 0;
+	case ULZ4_DESCRIPTOR:
+		field = ulz4_gather(s, in, len, 2 * sizeof(u8));
+		if (!field)
+			return 0;
+		s->state = ULZ4_BLOCK_HEADER;
+		return ulz4_frame_header(s, field);
+	case ULZ4_SKIPPABLE_SIZE:
+		field = ulz4_gather(s, in, len, sizeof(u32));
+		if (!field)
+			return 0;
+		s->skip = get_unaligned_le32(field);
+		s->state = ULZ4_MAGIC;
+		return 0;
+	case ULZ4_BLOCK_HEADER:
+		field = ulz4_gather(s, in, len, sizeof(u32));
+		if (!field)
+			return 0;
+		s->block_header = get_unaligned_le32(field);
+		s->block_size = s->block_header & ~LZ4F_BLOCKUNCOMPRESSED_FLAG;
+		s->block_len = 0;
+		if (s->block_size > s->max_block_size)
+			return -EINVAL;	/* larger than the frame allows */
+		if (s->block_size) {
+			s->state = ULZ4_BLOCK;
+		} else {
+			/* End mark, the frame is complete */
+			s->frames++;
+			s->skip = s->has_content_checksum ? sizeof(u32) : 0;
+			s->state = ULZ4_MAGIC;
 		}
+		return 0;
+	case ULZ4_BLOCK:
+		return ulz4_block(s, in, len);
+	case ULZ4_DONE:
+		*in += *len;
+		*len = 0;
+		return 0;
+	}
+
+	return -EINVAL;
+}
+
+int ulz4_stream_feed(struct ulz4_stream *s, const void *src, size_t srcn)
+{
+	const u8 *in = src;
+	int ret;
+
+	if (s->state == ULZ4_ERROR)
+		return s->err;
 
-		in += block_size;
-		if (has_block_checksum)
-			in += sizeof(u32);
+	while (srcn) {
+		ret = ulz4_stream_step(s, &in, &srcn);
+		if (ret) {
+			s->state = ULZ4_ERROR;
+			s->err = ret;
+			return ret;
+		}
 	}
 
-	*dstn = out - dst;
+	return 0;
+}
+
+int ulz4_stream_end(struct ulz4_stream *s)
+{
+	int ret;
+
+	free(s->buf);
+	s->buf = NULL;
+	s->buf_size = 0;
+
+	if (s->state == ULZ4_ERROR)
+		ret = s->err;
+	else if (!s->frames ||
+		 (s->state != ULZ4_MAGIC && s->state != ULZ4_DONE))
+		ret = -EINVAL;	/* input overrun */
+	else
+		ret = 0;	/* decompression successful */
+
 	return ret;
 }
+
+int ulz4fn(const void *src, size_t srcn, void *dst, size_t *dstn)
+{
+	struct ulz4_stream s;
+	int ret, err;
+
+	ulz4_stream_init(&s, dst, *dstn);
+	ret = ulz4_stream_feed(&s, src, srcn);
+	err = ulz4_stream_end(&s);
+	*dstn = s.out - s.dst;
+
+	return ret ? ret : err;
+}
@@ -440,6 +440,50 @@ static int compression_test_lz4(struct unit_test_state *uts)
 }
 COMPRESSION_TEST(compression_test_lz4, 0);
 
+/* Feed two concatenated lz4 frames in chunks of every size up to 16 bytes */
+static int compression_test_lz4_stream(struct unit_test_state *uts)
+{
+	const ulong plain_size = strlen(plain);
+	struct ulz4_stream s;
+	char *in, *out;
+	ulong pos, chunk;
+
+	in = malloc(2 * lz4_compressed_size);
+	out = malloc(2 * plain_size);
+	ut_assertnonnull(in);
+	ut_assertnonnull(out);
+	memcpy(in, lz4_compressed, lz4_compressed_size);
+	memcpy(in + lz4_compressed_size, lz4_compressed, lz4_compressed_size);
+
+	for (chunk = 1; chunk <= 16; chunk++) {
+		memset(out, '\0', 2 * plain_size);
+		ulz4_stream_init(&s, out, 2 * plain_size);
+		for (pos = 0; pos < 2 * lz4_compressed_size; pos += chunk)
+			ut_assertok(ulz4_stream_feed(&s, in + pos,
+					min(chunk, 2 * lz4_compressed_size - pos)));
+		ut_assertok(ulz4_stream_end(&s));
+		ut_asserteq(2 * plain_size, s.out - s.dst);
+		ut_asserteq_mem(plain, out, plain_size);
+		ut_asserteq_mem(plain, out + plain_size, plain_size);
+	}
+
+	/* A frame cut short is an input overrun */
+	ulz4_stream_init(&s, out, 2 * plain_size);
+	ut_assertok(ulz4_stream_feed(&s, in, lz4_compressed_size - 8));
+	ut_asserteq(-EINVAL, ulz4_stream_end(&s));
+
+	/* A block larger than the frame's maximum of 64KiB is rejected */
+	ulz4_stream_init(&s, out, 2 * plain_size);
+	ut_asserteq(-EINVAL, ulz4_stream_feed(&s, "\x04\x22\x4d\x18\x64\x40"
+					      "\xa7\x01\x00\x01\x00", 11));
+
+	free(out);
+	free(in);
+
+	return 0;
+}
+COMPRESSION_TEST(compression_test_lz4_stream, 0);
+
 static int compress_using_none(struct unit_test_state *uts,
 			       void *in, unsigned long in_size,
 			       void *out, unsigned long out_max,
@@ -536,6 +580,141 @@ static int compression_test_bootm_none(struct unit_test_state *uts)
 }
 COMPRESSION_TEST(compression_test_bootm_none, 0);
 
+/* Decompress @in by feeding it to image_decomp_stream_feed() @chunk at a time */
+static int stream_decomp(int comp_type, void *in, ulong in_size, ulong chunk,
+			 void *out, ulong out_max, ulong *out_size)
+{
+	struct image_decomp_stream s;
+	void *stage = NULL;
+	ulong pos;
+	int ret, err;
+
+	if (!image_decomp_can_stream(comp_type)) {
+		stage = malloc(in_size);
+		if (!stage)
+			return -ENOMEM;
+	}
+	ret = image_decomp_stream_start(&s, comp_type, out, out_max, stage,
+					in_size);
+	if (ret)
+		goto out;
+	for (pos = 0; !ret && pos < in_size; pos += chunk)
+		ret = image_decomp_stream_feed(&s, in + pos,
+					       min(chunk, in_size - pos));
+	err = image_decomp_stream_end(&s, out_size);
+	if (!ret)
+		ret = err;
+out:
+	free(stage);
+
+	return ret;
+}
+
+/**
+ * run_stream_test() - Run tests on the streaming image decompression
+ *
+ * @comp_type:	Compression type to test
+ * @compress:	Our function to compress data
+ * Return: 0 if OK, non-zero on failure
+ */
+static int run_stream_test(struct unit_test_state *uts, int comp_type,
+			   mutate_func compress)
+{
+	const ulong plain_size = strlen(plain);
+	ulong compress_size = 1024;
+	void *compress_buff, *out;
+	ulong chunk, out_size;
+
+	printf("Testing: %s\n", genimg_get_comp_name(comp_type));
+	compress_buff = malloc(compress_size);
+	out = malloc(2 * plain_size);
+	ut_assertnonnull(compress_buff);
+	ut_assertnonnull(out);
+	compress(uts, (void *)plain, plain_size, compress_buff, compress_size,
+		 &compress_size);
+
+	for (chunk = 1; chunk <= 16; chunk++) {
+		memset(out, '\0', 2 * plain_size);
+		ut_assertok(stream_decomp(comp_type, compress_buff,
+					  compress_size, chunk, out,
+					  2 * plain_size, &out_size));
+		ut_asserteq(plain_size, out_size);
+		ut_asserteq_mem(plain, out, plain_size);
+	}
+
+	ut_assert(stream_decomp(comp_type, compress_buff, compress_size, 16,
+				out, plain_size - 1, &out_size));
+
+	/* Collected input must fit in the stage buffer, which is required */
+	if (!image_decomp_can_stream(comp_type)) {
+		struct image_decomp_stream s;
+
+		ut_asserteq(-EINVAL,
+			    image_decomp_stream_start(&s, comp_type, out,
+						      2 * plain_size, NULL, 0));
+		ut_assertok(image_decomp_stream_start(&s, comp_type, out,
+						      2 * plain_size,
+						      compress_buff,
+						      compress_size - 1));
+		ut_asserteq(-ENOSPC,
+			    image_decomp_stream_feed(&s, compress_buff,
+						     compress_size));
+		image_decomp_stream_end(&s, &out_size);
+	}
+
+	/* We can't detect corruption when not decompressing */
+	if (comp_type != IH_COMP_NONE) {
+		memset(compress_buff + compress_size / 2, '\x49',
+		       compress_size / 2);
+		ut_assert(stream_decomp(comp_type, compress_buff,
+					compress_size, 16, out, 2 * plain_size,
+					&out_size));
+	}
+
+	free(out);
+	free(compress_buff);
+
+	return 0;
+}
+
+static int compression_test_stream_gzip(struct unit_test_state *uts)
+{
+	return run_stream_test(uts, IH_COMP_GZIP, compress_using_gzip);
+}
+COMPRESSION_TEST(compression_test_stream_gzip, 0);
+
+static int compression_test_stream_lz4(struct unit_test_state *uts)
+{
+	return run_stream_test(uts, IH_COMP_LZ4, compress_using_lz4);
+}
+COMPRESSION_TEST(compression_test_stream_lz4, 0);
+
+static int compression_test_stream_lzma(struct unit_test_state *uts)
+{
+	return run_stream_test(uts, IH_COMP_LZMA, compress_using_lzma);
+}
+COMPRESSION_TEST(compression_test_stream_lzma, 0);
+
+/* Unknown algorithms are refused before any input is taken */
+static int compression_test_stream_unknown(struct unit_test_state *uts)
+{
+	struct image_decomp_stream s;
+	char buf[16];
+
+	ut_asserteq(-ENOSYS, image_decomp_stream_start(&s, IH_COMP_COUNT, buf,
+						       sizeof(buf), buf,
+						       sizeof(buf)));
+
+	return 0;
+}
+COMPRESSION_TEST(compression_test_stream_unknown, 0);
+
+static int compression_test_stream_none(struct unit_test_state *uts)
+{
+	return run_stream_test(uts, IH_COMP_NONE, compress_using_none);
+}
+COMPRESSION_TEST(compression_test_stream_none, 0);
+
 int do_ut_compression(struct cmd_tbl *cmdtp, int flag, int argc,
 		      char *const argv[])
 {
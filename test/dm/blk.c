@@ -4,7 +4,11 @@
  */
 
 #include <common.h>
+#include <blk_req.h>
+#include <bouncebuf.h>
 #include <dm.h>
+#include <malloc.h>
+#include <memalign.h>
 #include <part.h>
 #include <usb.h>
 #include <asm/global_data.h>
@@ -334,3 +338,198 @@ static int dm_test_blk_foreach(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_blk_foreach, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+/* Test that the block cache merges adjacent reads and evicts in LRU order */
+static int dm_test_blk_cache(struct unit_test_state *uts)
+{
+	struct block_cache_stats old, stats;
+	char buf[8 * 512], out[8 * 512];
+	int i;
+
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = i / 512 + i;
+
+	/* Use two entries of four blocks each */
+	blkcache_stats(&old);
+	blkcache_configure(4, 2, 64 << 10);
+
+	/* Two adjacent reads end up in the same entry */
+	blkcache_fill(IF_TYPE_HOST, 9, 4, 2, 512, buf);
+	blkcache_fill(IF_TYPE_HOST, 9, 6, 2, 512, buf + 2 * 512);
+	ut_asserteq(1, blkcache_read(IF_TYPE_HOST, 9, 4, 4, 512, out));
+	ut_asserteq_mem(buf, out, 4 * 512);
+	ut_asserteq(1, blkcache_read(IF_TYPE_HOST, 9, 5, 2, 512, out));
+	ut_asserteq_mem(buf + 512, out, 2 * 512);
+
+	/* A range that is only partly cached is a miss */
+	ut_asserteq(0, blkcache_read(IF_TYPE_HOST, 9, 3, 2, 512, out));
+	ut_asserteq(0, blkcache_read(IF_TYPE_HOST, 9, 4, 4, 1024, out));
+
+	ut_assertok(blkcache_dev_stats(IF_TYPE_HOST, 9, &stats));
+	ut_asserteq(2, stats.hits);
+	ut_asserteq(2, stats.misses);
+	ut_asserteq(1, stats.entries);
+	ut_asserteq(-ENOENT, blkcache_dev_stats(IF_TYPE_HOST, 10, &stats));
+
+	/* A third entry pushes out the least recently used one */
+	blkcache_fill(IF_TYPE_HOST, 9, 0, 2, 512, buf);
+	blkcache_fill(IF_TYPE_HOST, 9, 8, 2, 512, buf);
+	ut_asserteq(0, blkcache_read(IF_TYPE_HOST, 9, 4, 1, 512, out));
+	ut_asserteq(1, blkcache_read(IF_TYPE_HOST, 9, 0, 2, 512, out));
+	ut_asserteq(1, blkcache_read(IF_TYPE_HOST, 9, 8, 2, 512, out));
+	ut_assertok(blkcache_dev_stats(IF_TYPE_HOST, 9, &stats));
+	ut_asserteq(1, stats.evictions);
+	ut_asserteq(2, stats.entries);
+
+	/* Large reads are not cached */
+	blkcache_fill(IF_TYPE_HOST, 9, 16, 8, 512, buf);
+	ut_asserteq(0, blkcache_read(IF_TYPE_HOST, 9, 16, 1, 512, out));
+
+	blkcache_invalidate(IF_TYPE_HOST, 9);
+	ut_asserteq(0, blkcache_read(IF_TYPE_HOST, 9, 0, 2, 512, out));
+	ut_assertok(blkcache_dev_stats(IF_TYPE_HOST, 9, &stats));
+	ut_asserteq(0, stats.entries);
+
+	blkcache_configure(old.max_blocks_per_entry, old.max_entries,
+			   old.max_bytes);
+
+	return 0;
+}
+DM_TEST(dm_test_blk_cache, 0);
+
+/* Test that sequential reads are satisfied from the readahead buffer */
+static int dm_test_blk_readahead(struct unit_test_state *uts)
+{
+	struct blk_readahead_stats stats;
+	struct blk_desc *desc;
+	char write[16 * 512], read[2 * 512];
+	int i;
+
+	ut_assertok(blk_get_device_by_str("mmc", "0", &desc));
+	ut_assertok(blk_set_readahead(desc->bdev, 8 * 512));
+
+	for (i = 0; i < sizeof(write); i++)
+		write[i] = i / 512 + i;
+	ut_asserteq(16, blk_dwrite(desc, 0, 16, write));
+
+	/* The first read is not taken as sequential, even at block 0 */
+	ut_asserteq(2, blk_dread(desc, 0, 2, read));
+	ut_asserteq_mem(write, read, sizeof(read));
+	ut_assertok(blk_get_readahead_stats(desc->bdev, &stats));
+	ut_asserteq(0, stats.issued);
+
+	/* The second of two consecutive reads fills the window */
+	ut_asserteq(2, blk_dread(desc, 4, 2, read));
+	ut_asserteq_mem(write + 4 * 512, read, sizeof(read));
+	ut_asserteq(2, blk_dread(desc, 6, 2, read));
+	ut_asserteq_mem(write + 6 * 512, read, sizeof(read));
+	ut_assertok(blk_get_readahead_stats(desc->bdev, &stats));
+	ut_asserteq(6, stats.issued);
+	ut_asserteq(0, stats.hits);
+
+	/* The following reads come from the buffer */
+	for (i = 8; i < 12; i += 2) {
+		ut_asserteq(2, blk_dread(desc, i, 2, read));
+		ut_asserteq_mem(write + i * 512, read, sizeof(read));
+	}
+	ut_assertok(blk_get_readahead_stats(desc->bdev, &stats));
+	ut_asserteq(6, stats.issued);
+	ut_asserteq(4, stats.hits);
+	ut_asserteq(2, stats.wasted);
+
+	/* Writing discards the buffer */
+	ut_asserteq(16, blk_dwrite(desc, 0, 16, write));
+	ut_asserteq(2, blk_dread(desc, 0, 2, read));
+	ut_asserteq_mem(write, read, sizeof(read));
+	ut_assertok(blk_get_readahead_stats(desc->bdev, &stats));
+	ut_asserteq(4, stats.hits);
+	ut_asserteq(2, stats.wasted);
+
+	return 0;
+}
+DM_TEST(dm_test_blk_readahead, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+static void blk_test_complete(struct blk_request *req)
+{
+	int *count = req->priv;
+
+	(*count)++;
+}
+
+/* Test asynchronous requests on a device which only supports read/write */
+static int dm_test_blk_submit(struct unit_test_state *uts)
+{
+	char write[4 * 512], read[4 * 512];
+	struct blk_request req;
+	struct blk_desc *desc;
+	int count = 0;
+	int i;
+
+	ut_assertok(blk_get_device_by_str("mmc", "0", &desc));
+	for (i = 0; i < sizeof(write); i++)
+		write[i] = i / 512 + i;
+
+	memset(&req, '\0', sizeof(req));
+	req.op = BLK_REQ_WRITE;
+	req.start = 8;
+	req.blkcnt = 4;
+	req.buffer = write;
+	req.complete = blk_test_complete;
+	req.priv = &count;
+	ut_assertok(blk_submit(desc->bdev, &req));
+	ut_assertok(blk_wait(desc->bdev, &req));
+	ut_asserteq(1, count);
+	ut_asserteq(4, req.result);
+
+	req.op = BLK_REQ_READ;
+	req.buffer = read;
+	ut_assertok(blk_submit(desc->bdev, &req));
+	ut_assertok(blk_wait(desc->bdev, &req));
+	ut_asserteq(2, count);
+	ut_asserteq(4, req.result);
+	ut_asserteq_mem(write, read, sizeof(read));
+
+	return 0;
+}
+DM_TEST(dm_test_blk_submit, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+#if IS_ENABLED(CONFIG_BOUNCE_BUFFER)
+/* Test that buffers from blk_dma_alloc() are not bounced */
+static int dm_test_blk_dma_alloc(struct unit_test_state *uts)
+{
+	struct bounce_buffer_stats stats;
+	struct bounce_buffer bbstate;
+	struct blk_desc *desc;
+	char *buf;
+
+	ut_assertok(blk_get_device_by_str("mmc", "0", &desc));
+	ut_asserteq(ARCH_DMA_MINALIGN, blk_dma_align(NULL));
+	ut_asserteq(ARCH_DMA_MINALIGN, blk_dma_align(desc));
+	desc->dma_align = 4096;
+	ut_asserteq(4096, blk_dma_align(desc));
+
+	buf = blk_dma_alloc(desc, 3 * 512);
+	ut_assertnonnull(buf);
+	ut_assert(IS_ALIGNED((ulong)buf, 4096));
+	desc->dma_align = 0;
+
+	bounce_buffer_reset_stats();
+	ut_assertok(bounce_buffer_start(&bbstate, buf, 3 * 512, GEN_BB_WRITE));
+	ut_asserteq_ptr(buf, bbstate.bounce_buffer);
+	ut_assertok(bounce_buffer_stop(&bbstate));
+
+	/* A misaligned buffer must be bounced */
+	ut_assertok(bounce_buffer_start(&bbstate, buf + 4, 512, GEN_BB_READ));
+	ut_assert(buf + 4 != bbstate.bounce_buffer);
+	ut_assertok(bounce_buffer_stop(&bbstate));
+
+	bounce_buffer_get_stats(&stats);
+	ut_asserteq(2, stats.sessions);
+	ut_asserteq(1, stats.bounced);
+	ut_asserteq(512, stats.bytes);
+	free(buf);
+
+	return 0;
+}
+DM_TEST(dm_test_blk_dma_alloc, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+#endif
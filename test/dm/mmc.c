@@ -4,9 +4,12 @@
  */
 
 #include <common.h>
+#include <blk.h>
 #include <dm.h>
+#include <malloc.h>
 #include <mmc.h>
 #include <part.h>
+#include <asm/test.h>
 #include <dm/test.h>
 #include <test/test.h>
 #include <test/ut.h>
@@ -52,3 +55,54 @@ static int dm_test_mmc_blk(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_mmc_blk, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+#if CONFIG_IS_ENABLED(MMC_CQE)
+static int dm_test_mmc_cqe(struct unit_test_state *uts)
+{
+	struct blk_desc *dev_desc;
+	struct mmc *mmc;
+	lbaint_t blocks;
+	char *write, *read;
+	int i;
+
+	mmc = find_mmc_device(0);
+	ut_assertnonnull(mmc);
+	ut_assertok(mmc_init(mmc));
+	dev_desc = mmc_get_blk_desc(mmc);
+	ut_assert(mmc->cfg->host_caps & MMC_CAP_CQE);
+
+	/* cover three tasks, one of them partial */
+	blocks = CONFIG_MMC_CQE_TASK_SIZE * 2 * 5 / 2;
+	ut_assert(blocks <= dev_desc->lba);
+	write = malloc(blocks * dev_desc->blksz);
+	read = malloc(blocks * dev_desc->blksz);
+	ut_assertnonnull(write);
+	ut_assertnonnull(read);
+	for (i = 0; i < blocks * dev_desc->blksz; i++)
+		write[i] = i * 7;
+
+	/* the sandbox card is an SD card, so pretend it can queue commands */
+	mmc->cmdq_depth = 16;
+	ut_asserteq(blocks, blk_dwrite(dev_desc, 0, blocks, write));
+	ut_asserteq(3, sandbox_mmc_cqe_max_queued(mmc->dev));
+
+	/* read it back with the legacy commands */
+	mmc->cmdq_depth = 0;
+	ut_asserteq(blocks, blk_dread(dev_desc, 0, blocks, read));
+	ut_asserteq_mem(write, read, blocks * dev_desc->blksz);
+
+	/* and with the command queue, limited by the card's depth */
+	memset(read, '\0', blocks * dev_desc->blksz);
+	blkcache_invalidate(dev_desc->if_type, dev_desc->devnum);
+	mmc->cmdq_depth = 2;
+	ut_asserteq(blocks, blk_dread(dev_desc, 0, blocks, read));
+	ut_asserteq_mem(write, read, blocks * dev_desc->blksz);
+	mmc->cmdq_depth = 0;
+
+	free(read);
+	free(write);
+
+	return 0;
+}
+DM_TEST(dm_test_mmc_cqe, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+#endif
@@ -190,6 +190,23 @@ static int dm_test_virtio_ring(struct unit_test_state *uts)
 	ut_asserteq(6, len);
 	ut_assertok(virtio_del_vqs(dev));
 
+	/* a multi-element buffer only takes one slot when indirect */
+	ut_assertok(virtio_find_vqs(dev, 1, &vq));
+	vq->indirect = true;
+	len = vq->num_free;
+	ut_assertok(virtqueue_add(vq, sgs, 1, 1));
+	ut_asserteq(len - 1, vq->num_free);
+	ut_asserteq(VRING_DESC_F_INDIRECT,
+		    virtio16_to_cpu(dev, vq->vring.desc[0].flags));
+	ut_asserteq(2 * sizeof(struct vring_desc),
+		    virtio32_to_cpu(dev, vq->vring.desc[0].len));
+	vq->vring.used->idx = 1;
+	vq->vring.used->ring[0].id = 0;
+	vq->vring.used->ring[0].len = 0;
+	ut_asserteq_ptr(buffer[0], virtqueue_get_buf(vq, &len));
+	ut_assertnull(vq->vring_desc_shadow[0].indir_desc);
+	ut_assertok(virtio_del_vqs(dev));
+
 	return 0;
 }
 DM_TEST(dm_test_virtio_ring, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
@@ -0,0 +1,92 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Test the CRC32 implementation against a bit-at-a-time reference
+ */
+
+#include <common.h>
+#include <u-boot/crc.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+#define TEST_BUF_SIZE	1024
+
+/* Straightforward bitwise CRC32, for comparison */
+static u32 crc32_ref(u32 crc, const u8 *buf, uint len)
+{
+	int i;
+
+	crc = ~crc;
+	while (len--) {
+		crc ^= *buf++;
+		for (i = 0; i < 8; i++)
+			crc = (crc >> 1) ^ (crc & 1 ? 0xedb88320 : 0);
+	}
+
+	return ~crc;
+}
+
+static void fill_buf(u8 *buf, uint len)
+{
+	u32 x = 0x12345678;
+
+	while (len--) {
+		x = x * 1103515245 + 12345;
+		*buf++ = x >> 16;
+	}
+}
+
+static int lib_test_crc32_check(struct unit_test_state *uts)
+{
+	ut_asserteq(0xcbf43926, crc32(0, (const u8 *)"123456789", 9));
+	ut_asserteq(0, crc32(0, NULL, 0));
+
+	return 0;
+}
+LIB_TEST(lib_test_crc32_check, 0);
+
+/* Every start alignment and length around the 4- and 8-byte steps */
+static int lib_test_crc32_align(struct unit_test_state *uts)
+{
+	u8 buf[TEST_BUF_SIZE];
+	uint off, len;
+
+	fill_buf(buf, sizeof(buf));
+	for (off = 0; off < 16; off++) {
+		for (len = 0; len < 80; len++) {
+			ut_asserteq(crc32_ref(0, buf + off, len),
+				    crc32(0, buf + off, len));
+			ut_asserteq(crc32_ref(0xdeadbeef, buf + off, len),
+				    crc32(0xdeadbeef, buf + off, len));
+		}
+		len = sizeof(buf) - off;
+		ut_asserteq(crc32_ref(0, buf + off, len),
+			    crc32(0, buf + off, len));
+	}
+
+	return 0;
+}
+LIB_TEST(lib_test_crc32_align, 0);
+
+/* Splitting the input must not change the result */
+static int lib_test_crc32_split(struct unit_test_state *uts)
+{
+	u8 buf[TEST_BUF_SIZE];
+	u32 expect, crc;
+	uint split;
+
+	fill_buf(buf, sizeof(buf));
+	expect = crc32_ref(0, buf, sizeof(buf));
+	for (split = 0; split <= sizeof(buf); split += 13) {
+		crc = crc32(0, buf, split);
+		crc = crc32(crc, buf + split, sizeof(buf) - split);
+		ut_asserteq(expect, crc);
+	}
+
+	/* crc32_no_comp() is crc32() without the inversions */
+	ut_asserteq(~crc32_ref(0, buf, sizeof(buf)),
+		    crc32_no_comp(~0U, buf, sizeof(buf)));
+
+	return 0;
+}
+LIB_TEST(lib_test_crc32_split, 0);
@@ -279,6 +279,7 @@ def fs_obj_basic(request, u_boot_config):
 
     small_file = mount_dir + '/' + SMALL_FILE
     big_file = mount_dir + '/' + BIG_FILE
+    comp_file = mount_dir + '/' + COMP_FILE
 
     try:
 
@@ -323,6 +324,15 @@ def fs_obj_basic(request, u_boot_config):
         check_call('dd if=/dev/urandom of=%s bs=1M count=1'
 	    % small_file, shell=True)
 
+        # Create a file holding the small file followed by 2MB of zeroes,
+        # and compressed copies of it, which take more than one read chunk.
+        # The tests needing bzip2 or lz4 are skipped if the tool is missing.
+        check_call('dd if=/dev/zero bs=1M count=2 2> /dev/null | '
+            'cat %s - > %s' % (small_file, comp_file), shell=True)
+        check_call('gzip -c %s > %s.gz' % (comp_file, comp_file), shell=True)
+        call('bzip2 -c %s > %s.bz2' % (comp_file, comp_file), shell=True)
+        call('lz4 -c %s > %s.lz4' % (comp_file, comp_file), shell=True)
+
         # Delete the small file copies which possibly are written as part of a
         # previous test.
         # check_call('rm -f "%s.w"' % MB1, shell=True)
@@ -12,5 +12,9 @@ MEDIUM_FILE='10MB.file'
 # $BIG_FILE is the name of the 2.5GB file in the file system image
 BIG_FILE='2.5GB.file'
 
+# $COMP_FILE is the name of the 3MB file in the file system image, of which
+# $COMP_FILE.gz, .bz2 and .lz4 are compressed copies
+COMP_FILE='3MB.file'
+
 ADDR=0x01000008
 LENGTH=0x00100000
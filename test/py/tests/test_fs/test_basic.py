@@ -290,3 +290,120 @@ class TestFsBasic(object):
                 'setenv filesize'])
             assert(md5val[0] in ''.join(output))
             assert_fs_integrity(fs_type, fs_img)
+
+    @pytest.mark.buildconfigspec('fs_load_hash')
+    @pytest.mark.buildconfigspec('cmd_crc32')
+    def test_fs14(self, u_boot_console, fs_obj_basic):
+        """
+        Test Case 14 - load with -h, hashing the file while it is read
+        """
+        fs_type,fs_img,md5val = fs_obj_basic
+        with u_boot_console.log.section('Test Case 14a - load -h (small)'):
+            # Test Case 14a - digest of a whole small file
+            output = u_boot_console.run_command_list([
+                'host bind 0 %s' % fs_img,
+                'load -h crc32 host 0:0 %x /%s' % (ADDR, SMALL_FILE),
+                'crc32 %x $filesize' % ADDR,
+                'printenv filehash'])
+            crc = re.search('==> ([0-9a-f]{8})', ''.join(output)).group(1)
+            assert('filehash=%s' % crc in ''.join(output))
+
+        with u_boot_console.log.section('Test Case 14b - load -h (offset)'):
+            # Test Case 14b - digest of the last 3MB of the big file,
+            # read in several chunks
+            output = u_boot_console.run_command_list([
+                'load -h crc32 host 0:0 %x /%s 0x300000 0x9c100000'
+                    % (ADDR, BIG_FILE),
+                'crc32 %x $filesize' % ADDR,
+                'printenv filehash',
+                'setenv filehash'])
+            assert('3145728 bytes read' in ''.join(output))
+            crc = re.search('==> ([0-9a-f]{8})', ''.join(output)).group(1)
+            assert('filehash=%s' % crc in ''.join(output))
+
+    def load_decomp(self, u_boot_console, name):
+        """
+        Load a file with -z, returning the output and the crc32 of the result
+        """
+        output = u_boot_console.run_command_list([
+            'mw.b %x 00 0x300000' % ADDR,
+            'load -z host 0:0 %x /%s' % (ADDR, name),
+            'printenv filesize',
+            'crc32 %x $filesize' % ADDR,
+            'setenv filesize'])
+        crc = re.search('==> ([0-9a-f]{8})', ''.join(output)).group(1)
+        return ''.join(output), crc
+
+    @pytest.mark.buildconfigspec('fs_load_decomp')
+    @pytest.mark.buildconfigspec('cmd_crc32')
+    def test_fs15(self, u_boot_console, fs_obj_basic):
+        """
+        Test Case 15 - load with -z, decompressing the file while it is read
+        """
+        fs_type,fs_img,md5val = fs_obj_basic
+        with u_boot_console.log.section('Test Case 15a - load -z (plain)'):
+            # Test Case 15a - an uncompressed file is loaded as it is
+            output = u_boot_console.run_command_list([
+                'host bind 0 %s' % fs_img,
+                'load host 0:0 %x /%s' % (ADDR, COMP_FILE),
+                'crc32 %x $filesize' % ADDR])
+            crc = re.search('==> ([0-9a-f]{8})', ''.join(output)).group(1)
+            output, crc_z = self.load_decomp(u_boot_console, COMP_FILE)
+            assert('filesize=300000' in output)
+            assert(crc_z == crc)
+
+        with u_boot_console.log.section('Test Case 15b - load -z (gzip)'):
+            # Test Case 15b - gzip is decompressed a chunk at a time
+            output, crc_z = self.load_decomp(u_boot_console, COMP_FILE + '.gz')
+            assert('3145728 bytes uncompressed' in output)
+            assert('filesize=300000' in output)
+            assert(crc_z == crc)
+
+        with u_boot_console.log.section('Test Case 15c - load -z -h'):
+            # Test Case 15c - -z cannot be combined with -h
+            output = u_boot_console.run_command(
+                'load -z -h crc32 host 0:0 %x /%s.gz' % (ADDR, COMP_FILE))
+            assert('Usage' in output)
+
+    @pytest.mark.buildconfigspec('fs_load_decomp')
+    @pytest.mark.buildconfigspec('cmd_crc32')
+    @pytest.mark.buildconfigspec('lz4')
+    @pytest.mark.requiredtool('lz4')
+    def test_fs16(self, u_boot_console, fs_obj_basic):
+        """
+        Test Case 16 - load with -z, lz4 file
+        """
+        fs_type,fs_img,md5val = fs_obj_basic
+        with u_boot_console.log.section('Test Case 16 - load -z (lz4)'):
+            # Test Case 16 - lz4 is decompressed a chunk at a time
+            output = u_boot_console.run_command_list([
+                'host bind 0 %s' % fs_img,
+                'load host 0:0 %x /%s' % (ADDR, COMP_FILE),
+                'crc32 %x $filesize' % ADDR])
+            crc = re.search('==> ([0-9a-f]{8})', ''.join(output)).group(1)
+            output, crc_z = self.load_decomp(u_boot_console, COMP_FILE + '.lz4')
+            assert('3145728 bytes uncompressed' in output)
+            assert('filesize=300000' in output)
+            assert(crc_z == crc)
+
+    @pytest.mark.buildconfigspec('fs_load_decomp')
+    @pytest.mark.buildconfigspec('cmd_crc32')
+    @pytest.mark.buildconfigspec('bzip2')
+    @pytest.mark.requiredtool('bzip2')
+    def test_fs17(self, u_boot_console, fs_obj_basic):
+        """
+        Test Case 17 - load with -z, bzip2 file collected in free memory
+        """
+        fs_type,fs_img,md5val = fs_obj_basic
+        with u_boot_console.log.section('Test Case 17 - load -z (bzip2)'):
+            # Test Case 17 - bzip2 has no streaming decoder, so the file is
+            # read to the top of the free memory and decompressed from there
+            output = u_boot_console.run_command_list([
+                'host bind 0 %s' % fs_img,
+                'load host 0:0 %x /%s' % (ADDR, COMP_FILE),
+                'crc32 %x $filesize' % ADDR])
+            crc = re.search('==> ([0-9a-f]{8})', ''.join(output)).group(1)
+            output, crc_z = self.load_decomp(u_boot_console, COMP_FILE + '.bz2')
+            assert('3145728 bytes uncompressed' in output)
+            assert('filesize=300000' in output)
+            assert(crc_z == crc)
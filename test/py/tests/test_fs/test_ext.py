@@ -10,6 +10,7 @@ This test verifies extended write operation on file system.
 
 import pytest
 import re
+from subprocess import check_call
 from fstest_defs import *
 from fstest_helpers import assert_fs_integrity
 
@@ -317,3 +318,57 @@ class TestFsExt(object):
             assert('FILE0123456789_79' in output)
 
             assert_fs_integrity(fs_type, fs_img)
+
+    @pytest.mark.buildconfigspec('fat_write_back')
+    def test_fs_ext12(self, u_boot_console, fs_obj_ext):
+        """
+        Test Case 12 - overwrite and append across fragments, with the FAT
+        written back at the end of each operation
+        """
+        fs_type,fs_img,md5val = fs_obj_ext
+        with u_boot_console.log.section('Test Case 12 - write (fragmented)'):
+            # Test Case 12a - Grow two files in turn, so that each append
+            # finds the next cluster taken by the other file
+            output = u_boot_console.run_command_list([
+                'host bind 0 %s' % fs_img,
+                '%sload host 0:0 %x /%s' % (fs_type, ADDR, MIN_FILE)])
+            for i in range(0, 5):
+                for name in ['frag.a', 'frag.b']:
+                    output = u_boot_console.run_command(
+                        '%swrite host 0:0 %x /dir1/%s 0x1000 0x%x'
+                        % (fs_type, ADDR + i * 0x1000, name, i * 0x1000))
+                    assert('4096 bytes written' in output)
+
+            # Test Case 12b - Check md5 of both fragmented files
+            for name in ['frag.a', 'frag.b']:
+                output = u_boot_console.run_command_list([
+                    'mw.b %x 00 100' % ADDR,
+                    '%sload host 0:0 %x /dir1/%s' % (fs_type, ADDR, name),
+                    'md5sum %x $filesize' % ADDR,
+                    'setenv filesize'])
+                assert(md5val[0] in ''.join(output))
+
+            # Test Case 12c - Overwrite across the fragments and append
+            output = u_boot_console.run_command_list([
+                '%sload host 0:0 %x /%s' % (fs_type, ADDR, MIN_FILE),
+                '%swrite host 0:0 %x /dir1/frag.a $filesize 0x1400'
+                    % (fs_type, ADDR)])
+            assert('20480 bytes written' in ''.join(output))
+
+            # Test Case 12d - Check size and md5 of the result
+            output = u_boot_console.run_command_list([
+                'mw.b %x 00 100' % ADDR,
+                '%sload host 0:0 %x /dir1/frag.a' % (fs_type, ADDR),
+                'printenv filesize',
+                'md5sum %x $filesize' % ADDR,
+                'setenv filesize'])
+            assert('filesize=6400' in ''.join(output))
+            assert(md5val[1] in ''.join(output))
+
+            # Test Case 12e - The other file is left as it was
+            output = u_boot_console.run_command_list([
+                '%sload host 0:0 %x /dir1/frag.b' % (fs_type, ADDR),
+                'md5sum %x $filesize' % ADDR,
+                'setenv filesize'])
+            assert(md5val[0] in ''.join(output))
+            check_call('fsck.fat -n %s' % fs_img, shell=True)
@@ -0,0 +1,144 @@
+# SPDX-License-Identifier: GPL-2.0+
+#
+# U-Boot File System: ext4 directory index test
+
+"""
+This test looks names up in an ext4 directory with a two-level hash index.
+"""
+
+import os
+import pytest
+import shutil
+import subprocess
+
+HTREE_SRC_DIR = 'htree_src_dir'
+HTREE_IMAGE_NAME = 'htree.img'
+
+# Fixed hash seed, so that the names below collide
+HASH_SEED = '1b6f3c5e-8f2a-4d1c-9e7b-2a4c6e8f0a1d'
+
+# Long names leave room for only a few entries per 1KiB leaf block, so that
+# the index needs two levels and colliding names often straddle two leaves
+NAME_PAD = 'h' * 198
+
+# Pairs of name prefixes whose names have the same half_md4 hash with
+# HASH_SEED. e2fsck -D puts some pairs on either side of a leaf boundary,
+# marking the second leaf as a continuation of the first.
+COLLISIONS = [
+    (0x1b6c26, 0x26bdf5), (0x058f39, 0x062ef9), (0x062144, 0x34b17e),
+    (0x2fdfa3, 0x3ad31d), (0x1effff, 0x25a75b), (0x0fe594, 0x2da0cc),
+    (0x2ef332, 0x3fd57b), (0x30d536, 0x34c2c1), (0x0abc78, 0x2ffb8a),
+    (0x0eeb34, 0x21ca09), (0x2bc300, 0x377f56), (0x03e07c, 0x380550),
+    (0x018981, 0x28a8b5), (0x15ab2f, 0x3902d5), (0x2e4635, 0x3f2e87),
+    (0x1e3b4e, 0x3e0864), (0x00125b, 0x3e6dae), (0x297c3c, 0x3606b0),
+    (0x101afd, 0x1c0262), (0x005595, 0x0bd360), (0x03deef, 0x2d37f2),
+    (0x0efed1, 0x3e312c), (0x28c757, 0x2b4ef1), (0x0bd996, 0x270f01),
+    (0x164574, 0x2c85cd), (0x04be08, 0x356cb8), (0x1e6bd5, 0x3afd13),
+    (0x00b6fb, 0x2a5831), (0x02a21d, 0x264c99), (0x232bc4, 0x3ccf26),
+    (0x12eb89, 0x390abc), (0x004c58, 0x06a6c9), (0x07f179, 0x2a64e5),
+    (0x18ccc0, 0x352f55), (0x2a93b4, 0x2c9c9b), (0x308d68, 0x3cb376),
+    (0x13ff74, 0x19475a), (0x256393, 0x31e563), (0x104265, 0x1ee0a8),
+    (0x005128, 0x2d5521), (0x0f987a, 0x2a5c79), (0x067675, 0x1faa2e),
+    (0x095460, 0x30981a), (0x03bbdb, 0x14d819), (0x1df8b1, 0x20acc6),
+    (0x16237d, 0x1b5b66), (0x088cdd, 0x37d7e9), (0x13eadc, 0x37781e),
+]
+
+# Both names of these pairs are created, only the first of the others
+BOTH_PRESENT = 40
+
+NR_FILLERS = 600
+
+def collision_name(prefix):
+    return '%06x-' % prefix
+
+def filler_name(i):
+    return 'f%05d-' % i
+
+def make_htree_image(build_dir):
+    """
+    Makes an ext4 image with a directory /htree holding the colliding names
+    and enough other entries to need a two-level index.
+    """
+    root = os.path.join(build_dir, HTREE_SRC_DIR)
+    htree = os.path.join(root, 'htree')
+    os.makedirs(htree)
+
+    for i, (first, second) in enumerate(COLLISIONS):
+        open(os.path.join(htree, collision_name(first) + NAME_PAD),
+             'w').close()
+        if i < BOTH_PRESENT:
+            open(os.path.join(htree, collision_name(second) + NAME_PAD),
+                 'w').close()
+    for i in range(NR_FILLERS):
+        open(os.path.join(htree, filler_name(i) + NAME_PAD), 'w').close()
+
+    image_path = os.path.join(build_dir, HTREE_IMAGE_NAME)
+    subprocess.run(['mkfs.ext4', '-q', '-b', '1024', '-N', '2048',
+                    '-O', 'dir_index', '-E', 'hash_seed=' + HASH_SEED,
+                    '-d', root, image_path, '8M'], check=True,
+                   stdout=subprocess.DEVNULL)
+
+    # Rebuild the directory as a hash index, packing the leaf blocks
+    ret = subprocess.run(['e2fsck', '-fyD', image_path],
+                         stdout=subprocess.DEVNULL).returncode
+    assert ret < 4
+
+def clean_htree_image(build_dir):
+    """
+    Deletes the image and src_dir at build_dir.
+    """
+    shutil.rmtree(os.path.join(build_dir, HTREE_SRC_DIR))
+    os.remove(os.path.join(build_dir, HTREE_IMAGE_NAME))
+
+def htree_lookup(u_boot_console, prefix):
+    """
+    Returns whether the name with the given prefix is found in /htree.
+    """
+    out = u_boot_console.run_command(
+        'size host 0:0 /htree/%s${pad} && echo found' % prefix)
+    return 'found' in out
+
+def htree_run_all_tests(u_boot_console):
+    """
+    Runs all test cases.
+    """
+    u_boot_console.run_command('setenv pad %s' % NAME_PAD)
+
+    # Names spread over the whole index
+    for i in range(0, NR_FILLERS, 37):
+        assert htree_lookup(u_boot_console, filler_name(i))
+
+    # Colliding names, including those on continuation leaves
+    for i, (first, second) in enumerate(COLLISIONS):
+        assert htree_lookup(u_boot_console, collision_name(first))
+        assert htree_lookup(u_boot_console, collision_name(second)) == \
+            (i < BOTH_PRESENT)
+
+    # Absent names, before, between and after the present ones
+    for prefix in ['000000-', 'f00000', 'f00300-x', 'zzzzzz-']:
+        assert not htree_lookup(u_boot_console, prefix)
+
+    u_boot_console.run_command('setenv pad')
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('cmd_fs_generic')
+@pytest.mark.buildconfigspec('ext4_htree')
+@pytest.mark.requiredtool('mkfs.ext4')
+@pytest.mark.requiredtool('e2fsck')
+
+def test_ext4_htree(u_boot_console):
+    """
+    Executes the ext4 directory index test suite.
+    """
+    build_dir = u_boot_console.config.build_dir
+
+    try:
+        make_htree_image(build_dir)
+        image_path = os.path.join(build_dir, HTREE_IMAGE_NAME)
+        u_boot_console.run_command('host bind 0 {}'.format(image_path))
+        htree_run_all_tests(u_boot_console)
+    except:
+        clean_htree_image(build_dir)
+        raise AssertionError
+
+    clean_htree_image(build_dir)
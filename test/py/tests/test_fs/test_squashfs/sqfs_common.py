@@ -66,14 +66,20 @@ def init_standard_table():
     for key, value in zip(STANDARD_TABLE.keys(), opts_list):
         STANDARD_TABLE[key] = value
 
-def generate_file(file_name, file_size):
+# files in frags/: three of them fill most of a 128KiB fragment block, so
+# they are spread over more fragment blocks than the driver caches
+FRAG_FILES = 12
+FRAG_FILE_SIZE = 40000
+
+def generate_file(file_name, file_size, char='x'):
     """ Generates a file filled with 'x'.
 
     Args:
         file_name: the file's name.
         file_size: the content's length and therefore the file size.
+        char: the character to fill the file with.
     """
-    content = 'x' * file_size
+    content = char * file_size
 
     file = open(file_name, 'w')
     file.write(content)
@@ -89,13 +95,18 @@ def generate_sqfs_src_dir(build_dir):
     ├── f1000
     ├── f4096
     ├── f5096
+    ├── frags/
+    │   ├── frag00
+    │   ├── ...
+    │   └── frag11
     ├── subdir/
     │   └── subdir-file
     └── sym -> subdir
 
-    3 directories, 4 files
+    4 directories, 16 files
 
     The files in the root dir. are prefixed with an 'f' followed by its size.
+    The files in frags/ each hold a different character.
 
     Args:
         build_dir: u-boot's build-sandbox directory.
@@ -117,6 +128,13 @@ def generate_sqfs_src_dir(build_dir):
     file_name = 'f1000'
     generate_file(os.path.join(root, file_name), 1000)
 
+    # files packed into several fragment blocks
+    frags_path = os.path.join(root, 'frags')
+    os.makedirs(frags_path)
+    for i in range(FRAG_FILES):
+        generate_file(os.path.join(frags_path, 'frag%02d' % i), FRAG_FILE_SIZE,
+                      chr(ord('a') + i))
+
     # sub-directory with a single file inside
     subdir_path = os.path.join(root, 'subdir')
     os.makedirs(subdir_path)
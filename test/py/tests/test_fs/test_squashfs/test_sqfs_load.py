@@ -10,6 +10,7 @@ from sqfs_common import SQFS_SRC_DIR, STANDARD_TABLE
 from sqfs_common import generate_sqfs_src_dir, make_all_images
 from sqfs_common import clean_sqfs_src_dir, clean_all_images
 from sqfs_common import check_mksquashfs_version
+from sqfs_common import FRAG_FILES, FRAG_FILE_SIZE
 
 @pytest.mark.requiredtool('md5sum')
 def original_md5sum(path):
@@ -92,6 +93,39 @@ def sqfs_load_files_at_subdir(u_boot_console):
     address = '$kernel_addr_r'
     sqfs_load_files(u_boot_console, files, sizes, address)
 
+def sqfs_load_files_in_fragments(u_boot_console):
+    """ Calls sqfs_load_files passing files spread over several fragment blocks.
+
+    The files are loaded in order, then in reverse order and then every third
+    one, so that decompressed fragment blocks are both found in the cache and
+    evicted from it.
+
+    Args:
+        u_boot_console: provides the means to interact with U-Boot's console.
+    """
+    frags = ['frags/frag%02d' % i for i in range(FRAG_FILES)]
+    order = frags + frags[::-1] + frags[::3]
+    sizes = [str(FRAG_FILE_SIZE)] * len(order)
+    address = '$kernel_addr_r'
+    sqfs_load_files(u_boot_console, order, sizes, address)
+
+def sqfs_load_same_paths(u_boot_console):
+    """ Calls sqfs_load_files passing the same paths several times.
+
+    The filesystem stays mounted between the commands, so later lookups go
+    through the cached metadata blocks, including those of a symlink target.
+
+    Args:
+        u_boot_console: provides the means to interact with U-Boot's console.
+    """
+    files = ['subdir/subdir-file', 'f5096', 'frags/frag07', 'f1000']
+    sizes = ['100', '5096', str(FRAG_FILE_SIZE), '1000']
+    address = '$kernel_addr_r'
+    for _ in range(3):
+        sqfs_load_files(u_boot_console, files, sizes, address)
+        out = u_boot_console.run_command('sqfsload host 0 {} sym/subdir-file'.format(address))
+        assert '100' in out
+
 def sqfs_load_non_existent_file(u_boot_console):
     """ Calls sqfs_load_files passing an non-existent file to raise an error.
 
@@ -114,6 +148,8 @@ def sqfs_run_all_load_tests(u_boot_console):
     """
     sqfs_load_files_at_root(u_boot_console)
     sqfs_load_files_at_subdir(u_boot_console)
+    sqfs_load_files_in_fragments(u_boot_console)
+    sqfs_load_same_paths(u_boot_console)
     sqfs_load_non_existent_file(u_boot_console)
 
 @pytest.mark.boardspec('sandbox')
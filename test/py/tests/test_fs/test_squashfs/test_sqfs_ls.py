@@ -9,6 +9,7 @@ from sqfs_common import STANDARD_TABLE
 from sqfs_common import generate_sqfs_src_dir, make_all_images
 from sqfs_common import clean_sqfs_src_dir, clean_all_images
 from sqfs_common import check_mksquashfs_version
+from sqfs_common import FRAG_FILES, FRAG_FILE_SIZE
 
 def sqfs_ls_at_root(u_boot_console):
     """ Runs sqfsls at image's root.
@@ -25,7 +26,7 @@ def sqfs_ls_at_root(u_boot_console):
     assert no_slash == slash
 
     expected_lines = ['empty-dir/', '1000   f1000', '4096   f4096', '5096   f5096',
-                      'subdir/', '<SYM>   sym', '4 file(s), 2 dir(s)']
+                      'frags/', 'subdir/', '<SYM>   sym', '4 file(s), 3 dir(s)']
 
     output = u_boot_console.run_command('sqfsls host 0')
     for line in expected_lines:
@@ -73,6 +74,26 @@ def sqfs_ls_at_symlink(u_boot_console):
     for line in expected_lines:
         assert line in output
 
+def sqfs_ls_repeated(u_boot_console):
+    """ Runs sqfsls several times on the same directories.
+
+    The filesystem stays mounted between the commands, so the later listings
+    come from cached metadata blocks and must not differ from the first one.
+
+    Args:
+        u_boot_console: provides the means to interact with U-Boot's console.
+    """
+    first = u_boot_console.run_command('sqfsls host 0 frags')
+    expected_lines = ['%d   frag%02d' % (FRAG_FILE_SIZE, i) for i in range(FRAG_FILES)]
+    expected_lines.append('%d file(s), 0 dir(s)' % FRAG_FILES)
+    for line in expected_lines:
+        assert line in first
+
+    for _ in range(3):
+        assert u_boot_console.run_command('sqfsls host 0 sym') == \
+            u_boot_console.run_command('sqfsls host 0 subdir')
+        assert u_boot_console.run_command('sqfsls host 0 frags') == first
+
 def sqfs_ls_at_non_existent_dir(u_boot_console):
     """ Runs sqfsls at a file and at a non-existent directory.
 
@@ -98,6 +119,7 @@ def sqfs_run_all_ls_tests(u_boot_console):
     sqfs_ls_at_empty_dir(u_boot_console)
     sqfs_ls_at_subdir(u_boot_console)
     sqfs_ls_at_symlink(u_boot_console)
+    sqfs_ls_repeated(u_boot_console)
     sqfs_ls_at_non_existent_dir(u_boot_console)
 
 @pytest.mark.boardspec('sandbox')